@@ -0,0 +1,863 @@
+/* broker.c
+ *
+ * Copyright (C) 2006-2022 wolfSSL Inc.
+ *
+ * This file is part of wolfTPM.
+ *
+ * wolfTPM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfTPM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+/* Local TPM broker daemon. The broker owns the TPM device and serves many
+ * client processes (wolfTPM built with --enable-broker) over a Unix-domain
+ * socket. Transient objects and sessions are private to the client that
+ * created them: the client sees virtual object handles, and the broker swaps
+ * each client's objects and sessions in and out with ContextLoad /
+ * ContextSave around every command. Client sockets are non-blocking and
+ * each client has its own receive and send buffer, so a client that sends
+ * part of a command or stops reading never holds up the others. Clients with
+ * a complete command are served round-robin, one command each per turn.
+ * See docs/BROKER.md */
+
+#include <wolftpm/tpm2_wrap.h>
+#include <wolftpm/tpm2_broker.h>
+
+#include <stdio.h>
+
+#if !defined(WOLFTPM2_NO_WRAPPER) && !defined(WOLFTPM_BROKER) && \
+    !defined(_WIN32)
+
+#include <examples/broker/broker.h>
+#include <hal/tpm_io.h>
+#include <examples/tpm_test.h>
+
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#ifndef BROKER_MAX_CLIENTS
+#define BROKER_MAX_CLIENTS  16
+#endif
+#ifndef BROKER_MAX_OBJECTS
+#define BROKER_MAX_OBJECTS  8   /* transient objects per client */
+#endif
+#ifndef BROKER_MAX_SESSIONS
+#define BROKER_MAX_SESSIONS 3   /* sessions per client */
+#endif
+#ifndef BROKER_GROUP
+#define BROKER_GROUP        "tss" /* group allowed to connect */
+#endif
+
+/* Virtual transient handle: 0x80, 16-bit client id, 8-bit object index.
+ * Client ids start at 1, so they never collide with TPM handles. */
+#define BROKER_VHANDLE(id, idx) \
+    (TRANSIENT_FIRST | (((word32)(id) & 0xFFFF) << 8) | (word32)(idx))
+
+typedef struct BrokerObject {
+    TPM_HANDLE vHandle;     /* handle seen by the client, 0 when free */
+    TPM_HANDLE hndl;        /* TPM handle while loaded, 0 when saved */
+    TPMS_CONTEXT context;   /* saved context */
+} BrokerObject;
+
+typedef struct BrokerSession {
+    TPM_HANDLE hndl;        /* session handle (kept when saved), 0 when free */
+    int isSaved;
+    int clientSaved;        /* saved by the client, which holds the context */
+    TPMS_CONTEXT context;
+} BrokerSession;
+
+typedef struct BrokerUsage {
+    word32 commands;
+    word32 errors;          /* TPM returned an error */
+    word32 rejected;        /* refused by the broker */
+    word32 swaps;           /* contexts loaded for this client */
+    word32 tpmMs;           /* time spent in the TPM */
+    unsigned long bytesIn;
+    unsigned long bytesOut;
+} BrokerUsage;
+
+typedef struct BrokerClient {
+    int fd;
+    word32 id;
+    BrokerObject obj[BROKER_MAX_OBJECTS];
+    BrokerSession sess[BROKER_MAX_SESSIONS];
+    BrokerUsage usage;
+    int rxLen;              /* bytes of the next command received so far */
+    int rxReady;            /* rx holds a complete command */
+    int txLen;              /* response size, 0 when nothing is pending */
+    int txPos;              /* bytes of the response already sent */
+    byte rx[MAX_COMMAND_SIZE];
+    byte tx[MAX_RESPONSE_SIZE];
+} BrokerClient;
+
+static BrokerClient gClients[BROKER_MAX_CLIENTS];
+static byte gBuf[XFER_MAX_SIZE];
+static word32 gNextId;
+static volatile sig_atomic_t gStop;
+static volatile sig_atomic_t gReport;
+
+/******************************************************************************/
+/* --- BEGIN TPM2.0 Broker Daemon -- */
+/******************************************************************************/
+static void usage(void)
+{
+    printf("Expected usage:\n");
+    printf("./examples/broker/broker [socket]\n");
+    printf("* socket: Unix-domain socket path (default: %s). Its directory\n"
+           "  must not be writable by other users.\n", TPM2_BROKER_PATH);
+    printf("Send SIGUSR1 to print per client usage, SIGINT to stop\n");
+}
+
+static void BrokerSignal(int sig)
+{
+    if (sig == SIGUSR1)
+        gReport = 1;
+    else
+        gStop = 1;
+}
+
+static word32 BrokerGetU32(const byte* p)
+{
+    return ((word32)p[0] << 24) | ((word32)p[1] << 16) |
+           ((word32)p[2] << 8)  |  (word32)p[3];
+}
+
+static void BrokerPutU32(byte* p, word32 v)
+{
+    p[0] = (byte)(v >> 24); p[1] = (byte)(v >> 16);
+    p[2] = (byte)(v >> 8);  p[3] = (byte)v;
+}
+
+static word32 BrokerMs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (word32)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+/* Build a header only response carrying a response code */
+static int BrokerErrorRsp(byte* buf, TPM_RC rc)
+{
+    buf[0] = (byte)(TPM_ST_NO_SESSIONS >> 8);
+    buf[1] = (byte)TPM_ST_NO_SESSIONS;
+    BrokerPutU32(&buf[2], TPM2_HEADER_SIZE);
+    BrokerPutU32(&buf[6], rc);
+    return TPM2_HEADER_SIZE;
+}
+
+static int BrokerIsSession(TPM_HANDLE h)
+{
+    return (h >> HR_SHIFT) == TPM_HT_HMAC_SESSION ||
+           (h >> HR_SHIFT) == TPM_HT_POLICY_SESSION;
+}
+
+static BrokerObject* BrokerFindObject(BrokerClient* c, TPM_HANDLE vHandle)
+{
+    int i;
+    for (i = 0; i < BROKER_MAX_OBJECTS; i++) {
+        if (c->obj[i].vHandle != 0 && c->obj[i].vHandle == vHandle)
+            return &c->obj[i];
+    }
+    return NULL;
+}
+
+static BrokerSession* BrokerFindSession(BrokerClient* c, TPM_HANDLE h)
+{
+    int i;
+    for (i = 0; i < BROKER_MAX_SESSIONS; i++) {
+        if (c->sess[i].hndl != 0 && c->sess[i].hndl == h)
+            return &c->sess[i];
+    }
+    return NULL;
+}
+
+static void BrokerFlush(TPM_HANDLE h)
+{
+    FlushContext_In in;
+    in.flushHandle = h;
+    (void)TPM2_FlushContext(&in);
+}
+
+static TPM_RC BrokerContextLoad(BrokerClient* c, TPMS_CONTEXT* context,
+    TPM_HANDLE* h)
+{
+    TPM_RC rc;
+    ContextLoad_In in;
+    ContextLoad_Out out;
+
+    XMEMCPY(&in.context, context, sizeof(in.context));
+    rc = TPM2_ContextLoad(&in, &out);
+    if (rc == TPM_RC_SUCCESS) {
+        *h = out.loadedHandle;
+        c->usage.swaps++;
+    }
+    return rc;
+}
+
+static TPM_RC BrokerContextSave(TPM_HANDLE h, TPMS_CONTEXT* context)
+{
+    TPM_RC rc;
+    ContextSave_In in;
+    ContextSave_Out out;
+
+    in.saveHandle = h;
+    rc = TPM2_ContextSave(&in, &out);
+    if (rc == TPM_RC_SUCCESS)
+        XMEMCPY(context, &out.context, sizeof(*context));
+    return rc;
+}
+
+/* Bring a session the command uses back into the TPM. Sessions the client
+ * saved itself stay with the client. */
+static TPM_RC BrokerLoadSession(BrokerClient* c, BrokerSession* s)
+{
+    TPM_RC rc = TPM_RC_SUCCESS;
+
+    if (s->isSaved && !s->clientSaved) {
+        rc = BrokerContextLoad(c, &s->context, &s->hndl);
+        if (rc == TPM_RC_SUCCESS)
+            s->isSaved = 0;
+    }
+    return rc;
+}
+
+/* Save and evict everything the client has loaded, so the TPM is free for
+ * the next client. Objects or sessions the TPM already dropped (completed
+ * sequences, sessions without continueSession) fail to save and are
+ * released. */
+static void BrokerSwapOut(BrokerClient* c)
+{
+    int i;
+    BrokerObject* obj;
+    BrokerSession* s;
+
+    for (i = 0; i < BROKER_MAX_OBJECTS; i++) {
+        obj = &c->obj[i];
+        if (obj->vHandle == 0 || obj->hndl == 0)
+            continue;
+        if (BrokerContextSave(obj->hndl, &obj->context) == TPM_RC_SUCCESS) {
+            BrokerFlush(obj->hndl);
+        }
+        else {
+            obj->vHandle = 0;
+        }
+        obj->hndl = 0;
+    }
+    for (i = 0; i < BROKER_MAX_SESSIONS; i++) {
+        s = &c->sess[i];
+        if (s->hndl == 0 || s->isSaved)
+            continue;
+        /* a saved session keeps its handle, no flush needed */
+        if (BrokerContextSave(s->hndl, &s->context) == TPM_RC_SUCCESS)
+            s->isSaved = 1;
+        else
+            s->hndl = 0;
+    }
+}
+
+/* Translate one command handle to the TPM handle */
+static TPM_RC BrokerMapHandle(BrokerClient* c, TPM_HANDLE* h)
+{
+    TPM_RC rc = TPM_RC_SUCCESS;
+    BrokerObject* obj;
+    BrokerSession* s;
+
+    if ((*h >> HR_SHIFT) == TPM_HT_TRANSIENT) {
+        obj = BrokerFindObject(c, *h);
+        if (obj == NULL)
+            return TPM_RC_HANDLE;
+        if (obj->hndl == 0)
+            rc = BrokerContextLoad(c, &obj->context, &obj->hndl);
+        if (rc == TPM_RC_SUCCESS)
+            *h = obj->hndl;
+    }
+    else if (BrokerIsSession(*h)) {
+        s = BrokerFindSession(c, *h);
+        if (s == NULL)
+            return TPM_RC_HANDLE;
+        rc = BrokerLoadSession(c, s);
+    }
+    return rc;
+}
+
+/* Record a handle returned by the TPM and translate it for the client */
+static TPM_RC BrokerTrackHandle(BrokerClient* c, TPM_HANDLE* h)
+{
+    int i;
+
+    if ((*h >> HR_SHIFT) == TPM_HT_TRANSIENT) {
+        for (i = 0; i < BROKER_MAX_OBJECTS; i++) {
+            if (c->obj[i].vHandle == 0) {
+                c->obj[i].vHandle = BROKER_VHANDLE(c->id, i);
+                c->obj[i].hndl = *h;
+                *h = c->obj[i].vHandle;
+                return TPM_RC_SUCCESS;
+            }
+        }
+        return TPM_RC_OBJECT_MEMORY;
+    }
+    if (BrokerIsSession(*h)) {
+        for (i = 0; i < BROKER_MAX_SESSIONS; i++) {
+            if (c->sess[i].hndl == 0) {
+                c->sess[i].hndl = *h;
+                c->sess[i].isSaved = 0;
+                return TPM_RC_SUCCESS;
+            }
+        }
+        return TPM_RC_SESSION_MEMORY;
+    }
+    return TPM_RC_SUCCESS;
+}
+
+/* Sessions in the authorization area must belong to the client, they are
+ * loaded for the command */
+static TPM_RC BrokerCheckAuth(BrokerClient* c, const byte* buf, int pos,
+    int cmdSz)
+{
+    TPM_RC rc;
+    int end, n = 0;
+    word32 authSz, sz;
+    TPM_HANDLE h;
+    BrokerSession* s;
+
+    if (pos + 4 > cmdSz)
+        return TPM_RC_AUTHSIZE;
+    authSz = BrokerGetU32(&buf[pos]);
+    pos += 4;
+    if (authSz > (word32)(cmdSz - pos))
+        return TPM_RC_AUTHSIZE;
+    end = pos + (int)authSz;
+
+    while (pos < end) {
+        n++;
+        if (pos + 4 + 2 > end)
+            return TPM_RC_AUTHSIZE;
+        h = BrokerGetU32(&buf[pos]);
+        pos += 4;
+        if (h != TPM_RS_PW) {
+            s = BrokerFindSession(c, h);
+            if (s == NULL)
+                return TPM_RC_HANDLE + TPM_RC_S + (TPM_RC_1 * n);
+            rc = BrokerLoadSession(c, s);
+            if (rc != TPM_RC_SUCCESS)
+                return rc;
+        }
+        sz = ((word32)buf[pos] << 8) | buf[pos+1];  /* nonce */
+        pos += 2 + (int)sz + 1;                     /* attributes */
+        if (pos + 2 > end)
+            return TPM_RC_AUTHSIZE;
+        sz = ((word32)buf[pos] << 8) | buf[pos+1];  /* hmac */
+        pos += 2 + (int)sz;
+    }
+    return (pos == end) ? TPM_RC_SUCCESS : TPM_RC_AUTHSIZE;
+}
+
+/* Commands that change the state of the whole TPM are left to the broker */
+static int BrokerIsDenied(TPM_CC cc)
+{
+    switch (cc) {
+        case TPM_CC_Startup:
+        case TPM_CC_Shutdown:
+        case TPM_CC_Clear:
+            return 1;
+        default:
+            break;
+    }
+    return 0;
+}
+
+/* A session context may only be loaded by the client that saved it. Returns
+ * that session, NULL for object contexts. */
+static TPM_RC BrokerCheckContextLoad(BrokerClient* c, const byte* buf,
+    int cmdSz, BrokerSession** sess)
+{
+    TPM_HANDLE h;
+    BrokerSession* s;
+
+    *sess = NULL;
+    /* TPMS_CONTEXT: sequence (8), savedHandle (4), ... */
+    if (cmdSz < TPM2_HEADER_SIZE + 8 + 4)
+        return TPM_RC_COMMAND_SIZE;
+    h = BrokerGetU32(&buf[TPM2_HEADER_SIZE + 8]);
+    if (!BrokerIsSession(h))
+        return TPM_RC_SUCCESS;
+    s = BrokerFindSession(c, h);
+    if (s == NULL || !s->clientSaved)
+        return TPM_RC_HANDLE + TPM_RC_P + TPM_RC_1;
+    *sess = s;
+    return TPM_RC_SUCCESS;
+}
+
+/* TPM2_FlushContext carries its handle in the parameter area */
+static int BrokerFlushContext(WOLFTPM2_DEV* dev, BrokerClient* c, byte* buf,
+    int cmdSz)
+{
+    TPM_RC rc = TPM_RC_HANDLE + TPM_RC_P + TPM_RC_1;
+    TPM_HANDLE h;
+    BrokerObject* obj;
+    BrokerSession* s;
+    int rspSz;
+
+    if (cmdSz != TPM2_HEADER_SIZE + 4)
+        return BrokerErrorRsp(buf, TPM_RC_COMMAND_SIZE);
+    h = BrokerGetU32(&buf[TPM2_HEADER_SIZE]);
+
+    obj = BrokerFindObject(c, h);
+    if (obj != NULL) {
+        /* objects are only held as saved contexts between commands */
+        if (obj->hndl != 0)
+            BrokerFlush(obj->hndl);
+        XMEMSET(obj, 0, sizeof(*obj));
+        rc = TPM_RC_SUCCESS;
+    }
+    s = BrokerFindSession(c, h);
+    if (s != NULL) {
+        rc = TPM2_SendRawCommand(&dev->ctx, buf, cmdSz, (int)sizeof(gBuf),
+            &rspSz);
+        if (rc == TPM_RC_SUCCESS) {
+            rc = BrokerGetU32(&buf[6]);
+            if (rc == TPM_RC_SUCCESS)
+                s->hndl = 0;
+            return rspSz;
+        }
+        rc = TPM_RC_FAILURE;
+    }
+    if (rc != TPM_RC_SUCCESS)
+        c->usage.rejected++;
+    return BrokerErrorRsp(buf, rc);
+}
+
+/* Run one client command in gBuf, returns the response size */
+static int BrokerProcess(WOLFTPM2_DEV* dev, BrokerClient* c, int cmdSz)
+{
+    TPM_RC rc;
+    byte* buf = gBuf;
+    TPM_ST tag;
+    TPM_CC cc;
+    TPM_HANDLE h;
+    BrokerSession* s = NULL;
+    BrokerSession* saved = NULL;
+    int i, inCnt = 0, outCnt = 0, rspSz = 0;
+    word32 start;
+
+    tag = (TPM_ST)(((word32)buf[0] << 8) | buf[1]);
+    cc = BrokerGetU32(&buf[6]);
+
+    rc = TPM2_GetCommandHandleCount(cc, &inCnt, &outCnt);
+    if (rc == TPM_RC_SUCCESS && BrokerIsDenied(cc))
+        rc = TPM_RC_COMMAND_CODE;
+    if (rc == TPM_RC_SUCCESS && cmdSz < TPM2_HEADER_SIZE + inCnt * 4)
+        rc = TPM_RC_COMMAND_SIZE;
+    if (rc == TPM_RC_SUCCESS && cc == TPM_CC_FlushContext)
+        return BrokerFlushContext(dev, c, buf, cmdSz);
+    if (rc == TPM_RC_SUCCESS && cc == TPM_CC_ContextLoad)
+        rc = BrokerCheckContextLoad(c, buf, cmdSz, &s);
+    if (rc == TPM_RC_SUCCESS && cc == TPM_CC_ContextSave) {
+        /* the client keeps the context of its own session */
+        saved = BrokerFindSession(c, BrokerGetU32(&buf[TPM2_HEADER_SIZE]));
+    }
+
+    for (i = 0; i < inCnt && rc == TPM_RC_SUCCESS; i++) {
+        h = BrokerGetU32(&buf[TPM2_HEADER_SIZE + i * 4]);
+        rc = BrokerMapHandle(c, &h);
+        if (rc == TPM_RC_HANDLE)
+            rc += TPM_RC_H + (TPM_RC_1 * (i + 1));
+        BrokerPutU32(&buf[TPM2_HEADER_SIZE + i * 4], h);
+    }
+    if (rc == TPM_RC_SUCCESS && tag == TPM_ST_SESSIONS) {
+        rc = BrokerCheckAuth(c, buf, TPM2_HEADER_SIZE + inCnt * 4, cmdSz);
+    }
+
+    if (rc != TPM_RC_SUCCESS) {
+        c->usage.rejected++;
+        rspSz = BrokerErrorRsp(buf, rc);
+    }
+    else {
+        start = BrokerMs();
+        rc = TPM2_SendRawCommand(&dev->ctx, buf, cmdSz, (int)sizeof(gBuf),
+            &rspSz);
+        c->usage.tpmMs += BrokerMs() - start;
+        if (rc != TPM_RC_SUCCESS) {
+            rspSz = BrokerErrorRsp(buf, TPM_RC_FAILURE);
+        }
+        rc = BrokerGetU32(&buf[6]);
+        if (rc != TPM_RC_SUCCESS) {
+            c->usage.errors++;
+        }
+        else if (saved != NULL) {
+            saved->isSaved = 1;
+            saved->clientSaved = 1;
+        }
+        else if (s != NULL) {
+            /* the client's session is loaded again under its handle */
+            s->isSaved = 0;
+            s->clientSaved = 0;
+        }
+        else if (outCnt > 0 && rspSz >= TPM2_HEADER_SIZE + 4) {
+            h = BrokerGetU32(&buf[TPM2_HEADER_SIZE]);
+            rc = BrokerTrackHandle(c, &h);
+            if (rc == TPM_RC_SUCCESS) {
+                BrokerPutU32(&buf[TPM2_HEADER_SIZE], h);
+            }
+            else {
+                BrokerFlush(h);
+                c->usage.rejected++;
+                rspSz = BrokerErrorRsp(buf, rc);
+            }
+        }
+    }
+
+    BrokerSwapOut(c);
+    return rspSz;
+}
+
+/* Reads what the client has sent of its next command without blocking.
+ * Returns 0 while connected (rxReady is set once the command is complete),
+ * -1 when the client is gone or sent a size that cannot be framed. */
+static int BrokerRecv(BrokerClient* c)
+{
+    ssize_t r;
+    int need;
+
+    while (!c->rxReady) {
+        need = TPM2_HEADER_SIZE;
+        if (c->rxLen >= TPM2_HEADER_SIZE) {
+            need = (int)BrokerGetU32(&c->rx[2]);
+            if (need < TPM2_HEADER_SIZE || need > (int)sizeof(c->rx))
+                return -1; /* cannot resynchronize the stream */
+            if (c->rxLen == need) {
+                c->rxReady = 1;
+                break;
+            }
+        }
+        r = read(c->fd, &c->rx[c->rxLen], need - c->rxLen);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (r <= 0)
+            return -1;
+        c->rxLen += (int)r;
+    }
+    return 0;
+}
+
+/* Sends as much of the pending response as the socket takes */
+static int BrokerSend(BrokerClient* c)
+{
+    ssize_t r;
+
+    while (c->txPos < c->txLen) {
+        r = write(c->fd, &c->tx[c->txPos], c->txLen - c->txPos);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+        if (r <= 0)
+            return -1;
+        c->txPos += (int)r;
+    }
+    c->txLen = 0;
+    c->txPos = 0;
+    return 0;
+}
+
+static void BrokerPrintUsage(BrokerClient* c)
+{
+    printf("Client %u: commands %u, errors %u, rejected %u, swaps %u, "
+        "TPM %u ms, in %lu bytes, out %lu bytes\n",
+        c->id, c->usage.commands, c->usage.errors, c->usage.rejected,
+        c->usage.swaps, c->usage.tpmMs, c->usage.bytesIn, c->usage.bytesOut);
+}
+
+static void BrokerDropClient(BrokerClient* c)
+{
+    int i;
+
+    /* saved objects vanish with their contexts, saved sessions need a flush */
+    for (i = 0; i < BROKER_MAX_SESSIONS; i++) {
+        if (c->sess[i].hndl != 0)
+            BrokerFlush(c->sess[i].hndl);
+    }
+    BrokerPrintUsage(c);
+    close(c->fd);
+    XMEMSET(c, 0, sizeof(*c));
+    c->fd = -1;
+}
+
+/* Run the client's buffered command and queue the response */
+static int BrokerServe(WOLFTPM2_DEV* dev, BrokerClient* c)
+{
+    int cmdSz, rspSz;
+
+    cmdSz = c->rxLen;
+    XMEMCPY(gBuf, c->rx, cmdSz);
+    c->rxLen = 0;
+    c->rxReady = 0;
+
+    c->usage.commands++;
+    c->usage.bytesIn += cmdSz;
+    rspSz = BrokerProcess(dev, c, cmdSz);
+    if (rspSz > (int)sizeof(c->tx))
+        rspSz = BrokerErrorRsp(gBuf, TPM_RC_SIZE);
+    c->usage.bytesOut += rspSz;
+
+    XMEMCPY(c->tx, gBuf, rspSz);
+    c->txLen = rspSz;
+    c->txPos = 0;
+    return BrokerSend(c);
+}
+
+static void BrokerAccept(int lfd)
+{
+    int i, fd;
+
+    fd = accept(lfd, NULL, NULL);
+    if (fd < 0)
+        return;
+    if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK) != 0) {
+        close(fd);
+        return;
+    }
+    for (i = 0; i < BROKER_MAX_CLIENTS; i++) {
+        if (gClients[i].fd < 0) {
+            if (++gNextId > 0xFFFF)
+                gNextId = 1;
+            gClients[i].fd = fd;
+            gClients[i].id = gNextId;
+            printf("Client %u connected\n", gNextId);
+            return;
+        }
+    }
+    printf("Broker full, refusing client\n");
+    close(fd);
+}
+
+/* Another user who can write the socket directory could bind the path first
+ * and pose as the TPM, so only listen in a directory that is private to the
+ * broker and its clients, such as /run/wolftpm */
+static int BrokerCheckDir(const char* path)
+{
+    char dir[sizeof(((struct sockaddr_un*)0)->sun_path)];
+    struct stat st;
+    int i;
+
+    /* path length was checked against sun_path */
+    i = (int)XSTRLEN(path);
+    while (i > 0 && path[i - 1] != '/')
+        i--;
+    if (i == 0) {
+        dir[0] = '.';
+        i = 1;
+    }
+    else if (i == 1) {
+        dir[0] = '/';
+    }
+    else {
+        i--; /* drop the trailing separator */
+        XMEMCPY(dir, path, i);
+    }
+    dir[i] = '\0';
+
+    if (stat(dir, &st) != 0) {
+        printf("Socket directory %s missing, errno %d\n", dir, errno);
+        return -1;
+    }
+    if (st.st_mode & S_IWOTH) {
+        printf("Socket directory %s is writable by other users\n", dir);
+        return -1;
+    }
+    return 0;
+}
+
+/* Only the owner and BROKER_GROUP may connect */
+static void BrokerSetPerms(const char* path)
+{
+    struct group* grp = getgrnam(BROKER_GROUP);
+
+    if (grp == NULL || chown(path, (uid_t)-1, grp->gr_gid) != 0) {
+        printf("Group %s not set on socket, only the owner can connect\n",
+            BROKER_GROUP);
+        (void)chmod(path, S_IRUSR | S_IWUSR);
+        return;
+    }
+    (void)chmod(path, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+}
+
+int TPM2_Broker_Daemon(void* userCtx, int argc, char *argv[])
+{
+    int rc;
+    WOLFTPM2_DEV dev;
+    const char* path = TPM2_BROKER_PATH;
+    struct sockaddr_un addr;
+    struct pollfd pfd[BROKER_MAX_CLIENTS + 1];
+    int lfd = -1, i, k, turn = 0;
+    mode_t mask;
+    BrokerClient* c;
+
+    if (argc >= 2) {
+        if (XSTRCMP(argv[1], "-?") == 0 ||
+            XSTRCMP(argv[1], "-h") == 0 ||
+            XSTRCMP(argv[1], "--help") == 0) {
+            usage();
+            return 0;
+        }
+        path = argv[1];
+    }
+    if (XSTRLEN(path) >= sizeof(addr.sun_path)) {
+        printf("Socket path too long\n");
+        return BAD_FUNC_ARG;
+    }
+    if (BrokerCheckDir(path) != 0)
+        return BAD_FUNC_ARG;
+
+    printf("TPM2.0 Broker daemon on %s\n", path);
+
+    for (i = 0; i < BROKER_MAX_CLIENTS; i++) {
+        XMEMSET(&gClients[i], 0, sizeof(gClients[i]));
+        gClients[i].fd = -1;
+    }
+
+    rc = wolfTPM2_Init(&dev, TPM2_IoCb, userCtx);
+    if (rc != TPM_RC_SUCCESS) {
+        printf("wolfTPM2_Init failed 0x%x: %s\n", rc, TPM2_GetRCString(rc));
+        return rc;
+    }
+    /* start from a TPM without transient objects or sessions */
+    rc = wolfTPM2_UnloadHandles_All(&dev);
+    if (rc != 0) goto exit;
+
+    XMEMSET(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    XMEMCPY(addr.sun_path, path, XSTRLEN(path));
+    unlink(path);
+    lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    /* nobody may connect before the group is set */
+    mask = umask(S_IRWXG | S_IRWXO);
+    if (lfd < 0 ||
+        bind(lfd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        umask(mask);
+        printf("Failed to bind %s, errno %d\n", path, errno);
+        rc = SOCKET_ERROR_E;
+        goto exit;
+    }
+    umask(mask);
+    BrokerSetPerms(path);
+    if (listen(lfd, BROKER_MAX_CLIENTS) != 0) {
+        printf("Failed to listen on %s, errno %d\n", path, errno);
+        rc = SOCKET_ERROR_E;
+        goto exit;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, BrokerSignal);
+    signal(SIGTERM, BrokerSignal);
+    signal(SIGUSR1, BrokerSignal);
+
+    while (!gStop) {
+        pfd[0].fd = lfd;
+        pfd[0].events = POLLIN;
+        for (i = 0; i < BROKER_MAX_CLIENTS; i++) {
+            c = &gClients[i];
+            pfd[i+1].fd = c->fd; /* negative fds are ignored */
+            pfd[i+1].events = (c->txLen > 0) ? POLLOUT :
+                              (c->rxReady ? 0 : POLLIN);
+            pfd[i+1].revents = 0;
+        }
+        if (poll(pfd, BROKER_MAX_CLIENTS + 1, 1000) < 0 && errno != EINTR) {
+            rc = SOCKET_ERROR_E;
+            break;
+        }
+
+        if (gReport) {
+            gReport = 0;
+            for (i = 0; i < BROKER_MAX_CLIENTS; i++) {
+                if (gClients[i].fd >= 0)
+                    BrokerPrintUsage(&gClients[i]);
+            }
+        }
+
+        /* move data without blocking on any one client */
+        for (i = 0; i < BROKER_MAX_CLIENTS; i++) {
+            c = &gClients[i];
+            if (c->fd < 0 || pfd[i+1].revents == 0)
+                continue;
+            if (((pfd[i+1].revents & POLLOUT) && BrokerSend(c) != 0) ||
+                ((pfd[i+1].revents & (POLLIN|POLLHUP|POLLERR|POLLNVAL)) &&
+                    BrokerRecv(c) != 0)) {
+                printf("Client %u disconnected\n", c->id);
+                BrokerDropClient(c);
+            }
+        }
+
+        /* one command per client with a complete command, rotating the
+         * first one served */
+        for (k = 0; k < BROKER_MAX_CLIENTS; k++) {
+            i = (turn + k) % BROKER_MAX_CLIENTS;
+            c = &gClients[i];
+            if (c->fd < 0 || !c->rxReady || c->txLen > 0)
+                continue;
+            if (BrokerServe(&dev, c) != 0) {
+                printf("Client %u disconnected\n", c->id);
+                BrokerDropClient(c);
+            }
+        }
+        turn = (turn + 1) % BROKER_MAX_CLIENTS;
+
+        if (pfd[0].revents & POLLIN)
+            BrokerAccept(lfd);
+    }
+
+exit:
+    for (i = 0; i < BROKER_MAX_CLIENTS; i++) {
+        if (gClients[i].fd >= 0)
+            BrokerDropClient(&gClients[i]);
+    }
+    if (lfd >= 0) {
+        close(lfd);
+        unlink(path);
+    }
+    wolfTPM2_Cleanup(&dev);
+    return rc;
+}
+
+/******************************************************************************/
+/* --- END TPM2.0 Broker Daemon -- */
+/******************************************************************************/
+#endif /* !WOLFTPM2_NO_WRAPPER && !WOLFTPM_BROKER && !_WIN32 */
+
+#ifndef NO_MAIN_DRIVER
+int main(int argc, char *argv[])
+{
+    int rc = NOT_COMPILED_IN;
+
+#if !defined(WOLFTPM2_NO_WRAPPER) && !defined(WOLFTPM_BROKER) && \
+    !defined(_WIN32)
+    rc = TPM2_Broker_Daemon(NULL, argc, argv);
+#else
+    printf("Broker daemon not compiled in (requires a direct TPM interface)\n");
+    (void)argc;
+    (void)argv;
+#endif
+
+    return rc;
+}
+#endif
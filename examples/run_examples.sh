@@ -362,6 +362,27 @@ if [ $WOLFCRYPT_ENABLE -eq 1 ]; then
     rm -f sealedkeyblob.bin
 fi
 
+# Envelope encryption (sealed data key, host AES-GCM)
+if [ $WOLFCRYPT_ENABLE -eq 1 ]; then
+    echo -e "Envelope encrypt/decrypt"
+    head -c 50000 /dev/urandom > envelope.in
+    ./examples/seal/envelope -e envelope.in envelope.bin >> run.out
+    RESULT=$?
+    [ $RESULT -ne 0 ] && echo -e "envelope encrypt failed! $RESULT" && exit 1
+    ./examples/seal/envelope -d envelope.bin envelope.out >> run.out
+    RESULT=$?
+    [ $RESULT -ne 0 ] && echo -e "envelope decrypt failed! $RESULT" && exit 1
+    cmp envelope.in envelope.out
+    RESULT=$?
+    [ $RESULT -ne 0 ] && echo -e "envelope data mismatch! $RESULT" && exit 1
+    # altered header (base nonce) must fail authentication
+    dd if=/dev/zero of=envelope.bin bs=1 seek=5 count=12 conv=notrunc 2>/dev/null
+    ./examples/seal/envelope -d envelope.bin envelope.out >> run.out
+    RESULT=$?
+    [ $RESULT -eq 0 ] && echo -e "envelope altered header accepted!" && exit 1
+    rm -f envelope.in envelope.bin envelope.out
+fi
+
 # Seal/Unseal (Policy auth)
 echo -e "Seal/Unseal (Policy auth)"
 if [ $WOLFCRYPT_ENABLE -eq 1 ]; then
@@ -0,0 +1,287 @@
+/* envelope.c
+ *
+ * Copyright (C) 2006-2022 wolfSSL Inc.
+ *
+ * This file is part of wolfTPM.
+ *
+ * wolfTPM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfTPM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+/* This example demonstrates envelope encryption of a file. A random data key
+ * is sealed by the TPM and stored in the file header. The file contents are
+ * encrypted on the host with AES-GCM, so the TPM is used once per file. */
+
+#include <wolftpm/tpm2_wrap.h>
+
+#include <stdio.h>
+
+#if !defined(WOLFTPM2_NO_WRAPPER) && !defined(WOLFTPM2_NO_WOLFCRYPT) && \
+    defined(HAVE_AESGCM) && !defined(NO_SHA256) && !defined(NO_FILESYSTEM)
+
+#include <examples/seal/seal.h>
+#include <hal/tpm_io.h>
+#include <examples/tpm_test.h>
+#include <examples/tpm_test_keys.h>
+
+/* File: envelope header, then records of:
+ *   length (4 bytes big endian, high bit set on final record) |
+ *   cipher text | tag (WOLFTPM2_ENVELOPE_TAG_SZ) */
+#ifndef ENVELOPE_CHUNK_SZ
+#define ENVELOPE_CHUNK_SZ   (16 * 1024)
+#endif
+#define ENVELOPE_FINAL_FLAG 0x80000000UL
+
+/******************************************************************************/
+/* --- BEGIN TPM2.0 Envelope Encryption Example -- */
+/******************************************************************************/
+static void usage(void)
+{
+    printf("Expected usage:\n");
+    printf("./examples/seal/envelope [-e/-d] [infile] [outfile]\n");
+    printf("* -e: Encrypt infile to outfile (default)\n");
+    printf("* -d: Decrypt infile to outfile\n");
+    printf("* infile: Input file (default: envelope.in)\n");
+    printf("* outfile: Output file (default: envelope.bin)\n");
+}
+
+static int EnvelopeEncryptFile(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* storage,
+    XFILE fin, XFILE fout, byte* in, byte* out)
+{
+    int rc;
+    WOLFTPM2_ENVELOPE env;
+    byte hdr[4 + sizeof(WOLFTPM2_KEYBLOB)];
+    byte tag[WOLFTPM2_ENVELOPE_TAG_SZ];
+    size_t len, next;
+    word32 rec;
+    int isFinal;
+
+    rc = wolfTPM2_EnvelopeCreate(dev, &env, &storage->handle,
+        (const byte*)gKeyAuth, sizeof(gKeyAuth)-1);
+    if (rc != 0) return rc;
+
+    rc = wolfTPM2_EnvelopeGetHeader(&env, hdr, (word32)sizeof(hdr));
+    if (rc > 0) {
+        if (XFWRITE(hdr, 1, rc, fout) != (size_t)rc)
+            rc = BUFFER_E;
+        else
+            rc = 0;
+    }
+
+    /* read ahead one chunk to know which record is the final one */
+    len = XFREAD(in, 1, ENVELOPE_CHUNK_SZ, fin);
+    while (rc == 0) {
+        next = 0;
+        if (len == ENVELOPE_CHUNK_SZ) {
+            next = XFREAD(out, 1, ENVELOPE_CHUNK_SZ, fin);
+        }
+        isFinal = (next == 0);
+
+        rc = wolfTPM2_EnvelopeEncrypt(&env, in, (word32)len, in, tag, isFinal);
+        if (rc != 0) break;
+
+        rec = (word32)len | (isFinal ? ENVELOPE_FINAL_FLAG : 0);
+        hdr[0] = (byte)(rec >> 24); hdr[1] = (byte)(rec >> 16);
+        hdr[2] = (byte)(rec >> 8);  hdr[3] = (byte)(rec);
+        if (XFWRITE(hdr, 1, 4, fout) != 4 ||
+            XFWRITE(in, 1, len, fout) != len ||
+            XFWRITE(tag, 1, sizeof(tag), fout) != sizeof(tag)) {
+            rc = BUFFER_E;
+            break;
+        }
+        if (isFinal)
+            break;
+
+        XMEMCPY(in, out, next);
+        len = next;
+    }
+
+    wolfTPM2_EnvelopeFree(&env);
+    return rc;
+}
+
+static int EnvelopeDecryptFile(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* storage,
+    XFILE fin, XFILE fout, byte* in, byte* out)
+{
+    int rc;
+    WOLFTPM2_ENVELOPE env;
+    byte hdr[4 + sizeof(WOLFTPM2_KEYBLOB)];
+    byte tag[WOLFTPM2_ENVELOPE_TAG_SZ];
+    word32 rec, len;
+    int isFinal = 0;
+
+    /* fixed header part ends with the size of the sealed key blob */
+    if (XFREAD(hdr, 1, WOLFTPM2_ENVELOPE_HDR_SZ, fin) !=
+                                                    WOLFTPM2_ENVELOPE_HDR_SZ) {
+        return BUFFER_E;
+    }
+    len = ((word32)hdr[WOLFTPM2_ENVELOPE_HDR_SZ-2] << 8) |
+                   hdr[WOLFTPM2_ENVELOPE_HDR_SZ-1];
+    if (len > sizeof(hdr) - WOLFTPM2_ENVELOPE_HDR_SZ ||
+        XFREAD(&hdr[WOLFTPM2_ENVELOPE_HDR_SZ], 1, len, fin) != len) {
+        return BUFFER_E;
+    }
+    rc = wolfTPM2_EnvelopeSetHeader(&env, hdr, WOLFTPM2_ENVELOPE_HDR_SZ + len);
+    if (rc < 0) return rc;
+
+    rc = wolfTPM2_EnvelopeOpen(dev, &env, &storage->handle,
+        (const byte*)gKeyAuth, sizeof(gKeyAuth)-1);
+    while (rc == 0 && !isFinal) {
+        if (XFREAD(hdr, 1, 4, fin) != 4) {
+            rc = BUFFER_E; /* truncated */
+            break;
+        }
+        rec = ((word32)hdr[0] << 24) | ((word32)hdr[1] << 16) |
+              ((word32)hdr[2] << 8)  |  (word32)hdr[3];
+        isFinal = (rec & ENVELOPE_FINAL_FLAG) != 0;
+        len = rec & ~ENVELOPE_FINAL_FLAG;
+        if (len > ENVELOPE_CHUNK_SZ ||
+            XFREAD(in, 1, len, fin) != len ||
+            XFREAD(tag, 1, sizeof(tag), fin) != sizeof(tag)) {
+            rc = BUFFER_E;
+            break;
+        }
+
+        rc = wolfTPM2_EnvelopeDecrypt(&env, in, len, out, tag, isFinal);
+        if (rc == 0 && XFWRITE(out, 1, len, fout) != len) {
+            rc = BUFFER_E;
+        }
+    }
+
+    wolfTPM2_EnvelopeFree(&env);
+    return rc;
+}
+
+int TPM2_Envelope_Example(void* userCtx, int argc, char *argv[])
+{
+    int rc;
+    WOLFTPM2_DEV dev;
+    WOLFTPM2_KEY storage; /* SRK */
+    const char* inFile = "envelope.in";
+    const char* outFile = "envelope.bin";
+    int doDecrypt = 0;
+    int i, argPos = 0;
+    XFILE fin = XBADFILE;
+    XFILE fout = XBADFILE;
+    byte* in = NULL;
+    byte* out = NULL;
+
+    XMEMSET(&dev, 0, sizeof(dev));
+    XMEMSET(&storage, 0, sizeof(storage));
+
+    if (argc >= 2) {
+        if (XSTRCMP(argv[1], "-?") == 0 ||
+            XSTRCMP(argv[1], "-h") == 0 ||
+            XSTRCMP(argv[1], "--help") == 0) {
+            usage();
+            return 0;
+        }
+    }
+    for (i = 1; i < argc; i++) {
+        if (XSTRCMP(argv[i], "-d") == 0) {
+            doDecrypt = 1;
+        }
+        else if (XSTRCMP(argv[i], "-e") == 0) {
+            doDecrypt = 0;
+        }
+        else if (argv[i][0] == '-') {
+            printf("Warning: Unrecognized option: %s\n", argv[i]);
+        }
+        else if (argPos++ == 0) {
+            inFile = argv[i];
+        }
+        else {
+            outFile = argv[i];
+        }
+    }
+
+    printf("TPM2.0 Envelope Encryption example\n");
+    printf("\t%s: %s -> %s\n", doDecrypt ? "Decrypt" : "Encrypt",
+        inFile, outFile);
+
+    in = (byte*)XMALLOC(ENVELOPE_CHUNK_SZ, NULL, DYNAMIC_TYPE_TMP_BUFFER);
+    out = (byte*)XMALLOC(ENVELOPE_CHUNK_SZ, NULL, DYNAMIC_TYPE_TMP_BUFFER);
+    if (in == NULL || out == NULL) {
+        rc = MEMORY_E;
+        goto exit;
+    }
+
+    rc = wolfTPM2_Init(&dev, TPM2_IoCb, userCtx);
+    if (rc != TPM_RC_SUCCESS) {
+        printf("wolfTPM2_Init failed 0x%x: %s\n", rc, TPM2_GetRCString(rc));
+        goto exit;
+    }
+
+    rc = getPrimaryStoragekey(&dev, &storage, TPM_ALG_RSA);
+    if (rc != 0) goto exit;
+
+    fin = XFOPEN(inFile, "rb");
+    fout = XFOPEN(outFile, "wb");
+    if (fin == XBADFILE || fout == XBADFILE) {
+        printf("Error opening files\n");
+        rc = BUFFER_E;
+        goto exit;
+    }
+
+    if (doDecrypt) {
+        rc = EnvelopeDecryptFile(&dev, &storage, fin, fout, in, out);
+    }
+    else {
+        rc = EnvelopeEncryptFile(&dev, &storage, fin, fout, in, out);
+    }
+    if (rc != 0) {
+        printf("Envelope %s failed %d: %s\n", doDecrypt ? "decrypt" : "encrypt",
+            rc, wolfTPM2_GetRCString(rc));
+    }
+    else {
+        printf("Envelope %s success\n", doDecrypt ? "decrypt" : "encrypt");
+    }
+
+exit:
+    if (fin != XBADFILE)
+        XFCLOSE(fin);
+    if (fout != XBADFILE)
+        XFCLOSE(fout);
+    XFREE(in, NULL, DYNAMIC_TYPE_TMP_BUFFER);
+    XFREE(out, NULL, DYNAMIC_TYPE_TMP_BUFFER);
+
+    wolfTPM2_UnloadHandle(&dev, &storage.handle);
+    wolfTPM2_Cleanup(&dev);
+    return rc;
+}
+
+/******************************************************************************/
+/* --- END TPM2.0 Envelope Encryption Example -- */
+/******************************************************************************/
+
+#endif /* !WOLFTPM2_NO_WRAPPER && !WOLFTPM2_NO_WOLFCRYPT && HAVE_AESGCM &&
+        * !NO_SHA256 */
+
+#ifndef NO_MAIN_DRIVER
+int main(int argc, char *argv[])
+{
+    int rc = -1;
+
+#if !defined(WOLFTPM2_NO_WRAPPER) && !defined(WOLFTPM2_NO_WOLFCRYPT) && \
+    defined(HAVE_AESGCM) && !defined(NO_SHA256) && !defined(NO_FILESYSTEM)
+    rc = TPM2_Envelope_Example(NULL, argc, argv);
+#else
+    printf("Wrapper or AES-GCM code not compiled in\n");
+    (void)argc;
+    (void)argv;
+#endif
+
+    return rc;
+}
+#endif
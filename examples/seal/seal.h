@@ -29,6 +29,7 @@
 int TPM2_Seal_Example(void* userCtx, int argc, char *argv[]);
 int TPM2_Unseal_Example(void* userCtx, int argc, char *argv[]);
 int TPM2_PCR_Seal_With_Policy_Auth_Test(void* userCtx, int argc, char *argv[]);
+int TPM2_Envelope_Example(void* userCtx, int argc, char *argv[]);
 
 #ifdef __cplusplus
     }  /* extern "C" */
@@ -34,6 +34,11 @@
 
 #define RSA_FILENAME  "rsa_test_blob.raw"
 #define ECC_FILENAME  "ecc_test_blob.raw"
+/* A transient SRK context is only kept on disk when this environment variable
+ * names a directory for it (e.g. one only the TPM user can write) */
+#define SRK_CTX_DIR_ENV      "WOLFTPM_SRK_CTX_DIR"
+#define SRK_RSA_CTX_FILENAME "srk_rsa.ctx"
+#define SRK_ECC_CTX_FILENAME "srk_ecc.ctx"
 
 #ifndef WOLFTPM2_NO_WRAPPER
 
@@ -329,40 +334,74 @@ int getPrimaryStoragekey(WOLFTPM2_DEV* pDev, WOLFTPM2_KEY* pStorageKey,
 {
     int rc;
     TPM_HANDLE handle;
-
-    if (alg == TPM_ALG_RSA)
+    const char* ctxFile;
+    const char* ctxDir = NULL;
+    char ctxPath[256];
+    TPMS_CONTEXT savedCtx;
+    word32 savedCtxSz = (word32)sizeof(savedCtx);
+    UINT64 savedSeq = 0;
+    int haveCtx = 0;
+
+    if (alg == TPM_ALG_RSA) {
         handle = TPM2_DEMO_STORAGE_KEY_HANDLE;
-    else if (alg == TPM_ALG_ECC)
+        ctxFile = SRK_RSA_CTX_FILENAME;
+    }
+    else if (alg == TPM_ALG_ECC) {
         handle = TPM2_DEMO_STORAGE_EC_KEY_HANDLE;
+        ctxFile = SRK_ECC_CTX_FILENAME;
+    }
     else {
         printf("Invalid SRK alg %x\n", alg);
         return BAD_FUNC_ARG;
     }
 
-    /* See if SRK already exists */
-    rc = wolfTPM2_ReadPublicKey(pDev, pStorageKey, handle);
-    if (rc != 0) {
-        /* Create primary storage key */
-        rc = wolfTPM2_CreateSRK(pDev, pStorageKey, alg,
-            (byte*)gStorageKeyAuth, sizeof(gStorageKeyAuth)-1);
-    #ifndef WOLFTPM_WINAPI
-        if (rc == TPM_RC_SUCCESS) {
-            /* Move storage key into persistent NV */
-            rc = wolfTPM2_NVStoreKey(pDev, TPM_RH_OWNER, pStorageKey, handle);
-        }
-    #endif
+    /* SRK context saved when it could not be persisted (valid until reset) */
+    XMEMSET(&savedCtx, 0, sizeof(savedCtx));
+#if !defined(NO_FILESYSTEM) && !defined(NO_WRITE_TEMP_FILES)
+    ctxDir = getenv(SRK_CTX_DIR_ENV);
+    if (ctxDir != NULL && ctxDir[0] == '\0') {
+        ctxDir = NULL;
     }
-    else {
-        /* specify auth password for storage key */
-        pStorageKey->handle.auth.size = sizeof(gStorageKeyAuth)-1;
-        XMEMCPY(pStorageKey->handle.auth.buffer, gStorageKeyAuth,
-                pStorageKey->handle.auth.size);
+    if (ctxDir != NULL) {
+        size_t dirLen = XSTRLEN(ctxDir);
+        size_t fileLen = XSTRLEN(ctxFile);
+        if (dirLen + 1 + fileLen + 1 > sizeof(ctxPath)) {
+            printf("%s is too long\n", SRK_CTX_DIR_ENV);
+            return BUFFER_E;
+        }
+        XMEMCPY(ctxPath, ctxDir, dirLen);
+        ctxPath[dirLen] = '/';
+        XMEMCPY(&ctxPath[dirLen + 1], ctxFile, fileLen + 1);
+        if (readBin(ctxPath, (byte*)&savedCtx, &savedCtxSz) == 0 &&
+                savedCtxSz == (word32)sizeof(savedCtx)) {
+            haveCtx = 1;
+            savedSeq = savedCtx.sequence;
+        }
+        else {
+            XMEMSET(&savedCtx, 0, sizeof(savedCtx));
+        }
     }
+#endif
+
+    /* Use persistent or saved SRK, otherwise create and persist it */
+    rc = wolfTPM2_GetPrimaryStorageKey(pDev, pStorageKey, alg,
+    #ifndef WOLFTPM_WINAPI
+        handle,
+    #else
+        0, /* no NV storage of keys with TBS */
+    #endif
+        (byte*)gStorageKeyAuth, sizeof(gStorageKeyAuth)-1,
+        ctxDir != NULL ? &savedCtx : NULL);
     if (rc != 0) {
         printf("Loading SRK: Storage failed 0x%x: %s\n", rc,
             TPM2_GetRCString(rc));
         return rc;
     }
+    if (ctxDir != NULL && savedCtx.savedHandle != 0 &&
+            (!haveCtx || savedCtx.sequence != savedSeq)) {
+        /* newly saved context */
+        writeBin(ctxPath, (byte*)&savedCtx, (word32)sizeof(savedCtx));
+    }
     printf("Loading SRK: Storage 0x%x (%d bytes)\n",
         (word32)pStorageKey->handle.hndl, pStorageKey->pub.size);
     return rc;
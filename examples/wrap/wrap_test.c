@@ -57,6 +57,200 @@ static void usage(void)
 
 }
 
+/* Save and restore a started sequence, as a new process would. The sequence
+ * auth is not saved, so it is set again. */
+static int TPM2_Wrapper_HashSaveLoad(WOLFTPM2_DEV* dev, WOLFTPM2_HASH* hash)
+{
+    int rc;
+    byte saveBuf[sizeof(TPMS_CONTEXT) + sizeof(WOLFTPM2_HASH)];
+
+    rc = wolfTPM2_SaveHashContext(dev, hash, saveBuf, (word32)sizeof(saveBuf));
+    if (rc < 0)
+        return rc;
+    rc = wolfTPM2_LoadHashContext(dev, hash, saveBuf, (word32)rc);
+    if (rc == 0 && hash->handle.auth.size != 0) {
+        printf("Hash context: auth was exported\n");
+        rc = TPM_RC_FAILURE;
+    }
+    if (rc == 0) {
+        hash->handle.auth.size = sizeof(gUsageAuth)-1;
+        XMEMCPY(hash->handle.auth.buffer, gUsageAuth, hash->handle.auth.size);
+    }
+    return rc;
+}
+
+/* Hash and HMAC input that exactly fills one command buffer completes with
+ * a single TPM2_Hash / TPM2_HMAC (WOLFTPM2_HASH_HYBRID), one byte more
+ * switches to a sequence. Without it both sizes run as a sequence. */
+static int TPM2_Wrapper_HashThresholdTest(WOLFTPM2_DEV* dev,
+    WOLFTPM2_KEY* storageKey)
+{
+    int rc = 0, i, pass;
+    byte data[MAX_DIGEST_BUFFER + 1];
+    byte digest[TPM_SHA256_DIGEST_SIZE];
+    word32 digestSz, dataSz;
+    WOLFTPM2_HASH hash;
+    WOLFTPM2_HMAC hmac;
+    const char* hmacKey =
+        "\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b"
+        "\x0b\x0b\x0b\x0b";
+    /* SHA256 and HMAC-SHA256 of bytes (i & 0xFF) for 1024 and 1025 bytes */
+    const char* hashDig[2] = {
+        "\x78\x5b\x07\x51\xfc\x2c\x53\xdc\x14\xa4\xce\x3d\x80\x0e\x69\xef"
+        "\x9c\xe1\x00\x9e\xb3\x27\xcc\xf4\x58\xaf\xe0\x9c\x24\x2c\x26\xc9",
+        "\xb3\x98\x1d\x93\xee\xb6\x4a\xa9\x00\xf3\xe4\x8c\xfc\xd4\x8e\x9b"
+        "\xbc\x89\xb7\x77\x32\xc4\x9e\xa2\x01\xc9\x36\x56\xc6\x2b\x6a\x09"
+    };
+    const char* hmacDig[2] = {
+        "\xcf\xf7\x2b\x9f\x0a\x65\x65\x57\xcc\x0b\xe3\x5d\x89\x9c\x96\x8d"
+        "\x0b\x73\xa9\xc3\xf7\x2c\x7b\xcf\x37\xc0\x76\x84\xa6\x92\xb6\xc3",
+        "\x87\x1c\xe8\xcd\xf8\x27\x66\xe0\xff\xbc\x9c\xdd\x4e\x52\x3e\xa5"
+        "\xea\xbc\x5a\x5e\x4f\x5e\xf5\xbf\xe6\xd9\x40\x1a\xd4\x48\xc7\xfa"
+    };
+
+    for (i = 0; i < (int)sizeof(data); i++) {
+        data[i] = (byte)(i & 0xFF);
+    }
+
+    /* pass 0: one-shot, pass 1: buffered input then one byte starts the
+     * sequence */
+    for (pass = 0; pass < 2 && rc == 0; pass++) {
+        dataSz = MAX_DIGEST_BUFFER + pass;
+
+        rc = wolfTPM2_HashStart(dev, &hash, TPM_ALG_SHA256,
+            (const byte*)gUsageAuth, sizeof(gUsageAuth)-1);
+        if (rc == 0)
+            rc = wolfTPM2_HashUpdate(dev, &hash, data, MAX_DIGEST_BUFFER);
+    #ifdef WOLFTPM2_HASH_HYBRID
+        if (rc == 0 && hash.isPending == 0) {
+            printf("Hash threshold: sequence started early\n");
+            rc = TPM_RC_FAILURE;
+        }
+    #endif
+        if (rc == 0 && pass == 1) {
+            rc = wolfTPM2_HashUpdate(dev, &hash, &data[MAX_DIGEST_BUFFER], 1);
+        #ifdef WOLFTPM2_HASH_HYBRID
+            if (rc == 0 && hash.isPending) {
+                printf("Hash threshold: sequence not started\n");
+                rc = TPM_RC_FAILURE;
+            }
+        #endif
+            if (rc == 0)
+                rc = TPM2_Wrapper_HashSaveLoad(dev, &hash);
+        }
+        if (rc == 0) {
+            digestSz = (word32)sizeof(digest);
+            rc = wolfTPM2_HashFinish(dev, &hash, digest, &digestSz);
+        }
+        if (rc == 0 && (digestSz != TPM_SHA256_DIGEST_SIZE ||
+                XMEMCMP(digest, hashDig[pass], digestSz) != 0)) {
+            printf("Hash threshold test failed for %u bytes\n", dataSz);
+            rc = TPM_RC_FAILURE;
+        }
+
+        if (rc == 0) {
+            XMEMSET(&hmac, 0, sizeof(hmac));
+            rc = wolfTPM2_HmacStart(dev, &hmac, &storageKey->handle,
+                TPM_ALG_SHA256, (const byte*)hmacKey,
+                (word32)XSTRLEN(hmacKey), (const byte*)gUsageAuth,
+                sizeof(gUsageAuth)-1);
+        }
+        if (rc == 0)
+            rc = wolfTPM2_HmacUpdate(dev, &hmac, data, dataSz);
+        if (rc == 0 && pass == 1)
+            rc = TPM2_Wrapper_HashSaveLoad(dev, &hmac.hash);
+        if (rc == 0) {
+            digestSz = (word32)sizeof(digest);
+            rc = wolfTPM2_HmacFinish(dev, &hmac, digest, &digestSz);
+        }
+        if (rc == 0 && (digestSz != TPM_SHA256_DIGEST_SIZE ||
+                XMEMCMP(digest, hmacDig[pass], digestSz) != 0)) {
+            printf("HMAC threshold test failed for %u bytes\n", dataSz);
+            rc = TPM_RC_FAILURE;
+        }
+    }
+
+    return rc;
+}
+
+/* A saved policy session continues after loading, a salted session (whose
+ * key would have to be exported) is refused */
+static int TPM2_Wrapper_SessionSaveLoadTest(WOLFTPM2_DEV* dev,
+    WOLFTPM2_KEY* storageKey)
+{
+    int rc, saveSz;
+    WOLFTPM2_SESSION session;
+    TPM2B_NONCE nonceTPM;
+    byte saveBuf[sizeof(TPMS_CONTEXT) + sizeof(WOLFTPM2_SESSION)];
+    byte digest[TPM_SHA256_DIGEST_SIZE];
+    byte expect[TPM_SHA256_DIGEST_SIZE];
+    word32 digestSz = (word32)sizeof(digest);
+    word32 expectSz = (word32)sizeof(expect);
+    byte pcrArray[1] = {TPM2_TEST_PCR};
+
+    /* expected digest from a session that is not saved */
+    rc = wolfTPM2_StartSession(dev, &session, NULL, NULL, TPM_SE_POLICY,
+        TPM_ALG_NULL);
+    if (rc == 0)
+        rc = wolfTPM2_PolicyPCR(dev, session.handle.hndl, TPM_ALG_SHA256,
+            pcrArray, sizeof(pcrArray));
+    if (rc == 0)
+        rc = wolfTPM2_GetPolicyDigest(dev, session.handle.hndl, expect,
+            &expectSz);
+    wolfTPM2_UnloadHandle(dev, &session.handle);
+    if (rc != 0)
+        return rc;
+
+    rc = wolfTPM2_StartSession(dev, &session, NULL, NULL, TPM_SE_POLICY,
+        TPM_ALG_NULL);
+    if (rc != 0)
+        return rc;
+    nonceTPM = session.nonceTPM;
+    saveSz = wolfTPM2_SaveSessionContext(dev, &session, saveBuf,
+        (word32)sizeof(saveBuf));
+    if (saveSz < 0) {
+        wolfTPM2_UnloadHandle(dev, &session.handle);
+        return saveSz;
+    }
+    rc = wolfTPM2_LoadSessionContext(dev, &session, saveBuf, (word32)saveSz);
+    if (rc == 0 && (session.nonceTPM.size != nonceTPM.size ||
+            XMEMCMP(session.nonceTPM.buffer, nonceTPM.buffer,
+                nonceTPM.size) != 0 ||
+            session.nonceCaller.size != TPM_SHA256_DIGEST_SIZE)) {
+        printf("Session context: nonces not restored\n");
+        rc = TPM_RC_FAILURE;
+    }
+    if (rc == 0)
+        rc = wolfTPM2_PolicyPCR(dev, session.handle.hndl, TPM_ALG_SHA256,
+            pcrArray, sizeof(pcrArray));
+    if (rc == 0)
+        rc = wolfTPM2_GetPolicyDigest(dev, session.handle.hndl, digest,
+            &digestSz);
+    if (rc == 0 && (digestSz != expectSz ||
+            XMEMCMP(digest, expect, digestSz) != 0)) {
+        printf("Session context: policy digest mismatch\n");
+        rc = TPM_RC_FAILURE;
+    }
+    wolfTPM2_UnloadHandle(dev, &session.handle);
+    if (rc != 0)
+        return rc;
+
+    /* salted session key must not be written out */
+    rc = wolfTPM2_StartSession(dev, &session, storageKey, NULL, TPM_SE_HMAC,
+        TPM_ALG_CFB);
+    if (rc != 0)
+        return rc;
+    saveSz = wolfTPM2_SaveSessionContext(dev, &session, saveBuf,
+        (word32)sizeof(saveBuf));
+    if (saveSz != BAD_FUNC_ARG) {
+        printf("Session context: salted session was saved\n");
+        rc = TPM_RC_FAILURE;
+    }
+    wolfTPM2_UnloadHandle(dev, &session.handle);
+
+    return rc;
+}
+
 int TPM2_Wrapper_Test(void* userCtx)
 {
     return TPM2_Wrapper_TestArgs(userCtx, 0, NULL);
@@ -73,6 +267,11 @@ int TPM2_Wrapper_TestArgs(void* userCtx, int argc, char *argv[])
     WOLFTPM2_KEY publicKey;
     WOLFTPM2_KEY aesKey;
     WOLFTPM2_KEYBLOB testKey;
+    WOLFTPM2_PUBCACHE pubCache;
+    byte saveBuf[4096]; /* exported cache, saved context or signatures */
+#ifdef WOLFTPM_KEY_CACHE
+    word32 hndl;
+#endif
     byte aesIv[MAX_AES_BLOCK_SIZE_BYTES];
     WOLFTPM2_BUFFER message;
     WOLFTPM2_BUFFER cipher;
@@ -194,6 +393,17 @@ int TPM2_Wrapper_TestArgs(void* userCtx, int argc, char *argv[])
         caps.mfgStr, caps.mfg, caps.vendorStr, caps.fwVerMajor,
         caps.fwVerMinor, caps.fwVerVendor, caps.fips140_2, caps.cc_eal4);
 
+#ifdef WOLFTPM_SINGLE_FLIGHT
+    {
+        /* sequential requests are never coalesced */
+        word32 issued = 0, coalesced = 0;
+        rc = wolfTPM2_GetFlightStats(&dev, &issued, &coalesced);
+        if (rc == 0 && (issued != 1 || coalesced != 0))
+            rc = TPM_RC_FAILURE;
+        if (rc != 0) goto exit;
+    }
+#endif
+
     if (resetTPM) {
         /* reset all content on TPM and reseed */
         rc = wolfTPM2_Clear(&dev);
@@ -250,6 +460,60 @@ int TPM2_Wrapper_TestArgs(void* userCtx, int argc, char *argv[])
             storageKey.handle.auth.size);
     }
 
+    /* Persistent public cache: second process start-up reads from cache */
+    rc = wolfTPM2_PubCacheImport(&pubCache, NULL, 0);
+    if (rc == 0) {
+        rc = wolfTPM2_PubCacheReadPublicKey(&dev, &pubCache, &publicKey,
+            storageKey.handle.hndl);
+    }
+    if (rc == 0) {
+        rc = wolfTPM2_PubCacheExport(&pubCache, saveBuf,
+            (word32)sizeof(saveBuf));
+        rc = (rc > 0) ? wolfTPM2_PubCacheImport(&pubCache, saveBuf, rc) : rc;
+    }
+    if (rc == 0) {
+        rc = wolfTPM2_PubCacheReadPublicKey(&dev, &pubCache, &publicKey,
+            storageKey.handle.hndl);
+    }
+    if (rc == 0 && (publicKey.handle.name.size != storageKey.handle.name.size ||
+            XMEMCMP(publicKey.handle.name.name, storageKey.handle.name.name,
+                publicKey.handle.name.size) != 0)) {
+        printf("Public cache name mismatch\n");
+        rc = -1;
+    }
+    if (rc != 0) goto exit;
+
+#ifndef WOLFTPM_WINAPI
+    /* Re-provisioning a persistent handle must not return the old entry */
+    if (wolfTPM2_ReadPublicKey(&dev, &ekKey,
+            TPM2_DEMO_PERSISTENT_KEY_HANDLE) == 0) {
+        wolfTPM2_NVDeleteKey(&dev, TPM_RH_OWNER, &ekKey);
+    }
+    for (i = 0; i < 2 && rc == 0; i++) {
+        rc = wolfTPM2_CreateSRK(&dev, &ekKey, (i == 0) ? TPM_ALG_ECC :
+            TPM_ALG_RSA, NULL, 0);
+        if (rc == 0) {
+            rc = wolfTPM2_NVStoreKey(&dev, TPM_RH_OWNER, &ekKey,
+                TPM2_DEMO_PERSISTENT_KEY_HANDLE);
+        }
+        if (rc == 0) {
+            rc = wolfTPM2_PubCacheReadPublicKey(&dev, &pubCache, &publicKey,
+                TPM2_DEMO_PERSISTENT_KEY_HANDLE);
+        }
+        if (rc == 0 && (publicKey.handle.name.size != ekKey.handle.name.size ||
+                XMEMCMP(publicKey.handle.name.name, ekKey.handle.name.name,
+                    publicKey.handle.name.size) != 0)) {
+            printf("Public cache returned a stale entry\n");
+            rc = -1;
+        }
+        if (rc == 0) {
+            rc = wolfTPM2_NVDeleteKey(&dev, TPM_RH_OWNER, &ekKey);
+        }
+    }
+    if (rc != 0) goto exit;
+#endif
+    printf("Persistent public cache Test Passed\n");
+
     /* Start an authenticated session (salted / unbound) with parameter encryption */
     if (paramEncAlg != TPM_ALG_NULL) {
         rc = wolfTPM2_StartSession(&dev, &tpmSession, &storageKey, NULL,
@@ -282,6 +546,42 @@ int TPM2_Wrapper_TestArgs(void* userCtx, int argc, char *argv[])
         goto exit;
     }
 
+#ifdef WOLFTPM_KEY_CACHE
+    /* Loading the same key blob again should reuse the cached handle */
+    rc = wolfTPM2_CreateKey(&dev, &testKey, &storageKey.handle,
+        &publicTemplate, (byte*)gKeyAuth, sizeof(gKeyAuth)-1);
+    if (rc != 0) goto exit;
+    rc = wolfTPM2_LoadKey(&dev, &testKey, &storageKey.handle);
+    if (rc != 0) goto exit;
+    hndl = testKey.handle.hndl;
+    rc = wolfTPM2_UnloadHandle(&dev, &testKey.handle);
+    if (rc != 0) goto exit;
+    rc = wolfTPM2_LoadKey(&dev, &testKey, &storageKey.handle);
+    if (rc != 0) goto exit;
+    if (testKey.handle.hndl != hndl) {
+        printf("Key cache handle mismatch 0x%x != 0x%x\n",
+            (word32)testKey.handle.hndl, hndl);
+        rc = -1; goto exit;
+    }
+    wolfTPM2_UnloadHandle(&dev, &testKey.handle);
+    /* a cached key still requires the parent auth */
+    {
+        WOLFTPM2_HANDLE badParent;
+        XMEMCPY(&badParent, &storageKey.handle, sizeof(badParent));
+        badParent.auth.size = 4;
+        XMEMCPY(badParent.auth.buffer, "bad!", badParent.auth.size);
+        rc = wolfTPM2_LoadKey(&dev, &testKey, &badParent);
+        if (rc == 0) {
+            printf("Key cache returned a key without the parent auth\n");
+            wolfTPM2_UnloadHandle(&dev, &testKey.handle);
+            rc = -1; goto exit;
+        }
+    }
+    rc = wolfTPM2_KeyCacheFlush(&dev);
+    if (rc != 0) goto exit;
+    printf("Loaded key cache Test Passed\n");
+#endif
+
     /* Create RSA key for sign/verify */
     rc = wolfTPM2_GetKeyTemplate_RSA(&publicTemplate,
         TPMA_OBJECT_sensitiveDataOrigin | TPMA_OBJECT_userWithAuth |
@@ -315,6 +615,35 @@ int TPM2_Wrapper_TestArgs(void* userCtx, int argc, char *argv[])
     if (rc != 0) goto exit;
     printf("RSA Sign/Verify using RSA PSS padding\n");
 
+    /* Save key context, unload and resume using it */
+    rc = wolfTPM2_SaveKeyContext(&dev, &rsaKey, saveBuf, (word32)sizeof(saveBuf));
+    if (rc < 0) goto exit;
+    i = rc;
+    rc = wolfTPM2_UnloadHandle(&dev, &rsaKey.handle);
+    if (rc != 0) goto exit;
+    rc = wolfTPM2_LoadKeyContext(&dev, &rsaKey, saveBuf, (word32)i);
+    if (rc != 0) goto exit;
+    /* the key auth is not part of the saved context */
+    rc = wolfTPM2_SetKeyAuthPassword(&rsaKey, (byte*)gKeyAuth,
+        sizeof(gKeyAuth)-1);
+    if (rc != 0) goto exit;
+    cipher.size = sizeof(cipher.buffer); /* signature */
+    rc = wolfTPM2_SignHashScheme(&dev, &rsaKey, message.buffer, message.size,
+        cipher.buffer, &cipher.size, TPM_ALG_RSASSA, TPM_ALG_SHA256);
+    if (rc != 0) goto exit;
+    printf("RSA Sign after key context save/load\n");
+
+    /* Batch sign with no scheme in the key or the call uses RSASSA */
+    rc = wolfTPM2_SignHashBatch(&dev, &rsaKey, message.buffer,
+        message.size, 1, cipher.buffer, (int)sizeof(cipher.buffer),
+        TPM_ALG_NULL, TPM_ALG_SHA256, &i);
+    if (rc != 0 || i != 1) { rc = (rc != 0) ? rc : -1; goto exit; }
+    rc = wolfTPM2_VerifyHashScheme(&dev, &rsaKey, cipher.buffer,
+        rsaKey.pub.publicArea.parameters.rsaDetail.keyBits / 8,
+        message.buffer, message.size, TPM_ALG_RSASSA, TPM_ALG_SHA256);
+    if (rc != 0) goto exit;
+    printf("RSA batch sign with default scheme\n");
+
     rc = wolfTPM2_UnloadHandle(&dev, &rsaKey.handle);
     if (rc != 0) goto exit;
 
@@ -552,6 +881,21 @@ int TPM2_Wrapper_TestArgs(void* userCtx, int argc, char *argv[])
         message.buffer, message.size);
     if (rc != 0) goto exit;
 
+    /* Batch sign two digests (0x11,... and 0x22,...) */
+    XMEMSET(plain.buffer, 0x11, TPM_SHA256_DIGEST_SIZE);
+    XMEMSET(plain.buffer + TPM_SHA256_DIGEST_SIZE, 0x22,
+        TPM_SHA256_DIGEST_SIZE);
+    rc = wolfTPM2_SignHashBatch(&dev, &eccKey, plain.buffer,
+        TPM_SHA256_DIGEST_SIZE, 2, saveBuf, 64, TPM_ALG_NULL,
+        TPM_ALG_SHA256, &i);
+    if (rc != 0 || i != 2) { rc = (rc != 0) ? rc : -1; goto exit; }
+    for (i = 0; i < 2; i++) {
+        rc = wolfTPM2_VerifyHash(&dev, &eccKey, &saveBuf[i * 64], 64,
+            plain.buffer + (i * TPM_SHA256_DIGEST_SIZE),
+            TPM_SHA256_DIGEST_SIZE);
+        if (rc != 0) goto exit;
+    }
+
     rc = wolfTPM2_UnloadHandle(&dev, &eccKey.handle);
     if (rc != 0) goto exit;
 
@@ -803,6 +1147,12 @@ int TPM2_Wrapper_TestArgs(void* userCtx, int argc, char *argv[])
     if (rc != 0) goto exit;
 #endif
 
+    /* Save and restore the sequence, as a new process would */
+    rc = wolfTPM2_SaveHashContext(&dev, &hash, saveBuf, (word32)sizeof(saveBuf));
+    if (rc < 0) goto exit;
+    rc = wolfTPM2_LoadHashContext(&dev, &hash, saveBuf, (word32)rc);
+    if (rc != 0) goto exit;
+
     cipher.size = TPM_SHA256_DIGEST_SIZE;
     rc = wolfTPM2_HashFinish(&dev, &hash, cipher.buffer, (word32*)&cipher.size);
     if (rc != 0) goto exit;
@@ -814,6 +1164,60 @@ int TPM2_Wrapper_TestArgs(void* userCtx, int argc, char *argv[])
     }
     printf("Hash SHA256 test success\n");
 
+    /* Hybrid hash: computed on host unless a ticket is needed */
+    rc = wolfTPM2_HashStart_ex(&dev, &hash, TPM_ALG_SHA256, NULL, 0, NULL);
+    if (rc != 0) goto exit;
+
+    rc = wolfTPM2_HashUpdate(&dev, &hash, (byte*)hashTestData,
+        (word32)XSTRLEN(hashTestData));
+    if (rc != 0) goto exit;
+
+    cipher.size = TPM_SHA256_DIGEST_SIZE;
+    rc = wolfTPM2_HashFinish(&dev, &hash, cipher.buffer, (word32*)&cipher.size);
+    if (rc != 0) goto exit;
+
+    if (cipher.size != TPM_SHA256_DIGEST_SIZE ||
+        XMEMCMP(cipher.buffer, hashTestDig, cipher.size) != 0) {
+        printf("Hybrid Hash SHA256 test failed, result not as expected!\n");
+        goto exit;
+    }
+    printf("Hybrid Hash SHA256 test success\n");
+
+    /* Restricted signing key in the endorsement hierarchy needs a ticket
+     * from the same hierarchy */
+    rc = wolfTPM2_GetKeyTemplate_RSA_AIK(&publicTemplate);
+    if (rc != 0) goto exit;
+    rc = wolfTPM2_CreatePrimaryKey(&dev, &ekKey, TPM_RH_ENDORSEMENT,
+        &publicTemplate, NULL, 0);
+    if (rc != 0) goto exit;
+
+    rc = wolfTPM2_HashStart_ex(&dev, &hash, TPM_ALG_SHA256, NULL, 0, &ekKey);
+    if (rc != 0) goto exit;
+    rc = wolfTPM2_HashUpdate(&dev, &hash, (byte*)hashTestData,
+        (word32)XSTRLEN(hashTestData));
+    if (rc != 0) goto exit;
+    {
+        TPMT_TK_HASHCHECK ticket;
+        int sigSz = (int)sizeof(saveBuf);
+
+        cipher.size = TPM_SHA256_DIGEST_SIZE;
+        rc = wolfTPM2_HashFinishTicket(&dev, &hash, cipher.buffer,
+            (word32*)&cipher.size, TPM_RH_ENDORSEMENT, &ticket);
+        if (rc == 0 && ticket.hierarchy != TPM_RH_ENDORSEMENT) {
+            printf("Hash ticket hierarchy 0x%x unexpected\n",
+                (word32)ticket.hierarchy);
+            rc = TPM_RC_FAILURE;
+        }
+        if (rc == 0) {
+            rc = wolfTPM2_SignHashTicket(&dev, &ekKey, cipher.buffer,
+                cipher.size, saveBuf, &sigSz, TPM_ALG_RSASSA, TPM_ALG_SHA256,
+                &ticket);
+        }
+    }
+    wolfTPM2_UnloadHandle(&dev, &ekKey.handle);
+    if (rc != 0) goto exit;
+    printf("Restricted key sign with hash ticket success\n");
+
 
     /*------------------------------------------------------------------------*/
     /* HMAC TESTS */
@@ -849,6 +1253,14 @@ int TPM2_Wrapper_TestArgs(void* userCtx, int argc, char *argv[])
 
     printf("HMAC SHA256 test success\n");
 
+    rc = TPM2_Wrapper_HashThresholdTest(&dev, &storageKey);
+    if (rc != 0) goto exit;
+    printf("Hash/HMAC one-shot and sequence threshold test success\n");
+
+    rc = TPM2_Wrapper_SessionSaveLoadTest(&dev, &storageKey);
+    if (rc != 0) goto exit;
+    printf("Session context save/load test success\n");
+
 
     /*------------------------------------------------------------------------*/
     /* ENCRYPT/DECRYPT TESTS */
@@ -955,6 +1367,24 @@ int TPM2_Wrapper_TestArgs(void* userCtx, int argc, char *argv[])
     if (rc != 0) goto exit;
     printf("PCR Test pass\n");
 
+#ifdef WOLFTPM_SCRATCH
+    {
+        /* the arena is released and zeroed after every wrapper call */
+        word32 scratchSz = 0, scratchHigh = 0;
+        rc = wolfTPM2_GetScratchStats(&dev, &scratchSz, &scratchHigh);
+        if (rc == 0 && (scratchHigh == 0 || scratchHigh > scratchSz ||
+                        dev.scratchPos != 0))
+            rc = TPM_RC_FAILURE;
+        for (i = 0; rc == 0 && i < (int)scratchSz; i++) {
+            if (((byte*)dev.scratch)[i] != 0)
+                rc = TPM_RC_FAILURE;
+        }
+        if (rc != 0) goto exit;
+        printf("Scratch arena: high-water %u of %u bytes\n",
+            scratchHigh, scratchSz);
+    }
+#endif
+
     /*------------------------------------------------------------------------*/
     /* OTHER TESTS */
     /*------------------------------------------------------------------------*/
@@ -42,12 +42,15 @@
 /* Native Windows, native Linux and TPM Simulator do not need an IO callback */
 #if ! (defined(WOLFTPM_LINUX_DEV) || \
        defined(WOLFTPM_SWTPM) ||     \
+       defined(WOLFTPM_BROKER) ||    \
        defined(WOLFTPM_WINAPI) )
 
 /* Set WOLFTPM_INCLUDE_IO_FILE so each .c is built here and not compiled directly */
 #define WOLFTPM_INCLUDE_IO_FILE
 
-#if defined(WOLFTPM_MMIO)
+#if defined(WOLFTPM_CRB_SIM)
+#include "tpm_io_crbsim.c"
+#elif defined(WOLFTPM_MMIO)
 #include "tpm_io_mmio.c"
 #elif defined(__linux__)
 #include "hal/tpm_io_linux.c"
@@ -67,7 +70,7 @@
 #include "hal/tpm_io_microchip.c"
 #endif
 
-#if !defined(WOLFTPM_I2C) && !defined(WOLFTPM_MMIO)
+#if !defined(WOLFTPM_I2C) && !defined(WOLFTPM_MMIO) && !defined(WOLFTPM_CRB_SIM)
 static int TPM2_IoCb_SPI(TPM2_CTX* ctx, const byte* txBuf, byte* rxBuf,
     word16 xferSz, void* userCtx)
 {
@@ -111,7 +114,7 @@ int TPM2_IoCb(TPM2_CTX* ctx, int isRead, word32 addr, byte* buf,
     word16 size, void* userCtx)
 {
     int ret = TPM_RC_FAILURE;
-#if !defined(WOLFTPM_I2C) && !defined(WOLFTPM_MMIO)
+#if !defined(WOLFTPM_I2C) && !defined(WOLFTPM_MMIO) && !defined(WOLFTPM_CRB_SIM)
     byte txBuf[MAX_SPI_FRAMESIZE+TPM_TIS_HEADER_SZ];
     byte rxBuf[MAX_SPI_FRAMESIZE+TPM_TIS_HEADER_SZ];
 #endif
@@ -125,7 +128,11 @@ int TPM2_IoCb(TPM2_CTX* ctx, int isRead, word32 addr, byte* buf,
     }
 #endif
 
-#ifdef WOLFTPM_MMIO
+#ifdef WOLFTPM_CRB_SIM
+
+    ret = TPM2_IoCb_CrbSim(ctx, isRead, addr, buf, size, userCtx);
+
+#elif defined(WOLFTPM_MMIO)
 
     ret = TPM2_IoCb_Mmio(ctx, isRead, addr, buf, size, userCtx);
 
@@ -208,7 +215,8 @@ int TPM2_IoCb(TPM2_CTX* ctx, const byte* txBuf, byte* rxBuf,
 }
 
 #endif /* WOLFTPM_ADV_IO */
-#endif /* !(WOLFTPM_LINUX_DEV || WOLFTPM_SWTPM || WOLFTPM_WINAPI) */
+#endif /* !(WOLFTPM_LINUX_DEV || WOLFTPM_SWTPM || WOLFTPM_BROKER ||
+          WOLFTPM_WINAPI) */
 
 /******************************************************************************/
 /* --- END IO Callback Logic -- */
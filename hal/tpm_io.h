@@ -56,7 +56,7 @@
  */
 
 #if defined(WOLFTPM_LINUX_DEV) || defined(WOLFTPM_SWTPM) || \
-    defined(WOLFTPM_WINAPI)
+    defined(WOLFTPM_BROKER) || defined(WOLFTPM_WINAPI)
 
 /* HAL not required, so use NULL */
 #define TPM2_IoCb NULL
@@ -120,6 +120,12 @@ WOLFTPM_LOCAL int TPM2_IoCb_Mmio(TPM2_CTX* ctx, int isRead, word32 addr, byte* b
     word16 size, void* userCtx);
 #endif
 
+#if defined(WOLFTPM_CRB_SIM)
+/* in-memory CRB registers forwarding to a reference TPM, requires WOLFTPM_CRB */
+WOLFTPM_LOCAL int TPM2_IoCb_CrbSim(TPM2_CTX* ctx, int isRead, word32 addr,
+    byte* buf, word16 size, void* userCtx);
+#endif
+
 #endif /* WOLFTPM_EXAMPLE_HAL */
 #endif /* !(WOLFTPM_LINUX_DEV || WOLFTPM_SWTPM || WOLFTPM_WINAPI) */
 
@@ -35,6 +35,7 @@
 
 #if ! (defined(WOLFTPM_LINUX_DEV) || \
        defined(WOLFTPM_SWTPM) ||     \
+       defined(WOLFTPM_BROKER) ||    \
        defined(WOLFTPM_WINAPI) )
 
 /* Use the max speed by default - see tpm2_types.h for chip specific max values */
@@ -87,7 +88,8 @@
     }
 
 #endif
-#endif /* !(WOLFTPM_LINUX_DEV || WOLFTPM_SWTPM || WOLFTPM_WINAPI) */
+#endif /* !(WOLFTPM_LINUX_DEV || WOLFTPM_SWTPM || WOLFTPM_BROKER ||
+          WOLFTPM_WINAPI) */
 #endif /* WOLFTPM_INCLUDE_IO_FILE */
 
 /******************************************************************************/
@@ -0,0 +1,373 @@
+/* tpm_io_crbsim.c
+ *
+ * Copyright (C) 2006-2023 wolfSSL Inc.
+ *
+ * This file is part of wolfTPM.
+ *
+ * wolfTPM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfTPM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+/* In-memory CRB register simulator for testing the CRB interface without
+ * hardware. The register windows live in memory. A write of CRB_CTRL_START
+ * latches the command, which runs when CRB_CTRL_START is next read, the way
+ * a TPM completes it while the driver polls. Running it forwards the data
+ * buffer to a reference TPM simulator (ms-tpm-20-ref or swtpm) using the TPM
+ * TCP protocol and places the response back in the data buffer, then clears
+ * CRB_CTRL_START. A cancel request while CRB_CTRL_START is set drops the
+ * command with a TPM_RC_CANCELED response. The simulator address uses the SWTPM defaults and environment
+ * variables (WOLFTPM_SWTPM_HOST, WOLFTPM_SWTPM_PORT). A host starting with '/'
+ * is a Unix domain socket path. */
+
+#include <wolftpm/tpm2.h>
+#include <wolftpm/tpm2_crb.h>
+#include <wolftpm/tpm2_swtpm.h>
+#include "tpm_io.h"
+
+/******************************************************************************/
+/* --- BEGIN IO Callback Logic -- */
+/******************************************************************************/
+
+/* Included via tpm_io.c if WOLFTPM_INCLUDE_IO_FILE is defined */
+#ifdef WOLFTPM_INCLUDE_IO_FILE
+#ifdef WOLFTPM_CRB_SIM
+
+#ifndef WOLFTPM_CRB
+#error "WOLFTPM_CRB_SIM requires WOLFTPM_CRB"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define CRB_SIM_LOCALITIES  5
+#define CRB_SIM_WINDOW_SZ   0x1000
+#define CRB_SIM_VID         0x1414 /* reported vendor */
+#define CRB_SIM_DID         0x0001
+
+/* register offsets in a locality window */
+#define CRB_SIM_LOC_STATE   0x00
+#define CRB_SIM_LOC_CTRL    0x08
+#define CRB_SIM_LOC_STS     0x0C
+#define CRB_SIM_INTF_ID     0x30
+#define CRB_SIM_CTRL_REQ    0x40
+#define CRB_SIM_CTRL_STS    0x44
+#define CRB_SIM_CTRL_CANCEL 0x48
+#define CRB_SIM_CTRL_START  0x4C
+#define CRB_SIM_INT_ENABLE  0x50
+#define CRB_SIM_CMD_SIZE    0x58
+#define CRB_SIM_CMD_LADDR   0x5C
+#define CRB_SIM_RSP_SIZE    0x64
+#define CRB_SIM_RSP_ADDR    0x68
+#define CRB_SIM_DATA_BUFFER 0x80
+
+typedef struct CrbSim {
+    byte win[CRB_SIM_LOCALITIES][CRB_SIM_WINDOW_SZ];
+    int active;   /* assigned locality, -1 for none */
+    int fd;       /* connection to the reference TPM */
+    int init;
+} CrbSim;
+
+static CrbSim gCrbSim;
+
+static word32 CrbSim_Get32(const byte* p)
+{
+    return (word32)p[0] | ((word32)p[1] << 8) | ((word32)p[2] << 16) |
+           ((word32)p[3] << 24);
+}
+
+static void CrbSim_Set32(byte* p, word32 v)
+{
+    p[0] = (byte)v;
+    p[1] = (byte)(v >> 8);
+    p[2] = (byte)(v >> 16);
+    p[3] = (byte)(v >> 24);
+}
+
+/* LOC_STATE is the same in every locality window */
+static void CrbSim_SetLocState(CrbSim* sim)
+{
+    int l;
+    word32 state = TPM_CRB_LOC_STATE_REG_VALID;
+
+    if (sim->active >= 0) {
+        state |= TPM_CRB_LOC_STATE_ASSIGNED | ((word32)sim->active << 2);
+    }
+    for (l = 0; l < CRB_SIM_LOCALITIES; l++) {
+        CrbSim_Set32(&sim->win[l][CRB_SIM_LOC_STATE], state);
+        CrbSim_Set32(&sim->win[l][CRB_SIM_LOC_STS],
+            (l == sim->active) ? 1 : 0);
+    }
+}
+
+static void CrbSim_Init(CrbSim* sim)
+{
+    int l;
+
+    XMEMSET(sim, 0, sizeof(*sim));
+    sim->active = -1;
+    sim->fd = -1;
+    for (l = 0; l < CRB_SIM_LOCALITIES; l++) {
+        byte* w = sim->win[l];
+        /* CRB interface version 1, CapLocality, CapCRB, RID 1 */
+        CrbSim_Set32(&w[CRB_SIM_INTF_ID], TPM_CRB_INTF_TYPE_CRB | (1 << 4) |
+            (1 << 8) | (1 << 14) | (1UL << 24));
+        CrbSim_Set32(&w[CRB_SIM_INTF_ID + 4],
+            ((word32)CRB_SIM_DID << 16) | CRB_SIM_VID);
+        CrbSim_Set32(&w[CRB_SIM_CTRL_STS], TPM_CRB_CTRL_STS_IDLE);
+        CrbSim_Set32(&w[CRB_SIM_CMD_SIZE], TPM_CRB_DATA_BUFFER_SZ);
+        CrbSim_Set32(&w[CRB_SIM_CMD_LADDR], TPM_CRB_DATA_BUFFER(l));
+        CrbSim_Set32(&w[CRB_SIM_RSP_SIZE], TPM_CRB_DATA_BUFFER_SZ);
+        CrbSim_Set32(&w[CRB_SIM_RSP_ADDR], TPM_CRB_DATA_BUFFER(l));
+    }
+    CrbSim_SetLocState(sim);
+    sim->init = 1;
+}
+
+static int CrbSim_Connect(CrbSim* sim)
+{
+    const char* host = getenv(TPM2_SWTPM_HOST_ENV);
+    const char* port = getenv(TPM2_SWTPM_PORT_ENV);
+    struct addrinfo hints, *result, *rp;
+    int fd = -1;
+
+    if (host == NULL || host[0] == '\0')
+        host = TPM2_SWTPM_HOST;
+    if (port == NULL || port[0] == '\0')
+        port = TPM2_SWTPM_PORT;
+
+    if (host[0] == '/') {
+        struct sockaddr_un addr;
+        size_t pathSz = XSTRLEN(host);
+        if (pathSz >= sizeof(addr.sun_path))
+            return -1;
+        XMEMSET(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        XMEMCPY(addr.sun_path, host, pathSz);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 &&
+                connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    else {
+        XMEMSET(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(host, port, &hints, &result) != 0)
+            return -1;
+        for (rp = result; rp != NULL; rp = rp->ai_next) {
+            fd = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+            if (fd < 0)
+                continue;
+            if (connect(fd, rp->ai_addr, rp->ai_addrlen) == 0)
+                break;
+            close(fd);
+            fd = -1;
+        }
+        freeaddrinfo(result);
+    }
+#ifdef DEBUG_WOLFTPM
+    if (fd < 0)
+        printf("CRB simulator: reference TPM %s %s not reachable\n", host, port);
+#endif
+    sim->fd = fd;
+    return (fd >= 0) ? 0 : -1;
+}
+
+static int CrbSim_Xfer(int fd, byte* buf, size_t sz, int isRead)
+{
+    ssize_t n;
+
+    while (sz > 0) {
+        n = isRead ? recv(fd, buf, sz, 0) : send(fd, buf, sz, MSG_NOSIGNAL);
+        if (n <= 0)
+            return -1;
+        buf += n;
+        sz -= (size_t)n;
+    }
+    return 0;
+}
+
+/* Forwards the command in the data buffer of a locality to the reference
+ * TPM and writes the response back to the data buffer */
+static int CrbSim_Execute(CrbSim* sim, int locality)
+{
+    byte* data = &sim->win[locality][CRB_SIM_DATA_BUFFER];
+    byte hdr[9];
+    word32 cmdSz, rspSz;
+
+    cmdSz = ((word32)data[2] << 24) | ((word32)data[3] << 16) |
+            ((word32)data[4] << 8) | data[5];
+    if (cmdSz < TPM2_HEADER_SIZE || cmdSz > TPM_CRB_DATA_BUFFER_SZ)
+        return -1;
+    if (sim->fd < 0 && CrbSim_Connect(sim) != 0)
+        return -1;
+
+    /* TPM_SEND_COMMAND, locality, size (big endian) */
+    hdr[0] = 0; hdr[1] = 0; hdr[2] = 0; hdr[3] = TPM_SEND_COMMAND;
+    hdr[4] = (byte)locality;
+    hdr[5] = (byte)(cmdSz >> 24); hdr[6] = (byte)(cmdSz >> 16);
+    hdr[7] = (byte)(cmdSz >> 8);  hdr[8] = (byte)cmdSz;
+    if (CrbSim_Xfer(sim->fd, hdr, sizeof(hdr), 0) != 0 ||
+            CrbSim_Xfer(sim->fd, data, cmdSz, 0) != 0 ||
+            CrbSim_Xfer(sim->fd, hdr, 4, 1) != 0) {
+        goto fail;
+    }
+    rspSz = ((word32)hdr[0] << 24) | ((word32)hdr[1] << 16) |
+            ((word32)hdr[2] << 8) | hdr[3];
+    if (rspSz < TPM2_HEADER_SIZE || rspSz > TPM_CRB_DATA_BUFFER_SZ ||
+            CrbSim_Xfer(sim->fd, data, rspSz, 1) != 0 ||
+            CrbSim_Xfer(sim->fd, hdr, 4, 1) != 0) { /* trailing ack */
+        goto fail;
+    }
+    return 0;
+
+fail:
+    close(sim->fd);
+    sim->fd = -1;
+    return -1;
+}
+
+/* Runs a latched command, called when the driver polls CRB_CTRL_START */
+static void CrbSim_Run(CrbSim* sim, int l)
+{
+    byte* w = sim->win[l];
+
+    if ((CrbSim_Get32(&w[CRB_SIM_CTRL_START]) & 1) == 0)
+        return;
+    if (CrbSim_Execute(sim, l) != 0)
+        CrbSim_Set32(&w[CRB_SIM_CTRL_STS], TPM_CRB_CTRL_STS_ERROR);
+    CrbSim_Set32(&w[CRB_SIM_CTRL_START], 0);
+}
+
+/* Drops a latched command, leaving a header only TPM_RC_CANCELED response */
+static void CrbSim_Cancel(CrbSim* sim, int l)
+{
+    byte* w = sim->win[l];
+    byte* data = &w[CRB_SIM_DATA_BUFFER];
+
+    if ((CrbSim_Get32(&w[CRB_SIM_CTRL_START]) & 1) == 0)
+        return;
+    data[0] = (byte)(TPM_ST_NO_SESSIONS >> 8);
+    data[1] = (byte)TPM_ST_NO_SESSIONS;
+    data[2] = 0; data[3] = 0; data[4] = 0; data[5] = TPM2_HEADER_SIZE;
+    data[6] = (byte)(TPM_RC_CANCELED >> 24);
+    data[7] = (byte)(TPM_RC_CANCELED >> 16);
+    data[8] = (byte)(TPM_RC_CANCELED >> 8);
+    data[9] = (byte)TPM_RC_CANCELED;
+    CrbSim_Set32(&w[CRB_SIM_CTRL_START], 0);
+}
+
+static void CrbSim_Write(CrbSim* sim, int l, word32 off, const byte* buf,
+    word16 size)
+{
+    byte* w = sim->win[l];
+    word32 v;
+
+    if (off >= CRB_SIM_DATA_BUFFER) {
+        XMEMCPY(&w[off], buf, size);
+        return;
+    }
+    if (size != sizeof(word32))
+        return; /* control registers are written as 32-bit */
+    v = CrbSim_Get32(buf);
+
+    switch (off) {
+        case CRB_SIM_LOC_CTRL:
+            if (v & TPM_CRB_LOC_CTRL_REQUEST) {
+                if (sim->active < 0)
+                    sim->active = l;
+            }
+            else if ((v & TPM_CRB_LOC_CTRL_RELINQUISH) && sim->active == l) {
+                sim->active = -1;
+            }
+            CrbSim_SetLocState(sim);
+            break;
+        case CRB_SIM_CTRL_REQ:
+            if (l != sim->active)
+                break;
+            if (v & TPM_CRB_CTRL_REQ_CMD_READY)
+                CrbSim_Set32(&w[CRB_SIM_CTRL_STS], 0);
+            else if (v & TPM_CRB_CTRL_REQ_GO_IDLE)
+                CrbSim_Set32(&w[CRB_SIM_CTRL_STS], TPM_CRB_CTRL_STS_IDLE);
+            /* the request completes immediately and reads back as zero */
+            break;
+        case CRB_SIM_CTRL_START:
+            /* ignored while idle or for a locality that is not active,
+             * writing zero does not stop a command */
+            if ((v & 1) && l == sim->active &&
+                (CrbSim_Get32(&w[CRB_SIM_CTRL_STS]) &
+                    TPM_CRB_CTRL_STS_IDLE) == 0) {
+                CrbSim_Set32(&w[CRB_SIM_CTRL_START], 1);
+            }
+            break;
+        case CRB_SIM_CTRL_CANCEL:
+            if (v & 1)
+                CrbSim_Cancel(sim, l);
+            CrbSim_Set32(&w[off], v);
+            break;
+        case CRB_SIM_INT_ENABLE:
+            CrbSim_Set32(&w[off], v);
+            break;
+        default:
+            break; /* read only */
+    }
+}
+
+int TPM2_IoCb_CrbSim(TPM2_CTX* ctx, int isRead, word32 addr, byte* buf,
+    word16 size, void* userCtx)
+{
+    CrbSim* sim = &gCrbSim;
+    word32 off;
+    int l;
+
+    if (!sim->init)
+        CrbSim_Init(sim);
+
+    if ((addr & ~0x7FFFu) != TPM_CRB_BASE_ADDRESS)
+        return TPM_RC_FAILURE;
+    l = (int)((addr >> 12) & 0x7);
+    off = addr & (CRB_SIM_WINDOW_SZ - 1);
+    if (l >= CRB_SIM_LOCALITIES || off + size > CRB_SIM_WINDOW_SZ)
+        return TPM_RC_FAILURE;
+
+    if (isRead) {
+        if (off == CRB_SIM_CTRL_START)
+            CrbSim_Run(sim, l);
+        XMEMCPY(buf, &sim->win[l][off], size);
+    }
+    else
+        CrbSim_Write(sim, l, off, buf, size);
+
+    (void)ctx;
+    (void)userCtx;
+
+    return TPM_RC_SUCCESS;
+}
+
+#endif /* WOLFTPM_CRB_SIM */
+#endif /* WOLFTPM_INCLUDE_IO_FILE */
+
+/******************************************************************************/
+/* --- END IO Callback Logic -- */
+/******************************************************************************/
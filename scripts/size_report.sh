@@ -0,0 +1,65 @@
+#!/bin/sh
+#
+# Report the flash footprint of libwolftpm for a set of configurations
+#   ./scripts/size_report.sh                     default configuration list
+#   ./scripts/size_report.sh "--disable-nv" ...  one configuration per argument
+#
+# CONFIG_BASE is added to every configuration (default: static library only)
+# SIZE selects the size tool (default: size, use a cross size for targets)
+# WORK_DIR keeps the build copy and logs (default: a temporary directory)
+#
+
+TOP_DIR=$(realpath $(dirname $0)/..)
+CONFIG_BASE=${CONFIG_BASE:-"--disable-shared --disable-examples"}
+SIZE=${SIZE:-size}
+
+die() {
+    echo $* >&2
+    exit 1
+}
+
+if [ $# -eq 0 ]; then
+    set -- "" \
+        "--enable-smallstack" \
+        "--disable-rcstrings" \
+        "--disable-nv --disable-policy --disable-attest --disable-import --disable-csr" \
+        "--enable-smallstack --disable-nv --disable-policy --disable-attest --disable-import --disable-csr --disable-rcstrings"
+fi
+
+# a WORK_DIR passed in is kept, only a temporary one is removed
+if [ -n "$WORK_DIR" ]; then
+    [ -e "$WORK_DIR/src" ] && die "$WORK_DIR/src already exists"
+    mkdir -p "$WORK_DIR" || die "unable to create $WORK_DIR"
+    WORK_DIR_TMP=
+else
+    WORK_DIR=$(mktemp -d /tmp/wolftpm-size.XXXXXX) || die "mktemp failed"
+    WORK_DIR_TMP=$WORK_DIR
+fi
+
+# build from a copy, so the source tree configuration is left untouched
+cp -R "$TOP_DIR" "$WORK_DIR/src" || die "unable to copy $TOP_DIR"
+cd "$WORK_DIR/src" || die "unable to enter $WORK_DIR/src"
+if [ ! -x ./configure ]; then
+    ./autogen.sh > /dev/null 2>&1 || die "autogen.sh failed"
+fi
+
+printf "%8s %8s %8s %8s  %s\n" "text" "rodata" "data" "bss" "configuration"
+for cfg in "$@"; do
+    ./configure $CONFIG_BASE $cfg > "$WORK_DIR/configure.log" 2>&1 || \
+        die "configure failed for \"$cfg\", see $WORK_DIR/configure.log"
+    make clean > /dev/null 2>&1
+    make src/libwolftpm.la > "$WORK_DIR/make.log" 2>&1 || \
+        die "build failed for \"$cfg\", see $WORK_DIR/make.log"
+
+    # sum the sections of every object in the static library
+    $SIZE -A -d src/.libs/libwolftpm.a | awk -v cfg="${cfg:-(default)}" '
+        $1 ~ /^\.text/   { text   += $2 }
+        $1 ~ /^\.rodata/ { rodata += $2 }
+        $1 ~ /^\.data/   { data   += $2 }
+        $1 ~ /^\.bss/    { bss    += $2 }
+        END { printf "%8d %8d %8d %8d  %s\n", text, rodata, data, bss, cfg }'
+done
+
+if [ -n "$WORK_DIR_TMP" ]; then
+    rm -rf "$WORK_DIR_TMP"
+fi
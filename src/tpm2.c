@@ -23,13 +23,19 @@
 #include <wolftpm/tpm2.h>
 #include <wolftpm/tpm2_packet.h>
 #include <wolftpm/tpm2_tis.h>
+#include <wolftpm/tpm2_crb.h>
 #include <wolftpm/tpm2_linux.h>
 #include <wolftpm/tpm2_swtpm.h>
+#include <wolftpm/tpm2_broker.h>
 #include <wolftpm/tpm2_winapi.h>
 #include <wolftpm/tpm2_param_enc.h>
 
 #include <hal/tpm_io.h>
 
+#if defined(__linux__) || defined(__APPLE__) || defined(__unix__)
+    #include <time.h>
+#endif
+
 /******************************************************************************/
 /* --- Local Variables -- */
 /******************************************************************************/
@@ -38,6 +44,55 @@ static THREAD_LS_T TPM2_CTX* gActiveTPM;
 #ifndef WOLFTPM2_NO_WOLFCRYPT
 static volatile int gWolfCryptRefCount = 0;
 #endif
+#if !defined(WOLFTPM2_NO_WOLFCRYPT) && !defined(SINGLE_THREADED)
+/* The wolfCrypt reference count is the only state shared between contexts.
+ * It is guarded by a spin lock, since a mutex would need its own one time
+ * initialization. */
+#if defined(__GNUC__) || defined(__clang__)
+static volatile char gWolfCryptInitLock;
+#define TPM2_INIT_LOCK() \
+    while (__atomic_test_and_set(&gWolfCryptInitLock, __ATOMIC_ACQUIRE)) {}
+#define TPM2_INIT_UNLOCK() \
+    __atomic_clear(&gWolfCryptInitLock, __ATOMIC_RELEASE)
+#elif defined(_MSC_VER)
+static volatile LONG gWolfCryptInitLock;
+#define TPM2_INIT_LOCK() \
+    while (InterlockedExchange(&gWolfCryptInitLock, 1) != 0) {}
+#define TPM2_INIT_UNLOCK() InterlockedExchange(&gWolfCryptInitLock, 0)
+#else
+/* no atomics: contexts must be initialized and cleaned up by one thread */
+#define TPM2_INIT_LOCK()
+#define TPM2_INIT_UNLOCK()
+#endif
+
+/* Identifies the calling thread as owner of the recursive hardware lock.
+ * Ports may supply their own non-NULL task id. */
+#ifndef TPM2_THREAD_SELF
+#if defined(_WIN32)
+    #define TPM2_THREAD_SELF() ((void*)(size_t)GetCurrentThreadId())
+#elif defined(FREERTOS)
+    #include "task.h"
+    #define TPM2_THREAD_SELF() ((void*)xTaskGetCurrentTaskHandle())
+#elif defined(HAVE_THREAD_LS)
+    /* the address of a thread local is unique per thread */
+    static THREAD_LS_T byte gLockThreadTag;
+    #define TPM2_THREAD_SELF() ((void*)&gLockThreadTag)
+#else
+    #include <pthread.h>
+    #define TPM2_THREAD_SELF() ((void*)(size_t)pthread_self())
+#endif
+#endif
+#else
+#define TPM2_INIT_LOCK()
+#define TPM2_INIT_UNLOCK()
+#endif
+/* per thread override of the context command deadline */
+static THREAD_LS_T word32 gCallTimeoutMs;
+#ifdef WOLFTPM_PRIORITY
+/* per thread override of the context priority */
+static THREAD_LS_T int gCallPriority = TPM2_PRIORITY_DEFAULT;
+static THREAD_LS_T word32 gCallDeadlineMs;
+#endif
 
 #ifdef WOLFTPM_LINUX_DEV
 #define INTERNAL_SEND_COMMAND      TPM2_LINUX_SendCommand
@@ -45,41 +100,193 @@ static volatile int gWolfCryptRefCount = 0;
 #elif defined(WOLFTPM_SWTPM)
 #define INTERNAL_SEND_COMMAND      TPM2_SWTPM_SendCommand
 #define TPM2_INTERNAL_CLEANUP(ctx)
+#elif defined(WOLFTPM_BROKER)
+#define INTERNAL_SEND_COMMAND      TPM2_BROKER_SendCommand
+#define TPM2_INTERNAL_CLEANUP(ctx) TPM2_BROKER_Cleanup(ctx)
 #elif defined(WOLFTPM_WINAPI)
 #define INTERNAL_SEND_COMMAND      TPM2_WinApi_SendCommand
 #define TPM2_INTERNAL_CLEANUP(ctx) TPM2_WinApi_Cleanup(ctx)
+#elif defined(WOLFTPM_CRB)
+#define INTERNAL_SEND_COMMAND      TPM2_CRB_SendCommand
+#define TPM2_INTERNAL_CLEANUP(ctx) TPM2_CRB_Cleanup(ctx)
 #else
 #define INTERNAL_SEND_COMMAND      TPM2_TIS_SendCommand
+#ifdef WOLFTPM_TIS_LOCK
+#define TPM2_INTERNAL_CLEANUP(ctx) TPM2_TIS_Cleanup(ctx)
+#else
 #define TPM2_INTERNAL_CLEANUP(ctx)
 #endif
+#endif
 
 /******************************************************************************/
 /* --- Local Functions -- */
 /******************************************************************************/
+/* Gets the context tick, or the monotonic clock where one is known */
+static int TPM2_TimeMs(TPM2_CTX* ctx, word32* ms)
+{
+    if (ctx->timeCb != NULL) {
+        *ms = ctx->timeCb(ctx->timeCtx);
+        return 0;
+    }
+#if defined(__linux__) || defined(__APPLE__) || defined(__unix__)
+    {
+        struct timespec now;
+        if (clock_gettime(CLOCK_MONOTONIC, &now) != 0)
+            return -1;
+        *ms = (word32)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+        return 0;
+    }
+#else
+    (void)ms;
+    return -1; /* no clock, deadlines are disabled */
+#endif
+}
+
+#ifdef WOLFTPM_PRIORITY
+/* Takes the hardware lock in priority order. Waiters check the owner flag
+ * and the queued classes under prioLock and sleep between attempts, so a
+ * waiter never blocks on hwLock while another thread holds the TPM and its
+ * deadline is checked on every attempt. A class only takes the TPM while no
+ * higher class is waiting, so bulk work yields at each command boundary
+ * (between NV write chunks or sequence updates). */
+static TPM_RC TPM2_PriorityLock(TPM2_CTX* ctx)
+{
+    TPM_RC rc;
+    int i, prio, blocked, haveTime;
+    word32 start = 0, now = 0, waitMs = 0;
+    TPM2_PRIORITY_STATS* stats;
+
+    prio = gCallPriority;
+    if (prio < TPM2_PRIORITY_HIGH || prio >= TPM2_PRIORITY_COUNT)
+        prio = ctx->priority;
+    stats = &ctx->prioStats[prio];
+
+    haveTime = (TPM2_TimeMs(ctx, &start) == 0);
+    if (gCallDeadlineMs > 0 && !haveTime) {
+    #ifdef DEBUG_WOLFTPM
+        printf("TPM priority deadline set without a time source\n");
+    #endif
+        return BAD_FUNC_ARG;
+    }
+    if (wc_LockMutex(&ctx->prioLock) != 0)
+        return TPM_RC_FAILURE;
+    ctx->prioWaiting[prio]++;
+
+    for (;;) {
+        blocked = ctx->prioBusy;
+        for (i = TPM2_PRIORITY_HIGH; !blocked && i < prio; i++) {
+            if (ctx->prioWaiting[i] > 0)
+                blocked = 1;
+        }
+        if (haveTime && TPM2_TimeMs(ctx, &now) == 0)
+            waitMs = now - start;
+        if (!blocked) {
+            ctx->prioBusy = 1;
+            ctx->prioWaiting[prio]--;
+            stats->acquired++;
+            stats->waitTotalMs += waitMs;
+            if (waitMs > stats->waitMaxMs)
+                stats->waitMaxMs = waitMs;
+            wc_UnLockMutex(&ctx->prioLock);
+
+            /* only the prioBusy owner takes hwLock, so this does not wait
+             * on another command */
+            if (wc_LockMutex(&ctx->hwLock) != 0) {
+                (void)wc_LockMutex(&ctx->prioLock);
+                ctx->prioBusy = 0;
+                wc_UnLockMutex(&ctx->prioLock);
+                return TPM_RC_FAILURE;
+            }
+            return TPM_RC_SUCCESS;
+        }
+        if (gCallDeadlineMs > 0 && waitMs >= gCallDeadlineMs) {
+            rc = TPM_RC_DEADLINE;
+            break;
+        }
+        wc_UnLockMutex(&ctx->prioLock);
+        XTPM_PRIORITY_YIELD();
+        (void)wc_LockMutex(&ctx->prioLock);
+    }
+
+    ctx->prioWaiting[prio]--;
+    stats->expired++;
+    wc_UnLockMutex(&ctx->prioLock);
+    return rc;
+}
+#endif /* WOLFTPM_PRIORITY */
+
+#if !defined(WOLFTPM2_NO_WOLFCRYPT) && !defined(SINGLE_THREADED)
+static TPM_RC TPM2_InitLock(TPM2_CTX* ctx)
+{
+    if (wc_InitMutex(&ctx->hwLock) != 0) {
+    #ifdef DEBUG_WOLFTPM
+        printf("TPM Mutex Init failed\n");
+    #endif
+        return TPM_RC_FAILURE;
+    }
+#ifdef WOLFTPM_PRIORITY
+    if (wc_InitMutex(&ctx->prioLock) != 0) {
+        wc_FreeMutex(&ctx->hwLock);
+        return TPM_RC_FAILURE;
+    }
+#endif
+    ctx->hwLockInit = 1;
+    ctx->lockCount = 0;
+    ctx->lockOwner = NULL;
+    return TPM_RC_SUCCESS;
+}
+#endif
+
+/* The hardware lock is recursive for the owning thread only. Another thread
+ * always waits on the mutex, even while the owner is nested. */
 static TPM_RC TPM2_AcquireLock(TPM2_CTX* ctx)
 {
 #if defined(WOLFTPM2_NO_WOLFCRYPT) || defined(SINGLE_THREADED)
     (void)ctx;
 #else
-    int ret;
+    int ret, contended;
+    word32 start = 0, waitMs = 0;
+    void* self = TPM2_THREAD_SELF();
 
     if (!ctx->hwLockInit) {
-        if (wc_InitMutex(&ctx->hwLock) != 0) {
-        #ifdef DEBUG_WOLFTPM
-            printf("TPM Mutex Init failed\n");
-        #endif
-            return TPM_RC_FAILURE;
-        }
-        ctx->hwLockInit = 1;
-        ctx->lockCount = 0;
+        ret = TPM2_InitLock(ctx);
+        if (ret != TPM_RC_SUCCESS)
+            return ret;
     }
 
-    if (ctx->lockCount == 0) {
-        ret = wc_LockMutex(&ctx->hwLock);
-        if (ret != 0)
-            return TPM_RC_FAILURE;
+    /* only this thread stores its own id, so a match means it holds the
+     * lock */
+    if (ctx->lockOwner == self) {
+        ctx->lockCount++;
+        ctx->lockStats.recursive++;
+        return TPM_RC_SUCCESS;
+    }
+
+    contended = (ctx->lockOwner != NULL);
+    if (ctx->timeCb != NULL)
+        start = ctx->timeCb(ctx->timeCtx);
+#ifdef WOLFTPM_PRIORITY
+    ret = TPM2_PriorityLock(ctx);
+    if (ret != TPM_RC_SUCCESS)
+        return ret;
+#else
+    ret = wc_LockMutex(&ctx->hwLock);
+    if (ret != 0)
+        return TPM_RC_FAILURE;
+#endif
+    ctx->lockOwner = self;
+    ctx->lockCount = 1;
+
+    ctx->lockStats.acquired++;
+    if (contended)
+        ctx->lockStats.contended++;
+    if (ctx->timeCb != NULL) {
+        ctx->lockStart = ctx->timeCb(ctx->timeCtx);
+        waitMs = ctx->lockStart - start;
+        ctx->lockStats.waitTotalMs += waitMs;
+        if (waitMs > ctx->lockStats.waitMaxMs)
+            ctx->lockStats.waitMaxMs = waitMs;
     }
-    ctx->lockCount++;
 #endif
     return TPM_RC_SUCCESS;
 }
@@ -89,12 +296,136 @@ static void TPM2_ReleaseLock(TPM2_CTX* ctx)
 #if defined(WOLFTPM2_NO_WOLFCRYPT) || defined(SINGLE_THREADED)
     (void)ctx;
 #else
+    word32 holdMs;
+
+    if (ctx->lockOwner != TPM2_THREAD_SELF() || ctx->lockCount <= 0) {
+    #ifdef DEBUG_WOLFTPM
+        printf("TPM lock released by a thread that does not own it\n");
+    #endif
+        return;
+    }
     ctx->lockCount--;
     if (ctx->lockCount == 0) {
+        if (ctx->timeCb != NULL) {
+            holdMs = ctx->timeCb(ctx->timeCtx) - ctx->lockStart;
+            ctx->lockStats.holdTotalMs += holdMs;
+            if (holdMs > ctx->lockStats.holdMaxMs)
+                ctx->lockStats.holdMaxMs = holdMs;
+        }
+        ctx->lockOwner = NULL;
         wc_UnLockMutex(&ctx->hwLock);
+    #ifdef WOLFTPM_PRIORITY
+        (void)wc_LockMutex(&ctx->prioLock);
+        ctx->prioBusy = 0;
+        wc_UnLockMutex(&ctx->prioLock);
+    #endif
+    }
+#endif
+}
+
+#ifndef WOLFTPM_NO_RETRY
+/* Returns the retry class of a header only warning response, otherwise -1 */
+static int TPM2_RetryIndex(const TPM2_Packet* packet, word32* respCodeOut)
+{
+    const BYTE* b = packet->buf;
+    word32 respSz, respCode;
+
+    respSz = ((word32)b[2] << 24) | ((word32)b[3] << 16) |
+             ((word32)b[4] << 8) | b[5];
+    respCode = ((word32)b[6] << 24) | ((word32)b[7] << 16) |
+               ((word32)b[8] << 8) | b[9];
+    *respCodeOut = respCode;
+    if (respSz != TPM2_HEADER_SIZE)
+        return -1;
+    switch (respCode) {
+        case TPM_RC_RETRY:   return TPM2_RETRY_RC_RETRY;
+        case TPM_RC_YIELDED: return TPM2_RETRY_RC_YIELDED;
+        case TPM_RC_TESTING: return TPM2_RETRY_RC_TESTING;
+        case TPM_RC_NV_RATE: return TPM2_RETRY_RC_NV_RATE;
+        default:
+            break;
     }
+    return -1;
+}
+#endif
 
+/* Sends a command on the transport under the command deadline. Warning
+ * responses selected by the retry policy are resent with backoff. The TPM
+ * only writes a header for those, so restoring the command header restores
+ * the packet, and since the sessions were not processed the auth area built
+ * for it is still valid. The backoff runs under the TPM lock: the packet is
+ * the context command buffer and a caller may hold the lock across commands,
+ * so it can not be released here. */
+static TPM_RC TPM2_TransportSend(TPM2_CTX* ctx, TPM2_Packet* packet)
+{
+    TPM_RC rc;
+    word32 timeoutMs, now;
+#ifndef WOLFTPM_NO_RETRY
+    TPM2_RETRY_POLICY* policy = &ctx->retryPolicy;
+    BYTE cmdHdr[TPM2_HEADER_SIZE];
+    int cmdSz = packet->pos;
+    word32 tries = 0, delayMs = policy->initialMs, respCode;
+    int idx, left;
+
+    XMEMCPY(cmdHdr, packet->buf, sizeof(cmdHdr));
 #endif
+
+    timeoutMs = (gCallTimeoutMs > 0) ? gCallTimeoutMs : ctx->cmdTimeoutMs;
+    ctx->cmdDeadlineSet = 0;
+    if (timeoutMs > 0 && TPM2_TimeMs(ctx, &now) == 0) {
+        ctx->cmdDeadline = now + timeoutMs;
+        ctx->cmdDeadlineSet = 1;
+    }
+
+    for (;;) {
+        rc = (TPM_RC)INTERNAL_SEND_COMMAND(ctx, packet);
+    #ifndef WOLFTPM_NO_RETRY
+        if (rc != TPM_RC_SUCCESS)
+            break;
+        idx = TPM2_RetryIndex(packet, &respCode);
+        if (idx < 0 || (policy->rcMask & TPM2_RETRY_MASK(idx)) == 0) {
+            if (tries > 0)
+                ctx->retryStats.recovered++;
+            break;
+        }
+        if (tries >= policy->maxRetries) {
+            if (policy->maxRetries > 0)
+                ctx->retryStats.exhausted++;
+            break;
+        }
+        /* no point in waiting past the deadline */
+        left = TPM2_DeadlineRemaining(ctx);
+        if (left >= 0 && (word32)left <= delayMs) {
+            ctx->retryStats.exhausted++;
+            break;
+        }
+    #ifdef DEBUG_WOLFTPM
+        printf("TPM command retry %u after 0x%x, backoff %u ms\n",
+            tries + 1, respCode, delayMs);
+    #endif
+        ctx->retryStats.retries[idx]++;
+        tries++;
+        if (delayMs > 0) {
+            XTPM_DELAY_MS(delayMs);
+        }
+        delayMs = (delayMs > 0) ? delayMs * 2 : 1;
+        if (delayMs > policy->maxMs)
+            delayMs = policy->maxMs;
+
+        XMEMCPY(packet->buf, cmdHdr, sizeof(cmdHdr));
+        packet->pos = cmdSz;
+        continue;
+    #endif
+        break;
+    }
+
+    ctx->cmdDeadlineSet = 0;
+#ifdef DEBUG_WOLFTPM
+    if (rc == TPM_RC_DEADLINE) {
+        printf("TPM command canceled after %u ms deadline\n", timeoutMs);
+    }
+#endif
+    return rc;
 }
 
 static int TPM2_CommandProcess(TPM2_CTX* ctx, TPM2_Packet* packet,
@@ -403,7 +734,7 @@ static TPM_RC TPM2_SendCommandAuth(TPM2_CTX* ctx, TPM2_Packet* packet,
     packet->pos = cmdSz;
 
     /* submit command and wait for response */
-    rc = (TPM_RC)INTERNAL_SEND_COMMAND(ctx, packet);
+    rc = TPM2_TransportSend(ctx, packet);
     if (rc != 0)
         return rc;
 
@@ -434,7 +765,7 @@ static TPM_RC TPM2_SendCommand(TPM2_CTX* ctx, TPM2_Packet* packet)
         return BAD_FUNC_ARG;
 
     /* submit command and wait for response */
-    rc = (TPM_RC)INTERNAL_SEND_COMMAND(ctx, packet);
+    rc = TPM2_TransportSend(ctx, packet);
     if (rc != 0)
         return rc;
 
@@ -447,6 +778,7 @@ static inline int TPM2_WolfCrypt_Init(void)
     int rc = 0;
 
     /* track reference count for wolfCrypt initialization */
+    TPM2_INIT_LOCK();
     if (gWolfCryptRefCount == 0) {
     #ifdef DEBUG_WOLFSSL
         wolfSSL_Debugging_ON();
@@ -458,7 +790,9 @@ static inline int TPM2_WolfCrypt_Init(void)
             rc = wc_SetSeed_Cb(wc_GenerateSeed);
     #endif
     }
-    gWolfCryptRefCount++;
+    if (rc == 0)
+        gWolfCryptRefCount++;
+    TPM2_INIT_UNLOCK();
 
     return rc;
 }
@@ -477,6 +811,135 @@ void TPM2_SetActiveCtx(TPM2_CTX* ctx)
     gActiveTPM = ctx;
 }
 
+int TPM2_SetTimeCb(TPM2_CTX* ctx, TPM2TimeCb timeCb, void* timeCtx)
+{
+    if (ctx == NULL)
+        return BAD_FUNC_ARG;
+    ctx->timeCb = timeCb;
+    ctx->timeCtx = timeCtx;
+    return TPM_RC_SUCCESS;
+}
+
+int TPM2_SetCommandTimeout(TPM2_CTX* ctx, word32 timeoutMs)
+{
+    if (ctx == NULL)
+        return BAD_FUNC_ARG;
+    ctx->cmdTimeoutMs = timeoutMs;
+    return TPM_RC_SUCCESS;
+}
+
+word32 TPM2_SetCallTimeout(word32 timeoutMs)
+{
+    word32 prev = gCallTimeoutMs;
+    gCallTimeoutMs = timeoutMs;
+    return prev;
+}
+
+#ifndef WOLFTPM_NO_RETRY
+int TPM2_SetRetryPolicy(TPM2_CTX* ctx, const TPM2_RETRY_POLICY* policy)
+{
+    if (ctx == NULL)
+        return BAD_FUNC_ARG;
+    if (policy == NULL) {
+        ctx->retryPolicy.maxRetries = WOLFTPM_RETRY_MAX;
+        ctx->retryPolicy.initialMs = WOLFTPM_RETRY_INITIAL_MS;
+        ctx->retryPolicy.maxMs = WOLFTPM_RETRY_MAX_MS;
+        ctx->retryPolicy.rcMask = TPM2_RETRY_MASK_ALL;
+    }
+    else {
+        if (policy->initialMs > policy->maxMs)
+            return BAD_FUNC_ARG;
+        ctx->retryPolicy = *policy;
+    }
+    return TPM_RC_SUCCESS;
+}
+
+int TPM2_GetRetryStats(TPM2_CTX* ctx, TPM2_RETRY_STATS* stats)
+{
+    if (ctx == NULL || stats == NULL)
+        return BAD_FUNC_ARG;
+    *stats = ctx->retryStats;
+    return TPM_RC_SUCCESS;
+}
+#endif
+
+int TPM2_DeadlineRemaining(TPM2_CTX* ctx)
+{
+    word32 now;
+    int left;
+
+    if (ctx == NULL || !ctx->cmdDeadlineSet || TPM2_TimeMs(ctx, &now) != 0)
+        return -1;
+    left = (int)(ctx->cmdDeadline - now); /* wrap safe */
+    return (left > 0) ? left : 0;
+}
+
+int TPM2_GetLockStats(TPM2_CTX* ctx, TPM2_LOCK_STATS* stats)
+{
+    if (ctx == NULL || stats == NULL)
+        return BAD_FUNC_ARG;
+#if defined(WOLFTPM2_NO_WOLFCRYPT) || defined(SINGLE_THREADED)
+    return NOT_COMPILED_IN;
+#else
+    if (!ctx->hwLockInit || ctx->lockOwner == TPM2_THREAD_SELF()) {
+        *stats = ctx->lockStats;
+        return TPM_RC_SUCCESS;
+    }
+    /* take the mutex directly, so reading does not count as an acquisition */
+    if (wc_LockMutex(&ctx->hwLock) != 0)
+        return TPM_RC_FAILURE;
+    *stats = ctx->lockStats;
+    wc_UnLockMutex(&ctx->hwLock);
+    return TPM_RC_SUCCESS;
+#endif
+}
+
+#ifdef WOLFTPM_PRIORITY
+int TPM2_SetPriority(TPM2_CTX* ctx, int priority, TPM2TimeCb timeCb,
+    void* timeCtx)
+{
+    if (ctx == NULL || priority < TPM2_PRIORITY_HIGH ||
+                       priority >= TPM2_PRIORITY_COUNT) {
+        return BAD_FUNC_ARG;
+    }
+    ctx->priority = priority;
+    ctx->timeCb = timeCb;
+    ctx->timeCtx = timeCtx;
+    return TPM_RC_SUCCESS;
+}
+
+int TPM2_SetCallPriority(int priority, word32 deadlineMs)
+{
+    int prev = gCallPriority;
+    if (priority < TPM2_PRIORITY_HIGH || priority >= TPM2_PRIORITY_COUNT) {
+        priority = TPM2_PRIORITY_DEFAULT;
+        deadlineMs = 0;
+    }
+    gCallPriority = priority;
+    gCallDeadlineMs = deadlineMs;
+    return prev;
+}
+
+int TPM2_GetPriorityStats(TPM2_CTX* ctx, int priority,
+    TPM2_PRIORITY_STATS* stats)
+{
+    if (ctx == NULL || stats == NULL || priority < TPM2_PRIORITY_HIGH ||
+                                        priority >= TPM2_PRIORITY_COUNT) {
+        return BAD_FUNC_ARG;
+    }
+    if (!ctx->hwLockInit) {
+        /* no command issued yet */
+        XMEMSET(stats, 0, sizeof(*stats));
+        return TPM_RC_SUCCESS;
+    }
+    if (wc_LockMutex(&ctx->prioLock) != 0)
+        return TPM_RC_FAILURE;
+    *stats = ctx->prioStats[priority];
+    wc_UnLockMutex(&ctx->prioLock);
+    return TPM_RC_SUCCESS;
+}
+#endif /* WOLFTPM_PRIORITY */
+
 TPM_RC TPM2_SetSessionAuth(TPM2_AUTH_SESSION* session)
 {
     TPM_RC rc;
@@ -518,6 +981,20 @@ TPM_RC TPM2_ChipStartup(TPM2_CTX* ctx, int timeoutTries)
     rc = TPM2_AcquireLock(ctx);
     if (rc == TPM_RC_SUCCESS) {
 
+    #ifdef WOLFTPM_CRB
+        /* Wait for chip startup to complete */
+        rc = TPM2_CRB_StartupWait(ctx, timeoutTries);
+        if (rc == TPM_RC_SUCCESS) {
+
+            /* Request locality for TPM module */
+            rc = TPM2_CRB_RequestLocality(ctx, timeoutTries);
+            if (rc == TPM_RC_SUCCESS) {
+
+                /* Get device information */
+                rc = TPM2_CRB_GetInfo(ctx);
+            }
+        }
+    #else
         /* Wait for chip startup to complete */
         rc = TPM2_TIS_StartupWait(ctx, timeoutTries);
         if (rc == TPM_RC_SUCCESS) {
@@ -530,6 +1007,7 @@ TPM_RC TPM2_ChipStartup(TPM2_CTX* ctx, int timeoutTries)
                 rc = TPM2_TIS_GetInfo(ctx);
             }
         }
+    #endif
 
         TPM2_ReleaseLock(ctx);
     }
@@ -568,19 +1046,37 @@ TPM_RC TPM2_Init_ex(TPM2_CTX* ctx, TPM2HalIoCb ioCb, void* userCtx,
     }
 
     XMEMSET(ctx, 0, sizeof(TPM2_CTX));
+#ifdef WOLFTPM_PRIORITY
+    ctx->priority = TPM2_PRIORITY_NORMAL;
+#endif
 
 #ifndef WOLFTPM2_NO_WOLFCRYPT
     rc = TPM2_WolfCrypt_Init();
     if (rc != 0)
         return rc;
+    #ifndef SINGLE_THREADED
+    /* create the lock up front, so first use from two threads can not race */
+    rc = TPM2_InitLock(ctx);
+    if (rc != TPM_RC_SUCCESS)
+        return rc;
+    #endif
 #endif
 
-#if defined(WOLFTPM_SWTPM)
+#if defined(WOLFTPM_SWTPM) || defined(WOLFTPM_BROKER)
     ctx->tcpCtx.fd = -1;
 #endif
+#ifdef WOLFTPM_TIS_LOCK
+    ctx->tisLockFd = -1;
+#endif
+#ifndef WOLFTPM_NO_RETRY
+    (void)TPM2_SetRetryPolicy(ctx, NULL);
+#endif
+#ifdef WOLFTPM_CRB
+    ctx->crbCmdSz = TPM_CRB_DATA_BUFFER_SZ;
+#endif
 
 #if defined(WOLFTPM_LINUX_DEV) || defined(WOLFTPM_SWTPM) || \
-    defined(WOLFTPM_WINAPI)
+    defined(WOLFTPM_BROKER) || defined(WOLFTPM_WINAPI)
     if (ioCb != NULL || userCtx != NULL) {
         return BAD_FUNC_ARG;
     }
@@ -651,17 +1147,22 @@ TPM_RC TPM2_Cleanup(TPM2_CTX* ctx)
     if (ctx->hwLockInit) {
         ctx->hwLockInit = 0;
         wc_FreeMutex(&ctx->hwLock);
+    #ifdef WOLFTPM_PRIORITY
+        wc_FreeMutex(&ctx->prioLock);
+    #endif
     }
     #endif
 
     /* track wolf initialize reference count in wolfTPM. wolfCrypt does not
         properly track reference count in v4.1 or older releases */
+    TPM2_INIT_LOCK();
     gWolfCryptRefCount--;
     if (gWolfCryptRefCount < 0)
         gWolfCryptRefCount = 0;
     if (gWolfCryptRefCount == 0) {
         wolfCrypt_Cleanup();
     }
+    TPM2_INIT_UNLOCK();
 #endif /* !WOLFTPM2_NO_WOLFCRYPT */
 
     return TPM_RC_SUCCESS;
@@ -688,6 +1189,9 @@ TPM_RC TPM2_Startup(Startup_In* in)
 
         /* send command */
         rc = TPM2_SendCommand(ctx, &packet);
+        if (rc == TPM_RC_SUCCESS) {
+            ctx->stateGen++;
+        }
 
         TPM2_ReleaseLock(ctx);
     }
@@ -765,11 +1269,15 @@ TPM_RC TPM2_IncrementalSelfTest(IncrementalSelfTest_In* in,
         /* send command */
         rc = TPM2_SendCommand(ctx, &packet);
         if (rc == TPM_RC_SUCCESS) {
-            TPM2_Packet_ParseU32(&packet, &out->toDoList.count);
+            TPM2_Packet_ParseCount(&packet, &out->toDoList.count,
+                (UINT32)(sizeof(out->toDoList.algorithms) /
+                         sizeof(out->toDoList.algorithms[0])));
             for (i=0; i<(int)out->toDoList.count; i++) {
                 TPM2_Packet_ParseU16(&packet, &out->toDoList.algorithms[i]);
             }
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -793,11 +1301,12 @@ TPM_RC TPM2_GetTestResult(GetTestResult_Out* out)
         /* send command */
         rc = TPM2_SendCommand(ctx, &packet);
         if (rc == TPM_RC_SUCCESS) {
-            TPM2_Packet_ParseU16(&packet, &out->outData.size);
-            TPM2_Packet_ParseBytes(&packet, out->outData.buffer,
-                out->outData.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->outData.size,
+                out->outData.buffer, (UINT16)sizeof(out->outData.buffer));
             TPM2_Packet_ParseU16(&packet, &out->testResult);
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -832,7 +1341,9 @@ TPM_RC TPM2_GetCapability(GetCapability_In* in, GetCapability_Out* out)
                 case TPM_CAP_TPM_PROPERTIES: {
                     TPML_TAGGED_TPM_PROPERTY* prop =
                         &out->capabilityData.data.tpmProperties;
-                    TPM2_Packet_ParseU32(&packet, &prop->count);
+                    TPM2_Packet_ParseCount(&packet, &prop->count,
+                        (UINT32)(sizeof(prop->tpmProperty) /
+                                 sizeof(prop->tpmProperty[0])));
                     for (i=0; i<(int)prop->count; i++) {
                         TPM2_Packet_ParseU32(&packet,
                             &prop->tpmProperty[i].property);
@@ -849,6 +1360,8 @@ TPM_RC TPM2_GetCapability(GetCapability_In* in, GetCapability_Out* out)
                     break;
             }
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -873,10 +1386,12 @@ TPM_RC TPM2_GetRandom(GetRandom_In* in, GetRandom_Out* out)
         /* send command */
         rc = TPM2_SendCommand(ctx, &packet);
         if (rc == TPM_RC_SUCCESS) {
-            TPM2_Packet_ParseU16(&packet, &out->randomBytes.size);
-            TPM2_Packet_ParseBytes(&packet, out->randomBytes.buffer,
-                out->randomBytes.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->randomBytes.size,
+                out->randomBytes.buffer,
+                (UINT16)sizeof(out->randomBytes.buffer));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -929,14 +1444,17 @@ TPM_RC TPM2_PCR_Read(PCR_Read_In* in, PCR_Read_Out* out)
         if (rc == TPM_RC_SUCCESS) {
             TPM2_Packet_ParseU32(&packet, &out->pcrUpdateCounter);
             TPM2_Packet_ParsePCR(&packet, &out->pcrSelectionOut);
-            TPM2_Packet_ParseU32(&packet, &out->pcrValues.count);
+            TPM2_Packet_ParseCount(&packet, &out->pcrValues.count,
+                (UINT32)(sizeof(out->pcrValues.digests) /
+                         sizeof(out->pcrValues.digests[0])));
             for (i=0; i<(int)out->pcrValues.count; i++) {
-                TPM2_Packet_ParseU16(&packet, &out->pcrValues.digests[i].size);
-                TPM2_Packet_ParseBytes(&packet,
+                TPM2_Packet_ParseU16Buf(&packet, &out->pcrValues.digests[i].size,
                     out->pcrValues.digests[i].buffer,
-                    out->pcrValues.digests[i].size);
+                    (UINT16)sizeof(out->pcrValues.digests[i].buffer));
             }
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -956,8 +1474,7 @@ TPM_RC TPM2_PCR_Extend(PCR_Extend_In* in)
         int i;
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_PCR_Extend, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->pcrHandle);
@@ -993,8 +1510,7 @@ TPM_RC TPM2_Create(Create_In* in, Create_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_Create, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->parentHandle);
@@ -1014,51 +1530,47 @@ TPM_RC TPM2_Create(Create_In* in, Create_Out* out)
 
             TPM2_Packet_ParseU32(&packet, &paramSz);
 
-            TPM2_Packet_ParseU16(&packet, &out->outPrivate.size);
-            TPM2_Packet_ParseBytes(&packet, out->outPrivate.buffer,
-                out->outPrivate.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->outPrivate.size,
+                out->outPrivate.buffer, (UINT16)sizeof(out->outPrivate.buffer));
 
             TPM2_Packet_ParsePublic(&packet, &out->outPublic);
 
             TPM2_Packet_ParseU16(&packet, &out->creationData.size);
             TPM2_Packet_ParsePCR(&packet,
                 &out->creationData.creationData.pcrSelect);
-            TPM2_Packet_ParseU16(&packet,
-                &out->creationData.creationData.pcrDigest.size);
-            TPM2_Packet_ParseBytes(&packet,
+            TPM2_Packet_ParseU16Buf(&packet,
+                &out->creationData.creationData.pcrDigest.size,
                 out->creationData.creationData.pcrDigest.buffer,
-                out->creationData.creationData.pcrDigest.size);
+                (UINT16)sizeof(out->creationData.creationData.pcrDigest.buffer));
             TPM2_Packet_ParseU8(&packet,
                 &out->creationData.creationData.locality);
             TPM2_Packet_ParseU16(&packet,
                 &out->creationData.creationData.parentNameAlg);
-            TPM2_Packet_ParseU16(&packet,
-                &out->creationData.creationData.parentName.size);
-            TPM2_Packet_ParseBytes(&packet,
+            TPM2_Packet_ParseU16Buf(&packet,
+                &out->creationData.creationData.parentName.size,
                 out->creationData.creationData.parentName.name,
-                out->creationData.creationData.parentName.size);
-            TPM2_Packet_ParseU16(&packet,
-                &out->creationData.creationData.parentQualifiedName.size);
-            TPM2_Packet_ParseBytes(&packet,
+                (UINT16)sizeof(out->creationData.creationData.parentName.name));
+            TPM2_Packet_ParseU16Buf(&packet,
+                &out->creationData.creationData.parentQualifiedName.size,
                 out->creationData.creationData.parentQualifiedName.name,
-                out->creationData.creationData.parentQualifiedName.size);
-            TPM2_Packet_ParseU16(&packet,
-                &out->creationData.creationData.outsideInfo.size);
-            TPM2_Packet_ParseBytes(&packet,
+                (UINT16)sizeof(out->creationData.creationData.parentQualifiedName.name));
+            TPM2_Packet_ParseU16Buf(&packet,
+                &out->creationData.creationData.outsideInfo.size,
                 out->creationData.creationData.outsideInfo.buffer,
-                out->creationData.creationData.outsideInfo.size);
+                (UINT16)sizeof(out->creationData.creationData.outsideInfo.buffer));
 
-            TPM2_Packet_ParseU16(&packet, &out->creationHash.size);
-            TPM2_Packet_ParseBytes(&packet, out->creationHash.buffer,
-                out->creationHash.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->creationHash.size,
+                out->creationHash.buffer,
+                (UINT16)sizeof(out->creationHash.buffer));
 
             TPM2_Packet_ParseU16(&packet, &out->creationTicket.tag);
             TPM2_Packet_ParseU32(&packet, &out->creationTicket.hierarchy);
-            TPM2_Packet_ParseU16(&packet, &out->creationTicket.digest.size);
-            TPM2_Packet_ParseBytes(&packet,
-                        out->creationTicket.digest.buffer,
-                        out->creationTicket.digest.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->creationTicket.digest.size,
+                out->creationTicket.digest.buffer,
+                (UINT16)sizeof(out->creationTicket.digest.buffer));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -1077,8 +1589,7 @@ TPM_RC TPM2_CreateLoaded(CreateLoaded_In* in, CreateLoaded_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_CreateLoaded, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->parentHandle);
@@ -1095,15 +1606,16 @@ TPM_RC TPM2_CreateLoaded(CreateLoaded_In* in, CreateLoaded_Out* out)
             TPM2_Packet_ParseU32(&packet, &out->objectHandle);
             TPM2_Packet_ParseU32(&packet, &paramSz);
 
-            TPM2_Packet_ParseU16(&packet, &out->outPrivate.size);
-            TPM2_Packet_ParseBytes(&packet, out->outPrivate.buffer,
-                out->outPrivate.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->outPrivate.size,
+                out->outPrivate.buffer, (UINT16)sizeof(out->outPrivate.buffer));
 
             TPM2_Packet_ParsePublic(&packet, &out->outPublic);
 
-            TPM2_Packet_ParseU16(&packet, &out->name.size);
-            TPM2_Packet_ParseBytes(&packet, out->name.name, out->name.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->name.size,
+                out->name.name, (UINT16)sizeof(out->name.name));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -1122,9 +1634,7 @@ TPM_RC TPM2_CreatePrimary(CreatePrimary_In* in, CreatePrimary_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.outHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_CreatePrimary, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->primaryHandle);
@@ -1151,45 +1661,42 @@ TPM_RC TPM2_CreatePrimary(CreatePrimary_In* in, CreatePrimary_Out* out)
             TPM2_Packet_ParseU16(&packet, &out->creationData.size);
             TPM2_Packet_ParsePCR(&packet,
                 &out->creationData.creationData.pcrSelect);
-            TPM2_Packet_ParseU16(&packet,
-                &out->creationData.creationData.pcrDigest.size);
-            TPM2_Packet_ParseBytes(&packet,
+            TPM2_Packet_ParseU16Buf(&packet,
+                &out->creationData.creationData.pcrDigest.size,
                 out->creationData.creationData.pcrDigest.buffer,
-                out->creationData.creationData.pcrDigest.size);
+                (UINT16)sizeof(out->creationData.creationData.pcrDigest.buffer));
             TPM2_Packet_ParseU8(&packet,
                 &out->creationData.creationData.locality);
             TPM2_Packet_ParseU16(&packet,
                 &out->creationData.creationData.parentNameAlg);
-            TPM2_Packet_ParseU16(&packet,
-                &out->creationData.creationData.parentName.size);
-            TPM2_Packet_ParseBytes(&packet,
+            TPM2_Packet_ParseU16Buf(&packet,
+                &out->creationData.creationData.parentName.size,
                 out->creationData.creationData.parentName.name,
-                out->creationData.creationData.parentName.size);
-            TPM2_Packet_ParseU16(&packet,
-                &out->creationData.creationData.parentQualifiedName.size);
-            TPM2_Packet_ParseBytes(&packet,
+                (UINT16)sizeof(out->creationData.creationData.parentName.name));
+            TPM2_Packet_ParseU16Buf(&packet,
+                &out->creationData.creationData.parentQualifiedName.size,
                 out->creationData.creationData.parentQualifiedName.name,
-                out->creationData.creationData.parentQualifiedName.size);
-            TPM2_Packet_ParseU16(&packet,
-                &out->creationData.creationData.outsideInfo.size);
-            TPM2_Packet_ParseBytes(&packet,
+                (UINT16)sizeof(out->creationData.creationData.parentQualifiedName.name));
+            TPM2_Packet_ParseU16Buf(&packet,
+                &out->creationData.creationData.outsideInfo.size,
                 out->creationData.creationData.outsideInfo.buffer,
-                out->creationData.creationData.outsideInfo.size);
+                (UINT16)sizeof(out->creationData.creationData.outsideInfo.buffer));
 
-            TPM2_Packet_ParseU16(&packet, &out->creationHash.size);
-            TPM2_Packet_ParseBytes(&packet, out->creationHash.buffer,
-                out->creationHash.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->creationHash.size,
+                out->creationHash.buffer,
+                (UINT16)sizeof(out->creationHash.buffer));
 
             TPM2_Packet_ParseU16(&packet, &out->creationTicket.tag);
             TPM2_Packet_ParseU32(&packet, &out->creationTicket.hierarchy);
-            TPM2_Packet_ParseU16(&packet, &out->creationTicket.digest.size);
-            TPM2_Packet_ParseBytes(&packet,
-                        out->creationTicket.digest.buffer,
-                        out->creationTicket.digest.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->creationTicket.digest.size,
+                out->creationTicket.digest.buffer,
+                (UINT16)sizeof(out->creationTicket.digest.buffer));
 
-            TPM2_Packet_ParseU16(&packet, &out->name.size);
-            TPM2_Packet_ParseBytes(&packet, out->name.name, out->name.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->name.size,
+                out->name.name, (UINT16)sizeof(out->name.name));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -1209,9 +1716,7 @@ TPM_RC TPM2_Load(Load_In* in, Load_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.outHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_Load, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->parentHandle);
@@ -1228,9 +1733,11 @@ TPM_RC TPM2_Load(Load_In* in, Load_Out* out)
             UINT32 paramSz = 0;
             TPM2_Packet_ParseU32(&packet, &out->objectHandle);
             TPM2_Packet_ParseU32(&packet, &paramSz);
-            TPM2_Packet_ParseU16(&packet, &out->name.size);
-            TPM2_Packet_ParseBytes(&packet, out->name.name, out->name.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->name.size,
+                out->name.name, (UINT16)sizeof(out->name.name));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -1272,8 +1779,7 @@ TPM_RC TPM2_Unseal(Unseal_In* in, Unseal_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_Unseal, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->itemHandle);
@@ -1285,10 +1791,11 @@ TPM_RC TPM2_Unseal(Unseal_In* in, Unseal_Out* out)
         if (rc == TPM_RC_SUCCESS) {
             UINT32 paramSz = 0;
             TPM2_Packet_ParseU32(&packet, &paramSz);
-            TPM2_Packet_ParseU16(&packet, &out->outData.size);
-            TPM2_Packet_ParseBytes(&packet, out->outData.buffer,
-                out->outData.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->outData.size,
+                out->outData.buffer, (UINT16)sizeof(out->outData.buffer));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -1326,16 +1833,18 @@ TPM_RC TPM2_StartAuthSession(StartAuthSession_In* in, StartAuthSession_Out* out)
         rc = TPM2_SendCommand(ctx, &packet);
         if (rc == TPM_RC_SUCCESS) {
             TPM2_Packet_ParseU32(&packet, &out->sessionHandle);
-            TPM2_Packet_ParseU16(&packet, &out->nonceTPM.size);
-            TPM2_Packet_ParseBytes(&packet, out->nonceTPM.buffer,
-                out->nonceTPM.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->nonceTPM.size,
+                out->nonceTPM.buffer, (UINT16)sizeof(out->nonceTPM.buffer));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
     return rc;
 }
 
+#ifndef WOLFTPM2_NO_POLICY
 TPM_RC TPM2_PolicyRestart(PolicyRestart_In* in)
 {
     TPM_RC rc;
@@ -1358,6 +1867,7 @@ TPM_RC TPM2_PolicyRestart(PolicyRestart_In* in)
     }
     return rc;
 }
+#endif /* !WOLFTPM2_NO_POLICY */
 
 TPM_RC TPM2_LoadExternal(LoadExternal_In* in, LoadExternal_Out* out)
 {
@@ -1372,8 +1882,7 @@ TPM_RC TPM2_LoadExternal(LoadExternal_In* in, LoadExternal_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.outHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2);
+        TPM2_GetCmdInfo(TPM_CC_LoadExternal, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -1426,9 +1935,11 @@ TPM_RC TPM2_LoadExternal(LoadExternal_In* in, LoadExternal_Out* out)
                 TPM2_Packet_ParseU32(&packet, &paramSz);
             }
 
-            TPM2_Packet_ParseU16(&packet, &out->name.size);
-            TPM2_Packet_ParseBytes(&packet, out->name.name, out->name.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->name.size,
+                out->name.name, (UINT16)sizeof(out->name.name));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -1455,13 +1966,14 @@ TPM_RC TPM2_ReadPublic(ReadPublic_In* in, ReadPublic_Out* out)
         if (rc == TPM_RC_SUCCESS) {
             TPM2_Packet_ParsePublic(&packet, &out->outPublic);
 
-            TPM2_Packet_ParseU16(&packet, &out->name.size);
-            TPM2_Packet_ParseBytes(&packet, out->name.name, out->name.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->name.size,
+                out->name.name, (UINT16)sizeof(out->name.name));
 
-            TPM2_Packet_ParseU16(&packet, &out->qualifiedName.size);
-            TPM2_Packet_ParseBytes(&packet, out->qualifiedName.name,
-                out->qualifiedName.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->qualifiedName.size,
+                out->qualifiedName.name, (UINT16)sizeof(out->qualifiedName.name));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -1481,9 +1993,7 @@ TPM_RC TPM2_ActivateCredential(ActivateCredential_In* in,
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 2;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_ADMIN |
-            CMD_FLAG_AUTH_USER2);
+        TPM2_GetCmdInfo(TPM_CC_ActivateCredential, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->activateHandle);
@@ -1502,10 +2012,11 @@ TPM_RC TPM2_ActivateCredential(ActivateCredential_In* in,
         if (rc == TPM_RC_SUCCESS) {
             UINT32 paramSz = 0;
             TPM2_Packet_ParseU32(&packet, &paramSz);
-            TPM2_Packet_ParseU16(&packet, &out->certInfo.size);
-            TPM2_Packet_ParseBytes(&packet, out->certInfo.buffer,
-                out->certInfo.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->certInfo.size,
+                out->certInfo.buffer, (UINT16)sizeof(out->certInfo.buffer));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -1540,14 +2051,15 @@ TPM_RC TPM2_MakeCredential(MakeCredential_In* in, MakeCredential_Out* out)
         /* send command */
         rc = TPM2_SendCommand(ctx, &packet);
         if (rc == TPM_RC_SUCCESS) {
-            TPM2_Packet_ParseU16(&packet, &out->credentialBlob.size);
-            TPM2_Packet_ParseBytes(&packet, out->credentialBlob.buffer,
-                out->credentialBlob.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->credentialBlob.size,
+                out->credentialBlob.buffer,
+                (UINT16)sizeof(out->credentialBlob.buffer));
 
-            TPM2_Packet_ParseU16(&packet, &out->secret.size);
-            TPM2_Packet_ParseBytes(&packet, out->secret.secret,
-                out->secret.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->secret.size,
+                out->secret.secret, (UINT16)sizeof(out->secret.secret));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -1566,8 +2078,7 @@ TPM_RC TPM2_ObjectChangeAuth(ObjectChangeAuth_In* in, ObjectChangeAuth_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 2;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_ADMIN);
+        TPM2_GetCmdInfo(TPM_CC_ObjectChangeAuth, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->objectHandle);
@@ -1587,16 +2098,18 @@ TPM_RC TPM2_ObjectChangeAuth(ObjectChangeAuth_In* in, ObjectChangeAuth_Out* out)
             UINT32 paramSz = 0;
             TPM2_Packet_ParseU32(&packet, &paramSz);
 
-            TPM2_Packet_ParseU16(&packet, &out->outPrivate.size);
-            TPM2_Packet_ParseBytes(&packet, out->outPrivate.buffer,
-                out->outPrivate.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->outPrivate.size,
+                out->outPrivate.buffer, (UINT16)sizeof(out->outPrivate.buffer));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
     return rc;
 }
 
+#ifndef WOLFTPM2_NO_IMPORT
 TPM_RC TPM2_Duplicate(Duplicate_In* in, Duplicate_Out* out)
 {
     TPM_RC rc;
@@ -1609,8 +2122,7 @@ TPM_RC TPM2_Duplicate(Duplicate_In* in, Duplicate_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 2;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_DUP);
+        TPM2_GetCmdInfo(TPM_CC_Duplicate, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->objectHandle);
@@ -1635,18 +2147,18 @@ TPM_RC TPM2_Duplicate(Duplicate_In* in, Duplicate_Out* out)
 
             TPM2_Packet_ParseU32(&packet, &paramSz);
 
-            TPM2_Packet_ParseU16(&packet, &out->encryptionKeyOut.size);
-            TPM2_Packet_ParseBytes(&packet, out->encryptionKeyOut.buffer,
-                out->encryptionKeyOut.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->encryptionKeyOut.size,
+                out->encryptionKeyOut.buffer,
+                (UINT16)sizeof(out->encryptionKeyOut.buffer));
 
-            TPM2_Packet_ParseU16(&packet, &out->duplicate.size);
-            TPM2_Packet_ParseBytes(&packet, out->duplicate.buffer,
-                out->duplicate.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->duplicate.size,
+                out->duplicate.buffer, (UINT16)sizeof(out->duplicate.buffer));
 
-            TPM2_Packet_ParseU16(&packet, &out->outSymSeed.size);
-            TPM2_Packet_ParseBytes(&packet, out->outSymSeed.secret,
-                out->outSymSeed.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->outSymSeed.size,
+                out->outSymSeed.secret, (UINT16)sizeof(out->outSymSeed.secret));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -1665,8 +2177,7 @@ TPM_RC TPM2_Rewrap(Rewrap_In* in, Rewrap_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 2;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_Rewrap, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->oldParent);
@@ -1694,14 +2205,15 @@ TPM_RC TPM2_Rewrap(Rewrap_In* in, Rewrap_Out* out)
 
             TPM2_Packet_ParseU32(&packet, &paramSz);
 
-            TPM2_Packet_ParseU16(&packet, &out->outDuplicate.size);
-            TPM2_Packet_ParseBytes(&packet, out->outDuplicate.buffer,
-                out->outDuplicate.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->outDuplicate.size,
+                out->outDuplicate.buffer,
+                (UINT16)sizeof(out->outDuplicate.buffer));
 
-            TPM2_Packet_ParseU16(&packet, &out->outSymSeed.size);
-            TPM2_Packet_ParseBytes(&packet, out->outSymSeed.secret,
-                out->outSymSeed.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->outSymSeed.size,
+                out->outSymSeed.secret, (UINT16)sizeof(out->outSymSeed.secret));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -1720,8 +2232,7 @@ TPM_RC TPM2_Import(Import_In* in, Import_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_Import, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->parentHandle);
@@ -1747,15 +2258,17 @@ TPM_RC TPM2_Import(Import_In* in, Import_Out* out)
 
             TPM2_Packet_ParseU32(&packet, &paramSz);
 
-            TPM2_Packet_ParseU16(&packet, &out->outPrivate.size);
-            TPM2_Packet_ParseBytes(&packet, out->outPrivate.buffer,
-                out->outPrivate.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->outPrivate.size,
+                out->outPrivate.buffer, (UINT16)sizeof(out->outPrivate.buffer));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
     return rc;
 }
+#endif /* !WOLFTPM2_NO_IMPORT */
 
 TPM_RC TPM2_RSA_Encrypt(RSA_Encrypt_In* in, RSA_Encrypt_Out* out)
 {
@@ -1770,8 +2283,7 @@ TPM_RC TPM2_RSA_Encrypt(RSA_Encrypt_In* in, RSA_Encrypt_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2);
+        TPM2_GetCmdInfo(TPM_CC_RSA_Encrypt, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->keyHandle);
@@ -1800,10 +2312,11 @@ TPM_RC TPM2_RSA_Encrypt(RSA_Encrypt_In* in, RSA_Encrypt_Out* out)
                 TPM2_Packet_ParseU32(&packet, &paramSz);
             }
 
-            TPM2_Packet_ParseU16(&packet, &out->outData.size);
-            TPM2_Packet_ParseBytes(&packet, out->outData.buffer,
-                out->outData.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->outData.size,
+                out->outData.buffer, (UINT16)sizeof(out->outData.buffer));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -1822,8 +2335,7 @@ TPM_RC TPM2_RSA_Decrypt(RSA_Decrypt_In* in, RSA_Decrypt_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_RSA_Decrypt, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->keyHandle);
@@ -1851,10 +2363,11 @@ TPM_RC TPM2_RSA_Decrypt(RSA_Decrypt_In* in, RSA_Decrypt_Out* out)
 
             TPM2_Packet_ParseU32(&packet, &paramSz);
 
-            TPM2_Packet_ParseU16(&packet, &out->message.size);
-            TPM2_Packet_ParseBytes(&packet, out->message.buffer,
-                out->message.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->message.size,
+                out->message.buffer, (UINT16)sizeof(out->message.buffer));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -1874,8 +2387,7 @@ TPM_RC TPM2_ECDH_KeyGen(ECDH_KeyGen_In* in, ECDH_KeyGen_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_DEC2);
+        TPM2_GetCmdInfo(TPM_CC_ECDH_KeyGen, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->keyHandle);
@@ -1897,6 +2409,8 @@ TPM_RC TPM2_ECDH_KeyGen(ECDH_KeyGen_In* in, ECDH_KeyGen_Out* out)
             /* generated ephemeral public point (Qe) */
             TPM2_Packet_ParsePoint(&packet, &out->pubPoint);
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -1915,8 +2429,7 @@ TPM_RC TPM2_ECDH_ZGen(ECDH_ZGen_In* in, ECDH_ZGen_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_ECDH_ZGen, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->keyHandle);
@@ -1935,6 +2448,8 @@ TPM_RC TPM2_ECDH_ZGen(ECDH_ZGen_In* in, ECDH_ZGen_Out* out)
                Z = (xZ , yZ) ≔ [hdS]QB */
             TPM2_Packet_ParsePoint(&packet, &out->outPoint);
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -1975,34 +2490,36 @@ TPM_RC TPM2_ECC_Parameters(ECC_Parameters_In* in,
                 TPM2_Packet_ParseU16(&packet,
                     &out->parameters.sign.details.any.hashAlg);
 
-            TPM2_Packet_ParseU16(&packet, &out->parameters.p.size);
-            TPM2_Packet_ParseBytes(&packet, out->parameters.p.buffer,
-                out->parameters.p.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->parameters.p.size,
+                out->parameters.p.buffer,
+                (UINT16)sizeof(out->parameters.p.buffer));
 
-            TPM2_Packet_ParseU16(&packet, &out->parameters.a.size);
-            TPM2_Packet_ParseBytes(&packet, out->parameters.a.buffer,
-                out->parameters.a.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->parameters.a.size,
+                out->parameters.a.buffer,
+                (UINT16)sizeof(out->parameters.a.buffer));
 
-            TPM2_Packet_ParseU16(&packet, &out->parameters.b.size);
-            TPM2_Packet_ParseBytes(&packet, out->parameters.b.buffer,
-                out->parameters.b.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->parameters.b.size,
+                out->parameters.b.buffer,
+                (UINT16)sizeof(out->parameters.b.buffer));
 
-            TPM2_Packet_ParseU16(&packet, &out->parameters.gX.size);
-            TPM2_Packet_ParseBytes(&packet, out->parameters.gX.buffer,
-                out->parameters.gX.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->parameters.gX.size,
+                out->parameters.gX.buffer,
+                (UINT16)sizeof(out->parameters.gX.buffer));
 
-            TPM2_Packet_ParseU16(&packet, &out->parameters.gY.size);
-            TPM2_Packet_ParseBytes(&packet, out->parameters.gY.buffer,
-                out->parameters.gY.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->parameters.gY.size,
+                out->parameters.gY.buffer,
+                (UINT16)sizeof(out->parameters.gY.buffer));
 
-            TPM2_Packet_ParseU16(&packet, &out->parameters.n.size);
-            TPM2_Packet_ParseBytes(&packet, out->parameters.n.buffer,
-                out->parameters.n.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->parameters.n.size,
+                out->parameters.n.buffer,
+                (UINT16)sizeof(out->parameters.n.buffer));
 
-            TPM2_Packet_ParseU16(&packet, &out->parameters.h.size);
-            TPM2_Packet_ParseBytes(&packet, out->parameters.h.buffer,
-                out->parameters.h.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->parameters.h.size,
+                out->parameters.h.buffer,
+                (UINT16)sizeof(out->parameters.h.buffer));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -2021,8 +2538,7 @@ TPM_RC TPM2_ZGen_2Phase(ZGen_2Phase_In* in, ZGen_2Phase_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_ZGen_2Phase, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->keyA);
@@ -2043,6 +2559,8 @@ TPM_RC TPM2_ZGen_2Phase(ZGen_2Phase_In* in, ZGen_2Phase_Out* out)
             TPM2_Packet_ParsePoint(&packet, &out->outZ1);
             TPM2_Packet_ParsePoint(&packet, &out->outZ2);
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -2063,8 +2581,7 @@ TPM_RC TPM2_EncryptDecrypt(EncryptDecrypt_In* in, EncryptDecrypt_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_EncryptDecrypt, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->keyHandle);
@@ -2088,13 +2605,14 @@ TPM_RC TPM2_EncryptDecrypt(EncryptDecrypt_In* in, EncryptDecrypt_Out* out)
 
             TPM2_Packet_ParseU32(&packet, &paramSz);
 
-            TPM2_Packet_ParseU16(&packet, &out->outData.size);
-            TPM2_Packet_ParseBytes(&packet, out->outData.buffer,
-                out->outData.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->outData.size,
+                out->outData.buffer, (UINT16)sizeof(out->outData.buffer));
 
-            TPM2_Packet_ParseU16(&packet, &out->ivOut.size);
-            TPM2_Packet_ParseBytes(&packet, out->ivOut.buffer, out->ivOut.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->ivOut.size,
+                out->ivOut.buffer, (UINT16)sizeof(out->ivOut.buffer));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -2113,8 +2631,7 @@ TPM_RC TPM2_EncryptDecrypt2(EncryptDecrypt2_In* in, EncryptDecrypt2_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_EncryptDecrypt2, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->keyHandle);
@@ -2138,13 +2655,14 @@ TPM_RC TPM2_EncryptDecrypt2(EncryptDecrypt2_In* in, EncryptDecrypt2_Out* out)
 
             TPM2_Packet_ParseU32(&packet, &paramSz);
 
-            TPM2_Packet_ParseU16(&packet, &out->outData.size);
-            TPM2_Packet_ParseBytes(&packet, out->outData.buffer,
-                out->outData.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->outData.size,
+                out->outData.buffer, (UINT16)sizeof(out->outData.buffer));
 
-            TPM2_Packet_ParseU16(&packet, &out->ivOut.size);
-            TPM2_Packet_ParseBytes(&packet, out->ivOut.buffer, out->ivOut.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->ivOut.size,
+                out->ivOut.buffer, (UINT16)sizeof(out->ivOut.buffer));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -2164,7 +2682,7 @@ TPM_RC TPM2_Hash(Hash_In* in, Hash_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2);
+        TPM2_GetCmdInfo(TPM_CC_Hash, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -2187,17 +2705,18 @@ TPM_RC TPM2_Hash(Hash_In* in, Hash_Out* out)
                 TPM2_Packet_ParseU32(&packet, &paramSz);
             }
 
-            TPM2_Packet_ParseU16(&packet, &out->outHash.size);
-            TPM2_Packet_ParseBytes(&packet, out->outHash.buffer,
-                out->outHash.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->outHash.size,
+                out->outHash.buffer, (UINT16)sizeof(out->outHash.buffer));
 
             TPM2_Packet_ParseU16(&packet, &out->validation.tag);
             TPM2_Packet_ParseU32(&packet, &out->validation.hierarchy);
 
-            TPM2_Packet_ParseU16(&packet, &out->validation.digest.size);
-            TPM2_Packet_ParseBytes(&packet, out->validation.digest.buffer,
-                out->validation.digest.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->validation.digest.size,
+                out->validation.digest.buffer,
+                (UINT16)sizeof(out->validation.digest.buffer));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -2216,8 +2735,7 @@ TPM_RC TPM2_HMAC(HMAC_In* in, HMAC_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_HMAC, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -2238,10 +2756,11 @@ TPM_RC TPM2_HMAC(HMAC_In* in, HMAC_Out* out)
 
             TPM2_Packet_ParseU32(&packet, &paramSz);
 
-            TPM2_Packet_ParseU16(&packet, &out->outHMAC.size);
-            TPM2_Packet_ParseBytes(&packet, out->outHMAC.buffer,
-                out->outHMAC.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->outHMAC.size,
+                out->outHMAC.buffer, (UINT16)sizeof(out->outHMAC.buffer));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -2260,9 +2779,7 @@ TPM_RC TPM2_HMAC_Start(HMAC_Start_In* in, HMAC_Start_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.outHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_HMAC_Start, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -2284,6 +2801,8 @@ TPM_RC TPM2_HMAC_Start(HMAC_Start_In* in, HMAC_Start_Out* out)
             TPM2_Packet_ParseU32(&packet, &out->sequenceHandle);
             TPM2_Packet_ParseU32(&packet, &paramSz);
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -2304,8 +2823,7 @@ TPM_RC TPM2_HashSequenceStart(HashSequenceStart_In* in,
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.outHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2);
+        TPM2_GetCmdInfo(TPM_CC_HashSequenceStart, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -2323,6 +2841,8 @@ TPM_RC TPM2_HashSequenceStart(HashSequenceStart_In* in,
         if (rc == TPM_RC_SUCCESS) {
             TPM2_Packet_ParseU32(&packet, &out->sequenceHandle);
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -2341,8 +2861,7 @@ TPM_RC TPM2_SequenceUpdate(SequenceUpdate_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_SequenceUpdate, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -2374,8 +2893,7 @@ TPM_RC TPM2_SequenceComplete(SequenceComplete_In* in, SequenceComplete_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_SequenceComplete, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -2396,17 +2914,18 @@ TPM_RC TPM2_SequenceComplete(SequenceComplete_In* in, SequenceComplete_Out* out)
 
             TPM2_Packet_ParseU32(&packet, &paramSz);
 
-            TPM2_Packet_ParseU16(&packet, &out->result.size);
-            TPM2_Packet_ParseBytes(&packet, out->result.buffer,
-                out->result.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->result.size,
+                out->result.buffer, (UINT16)sizeof(out->result.buffer));
 
             TPM2_Packet_ParseU16(&packet, &out->validation.tag);
             TPM2_Packet_ParseU32(&packet, &out->validation.hierarchy);
 
-            TPM2_Packet_ParseU16(&packet, &out->validation.digest.size);
-            TPM2_Packet_ParseBytes(&packet, out->validation.digest.buffer,
-                out->validation.digest.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->validation.digest.size,
+                out->validation.digest.buffer,
+                (UINT16)sizeof(out->validation.digest.buffer));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -2426,9 +2945,7 @@ TPM_RC TPM2_EventSequenceComplete(EventSequenceComplete_In* in,
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 2;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_AUTH_USER1 |
-            CMD_FLAG_AUTH_USER2);
+        TPM2_GetCmdInfo(TPM_CC_EventSequenceComplete, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -2451,7 +2968,9 @@ TPM_RC TPM2_EventSequenceComplete(EventSequenceComplete_In* in,
 
             TPM2_Packet_ParseU32(&packet, &paramSz);
 
-            TPM2_Packet_ParseU32(&packet, &out->results.count);
+            TPM2_Packet_ParseCount(&packet, &out->results.count,
+                (UINT32)(sizeof(out->results.digests) /
+                         sizeof(out->results.digests[0])));
             for (i=0; i<(int)out->results.count; i++) {
                 TPM2_Packet_ParseU16(&packet,
                     &out->results.digests[i].hashAlg);
@@ -2461,12 +2980,15 @@ TPM_RC TPM2_EventSequenceComplete(EventSequenceComplete_In* in,
                     out->results.digests[i].digest.H, digestSz);
             }
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
     return rc;
 }
 
+#ifndef WOLFTPM2_NO_ATTEST
 TPM_RC TPM2_Certify(Certify_In* in, Certify_Out* out)
 {
     TPM_RC rc;
@@ -2479,9 +3001,7 @@ TPM_RC TPM2_Certify(Certify_In* in, Certify_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 2;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_ADMIN |
-            CMD_FLAG_AUTH_USER2);
+        TPM2_GetCmdInfo(TPM_CC_Certify, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -2506,12 +3026,13 @@ TPM_RC TPM2_Certify(Certify_In* in, Certify_Out* out)
 
             TPM2_Packet_ParseU32(&packet, &paramSz);
 
-            TPM2_Packet_ParseU16(&packet, &out->certifyInfo.size);
-            TPM2_Packet_ParseBytes(&packet, out->certifyInfo.attestationData,
-                out->certifyInfo.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->certifyInfo.size,
+                out->certifyInfo.attestationData, (UINT16)sizeof(out->certifyInfo.attestationData));
 
             TPM2_Packet_ParseSignature(&packet, &out->signature);
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -2530,8 +3051,7 @@ TPM_RC TPM2_CertifyCreation(CertifyCreation_In* in, CertifyCreation_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 2;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_CertifyCreation, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -2567,12 +3087,13 @@ TPM_RC TPM2_CertifyCreation(CertifyCreation_In* in, CertifyCreation_Out* out)
 
             TPM2_Packet_ParseU32(&packet, &paramSz);
 
-            TPM2_Packet_ParseU16(&packet, &out->certifyInfo.size);
-            TPM2_Packet_ParseBytes(&packet, out->certifyInfo.attestationData,
-                out->certifyInfo.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->certifyInfo.size,
+                out->certifyInfo.attestationData, (UINT16)sizeof(out->certifyInfo.attestationData));
 
             TPM2_Packet_ParseSignature(&packet, &out->signature);
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -2591,8 +3112,7 @@ TPM_RC TPM2_Quote(Quote_In* in, Quote_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_Quote, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -2618,12 +3138,13 @@ TPM_RC TPM2_Quote(Quote_In* in, Quote_Out* out)
 
             TPM2_Packet_ParseU32(&packet, &paramSz);
 
-            TPM2_Packet_ParseU16(&packet, &out->quoted.size);
-            TPM2_Packet_ParseBytes(&packet, out->quoted.attestationData,
-                out->quoted.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->quoted.size,
+                out->quoted.attestationData, (UINT16)sizeof(out->quoted.attestationData));
 
             TPM2_Packet_ParseSignature(&packet, &out->signature);
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -2643,9 +3164,7 @@ TPM_RC TPM2_GetSessionAuditDigest(GetSessionAuditDigest_In* in,
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 2;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1 |
-            CMD_FLAG_AUTH_USER2);
+        TPM2_GetCmdInfo(TPM_CC_GetSessionAuditDigest, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -2672,12 +3191,13 @@ TPM_RC TPM2_GetSessionAuditDigest(GetSessionAuditDigest_In* in,
 
             TPM2_Packet_ParseU32(&packet, &paramSz);
 
-            TPM2_Packet_ParseU16(&packet, &out->auditInfo.size);
-            TPM2_Packet_ParseBytes(&packet, out->auditInfo.attestationData,
-                out->auditInfo.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->auditInfo.size,
+                out->auditInfo.attestationData, (UINT16)sizeof(out->auditInfo.attestationData));
 
             TPM2_Packet_ParseSignature(&packet, &out->signature);
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -2697,9 +3217,7 @@ TPM_RC TPM2_GetCommandAuditDigest(GetCommandAuditDigest_In* in,
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 2;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1 |
-            CMD_FLAG_AUTH_USER2);
+        TPM2_GetCmdInfo(TPM_CC_GetCommandAuditDigest, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -2725,12 +3243,13 @@ TPM_RC TPM2_GetCommandAuditDigest(GetCommandAuditDigest_In* in,
 
             TPM2_Packet_ParseU32(&packet, &paramSz);
 
-            TPM2_Packet_ParseU16(&packet, &out->auditInfo.size);
-            TPM2_Packet_ParseBytes(&packet, out->auditInfo.attestationData,
-                out->auditInfo.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->auditInfo.size,
+                out->auditInfo.attestationData, (UINT16)sizeof(out->auditInfo.attestationData));
 
             TPM2_Packet_ParseSignature(&packet, &out->signature);
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -2749,9 +3268,7 @@ TPM_RC TPM2_GetTime(GetTime_In* in, GetTime_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 2;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1 |
-            CMD_FLAG_AUTH_USER2);
+        TPM2_GetCmdInfo(TPM_CC_GetTime, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -2776,17 +3293,19 @@ TPM_RC TPM2_GetTime(GetTime_In* in, GetTime_Out* out)
 
             TPM2_Packet_ParseU32(&packet, &paramSz);
 
-            TPM2_Packet_ParseU16(&packet, &out->timeInfo.size);
-            TPM2_Packet_ParseBytes(&packet, out->timeInfo.attestationData,
-                out->timeInfo.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->timeInfo.size,
+                out->timeInfo.attestationData, (UINT16)sizeof(out->timeInfo.attestationData));
 
             TPM2_Packet_ParseSignature(&packet, &out->signature);
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
     return rc;
 }
+#endif /* !WOLFTPM2_NO_ATTEST */
 
 TPM_RC TPM2_Commit(Commit_In* in, Commit_Out* out)
 {
@@ -2800,8 +3319,7 @@ TPM_RC TPM2_Commit(Commit_In* in, Commit_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_Commit, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -2831,6 +3349,8 @@ TPM_RC TPM2_Commit(Commit_In* in, Commit_Out* out)
             TPM2_Packet_ParsePoint(&packet, &out->E);
             TPM2_Packet_ParseU16(&packet, &out->counter);
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -2850,7 +3370,7 @@ TPM_RC TPM2_EC_Ephemeral(EC_Ephemeral_In* in, EC_Ephemeral_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.flags = (CMD_FLAG_DEC2);
+        TPM2_GetCmdInfo(TPM_CC_EC_Ephemeral, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         st = TPM2_Packet_AppendAuth(&packet, ctx, &info);
@@ -2869,6 +3389,8 @@ TPM_RC TPM2_EC_Ephemeral(EC_Ephemeral_In* in, EC_Ephemeral_Out* out)
             TPM2_Packet_ParsePoint(&packet, &out->Q);
             TPM2_Packet_ParseU16(&packet, &out->counter);
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -2889,8 +3411,7 @@ TPM_RC TPM2_VerifySignature(VerifySignature_In* in,
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2);
+        TPM2_GetCmdInfo(TPM_CC_VerifySignature, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -2916,11 +3437,12 @@ TPM_RC TPM2_VerifySignature(VerifySignature_In* in,
 
             TPM2_Packet_ParseU16(&packet, &out->validation.tag);
             TPM2_Packet_ParseU32(&packet, &out->validation.hierarchy);
-            TPM2_Packet_ParseU16(&packet, &out->validation.digest.size);
-            TPM2_Packet_ParseBytes(&packet,
-                        out->validation.digest.buffer,
-                        out->validation.digest.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->validation.digest.size,
+                out->validation.digest.buffer,
+                (UINT16)sizeof(out->validation.digest.buffer));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -2939,8 +3461,7 @@ TPM_RC TPM2_Sign(Sign_In* in, Sign_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_Sign, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -2971,6 +3492,8 @@ TPM_RC TPM2_Sign(Sign_In* in, Sign_Out* out)
             TPM2_Packet_ParseU32(&packet, &paramSz);
             TPM2_Packet_ParseSignature(&packet, &out->signature);
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -2990,8 +3513,7 @@ TPM_RC TPM2_SetCommandCodeAuditStatus(SetCommandCodeAuditStatus_In* in)
         int i;
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_SetCommandCodeAuditStatus, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -3034,8 +3556,7 @@ TPM_RC TPM2_PCR_Event(PCR_Event_In* in, PCR_Event_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_PCR_Event, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -3056,8 +3577,10 @@ TPM_RC TPM2_PCR_Event(PCR_Event_In* in, PCR_Event_Out* out)
 
             TPM2_Packet_ParseU32(&packet, &paramSz);
 
-            TPM2_Packet_ParseU32(&packet, &out->digests.count);
-            for (i=0; (int)out->digests.count; i++) {
+            TPM2_Packet_ParseCount(&packet, &out->digests.count,
+                (UINT32)(sizeof(out->digests.digests) /
+                         sizeof(out->digests.digests[0])));
+            for (i=0; i<(int)out->digests.count; i++) {
                 int digestSz;
                 TPM2_Packet_ParseU16(&packet, &out->digests.digests[i].hashAlg);
                 digestSz = TPM2_GetHashDigestSize(
@@ -3066,6 +3589,8 @@ TPM_RC TPM2_PCR_Event(PCR_Event_In* in, PCR_Event_Out* out)
                     out->digests.digests[i].digest.H, digestSz);
             }
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -3084,8 +3609,7 @@ TPM_RC TPM2_PCR_Allocate(PCR_Allocate_In* in, PCR_Allocate_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_PCR_Allocate, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -3108,6 +3632,8 @@ TPM_RC TPM2_PCR_Allocate(PCR_Allocate_In* in, PCR_Allocate_Out* out)
             TPM2_Packet_ParseU32(&packet, &out->sizeNeeded);
             TPM2_Packet_ParseU32(&packet, &out->sizeAvailable);
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -3126,8 +3652,7 @@ TPM_RC TPM2_PCR_SetAuthPolicy(PCR_SetAuthPolicy_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2);
+        TPM2_GetCmdInfo(TPM_CC_PCR_SetAuthPolicy, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -3164,8 +3689,7 @@ TPM_RC TPM2_PCR_SetAuthValue(PCR_SetAuthValue_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_PCR_SetAuthValue, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -3197,8 +3721,7 @@ TPM_RC TPM2_PCR_Reset(PCR_Reset_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_PCR_Reset, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -3215,6 +3738,7 @@ TPM_RC TPM2_PCR_Reset(PCR_Reset_In* in)
     return rc;
 }
 
+#ifndef WOLFTPM2_NO_POLICY
 TPM_RC TPM2_PolicySigned(PolicySigned_In* in, PolicySigned_Out* out)
 {
     TPM_RC rc;
@@ -3228,8 +3752,7 @@ TPM_RC TPM2_PolicySigned(PolicySigned_In* in, PolicySigned_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 2;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2);
+        TPM2_GetCmdInfo(TPM_CC_PolicySigned, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -3265,17 +3788,17 @@ TPM_RC TPM2_PolicySigned(PolicySigned_In* in, PolicySigned_Out* out)
                 TPM2_Packet_ParseU32(&packet, &paramSz);
             }
 
-            TPM2_Packet_ParseU16(&packet, &out->timeout.size);
-            TPM2_Packet_ParseBytes(&packet, out->timeout.buffer,
-                out->timeout.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->timeout.size,
+                out->timeout.buffer, (UINT16)sizeof(out->timeout.buffer));
 
             TPM2_Packet_ParseU16(&packet, &out->policyTicket.tag);
             TPM2_Packet_ParseU32(&packet, &out->policyTicket.hierarchy);
-            TPM2_Packet_ParseU16(&packet, &out->policyTicket.digest.size);
-            TPM2_Packet_ParseBytes(&packet,
-                        out->policyTicket.digest.buffer,
-                        out->policyTicket.digest.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->policyTicket.digest.size,
+                out->policyTicket.digest.buffer,
+                (UINT16)sizeof(out->policyTicket.digest.buffer));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -3294,8 +3817,7 @@ TPM_RC TPM2_PolicySecret(PolicySecret_In* in, PolicySecret_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 2;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_PolicySecret, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -3327,17 +3849,17 @@ TPM_RC TPM2_PolicySecret(PolicySecret_In* in, PolicySecret_Out* out)
 
             TPM2_Packet_ParseU32(&packet, &paramSz);
 
-            TPM2_Packet_ParseU16(&packet, &out->timeout.size);
-            TPM2_Packet_ParseBytes(&packet, out->timeout.buffer,
-                out->timeout.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->timeout.size,
+                out->timeout.buffer, (UINT16)sizeof(out->timeout.buffer));
 
             TPM2_Packet_ParseU16(&packet, &out->policyTicket.tag);
             TPM2_Packet_ParseU32(&packet, &out->policyTicket.hierarchy);
-            TPM2_Packet_ParseU16(&packet, &out->policyTicket.digest.size);
-            TPM2_Packet_ParseBytes(&packet,
-                        out->policyTicket.digest.buffer,
-                        out->policyTicket.digest.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->policyTicket.digest.size,
+                out->policyTicket.digest.buffer,
+                (UINT16)sizeof(out->policyTicket.digest.buffer));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -3357,8 +3879,7 @@ TPM_RC TPM2_PolicyTicket(PolicyTicket_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2);
+        TPM2_GetCmdInfo(TPM_CC_PolicyTicket, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -3439,8 +3960,7 @@ TPM_RC TPM2_PolicyPCR(PolicyPCR_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2);
+        TPM2_GetCmdInfo(TPM_CC_PolicyPCR, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -3503,8 +4023,7 @@ TPM_RC TPM2_PolicyNV(PolicyNV_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 3;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_PolicyNV, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -3544,8 +4063,7 @@ TPM_RC TPM2_PolicyCounterTimer(PolicyCounterTimer_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2);
+        TPM2_GetCmdInfo(TPM_CC_PolicyCounterTimer, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -3611,8 +4129,7 @@ TPM_RC TPM2_PolicyCpHash(PolicyCpHash_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2);
+        TPM2_GetCmdInfo(TPM_CC_PolicyCpHash, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -3645,8 +4162,7 @@ TPM_RC TPM2_PolicyNameHash(PolicyNameHash_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2);
+        TPM2_GetCmdInfo(TPM_CC_PolicyNameHash, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -3680,8 +4196,7 @@ TPM_RC TPM2_PolicyDuplicationSelect(PolicyDuplicationSelect_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2);
+        TPM2_GetCmdInfo(TPM_CC_PolicyDuplicationSelect, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -3721,8 +4236,7 @@ TPM_RC TPM2_PolicyAuthorize(PolicyAuthorize_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2);
+        TPM2_GetCmdInfo(TPM_CC_PolicyAuthorize, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -3811,8 +4325,7 @@ TPM_RC TPM2_PolicyGetDigest(PolicyGetDigest_In* in, PolicyGetDigest_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_DEC2);
+        TPM2_GetCmdInfo(TPM_CC_PolicyGetDigest, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->policySession);
@@ -3828,10 +4341,12 @@ TPM_RC TPM2_PolicyGetDigest(PolicyGetDigest_In* in, PolicyGetDigest_Out* out)
                 TPM2_Packet_ParseU32(&packet, &paramSz);
             }
 
-            TPM2_Packet_ParseU16(&packet, &out->policyDigest.size);
-            TPM2_Packet_ParseBytes(&packet, out->policyDigest.buffer,
-                out->policyDigest.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->policyDigest.size,
+                out->policyDigest.buffer,
+                (UINT16)sizeof(out->policyDigest.buffer));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -3876,8 +4391,7 @@ TPM_RC TPM2_PolicyTemplate(PolicyTemplate_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2);
+        TPM2_GetCmdInfo(TPM_CC_PolicyTemplate, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->policySession);
@@ -3907,8 +4421,7 @@ TPM_RC TPM2_PolicyAuthorizeNV(PolicyAuthorizeNV_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 3;
-        info.flags = (CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_PolicyAuthorizeNV, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->authHandle);
@@ -3925,6 +4438,7 @@ TPM_RC TPM2_PolicyAuthorizeNV(PolicyAuthorizeNV_In* in)
     }
     return rc;
 }
+#endif /* !WOLFTPM2_NO_POLICY */
 
 
 TPM_RC TPM2_HierarchyControl(HierarchyControl_In* in)
@@ -3939,8 +4453,7 @@ TPM_RC TPM2_HierarchyControl(HierarchyControl_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_HierarchyControl, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->authHandle);
@@ -3969,8 +4482,7 @@ TPM_RC TPM2_SetPrimaryPolicy(SetPrimaryPolicy_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_SetPrimaryPolicy, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->authHandle);
@@ -4001,8 +4513,7 @@ static TPM_RC TPM2_ChangeSeed(ChangeSeed_In* in, TPM_CC cc)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(cc, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->authHandle);
@@ -4039,8 +4550,7 @@ TPM_RC TPM2_Clear(Clear_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_Clear, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->authHandle);
@@ -4067,8 +4577,7 @@ TPM_RC TPM2_ClearControl(ClearControl_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_ClearControl, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->auth);
@@ -4096,8 +4605,7 @@ TPM_RC TPM2_HierarchyChangeAuth(HierarchyChangeAuth_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_HierarchyChangeAuth, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->authHandle);
@@ -4127,8 +4635,7 @@ TPM_RC TPM2_DictionaryAttackLockReset(DictionaryAttackLockReset_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_DictionaryAttackLockReset, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->lockHandle);
@@ -4156,8 +4663,7 @@ TPM_RC TPM2_DictionaryAttackParameters(DictionaryAttackParameters_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_DictionaryAttackParameters, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->lockHandle);
@@ -4189,8 +4695,7 @@ TPM_RC TPM2_PP_Commands(PP_Commands_In* in)
         int i;
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_PP_Commands, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->auth);
@@ -4227,8 +4732,7 @@ TPM_RC TPM2_SetAlgorithmSet(SetAlgorithmSet_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_SetAlgorithmSet, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -4259,8 +4763,7 @@ TPM_RC TPM2_FieldUpgradeStart(FieldUpgradeStart_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 2;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_AUTH_ADMIN);
+        TPM2_GetCmdInfo(TPM_CC_FieldUpgradeStart, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -4279,6 +4782,9 @@ TPM_RC TPM2_FieldUpgradeStart(FieldUpgradeStart_In* in)
 
         /* send command */
         rc = TPM2_SendCommandAuth(ctx, &packet, &info);
+        if (rc == TPM_RC_SUCCESS) {
+            ctx->stateGen++;
+        }
 
         TPM2_ReleaseLock(ctx);
     }
@@ -4298,7 +4804,7 @@ TPM_RC TPM2_FieldUpgradeData(FieldUpgradeData_In* in, FieldUpgradeData_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.flags = (CMD_FLAG_ENC2);
+        TPM2_GetCmdInfo(TPM_CC_FieldUpgradeData, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -4315,6 +4821,8 @@ TPM_RC TPM2_FieldUpgradeData(FieldUpgradeData_In* in, FieldUpgradeData_Out* out)
             int digestSz;
             UINT32 paramSz = 0;
 
+            ctx->stateGen++;
+
             if (st == TPM_ST_SESSIONS) {
                 TPM2_Packet_ParseU32(&packet, &paramSz);
             }
@@ -4328,6 +4836,8 @@ TPM_RC TPM2_FieldUpgradeData(FieldUpgradeData_In* in, FieldUpgradeData_Out* out)
             TPM2_Packet_ParseBytes(&packet,
                 out->firstDigest.digest.H, digestSz);
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -4347,7 +4857,7 @@ TPM_RC TPM2_FirmwareRead(FirmwareRead_In* in, FirmwareRead_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.flags = (CMD_FLAG_DEC2);
+        TPM2_GetCmdInfo(TPM_CC_FirmwareRead, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -4364,10 +4874,11 @@ TPM_RC TPM2_FirmwareRead(FirmwareRead_In* in, FirmwareRead_Out* out)
                 TPM2_Packet_ParseU32(&packet, &paramSz);
             }
 
-            TPM2_Packet_ParseU16(&packet, &out->fuData.size);
-            TPM2_Packet_ParseBytes(&packet, out->fuData.buffer,
-                out->fuData.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->fuData.size,
+                out->fuData.buffer, (UINT16)sizeof(out->fuData.buffer));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -4396,10 +4907,12 @@ TPM_RC TPM2_ContextSave(ContextSave_In* in, ContextSave_Out* out)
             TPM2_Packet_ParseU32(&packet, &out->context.savedHandle);
             TPM2_Packet_ParseU32(&packet, &out->context.hierarchy);
 
-            TPM2_Packet_ParseU16(&packet, &out->context.contextBlob.size);
-            TPM2_Packet_ParseBytes(&packet, out->context.contextBlob.buffer,
-                out->context.contextBlob.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->context.contextBlob.size,
+                out->context.contextBlob.buffer,
+                (UINT16)sizeof(out->context.contextBlob.buffer));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -4434,6 +4947,8 @@ TPM_RC TPM2_ContextLoad(ContextLoad_In* in, ContextLoad_Out* out)
         if (rc == TPM_RC_SUCCESS) {
             TPM2_Packet_ParseU32(&packet, &out->loadedHandle);
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -4452,8 +4967,7 @@ TPM_RC TPM2_EvictControl(EvictControl_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 2;
-        info.flags = (CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_EvictControl, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -4484,6 +4998,7 @@ TPM_RC TPM2_ReadClock(ReadClock_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
+        TPM2_GetCmdInfo(TPM_CC_ReadClock, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -4507,6 +5022,8 @@ TPM_RC TPM2_ReadClock(ReadClock_Out* out)
                 &out->currentTime.clockInfo.restartCount);
             TPM2_Packet_ParseU8(&packet, &out->currentTime.clockInfo.safe);
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -4525,8 +5042,7 @@ TPM_RC TPM2_ClockSet(ClockSet_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_ClockSet, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->auth);
@@ -4555,8 +5071,7 @@ TPM_RC TPM2_ClockRateAdjust(ClockRateAdjust_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_ClockRateAdjust, &info);
 
         TPM2_Packet_Init(ctx, &packet);
         TPM2_Packet_AppendU32(&packet, in->auth);
@@ -4585,6 +5100,7 @@ TPM_RC TPM2_TestParms(TestParms_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
+        TPM2_GetCmdInfo(TPM_CC_TestParms, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -4603,6 +5119,7 @@ TPM_RC TPM2_TestParms(TestParms_In* in)
     return rc;
 }
 
+#ifndef WOLFTPM2_NO_NV
 TPM_RC TPM2_NV_DefineSpace(NV_DefineSpace_In* in)
 {
     TPM_RC rc;
@@ -4615,8 +5132,7 @@ TPM_RC TPM2_NV_DefineSpace(NV_DefineSpace_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_NV_DefineSpace, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -4663,8 +5179,7 @@ TPM_RC TPM2_NV_UndefineSpace(NV_UndefineSpace_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 2;
-        info.flags = (CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_NV_UndefineSpace, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -4694,8 +5209,7 @@ TPM_RC TPM2_NV_UndefineSpaceSpecial(NV_UndefineSpaceSpecial_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 2;
-        info.flags = (CMD_FLAG_AUTH_ADMIN | CMD_FLAG_AUTH_USER2);
+        TPM2_GetCmdInfo(TPM_CC_NV_UndefineSpaceSpecial, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -4727,8 +5241,7 @@ TPM_RC TPM2_NV_ReadPublic(NV_ReadPublic_In* in, NV_ReadPublic_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_DEC2);
+        TPM2_GetCmdInfo(TPM_CC_NV_ReadPublic, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -4751,17 +5264,18 @@ TPM_RC TPM2_NV_ReadPublic(NV_ReadPublic_In* in, NV_ReadPublic_Out* out)
             TPM2_Packet_ParseU16(&packet, &out->nvPublic.nvPublic.nameAlg);
             TPM2_Packet_ParseU32(&packet, &out->nvPublic.nvPublic.attributes);
 
-            TPM2_Packet_ParseU16(&packet,
-                &out->nvPublic.nvPublic.authPolicy.size);
-            TPM2_Packet_ParseBytes(&packet,
+            TPM2_Packet_ParseU16Buf(&packet,
+                &out->nvPublic.nvPublic.authPolicy.size,
                 out->nvPublic.nvPublic.authPolicy.buffer,
-                out->nvPublic.nvPublic.authPolicy.size);
+                (UINT16)sizeof(out->nvPublic.nvPublic.authPolicy.buffer));
 
             TPM2_Packet_ParseU16(&packet, &out->nvPublic.nvPublic.dataSize);
 
-            TPM2_Packet_ParseU16(&packet, &out->nvName.size);
-            TPM2_Packet_ParseBytes(&packet, out->nvName.name, out->nvName.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->nvName.size,
+                out->nvName.name, (UINT16)sizeof(out->nvName.name));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -4780,8 +5294,7 @@ TPM_RC TPM2_NV_Write(NV_Write_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 2;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_NV_Write, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -4816,8 +5329,7 @@ TPM_RC TPM2_NV_Increment(NV_Increment_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 2;
-        info.flags = (CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_NV_Increment, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -4847,8 +5359,7 @@ TPM_RC TPM2_NV_Extend(NV_Extend_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 2;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_NV_Extend, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -4881,8 +5392,7 @@ TPM_RC TPM2_NV_SetBits(NV_SetBits_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 2;
-        info.flags = (CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_NV_SetBits, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -4914,8 +5424,7 @@ TPM_RC TPM2_NV_WriteLock(NV_WriteLock_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 2;
-        info.flags = (CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_NV_WriteLock, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -4945,8 +5454,7 @@ TPM_RC TPM2_NV_GlobalWriteLock(NV_GlobalWriteLock_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_NV_GlobalWriteLock, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -4976,8 +5484,7 @@ TPM_RC TPM2_NV_Read(NV_Read_In* in, NV_Read_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 2;
-        info.flags = (CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_NV_Read, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -4997,9 +5504,11 @@ TPM_RC TPM2_NV_Read(NV_Read_In* in, NV_Read_Out* out)
 
             TPM2_Packet_ParseU32(&packet, &paramSz);
 
-            TPM2_Packet_ParseU16(&packet, &out->data.size);
-            TPM2_Packet_ParseBytes(&packet, out->data.buffer, out->data.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->data.size,
+                out->data.buffer, (UINT16)sizeof(out->data.buffer));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -5018,8 +5527,7 @@ TPM_RC TPM2_NV_ReadLock(NV_ReadLock_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 2;
-        info.flags = (CMD_FLAG_AUTH_USER1);
+        TPM2_GetCmdInfo(TPM_CC_NV_ReadLock, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -5049,8 +5557,7 @@ TPM_RC TPM2_NV_ChangeAuth(NV_ChangeAuth_In* in)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 1;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_AUTH_ADMIN);
+        TPM2_GetCmdInfo(TPM_CC_NV_ChangeAuth, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -5070,6 +5577,7 @@ TPM_RC TPM2_NV_ChangeAuth(NV_ChangeAuth_In* in)
     return rc;
 }
 
+#ifndef WOLFTPM2_NO_ATTEST
 TPM_RC TPM2_NV_Certify(NV_Certify_In* in, NV_Certify_Out* out)
 {
     TPM_RC rc;
@@ -5082,9 +5590,7 @@ TPM_RC TPM2_NV_Certify(NV_Certify_In* in, NV_Certify_Out* out)
     if (rc == TPM_RC_SUCCESS) {
         TPM2_Packet packet;
         CmdInfo_t info = {0,0,0,0};
-        info.inHandleCnt = 3;
-        info.flags = (CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1 |
-            CMD_FLAG_AUTH_USER2);
+        TPM2_GetCmdInfo(TPM_CC_NV_Certify, &info);
 
         TPM2_Packet_Init(ctx, &packet);
 
@@ -5112,17 +5618,20 @@ TPM_RC TPM2_NV_Certify(NV_Certify_In* in, NV_Certify_Out* out)
 
             TPM2_Packet_ParseU32(&packet, &paramSz);
 
-            TPM2_Packet_ParseU16(&packet, &out->certifyInfo.size);
-            TPM2_Packet_ParseBytes(&packet, out->certifyInfo.attestationData,
-                out->certifyInfo.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->certifyInfo.size,
+                out->certifyInfo.attestationData, (UINT16)sizeof(out->certifyInfo.attestationData));
 
             TPM2_Packet_ParseSignature(&packet, &out->signature);
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
     return rc;
 }
+#endif /* !WOLFTPM2_NO_ATTEST */
+#endif /* !WOLFTPM2_NO_NV */
 
 /******************************************************************************/
 /* --- END Standard TPM API's -- */
@@ -5216,10 +5725,12 @@ TPM_RC TPM2_GetRandom2(GetRandom2_In* in, GetRandom2_Out* out)
         /* send command */
         rc = TPM2_SendCommand(ctx, &packet);
         if (rc == TPM_RC_SUCCESS) {
-            TPM2_Packet_ParseU16(&packet, &out->randomBytes.size);
-            TPM2_Packet_ParseBytes(&packet, out->randomBytes.buffer,
-                out->randomBytes.size);
+            TPM2_Packet_ParseU16Buf(&packet, &out->randomBytes.size,
+                out->randomBytes.buffer,
+                (UINT16)sizeof(out->randomBytes.buffer));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -5316,6 +5827,8 @@ int TPM2_NTC2_GetConfig(NTC2_GetConfig_Out* out)
         if (rc == TPM_RC_SUCCESS) {
             TPM2_Packet_ParseBytes(&packet, (byte*)&out->preConfig, sizeof(out->preConfig));
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
 
         TPM2_ReleaseLock(ctx);
     }
@@ -5332,6 +5845,224 @@ int TPM2_NTC2_GetConfig(NTC2_GetConfig_Out* out)
 /* --- BEGIN Helpful API's -- */
 /******************************************************************************/
 
+/* Patch the variable fields and send a prepared command on the packet */
+static TPM_RC TPM2_PreparedSend(TPM2_CTX* ctx, TPM2_PREPARED* cmd,
+    const BYTE* var, UINT32 varSz, TPM2_Packet* packet, CmdInfo_t* info)
+{
+    int i;
+    UINT32 total = 0;
+
+    for (i = 0; i < cmd->fieldCnt; i++) {
+        total += cmd->field[i].size;
+    }
+    if (cmd->fieldCnt > TPM2_PREPARED_MAX_FIELDS || varSz != total ||
+            cmd->paramSz > sizeof(cmd->param)) {
+        return BAD_FUNC_ARG;
+    }
+    for (i = 0; i < cmd->fieldCnt; i++) {
+        XMEMCPY(&cmd->param[cmd->field[i].pos], var, cmd->field[i].size);
+        var += cmd->field[i].size;
+    }
+
+    if (TPM2_GetCmdInfo(cmd->cmdCode, info) != TPM_RC_SUCCESS ||
+            info->inHandleCnt > 1) {
+        return BAD_FUNC_ARG;
+    }
+
+    TPM2_Packet_Init(ctx, packet);
+    if (info->inHandleCnt == 1) {
+        TPM2_Packet_AppendU32(packet, cmd->handle);
+    }
+    TPM2_Packet_AppendAuth(packet, ctx, info);
+    TPM2_Packet_AppendBytes(packet, cmd->param, cmd->paramSz);
+    TPM2_Packet_Finalize(packet, TPM_ST_SESSIONS, cmd->cmdCode);
+
+    return TPM2_SendCommandAuth(ctx, packet, info);
+}
+
+TPM_RC TPM2_Sign_Prepare(TPM2_PREPARED* cmd, const Sign_In* in)
+{
+    TPM2_Packet packet;
+
+    if (cmd == NULL || in == NULL ||
+            in->digest.size > sizeof(in->digest.buffer) ||
+            in->validation.digest.size > sizeof(in->validation.digest.buffer)) {
+        return BAD_FUNC_ARG;
+    }
+    if (sizeof(UINT16) * 4 + sizeof(UINT32) + in->digest.size +
+            in->validation.digest.size > sizeof(cmd->param)) {
+        return BUFFER_E;
+    }
+
+    XMEMSET(cmd, 0, sizeof(*cmd));
+    cmd->cmdCode = TPM_CC_Sign;
+    cmd->handle = in->keyHandle;
+
+    TPM2_Packet_InitBuf(&packet, cmd->param, (int)sizeof(cmd->param));
+    packet.pos = 0;
+    TPM2_Packet_AppendU16(&packet, in->digest.size);
+    cmd->field[0].pos = (UINT16)packet.pos;
+    cmd->field[0].size = in->digest.size;
+    cmd->fieldCnt = 1;
+    TPM2_Packet_AppendBytes(&packet, (byte*)in->digest.buffer, in->digest.size);
+
+    TPM2_Packet_AppendU16(&packet, in->inScheme.scheme);
+    TPM2_Packet_AppendU16(&packet, in->inScheme.details.any.hashAlg);
+
+    TPM2_Packet_AppendU16(&packet, in->validation.tag);
+    TPM2_Packet_AppendU32(&packet, in->validation.hierarchy);
+
+    TPM2_Packet_AppendU16(&packet, in->validation.digest.size);
+    TPM2_Packet_AppendBytes(&packet, (byte*)in->validation.digest.buffer,
+        in->validation.digest.size);
+    cmd->paramSz = (UINT16)packet.pos;
+
+    return TPM_RC_SUCCESS;
+}
+
+TPM_RC TPM2_Sign_Execute(TPM2_PREPARED* cmd, const BYTE* digest,
+    UINT16 digestSz, Sign_Out* out)
+{
+    TPM_RC rc;
+    TPM2_CTX* ctx = TPM2_GetActiveCtx();
+
+    if (ctx == NULL || cmd == NULL || digest == NULL || out == NULL ||
+            ctx->session == NULL || cmd->cmdCode != TPM_CC_Sign)
+        return BAD_FUNC_ARG;
+
+    rc = TPM2_AcquireLock(ctx);
+    if (rc == TPM_RC_SUCCESS) {
+        TPM2_Packet packet;
+        CmdInfo_t info = {0,0,0,0};
+
+        rc = TPM2_PreparedSend(ctx, cmd, digest, digestSz, &packet, &info);
+        if (rc == TPM_RC_SUCCESS) {
+            UINT32 paramSz = 0;
+
+            TPM2_Packet_ParseU32(&packet, &paramSz);
+            TPM2_Packet_ParseSignature(&packet, &out->signature);
+        }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
+
+        TPM2_ReleaseLock(ctx);
+    }
+    return rc;
+}
+
+TPM_RC TPM2_PCR_Extend_Prepare(TPM2_PREPARED* cmd, const PCR_Extend_In* in)
+{
+    int i, digestSz;
+    UINT32 need;
+    TPM2_Packet packet;
+
+    if (cmd == NULL || in == NULL ||
+            in->digests.count > TPM2_PREPARED_MAX_FIELDS) {
+        return BAD_FUNC_ARG;
+    }
+    need = sizeof(UINT32);
+    for (i = 0; i < (int)in->digests.count; i++) {
+        digestSz = TPM2_GetHashDigestSize(in->digests.digests[i].hashAlg);
+        if (digestSz <= 0)
+            return BAD_FUNC_ARG;
+        need += sizeof(UINT16) + digestSz;
+    }
+    if (need > sizeof(cmd->param))
+        return BUFFER_E;
+
+    XMEMSET(cmd, 0, sizeof(*cmd));
+    cmd->cmdCode = TPM_CC_PCR_Extend;
+    cmd->handle = in->pcrHandle;
+
+    TPM2_Packet_InitBuf(&packet, cmd->param, (int)sizeof(cmd->param));
+    packet.pos = 0;
+    TPM2_Packet_AppendU32(&packet, in->digests.count);
+    for (i = 0; i < (int)in->digests.count; i++) {
+        UINT16 hashAlg = in->digests.digests[i].hashAlg;
+        digestSz = TPM2_GetHashDigestSize(hashAlg);
+        TPM2_Packet_AppendU16(&packet, hashAlg);
+        cmd->field[i].pos = (UINT16)packet.pos;
+        cmd->field[i].size = (UINT16)digestSz;
+        TPM2_Packet_AppendBytes(&packet,
+            (byte*)in->digests.digests[i].digest.H, digestSz);
+    }
+    cmd->fieldCnt = (BYTE)in->digests.count;
+    cmd->paramSz = (UINT16)packet.pos;
+
+    return TPM_RC_SUCCESS;
+}
+
+TPM_RC TPM2_PCR_Extend_Execute(TPM2_PREPARED* cmd, const BYTE* digests,
+    UINT32 digestsSz)
+{
+    TPM_RC rc;
+    TPM2_CTX* ctx = TPM2_GetActiveCtx();
+
+    if (ctx == NULL || cmd == NULL || digests == NULL ||
+            ctx->session == NULL || cmd->cmdCode != TPM_CC_PCR_Extend)
+        return BAD_FUNC_ARG;
+
+    rc = TPM2_AcquireLock(ctx);
+    if (rc == TPM_RC_SUCCESS) {
+        TPM2_Packet packet;
+        CmdInfo_t info = {0,0,0,0};
+
+        rc = TPM2_PreparedSend(ctx, cmd, digests, digestsSz, &packet, &info);
+
+        TPM2_ReleaseLock(ctx);
+    }
+    return rc;
+}
+
+int TPM2_GetCommandHandleCount(TPM_CC cc, int* inHandleCnt, int* outHandleCnt)
+{
+    int rc;
+    CmdInfo_t info;
+
+    rc = TPM2_GetCmdInfo(cc, &info);
+    if (rc == TPM_RC_SUCCESS) {
+        if (inHandleCnt != NULL)
+            *inHandleCnt = info.inHandleCnt;
+        if (outHandleCnt != NULL)
+            *outHandleCnt = info.outHandleCnt;
+    }
+    return rc;
+}
+
+TPM_RC TPM2_SendRawCommand(TPM2_CTX* ctx, BYTE* buf, int cmdSz, int bufSz,
+    int* rspSz)
+{
+    TPM_RC rc;
+    TPM2_Packet packet;
+
+    if (ctx == NULL || buf == NULL || rspSz == NULL ||
+            cmdSz < TPM2_HEADER_SIZE || bufSz < cmdSz) {
+        return BAD_FUNC_ARG;
+    }
+
+    rc = TPM2_AcquireLock(ctx);
+    if (rc == TPM_RC_SUCCESS) {
+        packet.buf = buf;
+        packet.pos = cmdSz;
+        packet.size = bufSz;
+        packet.parseErr = 0;
+
+        /* command is sent as-is, any auth area was built by the caller */
+        rc = TPM2_TransportSend(ctx, &packet);
+        if (rc == TPM_RC_SUCCESS) {
+            (void)TPM2_Packet_Parse(rc, &packet);
+            if (TPM2_Packet_ParseStatus(&packet) != 0 ||
+                    packet.size < TPM2_HEADER_SIZE || packet.size > bufSz)
+                rc = TPM_RC_SIZE;
+            else
+                *rspSz = packet.size;
+        }
+
+        TPM2_ReleaseLock(ctx);
+    }
+    return rc;
+}
+
 int TPM2_GetHashDigestSize(TPMI_ALG_HASH hashAlg)
 {
     switch (hashAlg) {
@@ -5420,17 +6151,20 @@ int TPM2_GetNonce(byte* nonceBuf, int nonceSz)
                 break;
             }
 
-            TPM2_Packet_ParseU16(&packet, &outSz);
-            if (outSz > MAX_RNG_REQ_SIZE) {
+            /* never more than requested, so nonceBuf cannot overflow */
+            rc = TPM2_Packet_ParseU16Buf(&packet, &outSz, &nonceBuf[randSz],
+                inSz);
+            if (rc != 0 || outSz == 0) {
             #ifdef DEBUG_WOLFTPM
                 printf("TPM2_GetNonce out size error\n");
             #endif
-                rc = BAD_FUNC_ARG;
+                rc = BUFFER_E;
                 break;
             }
-            TPM2_Packet_ParseBytes(&packet, &nonceBuf[randSz], outSz);
             randSz += outSz;
         }
+        if (rc == TPM_RC_SUCCESS)
+            rc = TPM2_Packet_ParseStatus(&packet);
         TPM2_ReleaseLock(ctx);
     }
 #endif
@@ -5520,10 +6254,15 @@ void TPM2_SetupPCRSelArray(TPML_PCR_SELECTION* pcr, TPM_ALG_ID alg,
 
 const char* TPM2_GetRCString(int rc)
 {
+#ifdef WOLFTPM2_NO_RC_STRINGS
+    /* string tables compiled out, callers print the numeric code */
+    return (rc == 0) ? "Success" : "Error";
+#else
     /* for negative return codes use wolfCrypt */
     if (rc < 0) {
         switch (rc) {
             TPM_RC_STR(TPM_RC_TIMEOUT, "Hardware timeout");
+            TPM_RC_STR(TPM_RC_DEADLINE, "Caller deadline expired");
             default:
                 break;
         }
@@ -5662,6 +6401,7 @@ const char* TPM2_GetRCString(int rc)
     }
 
     return "Unknown";
+#endif /* WOLFTPM2_NO_RC_STRINGS */
 }
 
 const char* TPM2_GetAlgName(TPM_ALG_ID alg)
@@ -5858,7 +6598,7 @@ int TPM2_ParseAttest(const TPM2B_ATTEST* in, TPMS_ATTEST* out)
     packet.size = in->size;
 
     TPM2_Packet_ParseAttest(&packet, out);
-    return TPM_RC_SUCCESS;
+    return TPM2_Packet_ParseStatus(&packet);
 }
 
 UINT16 TPM2_GetVendorID(void)
@@ -5982,11 +6722,12 @@ int TPM2_ParsePublic(TPM2B_PUBLIC* pub, byte* buf, word32 size, int* sizeUsed)
     packet.buf = buf;
     packet.pos = 0;
     packet.size = (int)size;
+    packet.parseErr = 0;
 
     TPM2_Packet_ParsePublic(&packet, pub);
     *sizeUsed = packet.pos;
 
-    return TPM_RC_SUCCESS;
+    return TPM2_Packet_ParseStatus(&packet);
 }
 
 /* This routine fills the first len bytes of the memory area pointed by mem
@@ -0,0 +1,224 @@
+/* tpm2_broker.c
+ *
+ * Copyright (C) 2006-2022 wolfSSL Inc.
+ *
+ * This file is part of wolfTPM.
+ *
+ * wolfTPM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfTPM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+
+/**
+ * Client transport for the local TPM broker daemon (examples/broker).
+ *
+ * Each TPM command is written to a Unix-domain socket as-is and the raw
+ * response is read back. The broker owns the TPM device and virtualizes
+ * transient object handles and sessions per connection.
+ *
+ * See docs/BROKER.md
+ */
+
+#include <wolftpm/tpm2_types.h>
+
+#ifdef WOLFTPM_BROKER
+#include <wolftpm/tpm2.h>
+#include <wolftpm/tpm2_broker.h>
+#include <wolftpm/tpm2_packet.h>
+
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+
+static TPM_RC BrokerTransmit(TPM2_CTX* ctx, const byte* buffer, int bufSz)
+{
+    ssize_t wrc;
+
+    while (bufSz > 0) {
+        wrc = write(ctx->tcpCtx.fd, buffer, bufSz);
+        if (wrc < 0 && errno == EINTR)
+            continue;
+        if (wrc <= 0) {
+        #ifdef DEBUG_WOLFTPM
+            printf("Failed to send to TPM broker, errno %d = %s\n",
+                errno, strerror(errno));
+        #endif
+            return SOCKET_ERROR_E;
+        }
+        buffer += wrc;
+        bufSz -= (int)wrc;
+    }
+    return TPM_RC_SUCCESS;
+}
+
+/* Waits for the broker reply within the command deadline */
+static TPM_RC BrokerPoll(TPM2_CTX* ctx)
+{
+    struct pollfd pfd;
+    int timeoutMs, prc;
+
+    timeoutMs = TPM2_DeadlineRemaining(ctx);
+    if (timeoutMs < 0)
+        return TPM_RC_SUCCESS;
+
+    pfd.fd = ctx->tcpCtx.fd;
+    pfd.events = POLLIN;
+    do {
+        prc = poll(&pfd, 1, timeoutMs);
+    } while (prc < 0 && errno == EINTR);
+    if (prc == 0)
+        return TPM_RC_DEADLINE;
+    if (prc < 0)
+        return SOCKET_ERROR_E;
+    return TPM_RC_SUCCESS;
+}
+
+static TPM_RC BrokerReceive(TPM2_CTX* ctx, byte* buffer, int rxSz)
+{
+    TPM_RC rc;
+    ssize_t wrc;
+
+    while (rxSz > 0) {
+        rc = BrokerPoll(ctx);
+        if (rc != TPM_RC_SUCCESS)
+            return rc;
+        wrc = read(ctx->tcpCtx.fd, buffer, rxSz);
+        if (wrc < 0 && errno == EINTR)
+            continue;
+        if (wrc <= 0) {
+        #ifdef DEBUG_WOLFTPM
+            if (wrc == 0) {
+                printf("Failed to read from TPM broker: EOF\n");
+            }
+            else {
+                printf("Failed to read from TPM broker, errno %d = %s\n",
+                    errno, strerror(errno));
+            }
+        #endif
+            return SOCKET_ERROR_E;
+        }
+        buffer += wrc;
+        rxSz -= (int)wrc;
+    }
+    return TPM_RC_SUCCESS;
+}
+
+static TPM_RC BrokerConnect(TPM2_CTX* ctx)
+{
+    struct sockaddr_un addr;
+    const char* path;
+    size_t pathSz;
+    int fd;
+
+    path = getenv(TPM2_BROKER_PATH_ENV);
+    if (path == NULL || path[0] == '\0')
+        path = TPM2_BROKER_PATH;
+    pathSz = XSTRLEN(path);
+    if (pathSz >= sizeof(addr.sun_path))
+        return BAD_FUNC_ARG;
+
+    XMEMSET(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    XMEMCPY(addr.sun_path, path, pathSz);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return SOCKET_ERROR_E;
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+    #ifdef DEBUG_WOLFTPM
+        printf("Failed to connect to TPM broker %s, errno %d = %s\n",
+            path, errno, strerror(errno));
+    #endif
+        close(fd);
+        return SOCKET_ERROR_E;
+    }
+
+    ctx->tcpCtx.fd = fd;
+    return TPM_RC_SUCCESS;
+}
+
+void TPM2_BROKER_Cleanup(TPM2_CTX* ctx)
+{
+    if (ctx != NULL && ctx->tcpCtx.fd >= 0) {
+        close(ctx->tcpCtx.fd);
+        ctx->tcpCtx.fd = -1;
+    }
+}
+
+/* Talk to the TPM through the broker
+ * return TPM_RC_SUCCESS on success,
+ *        SOCKET_ERROR_E on socket errors
+ */
+int TPM2_BROKER_SendCommand(TPM2_CTX* ctx, TPM2_Packet* packet)
+{
+    int rc = TPM_RC_SUCCESS;
+    UINT32 rspSz;
+
+    if (ctx == NULL || packet == NULL) {
+        return BAD_FUNC_ARG;
+    }
+
+    if (ctx->tcpCtx.fd < 0) {
+        rc = BrokerConnect(ctx);
+    }
+
+#ifdef WOLFTPM_DEBUG_VERBOSE
+    printf("Command size: %d\n", packet->pos);
+    TPM2_PrintBin(packet->buf, packet->pos);
+#endif
+
+    if (rc == TPM_RC_SUCCESS) {
+        rc = BrokerTransmit(ctx, packet->buf, packet->pos);
+    }
+
+    /* header carries the total response size */
+    if (rc == TPM_RC_SUCCESS) {
+        rc = BrokerReceive(ctx, packet->buf, TPM2_HEADER_SIZE);
+    }
+    if (rc == TPM_RC_SUCCESS) {
+        XMEMCPY(&rspSz, &packet->buf[2], sizeof(UINT32));
+        rspSz = TPM2_Packet_SwapU32(rspSz);
+        if (rspSz < TPM2_HEADER_SIZE || rspSz > (UINT32)packet->size) {
+        #ifdef DEBUG_WOLFTPM
+            printf("Broker response size %u invalid (buffer %d)\n",
+                rspSz, packet->size);
+        #endif
+            rc = SOCKET_ERROR_E;
+        }
+    }
+    if (rc == TPM_RC_SUCCESS) {
+        rc = BrokerReceive(ctx, &packet->buf[TPM2_HEADER_SIZE],
+            (int)rspSz - TPM2_HEADER_SIZE);
+    }
+
+#ifdef WOLFTPM_DEBUG_VERBOSE
+    if (rc == TPM_RC_SUCCESS) {
+        printf("Response size: %u\n", rspSz);
+        TPM2_PrintBin(packet->buf, rspSz);
+    }
+#endif
+
+    /* a broken stream cannot be resynchronized, start a new connection */
+    if (rc != TPM_RC_SUCCESS) {
+        TPM2_BROKER_Cleanup(ctx);
+    }
+
+    return rc;
+}
+#endif /* WOLFTPM_BROKER */
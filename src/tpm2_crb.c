@@ -0,0 +1,432 @@
+/* tpm2_crb.c
+ *
+ * Copyright (C) 2006-2023 wolfSSL Inc.
+ *
+ * This file is part of wolfTPM.
+ *
+ * wolfTPM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfTPM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+/**
+ * This implements the Command Response Buffer (CRB) interface from the
+ * "TCG PC Client Platform TPM Profile (PTP) Specification". The whole command
+ * is placed in the CRB data buffer and started with a single register write,
+ * so there is no burst count or FIFO handshaking as with TIS.
+ *
+ * The registers are accessed through the ADV_IO HAL callback (for example
+ * hal/tpm_io_mmio.c). A platform that maps the command buffer as memory can
+ * register it with TPM2_CRB_SetBuffer, then commands are marshaled in place
+ * and only the control registers go through the callback.
+ */
+
+#include <wolftpm/tpm2_types.h>
+
+#ifdef WOLFTPM_CRB
+#include <wolftpm/tpm2.h>
+#include <wolftpm/tpm2_crb.h>
+#include <wolftpm/tpm2_packet.h>
+
+#ifndef WOLFTPM_LOCALITY_DEFAULT
+#define WOLFTPM_LOCALITY_DEFAULT 0
+#endif
+
+/******************************************************************************/
+/* --- BEGIN TPM Command Response Buffer (CRB) Layer */
+/******************************************************************************/
+
+int TPM2_CRB_Read(TPM2_CTX* ctx, word32 addr, byte* result, word32 len)
+{
+    int rc;
+
+    if (ctx == NULL || ctx->ioCb == NULL || result == NULL || len == 0 ||
+            len > 0xFFFF) {
+        return BAD_FUNC_ARG;
+    }
+
+    rc = ctx->ioCb(ctx, 1, addr, result, (word16)len, ctx->userCtx);
+#ifdef WOLFTPM_DEBUG_IO
+    printf("CRB Read addr %x, len %d\n", addr, len);
+    TPM2_PrintBin(result, len);
+#endif
+    return rc;
+}
+
+int TPM2_CRB_Write(TPM2_CTX* ctx, word32 addr, const byte* value, word32 len)
+{
+    int rc;
+
+    if (ctx == NULL || ctx->ioCb == NULL || value == NULL || len == 0 ||
+            len > 0xFFFF) {
+        return BAD_FUNC_ARG;
+    }
+
+    rc = ctx->ioCb(ctx, 0, addr, (byte*)value, (word16)len, ctx->userCtx);
+#ifdef WOLFTPM_DEBUG_IO
+    printf("CRB Write addr %x, len %d\n", addr, len);
+    TPM2_PrintBin(value, len);
+#endif
+    return rc;
+}
+
+/* CRB registers are little endian */
+static int TPM2_CRB_Read32(TPM2_CTX* ctx, word32 addr, word32* reg)
+{
+    int rc = TPM2_CRB_Read(ctx, addr, (byte*)reg, sizeof(*reg));
+#ifdef BIG_ENDIAN_ORDER
+    *reg = ByteReverseWord32(*reg);
+#endif
+    return rc;
+}
+
+static int TPM2_CRB_Write32(TPM2_CTX* ctx, word32 addr, word32 reg)
+{
+#ifdef BIG_ENDIAN_ORDER
+    reg = ByteReverseWord32(reg);
+#endif
+    return TPM2_CRB_Write(ctx, addr, (byte*)&reg, sizeof(reg));
+}
+
+/* Polls a register until (reg & mask) == value. useDeadline: stop at the
+ * command deadline, otherwise only the poll count bounds the wait */
+static int TPM2_CRB_PollReg(TPM2_CTX* ctx, word32 addr, word32 mask,
+    word32 value, int useDeadline)
+{
+    int rc;
+    int timeout = TPM_TIMEOUT_TRIES;
+    word32 reg = 0;
+
+    do {
+        rc = TPM2_CRB_Read32(ctx, addr, &reg);
+        if (rc == TPM_RC_SUCCESS && (reg & mask) == value)
+            break;
+        if (useDeadline && TPM2_DeadlineRemaining(ctx) == 0)
+            return TPM_RC_DEADLINE;
+        XTPM_WAIT();
+    } while (rc == TPM_RC_SUCCESS && --timeout > 0);
+#ifdef WOLFTPM_DEBUG_TIMEOUT
+    printf("CRB_WaitForReg %x: Timeout %d\n", addr, TPM_TIMEOUT_TRIES - timeout);
+#endif
+    if (timeout <= 0)
+        return TPM_RC_TIMEOUT;
+    return rc;
+}
+
+static int TPM2_CRB_WaitForReg(TPM2_CTX* ctx, word32 addr, word32 mask,
+    word32 value)
+{
+    return TPM2_CRB_PollReg(ctx, addr, mask, value, 1);
+}
+
+int TPM2_CRB_StartupWait(TPM2_CTX* ctx, int timeout)
+{
+    int rc;
+    word32 state = 0;
+
+    do {
+        rc = TPM2_CRB_Read32(ctx, TPM_CRB_LOC_STATE(0), &state);
+        /* an absent device reads all ones */
+        if (rc == TPM_RC_SUCCESS && (state & TPM_CRB_LOC_STATE_REG_VALID) &&
+                state != 0xFFFFFFFF) {
+            return TPM_RC_SUCCESS;
+        }
+        XTPM_WAIT();
+    } while (rc == TPM_RC_SUCCESS && --timeout > 0);
+#ifdef WOLFTPM_DEBUG_TIMEOUT
+    printf("CRB_StartupWait: Timeout %d\n", TPM_TIMEOUT_TRIES - timeout);
+#endif
+    if (timeout <= 0)
+        return TPM_RC_TIMEOUT;
+    return rc;
+}
+
+static int TPM2_CRB_CheckLocality(TPM2_CTX* ctx, int locality)
+{
+    int rc;
+    word32 state = 0;
+
+    rc = TPM2_CRB_Read32(ctx, TPM_CRB_LOC_STATE(locality), &state);
+    if (rc == TPM_RC_SUCCESS) {
+        if ((state & (TPM_CRB_LOC_STATE_ASSIGNED |
+                      TPM_CRB_LOC_STATE_ACTIVE_MASK |
+                      TPM_CRB_LOC_STATE_REG_VALID)) ==
+                (TPM_CRB_LOC_STATE_ASSIGNED | TPM_CRB_LOC_STATE_REG_VALID |
+                 ((word32)locality << 2))) {
+            ctx->locality = locality;
+            return locality;
+        }
+        rc = -1;
+    }
+    return rc;
+}
+
+int TPM2_CRB_RequestLocality(TPM2_CTX* ctx, int timeout)
+{
+    int rc;
+    int locality = WOLFTPM_LOCALITY_DEFAULT;
+
+    rc = TPM2_CRB_CheckLocality(ctx, locality);
+    if (rc >= 0)
+        return rc;
+
+    rc = TPM2_CRB_Write32(ctx, TPM_CRB_LOC_CTRL(locality),
+        TPM_CRB_LOC_CTRL_REQUEST);
+    if (rc == TPM_RC_SUCCESS) {
+        do {
+            rc = TPM2_CRB_CheckLocality(ctx, locality);
+            if (rc >= 0)
+                return rc;
+            XTPM_WAIT();
+        } while (rc < 0 && --timeout > 0);
+#ifdef WOLFTPM_DEBUG_TIMEOUT
+        printf("CRB_RequestLocality: Timeout %d\n", TPM_TIMEOUT_TRIES - timeout);
+#endif
+        if (timeout <= 0)
+            return TPM_RC_TIMEOUT;
+    }
+
+    return rc;
+}
+
+int TPM2_CRB_GetInfo(TPM2_CTX* ctx)
+{
+    int rc;
+    word32 intfId[2] = {0, 0};
+    word32 reg = 0;
+
+    rc = TPM2_CRB_Read32(ctx, TPM_CRB_INTF_ID(ctx->locality), &intfId[0]);
+    if (rc == TPM_RC_SUCCESS) {
+        rc = TPM2_CRB_Read32(ctx, TPM_CRB_INTF_ID(ctx->locality) + 4,
+            &intfId[1]);
+    }
+    if (rc != TPM_RC_SUCCESS)
+        return rc;
+    if ((intfId[0] & TPM_CRB_INTF_TYPE_MASK) != TPM_CRB_INTF_TYPE_CRB) {
+    #ifdef DEBUG_WOLFTPM
+        printf("TPM2_CRB_GetInfo: Interface type %d is not CRB\n",
+            intfId[0] & TPM_CRB_INTF_TYPE_MASK);
+    #endif
+        return TPM_RC_FAILURE;
+    }
+    ctx->caps = intfId[0];
+    ctx->rid = (byte)(intfId[0] >> 24);
+    ctx->did_vid = intfId[1]; /* DID 63:48, VID 47:32 as in TIS DID_VID */
+
+    /* size of the data buffer in the locality window */
+    rc = TPM2_CRB_Read32(ctx, TPM_CRB_CTRL_CMD_SIZE(ctx->locality), &reg);
+    if (rc == TPM_RC_SUCCESS) {
+        if (reg == 0 || reg > TPM_CRB_DATA_BUFFER_SZ)
+            reg = TPM_CRB_DATA_BUFFER_SZ;
+        ctx->crbCmdSz = reg;
+    }
+
+    return rc;
+}
+
+/* Moves the TPM from idle to ready, a no-op when already ready */
+int TPM2_CRB_Ready(TPM2_CTX* ctx)
+{
+    int rc;
+    word32 sts = 0;
+
+    rc = TPM2_CRB_Read32(ctx, TPM_CRB_CTRL_STS(ctx->locality), &sts);
+    if (rc != TPM_RC_SUCCESS)
+        return rc;
+    if (sts & TPM_CRB_CTRL_STS_ERROR) {
+    #ifdef DEBUG_WOLFTPM
+        printf("TPM2_CRB_Ready: TPM in fatal error state\n");
+    #endif
+        return TPM_RC_FAILURE;
+    }
+    if ((sts & TPM_CRB_CTRL_STS_IDLE) == 0)
+        return TPM_RC_SUCCESS;
+
+    rc = TPM2_CRB_Write32(ctx, TPM_CRB_CTRL_REQ(ctx->locality),
+        TPM_CRB_CTRL_REQ_CMD_READY);
+    if (rc == TPM_RC_SUCCESS) {
+        /* the TPM clears cmdReady once it left idle */
+        rc = TPM2_CRB_WaitForReg(ctx, TPM_CRB_CTRL_REQ(ctx->locality),
+            TPM_CRB_CTRL_REQ_CMD_READY, 0);
+    }
+    if (rc == TPM_RC_SUCCESS) {
+        rc = TPM2_CRB_WaitForReg(ctx, TPM_CRB_CTRL_STS(ctx->locality),
+            TPM_CRB_CTRL_STS_IDLE, 0);
+    }
+    return rc;
+}
+
+int TPM2_CRB_GoIdle(TPM2_CTX* ctx)
+{
+    int rc;
+
+    rc = TPM2_CRB_Write32(ctx, TPM_CRB_CTRL_REQ(ctx->locality),
+        TPM_CRB_CTRL_REQ_GO_IDLE);
+    if (rc == TPM_RC_SUCCESS) {
+        rc = TPM2_CRB_WaitForReg(ctx, TPM_CRB_CTRL_REQ(ctx->locality),
+            TPM_CRB_CTRL_REQ_GO_IDLE, 0);
+    }
+    return rc;
+}
+
+/* Aborts the running command, the TPM clears start when it stopped */
+static int TPM2_CRB_Cancel(TPM2_CTX* ctx)
+{
+    int rc, rc2;
+
+    rc = TPM2_CRB_Write32(ctx, TPM_CRB_CTRL_CANCEL(ctx->locality), 1);
+    if (rc == TPM_RC_SUCCESS) {
+        /* the deadline has passed, so only the poll count bounds the wait.
+         * The caller's deadline is left set. */
+        rc = TPM2_CRB_PollReg(ctx, TPM_CRB_CTRL_START(ctx->locality), 1, 0,
+            0);
+    }
+    rc2 = TPM2_CRB_Write32(ctx, TPM_CRB_CTRL_CANCEL(ctx->locality), 0);
+    return (rc != TPM_RC_SUCCESS) ? rc : rc2;
+}
+
+/* size field of a command or response header */
+static int TPM2_CRB_HdrSize(const byte* buf)
+{
+    UINT32 tmpSz;
+    XMEMCPY(&tmpSz, &buf[2], sizeof(UINT32));
+    return (int)TPM2_Packet_SwapU32(tmpSz);
+}
+
+int TPM2_CRB_SendCommand(TPM2_CTX* ctx, TPM2_Packet* packet)
+{
+    int rc;
+    int inPlace, bufSz, rspSz, stashSz = 0;
+    word32 sts = 0;
+
+    inPlace = (ctx->crbBuf != NULL && packet->buf == ctx->crbBuf);
+    bufSz = (ctx->crbBuf != NULL) ? (int)ctx->crbBufSz : (int)ctx->crbCmdSz;
+    if (packet->pos < TPM2_HEADER_SIZE || packet->pos > bufSz)
+        return BUFFER_E;
+
+#ifdef WOLFTPM_DEBUG_VERBOSE
+    printf("Command: %d\n", packet->pos);
+    TPM2_PrintBin(packet->buf, packet->pos);
+#endif
+
+    rc = TPM2_CRB_Ready(ctx);
+    if (rc != TPM_RC_SUCCESS)
+        goto exit;
+
+    /* Write Command */
+    if (ctx->crbBuf != NULL) {
+        if (!inPlace) {
+            /* a command from another buffer (the TPM RNG nonce for an auth
+             * session) may run while a command is being built in place */
+            stashSz = TPM2_CRB_HdrSize(ctx->crbBuf);
+            if (stashSz < 0 || stashSz > bufSz ||
+                    stashSz > (int)sizeof(ctx->cmdBuf)) {
+                stashSz = 0;
+            }
+            if (stashSz > 0)
+                XMEMCPY(ctx->cmdBuf, ctx->crbBuf, stashSz);
+            XMEMCPY(ctx->crbBuf, packet->buf, packet->pos);
+        }
+    }
+    else {
+        rc = TPM2_CRB_Write(ctx, TPM_CRB_DATA_BUFFER(ctx->locality),
+            packet->buf, packet->pos);
+        if (rc != TPM_RC_SUCCESS)
+            goto exit;
+    }
+
+    /* Execute Command */
+    rc = TPM2_CRB_Write32(ctx, TPM_CRB_CTRL_START(ctx->locality), 1);
+    if (rc != TPM_RC_SUCCESS)
+        goto exit;
+    rc = TPM2_CRB_WaitForReg(ctx, TPM_CRB_CTRL_START(ctx->locality), 1, 0);
+    if (rc == TPM_RC_DEADLINE) {
+        (void)TPM2_CRB_Cancel(ctx);
+        goto exit;
+    }
+    if (rc == TPM_RC_SUCCESS)
+        rc = TPM2_CRB_Read32(ctx, TPM_CRB_CTRL_STS(ctx->locality), &sts);
+    if (rc == TPM_RC_SUCCESS && (sts & TPM_CRB_CTRL_STS_ERROR))
+        rc = TPM_RC_FAILURE;
+    if (rc != TPM_RC_SUCCESS)
+        goto exit;
+
+    /* Read response */
+    if (ctx->crbBuf != NULL) {
+        rspSz = TPM2_CRB_HdrSize(ctx->crbBuf);
+        if (rspSz < TPM2_HEADER_SIZE || rspSz > bufSz ||
+                rspSz > packet->size) {
+            rc = TPM_RC_FAILURE;
+            goto exit;
+        }
+        if (!inPlace)
+            XMEMCPY(packet->buf, ctx->crbBuf, rspSz);
+    }
+    else {
+        rc = TPM2_CRB_Read(ctx, TPM_CRB_DATA_BUFFER(ctx->locality),
+            packet->buf, TPM2_HEADER_SIZE);
+        if (rc != TPM_RC_SUCCESS)
+            goto exit;
+        rspSz = TPM2_CRB_HdrSize(packet->buf);
+        if (rspSz < TPM2_HEADER_SIZE || rspSz > bufSz ||
+                rspSz > packet->size) {
+            rc = TPM_RC_FAILURE;
+            goto exit;
+        }
+        if (rspSz > TPM2_HEADER_SIZE) {
+            rc = TPM2_CRB_Read(ctx,
+                TPM_CRB_DATA_BUFFER(ctx->locality) + TPM2_HEADER_SIZE,
+                &packet->buf[TPM2_HEADER_SIZE], rspSz - TPM2_HEADER_SIZE);
+            if (rc != TPM_RC_SUCCESS)
+                goto exit;
+        }
+    }
+
+#ifdef WOLFTPM_DEBUG_VERBOSE
+    printf("Response: %d\n", rspSz);
+    TPM2_PrintBin(packet->buf, rspSz);
+#endif
+
+exit:
+    if (stashSz > 0)
+        XMEMCPY(ctx->crbBuf, ctx->cmdBuf, stashSz);
+#ifdef WOLFTPM_CRB_IDLE
+    /* trade latency for power, the next command pays the idle exit */
+    (void)TPM2_CRB_GoIdle(ctx);
+#endif
+    return rc;
+}
+
+void TPM2_CRB_Cleanup(TPM2_CTX* ctx)
+{
+    if (ctx == NULL || ctx->ioCb == NULL)
+        return;
+    (void)TPM2_CRB_GoIdle(ctx);
+    (void)TPM2_CRB_Write32(ctx, TPM_CRB_LOC_CTRL(ctx->locality),
+        TPM_CRB_LOC_CTRL_RELINQUISH);
+}
+
+int TPM2_CRB_SetBuffer(TPM2_CTX* ctx, byte* buf, word32 bufSz)
+{
+    if (ctx == NULL || (buf != NULL && bufSz < TPM_CRB_DATA_BUFFER_SZ))
+        return BAD_FUNC_ARG;
+    ctx->crbBuf = buf;
+    ctx->crbBufSz = (buf != NULL) ? bufSz : 0;
+    return TPM_RC_SUCCESS;
+}
+
+/******************************************************************************/
+/* --- END TPM Command Response Buffer (CRB) Layer -- */
+/******************************************************************************/
+
+#endif /* WOLFTPM_CRB */
@@ -25,7 +25,7 @@
 
 /* Internal structure for tracking hash state */
 typedef struct WOLFTPM2_HASHCTX {
-    TPM_HANDLE handle;
+    WOLFTPM2_HASH hash; /* TPM sequence or pending one-shot input */
 #ifdef WOLFTPM_USE_SYMMETRIC
     byte*  cacheBuf;   /* buffer */
     word32 cacheBufSz; /* buffer size */
@@ -33,14 +33,24 @@ typedef struct WOLFTPM2_HASHCTX {
 #endif
 } WOLFTPM2_HASHCTX;
 
+/* A hash or HMAC has been started once it has a TPM sequence, or pending
+ * one-shot input when built with WOLFTPM2_HASH_HYBRID */
+#ifdef WOLFTPM2_HASH_HYBRID
+    #define WOLFTPM2_HASH_STARTED(h) ((h)->handle.hndl != 0 || (h)->isPending)
+#else
+    #define WOLFTPM2_HASH_STARTED(h) ((h)->handle.hndl != 0)
+#endif
+
 #ifdef WOLFTPM_USE_SYMMETRIC
 #ifndef WOLFTPM2_HASH_BLOCK_SZ
 #define WOLFTPM2_HASH_BLOCK_SZ 256
 #endif
 
-/* Forward declaration */
+/* Forward declarations */
 static int wolfTPM2_HashUpdateCache(WOLFTPM2_HASHCTX* hashCtx,
     const byte* in, word32 inSz);
+static int wolfTPM2_HashSingleShot(WOLFTPM2_DEV* dev, TPM_ALG_ID hashAlg,
+    const byte* in, word32 inSz, byte* digest);
 #endif /* WOLFTPM_USE_SYMMETRIC */
 
 
@@ -291,10 +301,11 @@ int wolfTPM2_CryptoDevCb(int devId, wc_CryptoInfo* info, void* ctx)
 #if !defined(NO_SHA) || !defined(NO_SHA256)
     else if (info->algo_type == WC_ALGO_TYPE_HASH) {
     #ifdef WOLFTPM_USE_SYMMETRIC
-        WOLFTPM2_HASH hash;
+        WOLFTPM2_HASH* hash;
         WOLFTPM2_HASHCTX* hashCtx = NULL;
         TPM_ALG_ID hashAlg = TPM_ALG_ERROR;
         word32 hashFlags = 0;
+        int hashCtxAlloc = 0;
     #endif
 
         if (info->hash.type != WC_HASH_TYPE_SHA &&
@@ -329,80 +340,74 @@ int wolfTPM2_CryptoDevCb(int devId, wc_CryptoInfo* info, void* ctx)
             return exit_rc;
         }
 
-        XMEMSET(&hash, 0, sizeof(hash));
-        if (hashCtx)
-            hash.handle.hndl = hashCtx->handle;
+        /* Single-shot hash with no prior update has no state to keep */
+        if (hashCtx == NULL && info->hash.in != NULL &&
+                info->hash.digest != NULL) {
+            return wolfTPM2_HashSingleShot(tlsCtx->dev, hashAlg,
+                info->hash.in, info->hash.inSz, info->hash.digest);
+        }
+
+        /* Multi-part state persists between calls, so it is kept in the
+         * heap context and used in place rather than copied */
+        if (hashCtx == NULL) {
+            hashCtx = (WOLFTPM2_HASHCTX*)XMALLOC(sizeof(*hashCtx), NULL,
+                DYNAMIC_TYPE_TMP_BUFFER);
+            if (hashCtx == NULL) {
+                return MEMORY_E;
+            }
+            XMEMSET(hashCtx, 0, sizeof(*hashCtx));
+            hashCtxAlloc = 1;
+        }
+        hash = &hashCtx->hash;
 
         if (info->hash.in != NULL) { /* Update */
             rc = 0;
-            /* If not single shot (update and final) then allocate context */
-            if (hashCtx == NULL && info->hash.digest == NULL) {
-                hashCtx = (WOLFTPM2_HASHCTX*)XMALLOC(sizeof(*hashCtx), NULL,
-                    DYNAMIC_TYPE_TMP_BUFFER);
-                if (hashCtx == NULL) {
-                    return MEMORY_E;
-                }
-                XMEMSET(hashCtx, 0, sizeof(*hashCtx));
+            if (hashFlags & WC_HASH_FLAG_WILLCOPY) {
+                rc = wolfTPM2_HashUpdateCache(hashCtx,
+                    info->hash.in, info->hash.inSz);
             }
-            if (rc == 0) {
-                if (hashCtx && (hashFlags & WC_HASH_FLAG_WILLCOPY)) {
-                    rc = wolfTPM2_HashUpdateCache(hashCtx,
-                        info->hash.in, info->hash.inSz);
+            else {
+                if (!WOLFTPM2_HASH_STARTED(hash)) {
+                    rc = wolfTPM2_HashStart(tlsCtx->dev, hash, hashAlg,
+                        NULL, 0);
                 }
-                else {
-                    if (hash.handle.hndl == 0) {
-                        rc = wolfTPM2_HashStart(tlsCtx->dev, &hash, hashAlg,
-                            NULL, 0);
-                        if (rc == 0) {
-                            /* save new handle to hash context */
-                            if (hashCtx)
-                                hashCtx->handle = hash.handle.hndl;
-                        }
-                    }
-                    if (rc == 0) {
-                        rc = wolfTPM2_HashUpdate(tlsCtx->dev, &hash,
-                            info->hash.in, info->hash.inSz);
-                    }
+                if (rc == 0) {
+                    rc = wolfTPM2_HashUpdate(tlsCtx->dev, hash,
+                        info->hash.in, info->hash.inSz);
                 }
             }
         }
         if (info->hash.digest != NULL) { /* Final */
             word32 digestSz = TPM2_GetHashDigestSize(hashAlg);
-            if (hashCtx && (hashFlags & WC_HASH_FLAG_WILLCOPY)) {
-                if (hash.handle.hndl == 0) {
-                    rc = wolfTPM2_HashStart(tlsCtx->dev, &hash, hashAlg,
+            if (hashFlags & WC_HASH_FLAG_WILLCOPY) {
+                if (!WOLFTPM2_HASH_STARTED(hash)) {
+                    rc = wolfTPM2_HashStart(tlsCtx->dev, hash, hashAlg,
                         NULL, 0);
-                    if (rc == 0) {
-                        /* save new handle to hash context */
-                        if (hashCtx)
-                            hashCtx->handle = hash.handle.hndl;
-                    }
                 }
                 if (rc == 0) {
-                    rc = wolfTPM2_HashUpdate(tlsCtx->dev, &hash,
+                    rc = wolfTPM2_HashUpdate(tlsCtx->dev, hash,
                             hashCtx->cacheBuf, hashCtx->cacheSz);
                 }
             }
             if (rc == 0) {
-                rc = wolfTPM2_HashFinish(tlsCtx->dev, &hash, info->hash.digest,
+                rc = wolfTPM2_HashFinish(tlsCtx->dev, hash, info->hash.digest,
                     &digestSz);
             }
         }
         /* if final or failure cleanup */
         if (info->hash.digest != NULL || rc != 0) {
-            if (hashCtx) {
-                hashCtx->handle = 0; /* clear hash handle */
-                if ((hashFlags & WC_HASH_FLAG_ISCOPY) == 0) {
-                    if (hashCtx->cacheBuf) {
-                        XFREE(hashCtx->cacheBuf, NULL, DYNAMIC_TYPE_TMP_BUFFER);
-                        hashCtx->cacheBuf = NULL;
-                    }
-                    XFREE(hashCtx, NULL, DYNAMIC_TYPE_TMP_BUFFER);
+            /* Make sure hash if free'd in case of failure */
+            wolfTPM2_UnloadHandle(tlsCtx->dev, &hash->handle);
+            /* clear hash handle and pending input */
+            XMEMSET(hash, 0, sizeof(*hash));
+            if ((hashFlags & WC_HASH_FLAG_ISCOPY) == 0 || hashCtxAlloc) {
+                if (hashCtx->cacheBuf) {
+                    XFREE(hashCtx->cacheBuf, NULL, DYNAMIC_TYPE_TMP_BUFFER);
+                    hashCtx->cacheBuf = NULL;
                 }
-                hashCtx = NULL;
+                XFREE(hashCtx, NULL, DYNAMIC_TYPE_TMP_BUFFER);
             }
-            /* Make sure hash if free'd in case of failure */
-            wolfTPM2_UnloadHandle(tlsCtx->dev, &hash.handle);
+            hashCtx = NULL;
         }
 
         /* save hashCtx to hash structure */
@@ -453,7 +458,7 @@ int wolfTPM2_CryptoDevCb(int devId, wc_CryptoInfo* info, void* ctx)
         }
 
         hmacCtx = (WOLFTPM2_HMAC*)info->hmac.hmac->devCtx;
-        if (hmacCtx && hmacCtx->hash.handle.hndl == 0) {
+        if (hmacCtx && !WOLFTPM2_HASH_STARTED(&hmacCtx->hash)) {
         #ifdef DEBUG_WOLFTPM
             printf("Error: HMAC context invalid!\n");
             return BAD_FUNC_ARG;
@@ -599,6 +604,51 @@ static int wolfTPM2_HashUpdateCache(WOLFTPM2_HASHCTX* hashCtx,
 
     return ret;
 }
+
+/* Input that fits one command buffer uses TPM2_Hash, larger input a
+ * sequence on a stack context */
+static int wolfTPM2_HashSingleShot(WOLFTPM2_DEV* dev, TPM_ALG_ID hashAlg,
+    const byte* in, word32 inSz, byte* digest)
+{
+    int rc;
+    word32 digestSz = TPM2_GetHashDigestSize(hashAlg);
+
+    if (inSz <= MAX_DIGEST_BUFFER) {
+        Hash_In hashIn;
+        Hash_Out hashOut;
+
+        XMEMSET(&hashIn, 0, sizeof(hashIn));
+        hashIn.data.size = (UINT16)inSz;
+        XMEMCPY(hashIn.data.buffer, in, inSz);
+        hashIn.hashAlg = hashAlg;
+        hashIn.hierarchy = TPM_RH_NULL;
+        rc = TPM2_Hash(&hashIn, &hashOut);
+        if (rc == TPM_RC_SUCCESS) {
+            if (hashOut.outHash.size != digestSz)
+                return BUFFER_E;
+            XMEMCPY(digest, hashOut.outHash.buffer, digestSz);
+        }
+    #ifdef DEBUG_WOLFTPM
+        else {
+            printf("TPM2_Hash failed 0x%x: %s\n", rc, TPM2_GetRCString(rc));
+        }
+    #endif
+    }
+    else {
+        WOLFTPM2_HASH hash;
+
+        rc = wolfTPM2_HashStart(dev, &hash, hashAlg, NULL, 0);
+        if (rc == 0) {
+            rc = wolfTPM2_HashUpdate(dev, &hash, in, inSz);
+            if (rc == 0)
+                rc = wolfTPM2_HashFinish(dev, &hash, digest, &digestSz);
+            if (rc != 0)
+                wolfTPM2_UnloadHandle(dev, &hash.handle);
+        }
+    }
+
+    return rc;
+}
 #endif /* WOLFTPM_USE_SYMMETRIC */
 
 #endif /* WOLFTPM_CRYPTOCB && !WOLFTPM2_NO_WRAPPER */
@@ -56,6 +56,7 @@ int TPM2_LINUX_SendCommand(TPM2_CTX* ctx, TPM2_Packet* packet)
     int rc = TPM_RC_FAILURE;
     int fd;
     int rc_poll, nfds = 1; /* Polling single TPM dev file */
+    int timeoutMs, hasDeadline;
     struct pollfd fds;
     size_t rspSz = 0;
 
@@ -70,9 +71,18 @@ int TPM2_LINUX_SendCommand(TPM2_CTX* ctx, TPM2_Packet* packet)
         if (write(fd, packet->buf, packet->pos) == packet->pos) {
             fds.fd = fd;
             fds.events = POLLIN;
-            /* Wait for response to be available */
-            rc_poll = poll(&fds, nfds, TPM2_LINUX_DEV_POLL_TIMEOUT);
-            if (rc_poll > 0 && fds.revents == POLLIN) {
+            /* Wait for response to be available, up to the deadline */
+            timeoutMs = TPM2_DeadlineRemaining(ctx);
+            hasDeadline = (timeoutMs >= 0);
+            if (!hasDeadline)
+                timeoutMs = TPM2_LINUX_DEV_POLL_TIMEOUT;
+            rc_poll = poll(&fds, nfds, timeoutMs);
+            if (rc_poll == 0 && hasDeadline) {
+                /* the driver completes the command once the descriptor is
+                 * closed, the caller gets no response */
+                rc = TPM_RC_DEADLINE;
+            }
+            else if (rc_poll > 0 && fds.revents == POLLIN) {
                 rspSz = read(fd, packet->buf, packet->size);
                 /* The caller parses the TPM_Packet for correctness */
                 if (rspSz >= TPM2_HEADER_SIZE) {
@@ -122,8 +132,6 @@ int TPM2_LINUX_SendCommand(TPM2_CTX* ctx, TPM2_Packet* packet)
     }
 #endif
 
-    (void)ctx;
-
     return rc;
 }
 #endif
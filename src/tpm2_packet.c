@@ -55,9 +55,158 @@ static inline void c32toa(word32 wc_u32, byte* c)
     c[3] =  wc_u32 & 0xff;
 }
 
+/* Command metadata for the standard TPM 2.0 commands (TPM 2.0 Part 3):
+ * handles in/out and parameter encryption / authorization flags.
+ * Sorted by command code for binary search. Vendor commands set their
+ * CmdInfo_t directly. */
+typedef struct {
+    TPM_CC cc;
+    unsigned char inHandleCnt;
+    unsigned char outHandleCnt;
+    unsigned char flags;
+} CmdInfoEntry_t;
+
+static const CmdInfoEntry_t gCmdInfo[] = {
+    { TPM_CC_NV_UndefineSpaceSpecial,    2, 0, CMD_FLAG_AUTH_ADMIN | CMD_FLAG_AUTH_USER2 },
+    { TPM_CC_EvictControl,               2, 0, CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_HierarchyControl,           1, 0, CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_NV_UndefineSpace,           2, 0, CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_ChangeEPS,                  1, 0, CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_ChangePPS,                  1, 0, CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_Clear,                      1, 0, CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_ClearControl,               1, 0, CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_ClockSet,                   1, 0, CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_HierarchyChangeAuth,        1, 0, CMD_FLAG_ENC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_NV_DefineSpace,             1, 0, CMD_FLAG_ENC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_PCR_Allocate,               1, 0, CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_PCR_SetAuthPolicy,          1, 0, CMD_FLAG_ENC2 },
+    { TPM_CC_PP_Commands,                1, 0, CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_SetPrimaryPolicy,           1, 0, CMD_FLAG_ENC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_FieldUpgradeStart,          2, 0, CMD_FLAG_ENC2 | CMD_FLAG_AUTH_ADMIN },
+    { TPM_CC_ClockRateAdjust,            1, 0, CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_CreatePrimary,              1, 1, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_NV_GlobalWriteLock,         1, 0, CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_GetCommandAuditDigest,      2, 0, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1 | CMD_FLAG_AUTH_USER2 },
+    { TPM_CC_NV_Increment,               2, 0, CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_NV_SetBits,                 2, 0, CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_NV_Extend,                  2, 0, CMD_FLAG_ENC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_NV_Write,                   2, 0, CMD_FLAG_ENC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_NV_WriteLock,               2, 0, CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_DictionaryAttackLockReset,  1, 0, CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_DictionaryAttackParameters, 1, 0, CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_NV_ChangeAuth,              1, 0, CMD_FLAG_ENC2 | CMD_FLAG_AUTH_ADMIN },
+    { TPM_CC_PCR_Event,                  1, 0, CMD_FLAG_ENC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_PCR_Reset,                  1, 0, CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_SequenceComplete,           1, 0, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_SetAlgorithmSet,            1, 0, CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_SetCommandCodeAuditStatus,  1, 0, CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_FieldUpgradeData,           0, 0, CMD_FLAG_ENC2 },
+    { TPM_CC_IncrementalSelfTest,        0, 0, 0 },
+    { TPM_CC_SelfTest,                   0, 0, 0 },
+    { TPM_CC_Startup,                    0, 0, 0 },
+    { TPM_CC_Shutdown,                   0, 0, 0 },
+    { TPM_CC_StirRandom,                 0, 0, 0 },
+    { TPM_CC_ActivateCredential,         2, 0, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_ADMIN | CMD_FLAG_AUTH_USER2 },
+    { TPM_CC_Certify,                    2, 0, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_ADMIN | CMD_FLAG_AUTH_USER2 },
+    { TPM_CC_PolicyNV,                   3, 0, CMD_FLAG_ENC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_CertifyCreation,            2, 0, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_Duplicate,                  2, 0, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_DUP },
+    { TPM_CC_GetTime,                    2, 0, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1 | CMD_FLAG_AUTH_USER2 },
+    { TPM_CC_GetSessionAuditDigest,      2, 0, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1 | CMD_FLAG_AUTH_USER2 },
+    { TPM_CC_NV_Read,                    2, 0, CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_NV_ReadLock,                2, 0, CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_ObjectChangeAuth,           2, 0, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_ADMIN },
+    { TPM_CC_PolicySecret,               2, 0, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_Rewrap,                     2, 0, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_Create,                     1, 0, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_ECDH_ZGen,                  1, 0, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_HMAC,                       1, 0, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_Import,                     1, 0, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_Load,                       1, 1, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_Quote,                      1, 0, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_RSA_Decrypt,                1, 0, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_HMAC_Start,                 1, 1, CMD_FLAG_ENC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_SequenceUpdate,             1, 0, CMD_FLAG_ENC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_Sign,                       1, 0, CMD_FLAG_ENC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_Unseal,                     1, 0, CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_PolicySigned,               2, 0, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 },
+    { TPM_CC_ContextLoad,                0, 1, 0 },
+    { TPM_CC_ContextSave,                1, 0, 0 },
+    { TPM_CC_ECDH_KeyGen,                1, 0, CMD_FLAG_DEC2 },
+    { TPM_CC_EncryptDecrypt,             1, 0, CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_FlushContext,               0, 0, 0 },
+    { TPM_CC_LoadExternal,               0, 1, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 },
+    { TPM_CC_MakeCredential,             1, 0, 0 },
+    { TPM_CC_NV_ReadPublic,              1, 0, CMD_FLAG_DEC2 },
+    { TPM_CC_PolicyAuthorize,            1, 0, CMD_FLAG_ENC2 },
+    { TPM_CC_PolicyAuthValue,            1, 0, 0 },
+    { TPM_CC_PolicyCommandCode,          1, 0, 0 },
+    { TPM_CC_PolicyCounterTimer,         1, 0, CMD_FLAG_ENC2 },
+    { TPM_CC_PolicyCpHash,               1, 0, CMD_FLAG_ENC2 },
+    { TPM_CC_PolicyLocality,             1, 0, 0 },
+    { TPM_CC_PolicyNameHash,             1, 0, CMD_FLAG_ENC2 },
+    { TPM_CC_PolicyOR,                   1, 0, 0 },
+    { TPM_CC_PolicyTicket,               1, 0, CMD_FLAG_ENC2 },
+    { TPM_CC_ReadPublic,                 1, 0, 0 },
+    { TPM_CC_RSA_Encrypt,                1, 0, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 },
+    { TPM_CC_StartAuthSession,           2, 1, 0 },
+    { TPM_CC_VerifySignature,            1, 0, CMD_FLAG_ENC2 },
+    { TPM_CC_ECC_Parameters,             0, 0, 0 },
+    { TPM_CC_FirmwareRead,               0, 0, CMD_FLAG_DEC2 },
+    { TPM_CC_GetCapability,              0, 0, 0 },
+    { TPM_CC_GetRandom,                  0, 0, 0 },
+    { TPM_CC_GetTestResult,              0, 0, 0 },
+    { TPM_CC_Hash,                       0, 0, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 },
+    { TPM_CC_PCR_Read,                   0, 0, 0 },
+    { TPM_CC_PolicyPCR,                  1, 0, CMD_FLAG_ENC2 },
+    { TPM_CC_PolicyRestart,              1, 0, 0 },
+    { TPM_CC_ReadClock,                  0, 0, CMD_FLAG_NONE },
+    { TPM_CC_PCR_Extend,                 1, 0, CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_PCR_SetAuthValue,           1, 0, CMD_FLAG_ENC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_NV_Certify,                 3, 0, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1 | CMD_FLAG_AUTH_USER2 },
+    { TPM_CC_EventSequenceComplete,      2, 0, CMD_FLAG_ENC2 | CMD_FLAG_AUTH_USER1 | CMD_FLAG_AUTH_USER2 },
+    { TPM_CC_HashSequenceStart,          0, 1, CMD_FLAG_ENC2 },
+    { TPM_CC_PolicyPhysicalPresence,     1, 0, 0 },
+    { TPM_CC_PolicyDuplicationSelect,    1, 0, CMD_FLAG_ENC2 },
+    { TPM_CC_PolicyGetDigest,            1, 0, CMD_FLAG_DEC2 },
+    { TPM_CC_TestParms,                  0, 0, CMD_FLAG_NONE },
+    { TPM_CC_Commit,                     1, 0, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_PolicyPassword,             1, 0, 0 },
+    { TPM_CC_ZGen_2Phase,                1, 0, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_EC_Ephemeral,               0, 0, CMD_FLAG_DEC2 },
+    { TPM_CC_PolicyNvWritten,            1, 0, 0 },
+    { TPM_CC_PolicyTemplate,             1, 0, CMD_FLAG_ENC2 },
+    { TPM_CC_CreateLoaded,               1, 1, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_PolicyAuthorizeNV,          3, 0, CMD_FLAG_AUTH_USER1 },
+    { TPM_CC_EncryptDecrypt2,            1, 0, CMD_FLAG_ENC2 | CMD_FLAG_DEC2 | CMD_FLAG_AUTH_USER1 },
+};
+
 /******************************************************************************/
 /* --- BEGIN TPM Packet Assembly / Parsing -- */
 /******************************************************************************/
+int TPM2_GetCmdInfo(TPM_CC cc, CmdInfo_t* info)
+{
+    int lo = 0, hi = (int)(sizeof(gCmdInfo) / sizeof(gCmdInfo[0])) - 1, mid;
+
+    if (info == NULL)
+        return BAD_FUNC_ARG;
+
+    while (lo <= hi) {
+        mid = (lo + hi) / 2;
+        if (gCmdInfo[mid].cc == cc) {
+            info->inHandleCnt = gCmdInfo[mid].inHandleCnt;
+            info->outHandleCnt = gCmdInfo[mid].outHandleCnt;
+            info->flags = gCmdInfo[mid].flags;
+            return TPM_RC_SUCCESS;
+        }
+        if (gCmdInfo[mid].cc < cc)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    return TPM_RC_COMMAND_CODE;
+}
+
 void TPM2_Packet_U16ToByteArray(UINT16 val, BYTE* b)
 {
     if (b)
@@ -88,12 +237,20 @@ void TPM2_Packet_InitBuf(TPM2_Packet* packet, byte* buf, int size)
         packet->buf  = buf;
         packet->pos = TPM2_HEADER_SIZE; /* skip header (fill during finalize) */
         packet->size = size;
+        packet->parseErr = 0;
     }
 }
 
 void TPM2_Packet_Init(TPM2_CTX* ctx, TPM2_Packet* packet)
 {
     if (ctx) {
+    #ifdef WOLFTPM_CRB
+        /* marshal in place in the mapped CRB buffer (zero copy) */
+        if (ctx->crbBuf != NULL) {
+            TPM2_Packet_InitBuf(packet, ctx->crbBuf, (int)ctx->crbBufSz);
+            return;
+        }
+    #endif
         TPM2_Packet_InitBuf(packet, ctx->cmdBuf, (int)sizeof(ctx->cmdBuf));
     }
 }
@@ -198,20 +355,97 @@ void TPM2_Packet_AppendBytes(TPM2_Packet* packet, byte* buf, int size)
         packet->pos += size;
     }
 }
+
+/* A response field that does not fit the packet or its destination stops
+ * parsing: the position moves to the end so following fields read as zero,
+ * and the error is kept for TPM2_Packet_ParseStatus */
+static void TPM2_Packet_ParseFail(TPM2_Packet* packet, int rc)
+{
+    if (packet->parseErr == 0)
+        packet->parseErr = rc;
+    packet->pos = packet->size;
+}
+
 void TPM2_Packet_ParseBytes(TPM2_Packet* packet, byte* buf, int size)
 {
     if (packet) {
-        if (buf) {
-            /* truncate result */
-            int sizeToCopy = size;
-            if (packet->pos + sizeToCopy > packet->size)
-                sizeToCopy = packet->size - packet->pos;
-            XMEMCPY(buf, &packet->buf[packet->pos], sizeToCopy);
+        if (size < 0 || packet->pos + size > packet->size) {
+        #ifdef DEBUG_WOLFTPM
+            printf("TPM2_Packet_ParseBytes: size %d exceeds packet\n", size);
+        #endif
+            if (buf && size > 0)
+                XMEMSET(buf, 0, size);
+            TPM2_Packet_ParseFail(packet, BUFFER_E);
+            return;
         }
+        if (buf)
+            XMEMCPY(buf, &packet->buf[packet->pos], size);
         packet->pos += size;
     }
 }
 
+/* Parse a size prefixed buffer (TPM2B) with a single validated copy.
+ * A size larger than maxSz or the remaining packet is an error. */
+int TPM2_Packet_ParseU16Buf(TPM2_Packet* packet, UINT16* size, byte* buf,
+    UINT16 maxSz)
+{
+    UINT16 wireSz = 0;
+
+    if (packet == NULL)
+        return BAD_FUNC_ARG;
+
+    TPM2_Packet_ParseU16(packet, &wireSz);
+    if (size != NULL) {
+        *size = 0;
+    }
+    if (wireSz > maxSz || packet->pos + wireSz > packet->size) {
+    #ifdef DEBUG_WOLFTPM
+        printf("TPM2_Packet_ParseU16Buf: size %d exceeds max %d or packet\n",
+            wireSz, maxSz);
+    #endif
+        TPM2_Packet_ParseFail(packet, BUFFER_E);
+        return BUFFER_E;
+    }
+    if (buf != NULL && wireSz > 0) {
+        XMEMCPY(buf, &packet->buf[packet->pos], wireSz);
+    }
+    if (size != NULL) {
+        *size = wireSz;
+    }
+    packet->pos += wireSz;
+    return 0;
+}
+
+/* Parse a list count, which must not exceed the entries in the destination */
+int TPM2_Packet_ParseCount(TPM2_Packet* packet, UINT32* count, UINT32 maxCount)
+{
+    UINT32 wireCount = 0;
+
+    if (packet == NULL || count == NULL)
+        return BAD_FUNC_ARG;
+
+    TPM2_Packet_ParseU32(packet, &wireCount);
+    if (wireCount > maxCount) {
+    #ifdef DEBUG_WOLFTPM
+        printf("TPM2_Packet_ParseCount: count %u exceeds max %u\n",
+            (unsigned int)wireCount, (unsigned int)maxCount);
+    #endif
+        *count = 0;
+        TPM2_Packet_ParseFail(packet, BUFFER_E);
+        return BUFFER_E;
+    }
+    *count = wireCount;
+    return 0;
+}
+
+/* Returns the first parse error of a response, 0 if all fields fit */
+int TPM2_Packet_ParseStatus(TPM2_Packet* packet)
+{
+    if (packet == NULL)
+        return BAD_FUNC_ARG;
+    return packet->parseErr;
+}
+
 void TPM2_Packet_MarkU16(TPM2_Packet* packet, int* markSz)
 {
     if (packet) {
@@ -376,11 +610,11 @@ void TPM2_Packet_ParseAuth(TPM2_Packet* packet, TPMS_AUTH_RESPONSE* authRsp)
     if (authRsp == NULL)
         return;
 
-    TPM2_Packet_ParseU16(packet, &authRsp->nonce.size);
-    TPM2_Packet_ParseBytes(packet, authRsp->nonce.buffer, authRsp->nonce.size);
+    TPM2_Packet_ParseU16Buf(packet, &authRsp->nonce.size,
+        authRsp->nonce.buffer, (UINT16)sizeof(authRsp->nonce.buffer));
     TPM2_Packet_ParseU8(packet, &authRsp->sessionAttributes);
-    TPM2_Packet_ParseU16(packet, &authRsp->hmac.size);
-    TPM2_Packet_ParseBytes(packet, authRsp->hmac.buffer, authRsp->hmac.size);
+    TPM2_Packet_ParseU16Buf(packet, &authRsp->hmac.size,
+        authRsp->hmac.buffer, (UINT16)sizeof(authRsp->hmac.buffer));
 }
 
 void TPM2_Packet_AppendPCR(TPM2_Packet* packet, TPML_PCR_SELECTION* pcr)
@@ -398,10 +632,16 @@ void TPM2_Packet_AppendPCR(TPM2_Packet* packet, TPML_PCR_SELECTION* pcr)
 void TPM2_Packet_ParsePCR(TPM2_Packet* packet, TPML_PCR_SELECTION* pcr)
 {
     int i;
-    TPM2_Packet_ParseU32(packet, &pcr->count);
+    TPM2_Packet_ParseCount(packet, &pcr->count,
+        (UINT32)(sizeof(pcr->pcrSelections) / sizeof(pcr->pcrSelections[0])));
     for (i=0; i<(int)pcr->count; i++) {
         TPM2_Packet_ParseU16(packet, &pcr->pcrSelections[i].hash);
         TPM2_Packet_ParseU8(packet, &pcr->pcrSelections[i].sizeofSelect);
+        if (pcr->pcrSelections[i].sizeofSelect >
+                sizeof(pcr->pcrSelections[i].pcrSelect)) {
+            pcr->pcrSelections[i].sizeofSelect = 0;
+            TPM2_Packet_ParseFail(packet, BUFFER_E);
+        }
         TPM2_Packet_ParseBytes(packet,
             pcr->pcrSelections[i].pcrSelect,
             pcr->pcrSelections[i].sizeofSelect);
@@ -529,10 +769,10 @@ void TPM2_Packet_ParseEccPoint(TPM2_Packet* packet, TPMS_ECC_POINT* point)
         return; /* help out static analysis */
     }
 
-    TPM2_Packet_ParseU16(packet, &point->x.size);
-    TPM2_Packet_ParseBytes(packet, point->x.buffer, point->x.size);
-    TPM2_Packet_ParseU16(packet, &point->y.size);
-    TPM2_Packet_ParseBytes(packet, point->y.buffer, point->y.size);
+    TPM2_Packet_ParseU16Buf(packet, &point->x.size,
+        point->x.buffer, (UINT16)sizeof(point->x.buffer));
+    TPM2_Packet_ParseU16Buf(packet, &point->y.size,
+        point->y.buffer, (UINT16)sizeof(point->y.buffer));
 }
 
 void TPM2_Packet_AppendPoint(TPM2_Packet* packet, TPM2B_ECC_POINT* point)
@@ -716,28 +956,28 @@ void TPM2_Packet_ParsePublic(TPM2_Packet* packet, TPM2B_PUBLIC* pub)
         TPM2_Packet_ParseU16(packet, &pub->publicArea.type);
         TPM2_Packet_ParseU16(packet, &pub->publicArea.nameAlg);
         TPM2_Packet_ParseU32(packet, &pub->publicArea.objectAttributes);
-        TPM2_Packet_ParseU16(packet, &pub->publicArea.authPolicy.size);
-        TPM2_Packet_ParseBytes(packet, pub->publicArea.authPolicy.buffer,
-            pub->publicArea.authPolicy.size);
+        TPM2_Packet_ParseU16Buf(packet, &pub->publicArea.authPolicy.size,
+            pub->publicArea.authPolicy.buffer,
+            (UINT16)sizeof(pub->publicArea.authPolicy.buffer));
 
         TPM2_Packet_ParsePublicParms(packet, pub->publicArea.type,
             &pub->publicArea.parameters);
 
         switch (pub->publicArea.type) {
         case TPM_ALG_KEYEDHASH:
-            TPM2_Packet_ParseU16(packet, &pub->publicArea.unique.keyedHash.size);
-            TPM2_Packet_ParseBytes(packet, pub->publicArea.unique.keyedHash.buffer,
-                pub->publicArea.unique.keyedHash.size);
+            TPM2_Packet_ParseU16Buf(packet, &pub->publicArea.unique.keyedHash.size,
+                pub->publicArea.unique.keyedHash.buffer,
+                (UINT16)sizeof(pub->publicArea.unique.keyedHash.buffer));
             break;
         case TPM_ALG_SYMCIPHER:
-            TPM2_Packet_ParseU16(packet, &pub->publicArea.unique.sym.size);
-            TPM2_Packet_ParseBytes(packet, pub->publicArea.unique.sym.buffer,
-                pub->publicArea.unique.sym.size);
+            TPM2_Packet_ParseU16Buf(packet, &pub->publicArea.unique.sym.size,
+                pub->publicArea.unique.sym.buffer,
+                (UINT16)sizeof(pub->publicArea.unique.sym.buffer));
             break;
         case TPM_ALG_RSA:
-            TPM2_Packet_ParseU16(packet, &pub->publicArea.unique.rsa.size);
-            TPM2_Packet_ParseBytes(packet, pub->publicArea.unique.rsa.buffer,
-                pub->publicArea.unique.rsa.size);
+            TPM2_Packet_ParseU16Buf(packet, &pub->publicArea.unique.rsa.size,
+                pub->publicArea.unique.rsa.buffer,
+                (UINT16)sizeof(pub->publicArea.unique.rsa.buffer));
             break;
         case TPM_ALG_ECC:
             TPM2_Packet_ParseEccPoint(packet, &pub->publicArea.unique.ecc);
@@ -796,21 +1036,21 @@ void TPM2_Packet_ParseSignature(TPM2_Packet* packet, TPMT_SIGNATURE* sig)
     case TPM_ALG_ECDAA:
         TPM2_Packet_ParseU16(packet, &sig->signature.ecdsa.hash);
 
-        TPM2_Packet_ParseU16(packet, &sig->signature.ecdsa.signatureR.size);
-        TPM2_Packet_ParseBytes(packet, sig->signature.ecdsa.signatureR.buffer,
-            sig->signature.ecdsa.signatureR.size);
+        TPM2_Packet_ParseU16Buf(packet, &sig->signature.ecdsa.signatureR.size,
+            sig->signature.ecdsa.signatureR.buffer,
+            (UINT16)sizeof(sig->signature.ecdsa.signatureR.buffer));
 
-        TPM2_Packet_ParseU16(packet, &sig->signature.ecdsa.signatureS.size);
-        TPM2_Packet_ParseBytes(packet, sig->signature.ecdsa.signatureS.buffer,
-            sig->signature.ecdsa.signatureS.size);
+        TPM2_Packet_ParseU16Buf(packet, &sig->signature.ecdsa.signatureS.size,
+            sig->signature.ecdsa.signatureS.buffer,
+            (UINT16)sizeof(sig->signature.ecdsa.signatureS.buffer));
         break;
     case TPM_ALG_RSASSA:
     case TPM_ALG_RSAPSS:
         TPM2_Packet_ParseU16(packet, &sig->signature.rsassa.hash);
 
-        TPM2_Packet_ParseU16(packet, &sig->signature.rsassa.sig.size);
-        TPM2_Packet_ParseBytes(packet, sig->signature.rsassa.sig.buffer,
-            sig->signature.rsassa.sig.size);
+        TPM2_Packet_ParseU16Buf(packet, &sig->signature.rsassa.sig.size,
+            sig->signature.rsassa.sig.buffer,
+            (UINT16)sizeof(sig->signature.rsassa.sig.buffer));
         break;
     case TPM_ALG_HMAC:
         TPM2_Packet_ParseU16(packet, &sig->signature.hmac.hashAlg);
@@ -836,13 +1076,11 @@ void TPM2_Packet_ParseAttest(TPM2_Packet* packet, TPMS_ATTEST* out)
 
     TPM2_Packet_ParseU16(packet, &out->type);
 
-    TPM2_Packet_ParseU16(packet, &out->qualifiedSigner.size);
-    TPM2_Packet_ParseBytes(packet, out->qualifiedSigner.name,
-        out->qualifiedSigner.size);
+    TPM2_Packet_ParseU16Buf(packet, &out->qualifiedSigner.size,
+        out->qualifiedSigner.name, (UINT16)sizeof(out->qualifiedSigner.name));
 
-    TPM2_Packet_ParseU16(packet, &out->extraData.size);
-    TPM2_Packet_ParseBytes(packet, out->extraData.buffer,
-        out->extraData.size);
+    TPM2_Packet_ParseU16Buf(packet, &out->extraData.size,
+        out->extraData.buffer, (UINT16)sizeof(out->extraData.buffer));
 
     TPM2_Packet_ParseU64(packet, &out->clockInfo.clock);
     TPM2_Packet_ParseU32(packet, &out->clockInfo.resetCount);
@@ -853,42 +1091,39 @@ void TPM2_Packet_ParseAttest(TPM2_Packet* packet, TPMS_ATTEST* out)
 
     switch (out->type) {
         case TPM_ST_ATTEST_CERTIFY:
-            TPM2_Packet_ParseU16(packet, &out->attested.certify.name.size);
-            TPM2_Packet_ParseBytes(packet, out->attested.certify.name.name,
-                out->attested.certify.name.size);
-            TPM2_Packet_ParseU16(packet, &out->attested.certify.qualifiedName.size);
-            TPM2_Packet_ParseBytes(packet, out->attested.certify.qualifiedName.name,
-                out->attested.certify.qualifiedName.size);
+            TPM2_Packet_ParseU16Buf(packet, &out->attested.certify.name.size,
+                out->attested.certify.name.name, (UINT16)sizeof(out->attested.certify.name.name));
+            TPM2_Packet_ParseU16Buf(packet, &out->attested.certify.qualifiedName.size,
+                out->attested.certify.qualifiedName.name, (UINT16)sizeof(out->attested.certify.qualifiedName.name));
             break;
         case TPM_ST_ATTEST_CREATION:
-            TPM2_Packet_ParseU16(packet, &out->attested.creation.objectName.size);
-            TPM2_Packet_ParseBytes(packet, out->attested.creation.objectName.name,
-                out->attested.creation.objectName.size);
-            TPM2_Packet_ParseU16(packet, &out->attested.creation.creationHash.size);
-            TPM2_Packet_ParseBytes(packet, out->attested.creation.creationHash.buffer,
-                out->attested.creation.creationHash.size);
+            TPM2_Packet_ParseU16Buf(packet, &out->attested.creation.objectName.size,
+                out->attested.creation.objectName.name, (UINT16)sizeof(out->attested.creation.objectName.name));
+            TPM2_Packet_ParseU16Buf(packet, &out->attested.creation.creationHash.size,
+                out->attested.creation.creationHash.buffer,
+                (UINT16)sizeof(out->attested.creation.creationHash.buffer));
             break;
         case TPM_ST_ATTEST_QUOTE:
             TPM2_Packet_ParsePCR(packet, &out->attested.quote.pcrSelect);
-            TPM2_Packet_ParseU16(packet, &out->attested.quote.pcrDigest.size);
-            TPM2_Packet_ParseBytes(packet, out->attested.quote.pcrDigest.buffer,
-                out->attested.quote.pcrDigest.size);
+            TPM2_Packet_ParseU16Buf(packet, &out->attested.quote.pcrDigest.size,
+                out->attested.quote.pcrDigest.buffer,
+                (UINT16)sizeof(out->attested.quote.pcrDigest.buffer));
             break;
         case TPM_ST_ATTEST_COMMAND_AUDIT:
             TPM2_Packet_ParseU64(packet, &out->attested.commandAudit.auditCounter);
             TPM2_Packet_ParseU16(packet, &out->attested.commandAudit.digestAlg);
-            TPM2_Packet_ParseU16(packet, &out->attested.commandAudit.auditDigest.size);
-            TPM2_Packet_ParseBytes(packet, out->attested.commandAudit.auditDigest.buffer,
-                out->attested.commandAudit.auditDigest.size);
-            TPM2_Packet_ParseU16(packet, &out->attested.commandAudit.commandDigest.size);
-            TPM2_Packet_ParseBytes(packet, out->attested.commandAudit.commandDigest.buffer,
-                out->attested.commandAudit.commandDigest.size);
+            TPM2_Packet_ParseU16Buf(packet, &out->attested.commandAudit.auditDigest.size,
+                out->attested.commandAudit.auditDigest.buffer,
+                (UINT16)sizeof(out->attested.commandAudit.auditDigest.buffer));
+            TPM2_Packet_ParseU16Buf(packet, &out->attested.commandAudit.commandDigest.size,
+                out->attested.commandAudit.commandDigest.buffer,
+                (UINT16)sizeof(out->attested.commandAudit.commandDigest.buffer));
             break;
         case TPM_ST_ATTEST_SESSION_AUDIT:
             TPM2_Packet_ParseU8(packet, &out->attested.sessionAudit.exclusiveSession);
-            TPM2_Packet_ParseU16(packet, &out->attested.sessionAudit.sessionDigest.size);
-            TPM2_Packet_ParseBytes(packet, out->attested.sessionAudit.sessionDigest.buffer,
-                out->attested.sessionAudit.sessionDigest.size);
+            TPM2_Packet_ParseU16Buf(packet, &out->attested.sessionAudit.sessionDigest.size,
+                out->attested.sessionAudit.sessionDigest.buffer,
+                (UINT16)sizeof(out->attested.sessionAudit.sessionDigest.buffer));
             break;
         case TPM_ST_ATTEST_TIME:
             TPM2_Packet_ParseU64(packet, &out->attested.time.time.time);
@@ -899,13 +1134,12 @@ void TPM2_Packet_ParseAttest(TPM2_Packet* packet, TPMS_ATTEST* out)
             TPM2_Packet_ParseU64(packet, &out->attested.time.firmwareVersion);
             break;
         case TPM_ST_ATTEST_NV:
-            TPM2_Packet_ParseU16(packet, &out->attested.nv.indexName.size);
-            TPM2_Packet_ParseBytes(packet, out->attested.nv.indexName.name,
-                out->attested.nv.indexName.size);
+            TPM2_Packet_ParseU16Buf(packet, &out->attested.nv.indexName.size,
+                out->attested.nv.indexName.name, (UINT16)sizeof(out->attested.nv.indexName.name));
             TPM2_Packet_ParseU16(packet, &out->attested.nv.offset);
-            TPM2_Packet_ParseU16(packet, &out->attested.nv.nvContents.size);
-            TPM2_Packet_ParseBytes(packet, out->attested.nv.nvContents.buffer,
-                out->attested.nv.nvContents.size);
+            TPM2_Packet_ParseU16Buf(packet, &out->attested.nv.nvContents.size,
+                out->attested.nv.nvContents.buffer,
+                (UINT16)sizeof(out->attested.nv.nvContents.buffer));
             break;
         default:
             /* unknown attestation type */
@@ -925,6 +1159,14 @@ TPM_RC TPM2_Packet_Parse(TPM_RC rc, TPM2_Packet* packet)
         TPM2_Packet_ParseU16(packet, NULL);     /* tag */
         TPM2_Packet_ParseU32(packet, &respSz);  /* response size */
         TPM2_Packet_ParseU32(packet, &tmpRc);   /* response code */
+        if (respSz < TPM2_HEADER_SIZE || respSz > (UINT32)packet->size) {
+        #ifdef DEBUG_WOLFTPM
+            printf("TPM2_Packet_Parse: response size %u invalid\n",
+                (unsigned int)respSz);
+        #endif
+            TPM2_Packet_ParseFail(packet, BUFFER_E);
+            return BUFFER_E;
+        }
         packet->size = respSz;
         rc = tmpRc;
     }
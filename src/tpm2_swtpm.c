@@ -45,24 +45,45 @@
 #include <stdio.h>
 
 #include <wolftpm/tpm2_socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <stdlib.h>
+
+/* The address is taken from the context (TPM2_SWTPM_SetAddress), then the
+ * environment, then the build default. A host starting with '/' is the path
+ * of a Unix domain socket and the port is ignored. */
+static const char* SwTpmAddrGet(const char* ctxVal, const char* env,
+    const char* def)
+{
+    const char* val = ctxVal;
+    if (val == NULL || val[0] == '\0')
+        val = getenv(env);
+    if (val == NULL || val[0] == '\0')
+        val = def;
+    return val;
+}
 
-#ifndef TPM2_SWTPM_HOST
-#define TPM2_SWTPM_HOST         "localhost"
-#endif
-#ifndef TPM2_SWTPM_PORT
-#define TPM2_SWTPM_PORT         "2321"
-#endif
+static int SwTpmAddrSet(char* dst, size_t dstSz, const char* src)
+{
+    size_t srcSz = (src != NULL) ? XSTRLEN(src) : 0;
+    if (srcSz >= dstSz)
+        return BAD_FUNC_ARG;
+    if (srcSz > 0)
+        XMEMCPY(dst, src, srcSz);
+    dst[srcSz] = '\0';
+    return TPM_RC_SUCCESS;
+}
 
-static TPM_RC SwTpmTransmit(TPM2_CTX* ctx, const void* buffer, ssize_t bufSz)
+static TPM_RC SwTpmTransmit(int fd, const void* buffer, ssize_t bufSz)
 {
     TPM_RC rc = TPM_RC_SUCCESS;
     ssize_t wrc = 0;
 
-    if (ctx == NULL || ctx->tcpCtx.fd < 0 || buffer == NULL) {
+    if (fd < 0 || buffer == NULL) {
         return BAD_FUNC_ARG;
     }
 
-    wrc = write(ctx->tcpCtx.fd, buffer, bufSz);
+    wrc = write(fd, buffer, bufSz);
     if (bufSz != wrc) {
         rc = SOCKET_ERROR_E;
     }
@@ -70,26 +91,51 @@ static TPM_RC SwTpmTransmit(TPM2_CTX* ctx, const void* buffer, ssize_t bufSz)
 #ifdef WOLFTPM_DEBUG_VERBOSE
     if (wrc < 0) {
         printf("Failed to send the TPM command to fd %d, got errno %d ="
-               "%s\n", ctx->tcpCtx.fd, errno, strerror(errno));
+               "%s\n", fd, errno, strerror(errno));
     }
 #endif
 
     return rc;
 }
 
-static TPM_RC SwTpmReceive(TPM2_CTX* ctx, void* buffer, size_t rxSz)
+/* Waits for the socket to become readable within the command deadline */
+static TPM_RC SwTpmPoll(TPM2_CTX* ctx, int fd)
+{
+    struct pollfd pfd;
+    int timeoutMs, prc;
+
+    timeoutMs = TPM2_DeadlineRemaining(ctx);
+    if (timeoutMs < 0)
+        return TPM_RC_SUCCESS; /* no deadline, use a blocking read */
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    do {
+        prc = poll(&pfd, 1, timeoutMs);
+    } while (prc < 0 && errno == EINTR);
+    if (prc == 0)
+        return TPM_RC_DEADLINE;
+    if (prc < 0)
+        return SOCKET_ERROR_E;
+    return TPM_RC_SUCCESS;
+}
+
+static TPM_RC SwTpmReceive(TPM2_CTX* ctx, int fd, void* buffer, size_t rxSz)
 {
     TPM_RC rc = TPM_RC_SUCCESS;
     ssize_t wrc = 0;
     size_t bytes_remaining = rxSz;
     char* ptr = (char*)buffer;
 
-    if (ctx == NULL || ctx->tcpCtx.fd < 0 || buffer == NULL) {
+    if (fd < 0 || buffer == NULL) {
         return BAD_FUNC_ARG;
     }
 
     while (bytes_remaining > 0) {
-        wrc = read(ctx->tcpCtx.fd, ptr, bytes_remaining);
+        rc = SwTpmPoll(ctx, fd);
+        if (rc != TPM_RC_SUCCESS)
+            break;
+        wrc = read(fd, ptr, bytes_remaining);
         if (wrc <= 0) {
             #ifdef DEBUG_WOLFTPM
             if (wrc == 0) {
@@ -97,7 +143,7 @@ static TPM_RC SwTpmReceive(TPM2_CTX* ctx, void* buffer, size_t rxSz)
             }
             else {
                 printf("Failed to read from TPM socket %d, got errno %d"
-                       " = %s\n", ctx->tcpCtx.fd, errno, strerror(errno));
+                       " = %s\n", fd, errno, strerror(errno));
             }
             #endif
             rc = SOCKET_ERROR_E;
@@ -116,18 +162,51 @@ static TPM_RC SwTpmReceive(TPM2_CTX* ctx, void* buffer, size_t rxSz)
     return rc;
 }
 
-static TPM_RC SwTpmConnect(TPM2_CTX* ctx, const char* host, const char* port)
+static TPM_RC SwTpmConnectUnix(const char* path, int* pFd)
+{
+    struct sockaddr_un addr;
+    size_t pathSz = XSTRLEN(path);
+    int fd;
+
+    if (pathSz >= sizeof(addr.sun_path))
+        return BAD_FUNC_ARG;
+
+    XMEMSET(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    XMEMCPY(addr.sun_path, path, pathSz);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return SOCKET_ERROR_E;
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+    #ifdef DEBUG_WOLFTPM
+        printf("Failed to connect to %s, errno %d = %s\n",
+            path, errno, strerror(errno));
+    #endif
+        close(fd);
+        return SOCKET_ERROR_E;
+    }
+
+    *pFd = fd;
+    return TPM_RC_SUCCESS;
+}
+
+static TPM_RC SwTpmConnect(const char* host, const char* port, int* pFd)
 {
     TPM_RC rc = SOCKET_ERROR_E;
     struct addrinfo hints;
     struct addrinfo *result, *rp;
     int s;
-    int fd;
+    int fd = -1;
 
-    if (ctx == NULL) {
+    if (host == NULL || port == NULL || pFd == NULL) {
         return BAD_FUNC_ARG;
     }
 
+    if (host[0] == '/') {
+        return SwTpmConnectUnix(host, pFd);
+    }
+
     XMEMSET(&hints, 0, sizeof(struct addrinfo));
     hints.ai_family = AF_UNSPEC;
     hints.ai_socktype = SOCK_STREAM;
@@ -135,6 +214,7 @@ static TPM_RC SwTpmConnect(TPM2_CTX* ctx, const char* host, const char* port)
     s = getaddrinfo(host, port, &hints, &result);
     if (s != 0) {
         fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(s));
+        return SOCKET_ERROR_E;
     }
 
     for (rp = result; rp != NULL; rp = rp->ai_next) {
@@ -152,7 +232,7 @@ static TPM_RC SwTpmConnect(TPM2_CTX* ctx, const char* host, const char* port)
     freeaddrinfo(result);
 
     if (rp != NULL) {
-        ctx->tcpCtx.fd = fd;
+        *pFd = fd;
         rc = TPM_RC_SUCCESS;
     }
     #ifdef DEBUG_WOLFTPM
@@ -175,7 +255,7 @@ static TPM_RC SwTpmDisconnect(TPM2_CTX* ctx)
 
     /* end swtpm session */
     tss_cmd = TPM2_Packet_SwapU32(TPM_SESSION_END);
-    rc = SwTpmTransmit(ctx, &tss_cmd, sizeof(uint32_t));
+    rc = SwTpmTransmit(ctx->tcpCtx.fd, &tss_cmd, sizeof(uint32_t));
     #ifdef WOLFTPM_DEBUG_VERBOSE
     if (rc != TPM_RC_SUCCESS) {
         printf("Failed to transmit SESSION_END\n");
@@ -196,6 +276,101 @@ static TPM_RC SwTpmDisconnect(TPM2_CTX* ctx)
     return rc;
 }
 
+int TPM2_SWTPM_SetAddress(TPM2_CTX* ctx, const char* host, const char* port)
+{
+    int rc;
+    if (ctx == NULL)
+        return BAD_FUNC_ARG;
+    rc = SwTpmAddrSet(ctx->tcpCtx.host, sizeof(ctx->tcpCtx.host), host);
+    if (rc == TPM_RC_SUCCESS)
+        rc = SwTpmAddrSet(ctx->tcpCtx.port, sizeof(ctx->tcpCtx.port), port);
+    return rc;
+}
+
+int TPM2_SWTPM_SetCtrlAddress(TPM2_CTX* ctx, const char* host,
+    const char* port)
+{
+    int rc;
+    if (ctx == NULL)
+        return BAD_FUNC_ARG;
+    rc = SwTpmAddrSet(ctx->tcpCtx.ctrlHost, sizeof(ctx->tcpCtx.ctrlHost),
+        host);
+    if (rc == TPM_RC_SUCCESS) {
+        rc = SwTpmAddrSet(ctx->tcpCtx.ctrlPort, sizeof(ctx->tcpCtx.ctrlPort),
+            port);
+    }
+    return rc;
+}
+
+/* Sends one command on the swtpm control channel. The request is the big
+ * endian command code and its payload, the response starts with the big
+ * endian result code. */
+int TPM2_SWTPM_CtrlCommand(TPM2_CTX* ctx, word32 cmd, const byte* in,
+    word32 inSz, word32* result)
+{
+    TPM_RC rc;
+    const char* host;
+    const char* port;
+    uint32_t tss_word;
+    int fd = -1;
+
+    if (ctx == NULL || result == NULL || (in == NULL && inSz > 0)) {
+        return BAD_FUNC_ARG;
+    }
+
+    /* the control channel defaults to the data host, except for a Unix
+     * socket path, which has no default control path */
+    host = SwTpmAddrGet(ctx->tcpCtx.ctrlHost, TPM2_SWTPM_CTRL_HOST_ENV, NULL);
+    if (host == NULL) {
+        host = SwTpmAddrGet(ctx->tcpCtx.host, TPM2_SWTPM_HOST_ENV,
+            TPM2_SWTPM_HOST);
+        if (host[0] == '/')
+            return BAD_FUNC_ARG;
+    }
+    port = SwTpmAddrGet(ctx->tcpCtx.ctrlPort, TPM2_SWTPM_CTRL_PORT_ENV,
+        TPM2_SWTPM_CTRL_PORT);
+
+    rc = SwTpmConnect(host, port, &fd);
+    if (rc == TPM_RC_SUCCESS) {
+        tss_word = TPM2_Packet_SwapU32(cmd);
+        rc = SwTpmTransmit(fd, &tss_word, sizeof(uint32_t));
+    }
+    if (rc == TPM_RC_SUCCESS && inSz > 0) {
+        rc = SwTpmTransmit(fd, in, inSz);
+    }
+    if (rc == TPM_RC_SUCCESS) {
+        rc = SwTpmReceive(ctx, fd, &tss_word, sizeof(uint32_t));
+        *result = TPM2_Packet_SwapU32(tss_word);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+
+#ifdef DEBUG_WOLFTPM
+    if (rc != TPM_RC_SUCCESS || *result != 0) {
+        printf("SWTPM control command %u failed: rc %d, result %u\n",
+            cmd, rc, *result);
+    }
+#endif
+
+    return rc;
+}
+
+int TPM2_SWTPM_PowerCycle(TPM2_CTX* ctx, int deleteVolatile)
+{
+    int rc;
+    word32 result = 0;
+    uint32_t flags;
+
+    flags = TPM2_Packet_SwapU32(deleteVolatile ?
+        SWTPM_CTRL_INIT_DELETE_VOLATILE : 0);
+    rc = TPM2_SWTPM_CtrlCommand(ctx, SWTPM_CTRL_CMD_INIT, (byte*)&flags,
+        sizeof(flags), &result);
+    if (rc == TPM_RC_SUCCESS && result != 0)
+        rc = TPM_RC_FAILURE;
+    return rc;
+}
+
 /* Talk to a TPM through socket
  * return TPM_RC_SUCCESS on success,
  *        SOCKET_ERROR_E on socket errors,
@@ -212,7 +387,12 @@ int TPM2_SWTPM_SendCommand(TPM2_CTX* ctx, TPM2_Packet* packet)
     }
 
     if (ctx->tcpCtx.fd < 0) {
-        rc = SwTpmConnect(ctx, TPM2_SWTPM_HOST, TPM2_SWTPM_PORT);
+        rc = SwTpmConnect(
+            SwTpmAddrGet(ctx->tcpCtx.host, TPM2_SWTPM_HOST_ENV,
+                TPM2_SWTPM_HOST),
+            SwTpmAddrGet(ctx->tcpCtx.port, TPM2_SWTPM_PORT_ENV,
+                TPM2_SWTPM_PORT),
+            &ctx->tcpCtx.fd);
     }
 
 #ifdef WOLFTPM_DEBUG_VERBOSE
@@ -223,28 +403,28 @@ int TPM2_SWTPM_SendCommand(TPM2_CTX* ctx, TPM2_Packet* packet)
     /* send start */
     tss_word = TPM2_Packet_SwapU32(TPM_SEND_COMMAND);
     if (rc == TPM_RC_SUCCESS) {
-        rc = SwTpmTransmit(ctx, &tss_word, sizeof(uint32_t));
+        rc = SwTpmTransmit(ctx->tcpCtx.fd, &tss_word, sizeof(uint32_t));
     }
 
     /* locality */
     if (rc == TPM_RC_SUCCESS) {
-        rc = SwTpmTransmit(ctx, &ctx->locality, sizeof(uint8_t));
+        rc = SwTpmTransmit(ctx->tcpCtx.fd, &ctx->locality, sizeof(uint8_t));
     }
 
     /* buffer size */
     tss_word = TPM2_Packet_SwapU32(packet->pos);
     if (rc == TPM_RC_SUCCESS) {
-        rc = SwTpmTransmit(ctx, &tss_word, sizeof(uint32_t));
+        rc = SwTpmTransmit(ctx->tcpCtx.fd, &tss_word, sizeof(uint32_t));
     }
 
     /* Send the TPM command buffer */
     if (rc == TPM_RC_SUCCESS) {
-        rc = SwTpmTransmit(ctx, packet->buf, packet->pos);
+        rc = SwTpmTransmit(ctx->tcpCtx.fd, packet->buf, packet->pos);
     }
 
     /* receive response */
     if (rc == TPM_RC_SUCCESS) {
-        rc = SwTpmReceive(ctx, &tss_word, sizeof(uint32_t));
+        rc = SwTpmReceive(ctx, ctx->tcpCtx.fd, &tss_word, sizeof(uint32_t));
         rspSz = TPM2_Packet_SwapU32(tss_word);
         if (rspSz > packet->size) {
             #ifdef WOLFTPM_DEBUG_VERBOSE
@@ -255,16 +435,16 @@ int TPM2_SWTPM_SendCommand(TPM2_CTX* ctx, TPM2_Packet* packet)
         }
     }
 
-    /* This performs a blocking read and could hang. This means a
-     * misbehaving actor on the other end of the socket
+    /* Without a command deadline this performs a blocking read and could
+     * hang on a misbehaving actor on the other end of the socket
      */
     if (rc == TPM_RC_SUCCESS) {
-        rc = SwTpmReceive(ctx, packet->buf, rspSz);
+        rc = SwTpmReceive(ctx, ctx->tcpCtx.fd, packet->buf, rspSz);
     }
 
     /* receive ack */
     if (rc == TPM_RC_SUCCESS) {
-        rc = SwTpmReceive(ctx, &tss_word, sizeof(uint32_t));
+        rc = SwTpmReceive(ctx, ctx->tcpCtx.fd, &tss_word, sizeof(uint32_t));
         tss_word = TPM2_Packet_SwapU32(tss_word);
         #ifdef WOLFTPM_DEBUG
         if (tss_word != 0) {
@@ -281,6 +461,11 @@ int TPM2_SWTPM_SendCommand(TPM2_CTX* ctx, TPM2_Packet* packet)
     }
 #endif
 
+    if (rc == TPM_RC_DEADLINE && ctx->tcpCtx.fd >= 0) {
+        /* the stream is mid response, drop it without a session end */
+        close(ctx->tcpCtx.fd);
+        ctx->tcpCtx.fd = -1;
+    }
     if (ctx->tcpCtx.fd >= 0) {
         TPM_RC rc_disconnect = SwTpmDisconnect(ctx);
         if (rc == TPM_RC_SUCCESS) {
@@ -86,89 +86,169 @@ enum tpm_tis_int_flags {
 #define TPM_XDATA_FIFO(l)       (TPM_BASE_ADDRESS | 0x0083u | ((l) << 12u))
 
 
-/* this option enables named semaphore protection on TIS commands for protected
-    concurrent process access */
+/* this option enables a file lock on TIS commands for protected concurrent
+    process access. The lock file is opened once per context and locked once
+    per command. The kernel drops the lock when a holder exits or crashes, so
+    a dead holder can not leave the TPM locked.
+    The path is taken from the WOLFTPM_TIS_LOCK_FILE environment variable,
+    then the build default. The file is shared through its group, so place it
+    in a directory only the TPM users can write to. */
 #ifdef WOLFTPM_TIS_LOCK
     #ifdef __linux__
-        #include <semaphore.h>
-        #include <fcntl.h>
+        #include <sys/file.h>
         #include <sys/stat.h>
+        #include <fcntl.h>
+        #include <unistd.h>
+        #include <stdlib.h>
+        #include <time.h>
         #include <errno.h>
 
-        #define SEM_NAME "/wolftpm"
-        #define SEM_PERMS (S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP)
-        #define INITIAL_VALUE 1
+        #ifndef WOLFTPM_TIS_LOCK_FILE
+            #define WOLFTPM_TIS_LOCK_FILE "/run/lock/wolftpm.lock"
+        #endif
+        #ifndef WOLFTPM_TIS_LOCK_FILE_ENV
+            #define WOLFTPM_TIS_LOCK_FILE_ENV "WOLFTPM_TIS_LOCK_FILE"
+        #endif
+        #define LOCK_PERMS 0660
+        #define LOCK_OPEN_FLAGS (O_RDONLY | O_NOFOLLOW | O_NONBLOCK | O_CLOEXEC)
         #define TIMEOUT_SECONDS 10
-        static int gLockCount = 0;
+        /* contended lock is polled with exponential backoff */
+        #define LOCK_POLL_US     100
+        #define LOCK_POLL_MAX_US 10000
 
-        static int TPM2_TIS_Lock(void)
+        static word32 TPM2_TIS_LockTimeMs(void)
         {
-            int ret = 0;
-            sem_t *sem;
-            struct timespec timeoutTime;
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            return (word32)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+        }
 
-            if (gLockCount == 0) {
-                clock_gettime(CLOCK_REALTIME, &timeoutTime);
-                timeoutTime.tv_sec += TIMEOUT_SECONDS;
+        /* Opens the lock file without following a symlink. A new file gets
+         * group permissions whatever the umask. A file that is not regular
+         * or that others can access was not created here and is refused. */
+        static int TPM2_TIS_LockOpen(const char* path)
+        {
+            int fd;
+            struct stat st;
+
+            fd = open(path, LOCK_OPEN_FLAGS);
+            if (fd < 0 && errno == ENOENT) {
+                fd = open(path, LOCK_OPEN_FLAGS | O_CREAT | O_EXCL,
+                    LOCK_PERMS);
+                if (fd >= 0) {
+                    (void)fchmod(fd, LOCK_PERMS);
+                }
+                else if (errno == EEXIST) {
+                    /* created by another process in the meantime */
+                    fd = open(path, LOCK_OPEN_FLAGS);
+                }
+            }
+            if (fd >= 0 && (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+                            (st.st_mode & S_IRWXO) != 0)) {
+            #ifdef DEBUG_WOLFTPM
+                printf("TPM2_TIS_Lock: Lock file %s is not a private "
+                       "regular file\n", path);
+            #endif
+                close(fd);
+                fd = -1;
+            }
+            return fd;
+        }
 
-                /* open semaphore and create if not found */
-                sem = sem_open(SEM_NAME, O_CREAT | O_RDWR, SEM_PERMS, INITIAL_VALUE);
-                if (sem == SEM_FAILED) {
+        static int TPM2_TIS_Lock(TPM2_CTX* ctx)
+        {
+            word32 start, waitMs, pollUs;
+            const char* path;
+
+            if (ctx->tisLockDepth > 0) {
+                ctx->tisLockDepth++;
+                return 0;
+            }
+            if (ctx->tisLockFd < 0) {
+                path = getenv(WOLFTPM_TIS_LOCK_FILE_ENV);
+                if (path == NULL || path[0] == '\0')
+                    path = WOLFTPM_TIS_LOCK_FILE;
+                ctx->tisLockFd = TPM2_TIS_LockOpen(path);
+                if (ctx->tisLockFd < 0) {
                 #ifdef DEBUG_WOLFTPM
-                    printf("TPM2_TIS_Lock: Semaphore %s open failed! %d\n",
-                        SEM_NAME, errno);
+                    printf("TPM2_TIS_Lock: Lock file %s open failed! %d\n",
+                        path, errno);
                 #endif
                     return BAD_MUTEX_E;
                 }
+            }
 
-                /* Try and decrement semaphore */
-                if (sem_timedwait(sem, &timeoutTime) != 0) {
-                #ifdef DEBUG_WOLFTPM
-                    printf("TPM2_TIS_Lock: Semaphore %s timeout! %d\n",
-                        SEM_NAME, errno);
-                #endif
-                    ret = WC_TIMEOUT_E;
+            if (flock(ctx->tisLockFd, LOCK_EX | LOCK_NB) != 0) {
+                if (errno != EWOULDBLOCK) {
+                    return BAD_MUTEX_E;
                 }
-
-                sem_close(sem);
-            }
-            if (ret == 0) {
-                gLockCount++;
+                /* held by another process or context */
+                ctx->tisLockStats.contended++;
+                start = TPM2_TIS_LockTimeMs();
+                pollUs = LOCK_POLL_US;
+                do {
+                    waitMs = TPM2_TIS_LockTimeMs() - start;
+                    if (waitMs >= TIMEOUT_SECONDS * 1000) {
+                    #ifdef DEBUG_WOLFTPM
+                        printf("TPM2_TIS_Lock: Lock file timeout!\n");
+                    #endif
+                        return WC_TIMEOUT_E;
+                    }
+                    usleep(pollUs);
+                    pollUs *= 2;
+                    if (pollUs > LOCK_POLL_MAX_US)
+                        pollUs = LOCK_POLL_MAX_US;
+                } while (flock(ctx->tisLockFd, LOCK_EX | LOCK_NB) != 0);
+
+                waitMs = TPM2_TIS_LockTimeMs() - start;
+                ctx->tisLockStats.waitTotalMs += waitMs;
+                if (waitMs > ctx->tisLockStats.waitMaxMs)
+                    ctx->tisLockStats.waitMaxMs = waitMs;
             }
+            ctx->tisLockStats.acquired++;
+            ctx->tisLockDepth = 1;
 
-            return ret;
+            return 0;
         }
 
-        static void TPM2_TIS_Unlock(void)
+        static void TPM2_TIS_Unlock(TPM2_CTX* ctx)
         {
-            if (gLockCount > 0) {
-                gLockCount--;
-            }
-            if (gLockCount == 0) {
-                sem_t *sem = sem_open(SEM_NAME, O_RDWR);
-                if (sem == SEM_FAILED) {
-                #ifdef DEBUG_WOLFTPM
-                    printf("TPM2_TIS_Unlock: Semaphore %s open failed! %d\n",
-                        SEM_NAME, errno);
-                #endif
-                    return;
+            if (ctx->tisLockDepth > 0) {
+                ctx->tisLockDepth--;
+                if (ctx->tisLockDepth == 0) {
+                    (void)flock(ctx->tisLockFd, LOCK_UN);
                 }
+            }
+        }
 
-                sem_post(sem); /* increment semaphore */
-                sem_close(sem);
+        void TPM2_TIS_Cleanup(TPM2_CTX* ctx)
+        {
+            if (ctx->tisLockFd >= 0) {
+                close(ctx->tisLockFd); /* also drops a held lock */
+                ctx->tisLockFd = -1;
             }
+            ctx->tisLockDepth = 0;
+        }
+
+        int TPM2_TIS_GetLockStats(TPM2_CTX* ctx, TPM2_TIS_LOCK_STATS* stats)
+        {
+            if (ctx == NULL || stats == NULL)
+                return BAD_FUNC_ARG;
+            *stats = ctx->tisLockStats;
+            return TPM_RC_SUCCESS;
         }
-        #define TPM2_TIS_LOCK()   TPM2_TIS_Lock()
-        #define TPM2_TIS_UNLOCK() TPM2_TIS_Unlock()
+
+        #define TPM2_TIS_LOCK(ctx)   TPM2_TIS_Lock(ctx)
+        #define TPM2_TIS_UNLOCK(ctx) TPM2_TIS_Unlock(ctx)
     #else
         #error TPM TIS Locking not supported on this platform
     #endif /* __linux__ */
 #endif /* WOLFTPM_TIS_LOCK */
 #ifndef TPM2_TIS_LOCK
-#define TPM2_TIS_LOCK() 0
+#define TPM2_TIS_LOCK(ctx) 0
 #endif
 #ifndef TPM2_TIS_UNLOCK
-#define TPM2_TIS_UNLOCK()
+#define TPM2_TIS_UNLOCK(ctx)
 #endif
 
 
@@ -184,7 +264,7 @@ int TPM2_TIS_Read(TPM2_CTX* ctx, word32 addr, byte* result,
     if (ctx == NULL || result == NULL || len == 0 || len > MAX_SPI_FRAMESIZE)
         return BAD_FUNC_ARG;
 
-    rc = TPM2_TIS_LOCK();
+    rc = TPM2_TIS_LOCK(ctx);
     if (rc != 0)
         return rc;
 
@@ -202,7 +282,7 @@ int TPM2_TIS_Read(TPM2_CTX* ctx, word32 addr, byte* result,
 
     XMEMCPY(result, &rxBuf[TPM_TIS_HEADER_SZ], len);
 #endif
-    TPM2_TIS_UNLOCK();
+    TPM2_TIS_UNLOCK(ctx);
 #ifdef WOLFTPM_DEBUG_IO
     printf("TIS Read addr %x, len %d\n", addr, len);
     TPM2_PrintBin(result, len);
@@ -222,7 +302,7 @@ int TPM2_TIS_Write(TPM2_CTX* ctx, word32 addr, const byte* value,
     if (ctx == NULL || value == NULL || len == 0 || len > MAX_SPI_FRAMESIZE)
         return BAD_FUNC_ARG;
 
-    rc = TPM2_TIS_LOCK();
+    rc = TPM2_TIS_LOCK(ctx);
     if (rc != 0)
         return rc;
 
@@ -240,7 +320,7 @@ int TPM2_TIS_Write(TPM2_CTX* ctx, word32 addr, const byte* value,
 
     rc = ctx->ioCb(ctx, txBuf, rxBuf, len + TPM_TIS_HEADER_SZ, ctx->userCtx);
 #endif
-    TPM2_TIS_UNLOCK();
+    TPM2_TIS_UNLOCK(ctx);
 #ifdef WOLFTPM_DEBUG_IO
     printf("TIS write addr %x, len %d\n", addr, len);
     TPM2_PrintBin(value, len);
@@ -373,6 +453,8 @@ int TPM2_TIS_WaitForStatus(TPM2_CTX* ctx, byte status, byte status_mask)
         rc = TPM2_TIS_Status(ctx, &reg);
         if (rc == TPM_RC_SUCCESS && (reg & status) == status_mask)
             break;
+        if (TPM2_DeadlineRemaining(ctx) == 0)
+            return TPM_RC_DEADLINE;
         XTPM_WAIT();
     } while (rc == TPM_RC_SUCCESS && --timeout > 0);
 #ifdef WOLFTPM_DEBUG_TIMEOUT
@@ -413,6 +495,8 @@ int TPM2_TIS_GetBurstCount(TPM2_CTX* ctx, word16* burstCount)
         #endif
             if (rc == TPM_RC_SUCCESS && *burstCount > 0)
                 break;
+            if (TPM2_DeadlineRemaining(ctx) == 0)
+                return TPM_RC_DEADLINE;
             XTPM_WAIT();
         } while (rc == TPM_RC_SUCCESS && --timeout > 0);
 
@@ -437,7 +521,7 @@ int TPM2_TIS_SendCommand(TPM2_CTX* ctx, TPM2_Packet* packet)
     byte access, status = 0;
     word16 burstCount;
 
-    rc = TPM2_TIS_LOCK();
+    rc = TPM2_TIS_LOCK(ctx);
     if (rc != 0)
         return rc;
 
@@ -573,8 +657,10 @@ exit:
     /* Tell TPM we are done */
     if (rc == TPM_RC_SUCCESS)
         rc = TPM2_TIS_Ready(ctx);
+    else if (rc == TPM_RC_DEADLINE)
+        (void)TPM2_TIS_Ready(ctx); /* commandReady aborts the command */
 
-    TPM2_TIS_UNLOCK();
+    TPM2_TIS_UNLOCK(ctx);
 
     return rc;
 }
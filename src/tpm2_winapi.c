@@ -75,6 +75,11 @@ int TPM2_WinApi_SendCommand(TPM2_CTX* ctx, TPM2_Packet* packet)
                                  &ctx->winCtx.tbs_context);
     }
 
+    /* TBS submits synchronously, so the deadline is only checked here */
+    if (rc == 0 && TPM2_DeadlineRemaining(ctx) == 0) {
+        rc = TPM_RC_DEADLINE;
+    }
+
     /* send the command to the device.  Error if the device send fails. */
     if (rc == 0) {
         uint32_t tmp = packet->size;
@@ -37,20 +37,326 @@ static void wolfTPM2_CopyPubT(TPMT_PUBLIC* out, const TPMT_PUBLIC* in);
 static void wolfTPM2_CopyPub(TPM2B_PUBLIC* out, const TPM2B_PUBLIC* in);
 static void wolfTPM2_CopyPriv(TPM2B_PRIVATE* out, const TPM2B_PRIVATE* in);
 static void wolfTPM2_CopyEccParam(TPM2B_ECC_PARAMETER* out, const TPM2B_ECC_PARAMETER* in);
+#ifndef WOLFTPM2_NO_IMPORT
 static void wolfTPM2_CopyKeyFromBlob(WOLFTPM2_KEY* key, const WOLFTPM2_KEYBLOB* keyBlob);
+#endif
+#ifndef WOLFTPM2_NO_NV
 static void wolfTPM2_CopyNvPublic(TPMS_NV_PUBLIC* out, const TPMS_NV_PUBLIC* in);
+#endif
 
 /******************************************************************************/
 /* --- BEGIN Wrapper Device Functions -- */
 /******************************************************************************/
 
+#ifdef WOLFTPM_SINGLE_FLIGHT
+/* Read-only requests that identical concurrent callers can share */
+enum {
+    WOLFTPM2_FLIGHT_READ_PUBLIC = 1,
+    WOLFTPM2_FLIGHT_NV_READ_PUBLIC,
+    WOLFTPM2_FLIGHT_PCR_READ,
+    WOLFTPM2_FLIGHT_CAPS,
+};
+
+static int wolfTPM2_FlightInit(WOLFTPM2_DEV* dev)
+{
+    dev->flight = NULL;
+    if (wc_InitMutex(&dev->flightLock) != 0)
+        return TPM_RC_FAILURE;
+    return TPM_RC_SUCCESS;
+}
+
+/* Allocates the flight slots on first use, with flightLock held. Returns
+ * NULL when out of memory, in which case the request is issued directly. */
+static WOLFTPM2_FLIGHT* wolfTPM2_FlightSlots(WOLFTPM2_DEV* dev)
+{
+    int i;
+    WOLFTPM2_FLIGHT* flight;
+
+    if (dev->flight != NULL)
+        return dev->flight;
+
+    flight = (WOLFTPM2_FLIGHT*)XMALLOC(
+        sizeof(WOLFTPM2_FLIGHT) * WOLFTPM2_FLIGHT_NUM, NULL,
+        DYNAMIC_TYPE_TMP_BUFFER);
+    if (flight == NULL)
+        return NULL;
+    XMEMSET(flight, 0, sizeof(WOLFTPM2_FLIGHT) * WOLFTPM2_FLIGHT_NUM);
+    for (i = 0; i < WOLFTPM2_FLIGHT_NUM; i++) {
+        if (wc_InitMutex(&flight[i].done) != 0) {
+            while (--i >= 0)
+                wc_FreeMutex(&flight[i].done);
+            XFREE(flight, NULL, DYNAMIC_TYPE_TMP_BUFFER);
+            return NULL;
+        }
+    }
+    dev->flight = flight;
+    return flight;
+}
+
+static void wolfTPM2_FlightFree(WOLFTPM2_DEV* dev)
+{
+    int i;
+    if (dev->flight != NULL) {
+        for (i = 0; i < WOLFTPM2_FLIGHT_NUM; i++) {
+            wc_FreeMutex(&dev->flight[i].done);
+        }
+        XFREE(dev->flight, NULL, DYNAMIC_TYPE_TMP_BUFFER);
+        dev->flight = NULL;
+    }
+    wc_FreeMutex(&dev->flightLock);
+}
+
+static int wolfTPM2_FlightIssue(word32 op, void* in, void* out)
+{
+    switch (op) {
+        case WOLFTPM2_FLIGHT_READ_PUBLIC:
+            return TPM2_ReadPublic((ReadPublic_In*)in, (ReadPublic_Out*)out);
+    #ifndef WOLFTPM2_NO_NV
+        case WOLFTPM2_FLIGHT_NV_READ_PUBLIC:
+            return TPM2_NV_ReadPublic((NV_ReadPublic_In*)in,
+                (NV_ReadPublic_Out*)out);
+    #endif
+        case WOLFTPM2_FLIGHT_PCR_READ:
+            return TPM2_PCR_Read((PCR_Read_In*)in, (PCR_Read_Out*)out);
+        case WOLFTPM2_FLIGHT_CAPS:
+            return wolfTPM2_GetCapabilities_NoDev((WOLFTPM2_CAPS*)out);
+        default:
+            break;
+    }
+    return BAD_FUNC_ARG;
+}
+
+/* Issue a read-only request, or wait for an identical one already in flight
+ * and share its result. Falls back to issuing when all slots are busy or
+ * cannot be allocated. */
+static int wolfTPM2_FlightRun(WOLFTPM2_DEV* dev, word32 op, word32 arg1,
+    word32 arg2, void* in, void* out, word32 outSz)
+{
+    int rc, i;
+    WOLFTPM2_FLIGHT* slots;
+    WOLFTPM2_FLIGHT* flight = NULL;
+    WOLFTPM2_FLIGHT* slot = NULL;
+
+    if (outSz > sizeof(flight->out))
+        return BAD_FUNC_ARG;
+    if (wc_LockMutex(&dev->flightLock) != 0)
+        return TPM_RC_FAILURE;
+
+    slots = wolfTPM2_FlightSlots(dev);
+    for (i = 0; slots != NULL && i < WOLFTPM2_FLIGHT_NUM; i++) {
+        WOLFTPM2_FLIGHT* f = &slots[i];
+        if (f->op == 0) {
+            if (slot == NULL)
+                slot = f;
+        }
+        else if (f->op == op && f->arg1 == arg1 && f->arg2 == arg2 &&
+                 !f->isDone) {
+            flight = f;
+            break;
+        }
+    }
+
+    if (flight != NULL) {
+        /* follower: wait for the leader to release the done lock */
+        flight->waiters++;
+        dev->flightCoalesced++;
+        wc_UnLockMutex(&dev->flightLock);
+
+        (void)wc_LockMutex(&flight->done);
+        wc_UnLockMutex(&flight->done);
+
+        if (wc_LockMutex(&dev->flightLock) != 0)
+            return TPM_RC_FAILURE;
+        rc = flight->rc;
+        XMEMCPY(out, &flight->out, outSz);
+        if (--flight->waiters == 0)
+            flight->op = 0;
+        wc_UnLockMutex(&dev->flightLock);
+        return rc;
+    }
+
+    dev->flightIssued++;
+    flight = slot;
+    if (flight != NULL) {
+        flight->op = op;
+        flight->arg1 = arg1;
+        flight->arg2 = arg2;
+        flight->waiters = 0;
+        flight->isDone = 0;
+        (void)wc_LockMutex(&flight->done);
+    }
+    wc_UnLockMutex(&dev->flightLock);
+
+    rc = wolfTPM2_FlightIssue(op, in, out);
+
+    if (flight != NULL) {
+        if (wc_LockMutex(&dev->flightLock) == 0) {
+            flight->rc = rc;
+            XMEMCPY(&flight->out, out, outSz);
+            flight->isDone = 1;
+            if (flight->waiters == 0)
+                flight->op = 0;
+            wc_UnLockMutex(&dev->flightLock);
+        }
+        wc_UnLockMutex(&flight->done);
+    }
+    return rc;
+}
+
+int wolfTPM2_GetFlightStats(WOLFTPM2_DEV* dev, word32* issued,
+    word32* coalesced)
+{
+    if (dev == NULL)
+        return BAD_FUNC_ARG;
+    if (wc_LockMutex(&dev->flightLock) != 0)
+        return TPM_RC_FAILURE;
+    if (issued != NULL)
+        *issued = dev->flightIssued;
+    if (coalesced != NULL)
+        *coalesced = dev->flightCoalesced;
+    wc_UnLockMutex(&dev->flightLock);
+    return TPM_RC_SUCCESS;
+}
+#endif /* WOLFTPM_SINGLE_FLIGHT */
+
+/******************************************************************************/
+/* --- BEGIN Scratch Arena -- */
+/******************************************************************************/
+
+/* The large command structures of the key and NV wrappers are taken from
+ * the device scratch arena with WOLFTPM_SCRATCH and from the stack otherwise.
+ * A wrapper holds the arena from WOLFTPM2_SCRATCH_BEGIN to
+ * WOLFTPM2_SCRATCH_END: threads sharing the device wait on scratchLock, and
+ * everything allocated is zeroed on release so auth values and NV data do
+ * not stay in the device. The arena lock is separate from the TPM lock so
+ * other commands keep running and NV chunks still yield to priority
+ * callers. Wrappers using the arena do not nest. */
+#ifdef WOLFTPM_SCRATCH
+static int wolfTPM2_ScratchBegin(WOLFTPM2_DEV* dev)
+{
+#ifdef WOLFTPM2_SCRATCH_LOCK
+    if (wc_LockMutex(&dev->scratchLock) != 0)
+        return TPM_RC_FAILURE;
+#endif
+    dev->scratchPos = 0;
+    return TPM_RC_SUCCESS;
+}
+
+static void wolfTPM2_ScratchEnd(WOLFTPM2_DEV* dev)
+{
+    TPM2_ForceZero(dev->scratch, dev->scratchPos);
+    dev->scratchPos = 0;
+#ifdef WOLFTPM2_SCRATCH_LOCK
+    wc_UnLockMutex(&dev->scratchLock);
+#endif
+}
+
+static void* wolfTPM2_ScratchAlloc(WOLFTPM2_DEV* dev, word32 sz)
+{
+    void* ptr;
+    word32 pos = (dev->scratchPos + WOLFTPM2_SCRATCH_ALIGN - 1) &
+        ~(word32)(WOLFTPM2_SCRATCH_ALIGN - 1);
+
+    if (sz > (word32)sizeof(dev->scratch) ||
+            pos > (word32)sizeof(dev->scratch) - sz) {
+    #ifdef DEBUG_WOLFTPM
+        printf("Scratch arena exhausted: need %u, used %u of %u\n",
+            sz, dev->scratchPos, (word32)sizeof(dev->scratch));
+    #endif
+        return NULL;
+    }
+    ptr = (byte*)dev->scratch + pos;
+    dev->scratchPos = pos + sz;
+    if (dev->scratchPos > dev->scratchHigh)
+        dev->scratchHigh = dev->scratchPos;
+    return ptr;
+}
+
+#define WOLFTPM2_SCRATCH_VAR(type, var)      type* var = NULL
+#define WOLFTPM2_SCRATCH_BEGIN(dev)          wolfTPM2_ScratchBegin(dev)
+#define WOLFTPM2_SCRATCH_GET(dev, type, var) \
+    (((var) = (type*)wolfTPM2_ScratchAlloc((dev), (word32)sizeof(type))) != NULL)
+#define WOLFTPM2_SCRATCH_END(dev)            wolfTPM2_ScratchEnd(dev)
+
+int wolfTPM2_GetScratchStats(WOLFTPM2_DEV* dev, word32* size,
+    word32* highWater)
+{
+    if (dev == NULL)
+        return BAD_FUNC_ARG;
+    if (size != NULL)
+        *size = (word32)sizeof(dev->scratch);
+    if (highWater != NULL)
+        *highWater = dev->scratchHigh;
+    return TPM_RC_SUCCESS;
+}
+#else
+#define WOLFTPM2_SCRATCH_VAR(type, var)      type var##Stk; type* var = &var##Stk
+#define WOLFTPM2_SCRATCH_BEGIN(dev)          TPM_RC_SUCCESS
+#define WOLFTPM2_SCRATCH_GET(dev, type, var) 1
+#define WOLFTPM2_SCRATCH_END(dev)            (void)(dev)
+#endif /* WOLFTPM_SCRATCH */
+
+/******************************************************************************/
+/* --- END Scratch Arena -- */
+/******************************************************************************/
+
+/* Initializes the per-device locks of the optional wrapper features */
+static int wolfTPM2_InitDevLocks(WOLFTPM2_DEV* dev)
+{
+    int rc = TPM_RC_SUCCESS;
+#ifdef WOLFTPM_SINGLE_FLIGHT
+    rc = wolfTPM2_FlightInit(dev);
+#endif
+#ifdef WOLFTPM2_SCRATCH_LOCK
+    if (rc == TPM_RC_SUCCESS && wc_InitMutex(&dev->scratchLock) != 0) {
+    #ifdef WOLFTPM_SINGLE_FLIGHT
+        wolfTPM2_FlightFree(dev);
+    #endif
+        rc = TPM_RC_FAILURE;
+    }
+#endif
+    (void)dev;
+    return rc;
+}
+
+/* Run incremental self-test for the algorithms the application uses */
+static int wolfTPM2_IncrementalSelfTest(const TPML_ALG* toTest)
+{
+    int rc;
+    IncrementalSelfTest_In in;
+    IncrementalSelfTest_Out out;
+
+    if (toTest->count > MAX_ALG_LIST_SIZE)
+        return BAD_FUNC_ARG;
+
+    XMEMSET(&in, 0, sizeof(in));
+    XMEMCPY(&in.toTest, toTest, sizeof(in.toTest));
+    rc = TPM2_IncrementalSelfTest(&in, &out);
+    if (rc != TPM_RC_SUCCESS) {
+    #ifdef DEBUG_WOLFTPM
+        printf("TPM2_IncrementalSelfTest failed 0x%x: %s\n", rc,
+            TPM2_GetRCString(rc));
+    #endif
+        return rc;
+    }
+#ifdef DEBUG_WOLFTPM
+    printf("TPM2_IncrementalSelfTest pass (%d algs, %d still to test)\n",
+        (int)toTest->count, (int)out.toDoList.count);
+#endif
+    return rc;
+}
+
+/* toTest: NULL for a cold start (Startup and optional full self-test).
+ * Otherwise warm start: Startup and full self-test are skipped if the TPM is
+ * already started and only toTest algorithms are self-tested. */
 static int wolfTPM2_Init_ex(TPM2_CTX* ctx, TPM2HalIoCb ioCb, void* userCtx,
-    int timeoutTries)
+    int timeoutTries, const TPML_ALG* toTest)
 {
     int rc;
 
 #if !defined(WOLFTPM_LINUX_DEV) && !defined(WOLFTPM_WINAPI)
     Startup_In startupIn;
+    int isStarted = 0;
 #if defined(WOLFTPM_MICROCHIP) || defined(WOLFTPM_PERFORM_SELFTEST)
     SelfTest_In selfTest;
 #endif
@@ -60,7 +366,7 @@ static int wolfTPM2_Init_ex(TPM2_CTX* ctx, TPM2HalIoCb ioCb, void* userCtx,
         return BAD_FUNC_ARG;
 
 #if defined(WOLFTPM_LINUX_DEV) || defined(WOLFTPM_SWTPM) || \
-    defined(WOLFTPM_WINAPI)
+    defined(WOLFTPM_BROKER) || defined(WOLFTPM_WINAPI)
     rc = TPM2_Init_minimal(ctx);
     /* Using standard file I/O for the Linux TPM device */
     (void)ioCb;
@@ -84,40 +390,59 @@ static int wolfTPM2_Init_ex(TPM2_CTX* ctx, TPM2HalIoCb ioCb, void* userCtx,
 #endif
 
 #if !defined(WOLFTPM_LINUX_DEV) && !defined(WOLFTPM_WINAPI)
-    /* startup */
-    XMEMSET(&startupIn, 0, sizeof(Startup_In));
-    startupIn.startupType = TPM_SU_CLEAR;
-    rc = TPM2_Startup(&startupIn);
-    if (rc != TPM_RC_SUCCESS &&
-        rc != TPM_RC_INITIALIZE /* TPM_RC_INITIALIZE = Already started */ ) {
+    if (toTest != NULL) {
+        /* TPM_RC_INITIALIZE until TPM2_Startup, otherwise already started */
+        GetTestResult_Out testOut;
+        rc = TPM2_GetTestResult(&testOut);
+        isStarted = (rc == TPM_RC_SUCCESS &&
+            (testOut.testResult == TPM_RC_SUCCESS ||
+             testOut.testResult == TPM_RC_TESTING));
     #ifdef DEBUG_WOLFTPM
-        printf("TPM2_Startup failed %d: %s\n", rc, wolfTPM2_GetRCString(rc));
+        printf("TPM2 warm start: %s\n", isStarted ? "already started" : "cold");
     #endif
-        return rc;
     }
-#ifdef DEBUG_WOLFTPM
-    printf("TPM2_Startup pass\n");
-#endif
 
-#if defined(WOLFTPM_MICROCHIP) || defined(WOLFTPM_PERFORM_SELFTEST)
-    /* Do full self-test (Chips such as ATTPM20 require this before some operations) */
-    XMEMSET(&selfTest, 0, sizeof(selfTest));
-    selfTest.fullTest = YES;
-    rc = TPM2_SelfTest(&selfTest);
-    if (rc != TPM_RC_SUCCESS) {
+    if (!isStarted) {
+        /* startup */
+        XMEMSET(&startupIn, 0, sizeof(Startup_In));
+        startupIn.startupType = TPM_SU_CLEAR;
+        rc = TPM2_Startup(&startupIn);
+        if (rc != TPM_RC_SUCCESS &&
+            rc != TPM_RC_INITIALIZE /* TPM_RC_INITIALIZE = Already started */ ) {
+        #ifdef DEBUG_WOLFTPM
+            printf("TPM2_Startup failed %d: %s\n", rc, wolfTPM2_GetRCString(rc));
+        #endif
+            return rc;
+        }
     #ifdef DEBUG_WOLFTPM
-        printf("TPM2_SelfTest failed 0x%x: %s\n", rc, TPM2_GetRCString(rc));
+        printf("TPM2_Startup pass\n");
     #endif
-        return rc;
+
+    #if defined(WOLFTPM_MICROCHIP) || defined(WOLFTPM_PERFORM_SELFTEST)
+        /* Do full self-test (Chips such as ATTPM20 require this before some operations) */
+        XMEMSET(&selfTest, 0, sizeof(selfTest));
+        selfTest.fullTest = YES;
+        rc = TPM2_SelfTest(&selfTest);
+        if (rc != TPM_RC_SUCCESS) {
+        #ifdef DEBUG_WOLFTPM
+            printf("TPM2_SelfTest failed 0x%x: %s\n", rc, TPM2_GetRCString(rc));
+        #endif
+            return rc;
+        }
+    #ifdef DEBUG_WOLFTPM
+        printf("TPM2_SelfTest pass\n");
+    #endif
+        /* full test covers all algorithms */
+        toTest = NULL;
+    #endif /* WOLFTPM_MICROCHIP || WOLFTPM_PERFORM_SELFTEST */
     }
-#ifdef DEBUG_WOLFTPM
-    printf("TPM2_SelfTest pass\n");
-#endif
-#else
     rc = TPM_RC_SUCCESS;
-#endif /* WOLFTPM_MICROCHIP || WOLFTPM_PERFORM_SELFTEST */
 #endif /* !WOLFTPM_LINUX_DEV && !WOLFTPM_WINAPI */
 
+    if (toTest != NULL && toTest->count > 0) {
+        rc = wolfTPM2_IncrementalSelfTest(toTest);
+    }
+
     return rc;
 }
 
@@ -132,7 +457,7 @@ int wolfTPM2_Test(TPM2HalIoCb ioCb, void* userCtx, WOLFTPM2_CAPS* caps)
     current_ctx = TPM2_GetActiveCtx();
 
     /* Perform startup and test device */
-    rc = wolfTPM2_Init_ex(&ctx, ioCb, userCtx, TPM_STARTUP_TEST_TRIES);
+    rc = wolfTPM2_Init_ex(&ctx, ioCb, userCtx, TPM_STARTUP_TEST_TRIES, NULL);
     if (rc != TPM_RC_SUCCESS) {
         return rc;
     }
@@ -160,7 +485,40 @@ int wolfTPM2_Init(WOLFTPM2_DEV* dev, TPM2HalIoCb ioCb, void* userCtx)
 
     XMEMSET(dev, 0, sizeof(WOLFTPM2_DEV));
 
-    rc = wolfTPM2_Init_ex(&dev->ctx, ioCb, userCtx, TPM_TIMEOUT_TRIES);
+    rc = wolfTPM2_Init_ex(&dev->ctx, ioCb, userCtx, TPM_TIMEOUT_TRIES, NULL);
+    if (rc != TPM_RC_SUCCESS) {
+        return rc;
+    }
+
+    /* define the default session auth */
+    XMEMSET(dev->session, 0, sizeof(dev->session));
+    wolfTPM2_SetAuthPassword(dev, 0, NULL);
+
+    rc = wolfTPM2_InitDevLocks(dev);
+    if (rc != TPM_RC_SUCCESS) {
+        TPM2_Cleanup(&dev->ctx);
+    }
+
+    return rc;
+}
+
+int wolfTPM2_InitWarmStart(WOLFTPM2_DEV* dev, TPM2HalIoCb ioCb, void* userCtx,
+    const TPML_ALG* toTest)
+{
+    int rc;
+    TPML_ALG none;
+
+    if (dev == NULL)
+        return BAD_FUNC_ARG;
+
+    if (toTest == NULL) {
+        XMEMSET(&none, 0, sizeof(none));
+        toTest = &none;
+    }
+
+    XMEMSET(dev, 0, sizeof(WOLFTPM2_DEV));
+
+    rc = wolfTPM2_Init_ex(&dev->ctx, ioCb, userCtx, TPM_TIMEOUT_TRIES, toTest);
     if (rc != TPM_RC_SUCCESS) {
         return rc;
     }
@@ -169,6 +527,11 @@ int wolfTPM2_Init(WOLFTPM2_DEV* dev, TPM2HalIoCb ioCb, void* userCtx)
     XMEMSET(dev->session, 0, sizeof(dev->session));
     wolfTPM2_SetAuthPassword(dev, 0, NULL);
 
+    rc = wolfTPM2_InitDevLocks(dev);
+    if (rc != TPM_RC_SUCCESS) {
+        TPM2_Cleanup(&dev->ctx);
+    }
+
     return rc;
 }
 
@@ -535,7 +898,7 @@ int wolfTPM2_OpenExisting(WOLFTPM2_DEV* dev, TPM2HalIoCb ioCb, void* userCtx)
     XMEMSET(dev, 0, sizeof(WOLFTPM2_DEV));
 
     /* The 0 startup indicates use existing locality */
-    rc = wolfTPM2_Init_ex(&dev->ctx, ioCb, userCtx, 0);
+    rc = wolfTPM2_Init_ex(&dev->ctx, ioCb, userCtx, 0, NULL);
     if (rc != TPM_RC_SUCCESS) {
     #ifdef DEBUG_WOLFTPM
         printf("TPM2_Init failed %d: %s\n", rc, wolfTPM2_GetRCString(rc));
@@ -547,6 +910,11 @@ int wolfTPM2_OpenExisting(WOLFTPM2_DEV* dev, TPM2HalIoCb ioCb, void* userCtx)
     XMEMSET(dev->session, 0, sizeof(dev->session));
     wolfTPM2_SetAuthPassword(dev, 0, NULL);
 
+    rc = wolfTPM2_InitDevLocks(dev);
+    if (rc != TPM_RC_SUCCESS) {
+        TPM2_Cleanup(&dev->ctx);
+    }
+
     return rc;
 }
 
@@ -732,10 +1100,48 @@ static int wolfTPM2_GetCapabilities_NoDev(WOLFTPM2_CAPS* cap)
 
 int wolfTPM2_GetCapabilities(WOLFTPM2_DEV* dev, WOLFTPM2_CAPS* cap)
 {
-    if (dev == NULL)
+    int rc;
+    int isCached = 0;
+    word32 gen;
+
+    if (dev == NULL || cap == NULL)
         return BAD_FUNC_ARG;
 
-    return wolfTPM2_GetCapabilities_NoDev(cap);
+    /* Startup and field upgrade bump stateGen, which drops the copy */
+    gen = dev->ctx.stateGen;
+#ifdef WOLFTPM_SINGLE_FLIGHT
+    if (wc_LockMutex(&dev->flightLock) != 0)
+        return TPM_RC_FAILURE;
+#endif
+    if (dev->capsValid && dev->capsGen == gen) {
+        XMEMCPY(cap, &dev->caps, sizeof(*cap));
+        isCached = 1;
+    }
+#ifdef WOLFTPM_SINGLE_FLIGHT
+    wc_UnLockMutex(&dev->flightLock);
+#endif
+    if (isCached)
+        return TPM_RC_SUCCESS;
+
+#ifdef WOLFTPM_SINGLE_FLIGHT
+    rc = wolfTPM2_FlightRun(dev, WOLFTPM2_FLIGHT_CAPS, 0, 0, NULL, cap,
+        sizeof(*cap));
+#else
+    rc = wolfTPM2_GetCapabilities_NoDev(cap);
+#endif
+    if (rc == TPM_RC_SUCCESS) {
+    #ifdef WOLFTPM_SINGLE_FLIGHT
+        if (wc_LockMutex(&dev->flightLock) != 0)
+            return rc;
+    #endif
+        XMEMCPY(&dev->caps, cap, sizeof(*cap));
+        dev->capsGen = gen;
+        dev->capsValid = 1;
+    #ifdef WOLFTPM_SINGLE_FLIGHT
+        wc_UnLockMutex(&dev->flightLock);
+    #endif
+    }
+    return rc;
 }
 
 int wolfTPM2_UnsetAuth(WOLFTPM2_DEV* dev, int index)
@@ -893,6 +1299,7 @@ int wolfTPM2_SetAuthSession(WOLFTPM2_DEV* dev, int index,
     return rc;
 }
 
+#ifndef WOLFTPM2_NO_POLICY
 int wolfTPM2_CreateAuthSession_EkPolicy(WOLFTPM2_DEV* dev,
                                         WOLFTPM2_SESSION* tpmSession)
 {
@@ -921,6 +1328,7 @@ int wolfTPM2_CreateAuthSession_EkPolicy(WOLFTPM2_DEV* dev,
     }
     return rc;
 }
+#endif /* !WOLFTPM2_NO_POLICY */
 
 int wolfTPM2_Cleanup_ex(WOLFTPM2_DEV* dev, int doShutdown)
 {
@@ -937,6 +1345,11 @@ int wolfTPM2_Cleanup_ex(WOLFTPM2_DEV* dev, int doShutdown)
         return rc;
 #endif
 
+#ifdef WOLFTPM_KEY_CACHE
+    /* release TPM object slots held by idle cached keys */
+    (void)wolfTPM2_KeyCacheFlush(dev);
+#endif
+
     if (doShutdown)  {
         Shutdown_In shutdownIn;
         XMEMSET(&shutdownIn, 0, sizeof(shutdownIn));
@@ -951,6 +1364,14 @@ int wolfTPM2_Cleanup_ex(WOLFTPM2_DEV* dev, int doShutdown)
         }
     }
 
+#ifdef WOLFTPM_SINGLE_FLIGHT
+    wolfTPM2_FlightFree(dev);
+#endif
+#ifdef WOLFTPM2_SCRATCH_LOCK
+    wc_FreeMutex(&dev->scratchLock);
+#endif
+    dev->pubCache = NULL;
+
     TPM2_Cleanup(&dev->ctx);
 
     return rc;
@@ -1469,56 +1890,76 @@ int wolfTPM2_CreatePrimaryKey(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* key,
     const byte* auth, int authSz)
 {
     int rc;
-    CreatePrimary_In  createPriIn;
-    CreatePrimary_Out createPriOut;
+    WOLFTPM2_SCRATCH_VAR(CreatePrimary_In,  createPriIn);
+    WOLFTPM2_SCRATCH_VAR(CreatePrimary_Out, createPriOut);
 
     if (dev == NULL || key == NULL || publicTemplate == NULL)
         return BAD_FUNC_ARG;
 
+    rc = WOLFTPM2_SCRATCH_BEGIN(dev);
+    if (rc != TPM_RC_SUCCESS)
+        return rc;
+    if (!WOLFTPM2_SCRATCH_GET(dev, CreatePrimary_In, createPriIn) ||
+        !WOLFTPM2_SCRATCH_GET(dev, CreatePrimary_Out, createPriOut)) {
+        WOLFTPM2_SCRATCH_END(dev);
+        return MEMORY_E;
+    }
+
     /* set session auth to blank */
     wolfTPM2_SetAuthPassword(dev, 0, NULL);
 
     /* clear output key buffer */
     XMEMSET(key, 0, sizeof(WOLFTPM2_KEY));
 
-    /* setup create primary command */
-    XMEMSET(&createPriIn, 0, sizeof(createPriIn));
+    /* setup create primary command, only the fields marshaled are set */
     /* TPM_RH_OWNER, TPM_RH_ENDORSEMENT, TPM_RH_PLATFORM or TPM_RH_NULL */
-    createPriIn.primaryHandle = primaryHandle;
+    createPriIn->primaryHandle = primaryHandle;
+    createPriIn->inSensitive.size = 0;
+    createPriIn->inSensitive.sensitive.userAuth.size = 0;
+    createPriIn->inSensitive.sensitive.data.size = 0;
+    createPriIn->outsideInfo.size = 0;
+    createPriIn->creationPCR.count = 0;
     if (auth && authSz > 0) {
         int nameAlgDigestSz = TPM2_GetHashDigestSize(publicTemplate->nameAlg);
         /* truncate if longer than name size */
         if (nameAlgDigestSz > 0 && authSz > nameAlgDigestSz)
             authSz = nameAlgDigestSz;
-        XMEMCPY(createPriIn.inSensitive.sensitive.userAuth.buffer, auth, authSz);
+        XMEMCPY(createPriIn->inSensitive.sensitive.userAuth.buffer, auth,
+            authSz);
         /* make sure auth is same size as nameAlg digest size */
-        if (nameAlgDigestSz > 0 && authSz < nameAlgDigestSz)
+        if (nameAlgDigestSz > 0 && authSz < nameAlgDigestSz) {
+            XMEMSET(&createPriIn->inSensitive.sensitive.userAuth.buffer[authSz],
+                0, nameAlgDigestSz - authSz);
             authSz = nameAlgDigestSz;
-        createPriIn.inSensitive.sensitive.userAuth.size = authSz;
+        }
+        createPriIn->inSensitive.sensitive.userAuth.size = authSz;
     }
-    XMEMCPY(&createPriIn.inPublic.publicArea, publicTemplate,
+    createPriIn->inPublic.size = 0;
+    XMEMCPY(&createPriIn->inPublic.publicArea, publicTemplate,
         sizeof(TPMT_PUBLIC));
-    rc = TPM2_CreatePrimary(&createPriIn, &createPriOut);
+    rc = TPM2_CreatePrimary(createPriIn, createPriOut);
     if (rc != TPM_RC_SUCCESS) {
     #ifdef DEBUG_WOLFTPM
         printf("TPM2_CreatePrimary: failed %d: %s\n", rc,
             wolfTPM2_GetRCString(rc));
     #endif
+        WOLFTPM2_SCRATCH_END(dev);
         return rc;
     }
-    key->handle.hndl = createPriOut.objectHandle;
+    key->handle.hndl = createPriOut->objectHandle;
     wolfTPM2_CopyAuth(&key->handle.auth,
-        &createPriIn.inSensitive.sensitive.userAuth);
-    wolfTPM2_CopyName(&key->handle.name, &createPriOut.name);
+        &createPriIn->inSensitive.sensitive.userAuth);
+    wolfTPM2_CopyName(&key->handle.name, &createPriOut->name);
     wolfTPM2_CopySymmetric(&key->handle.symmetric,
-        &createPriOut.outPublic.publicArea.parameters.asymDetail.symmetric);
-    wolfTPM2_CopyPub(&key->pub, &createPriOut.outPublic);
+        &createPriOut->outPublic.publicArea.parameters.asymDetail.symmetric);
+    wolfTPM2_CopyPub(&key->pub, &createPriOut->outPublic);
 
 #ifdef DEBUG_WOLFTPM
     printf("TPM2_CreatePrimary: 0x%x (%d bytes)\n",
         (word32)key->handle.hndl, key->pub.size);
 #endif
 
+    WOLFTPM2_SCRATCH_END(dev);
     return rc;
 }
 
@@ -1591,102 +2032,302 @@ int wolfTPM2_CreateKey(WOLFTPM2_DEV* dev, WOLFTPM2_KEYBLOB* keyBlob,
     const byte* auth, int authSz)
 {
     int rc;
-    Create_In  createIn;
-    Create_Out createOut;
+    WOLFTPM2_SCRATCH_VAR(Create_In,  createIn);
+    WOLFTPM2_SCRATCH_VAR(Create_Out, createOut);
 
     if (dev == NULL || keyBlob == NULL || parent == NULL ||
             publicTemplate == NULL) {
         return BAD_FUNC_ARG;
     }
 
+    rc = WOLFTPM2_SCRATCH_BEGIN(dev);
+    if (rc != TPM_RC_SUCCESS)
+        return rc;
+    if (!WOLFTPM2_SCRATCH_GET(dev, Create_In, createIn) ||
+        !WOLFTPM2_SCRATCH_GET(dev, Create_Out, createOut)) {
+        WOLFTPM2_SCRATCH_END(dev);
+        return MEMORY_E;
+    }
+
     /* clear output key buffer */
     XMEMSET(keyBlob, 0, sizeof(WOLFTPM2_KEYBLOB));
-    XMEMSET(&createOut, 0, sizeof(createOut)); /* make sure pub struct is zero init */
+    /* make sure pub struct is zero init */
+    XMEMSET(&createOut->outPublic, 0, sizeof(createOut->outPublic));
 
     /* set session auth for parent key */
     wolfTPM2_SetAuthHandle(dev, 0, parent);
 
-    XMEMSET(&createIn, 0, sizeof(createIn));
-    createIn.parentHandle = parent->hndl;
+    /* only the fields marshaled are set */
+    createIn->parentHandle = parent->hndl;
+    createIn->inSensitive.size = 0;
+    createIn->inSensitive.sensitive.userAuth.size = 0;
+    createIn->inSensitive.sensitive.data.size = 0;
     if (auth) {
-        createIn.inSensitive.sensitive.userAuth.size = authSz;
-        XMEMCPY(createIn.inSensitive.sensitive.userAuth.buffer, auth,
-            createIn.inSensitive.sensitive.userAuth.size);
+        if (authSz > (int)sizeof(createIn->inSensitive.sensitive.userAuth.buffer))
+            authSz = (int)sizeof(createIn->inSensitive.sensitive.userAuth.buffer);
+        createIn->inSensitive.sensitive.userAuth.size = authSz;
+        XMEMCPY(createIn->inSensitive.sensitive.userAuth.buffer, auth,
+            createIn->inSensitive.sensitive.userAuth.size);
     }
-    XMEMCPY(&createIn.inPublic.publicArea, publicTemplate, sizeof(TPMT_PUBLIC));
+    createIn->inPublic.size = 0;
+    XMEMCPY(&createIn->inPublic.publicArea, publicTemplate, sizeof(TPMT_PUBLIC));
+    createIn->outsideInfo.size = 0;
+    createIn->creationPCR.count = 0;
 
 #if 0
     /* Optional creation nonce */
-    createIn.outsideInfo.size = createNoneSz;
-    XMEMCPY(createIn.outsideInfo.buffer, createNonce, createIn.outsideInfo.size);
+    createIn->outsideInfo.size = createNoneSz;
+    XMEMCPY(createIn->outsideInfo.buffer, createNonce, createIn->outsideInfo.size);
 #endif
 
-    rc = TPM2_Create(&createIn, &createOut);
+    rc = TPM2_Create(createIn, createOut);
     if (rc != TPM_RC_SUCCESS) {
     #ifdef DEBUG_WOLFTPM
         printf("TPM2_Create key failed %d: %s\n", rc, wolfTPM2_GetRCString(rc));
     #endif
+        WOLFTPM2_SCRATCH_END(dev);
         return rc;
     }
 
 #ifdef DEBUG_WOLFTPM
     printf("TPM2_Create key: pub %d, priv %d\n",
-        createOut.outPublic.size, createOut.outPrivate.size);
-    TPM2_PrintPublicArea(&createOut.outPublic);
+        createOut->outPublic.size, createOut->outPrivate.size);
+    TPM2_PrintPublicArea(&createOut->outPublic);
 #endif
 
     wolfTPM2_CopyAuth(&keyBlob->handle.auth,
-        &createIn.inSensitive.sensitive.userAuth);
+        &createIn->inSensitive.sensitive.userAuth);
     wolfTPM2_CopySymmetric(&keyBlob->handle.symmetric,
-            &createOut.outPublic.publicArea.parameters.asymDetail.symmetric);
-    wolfTPM2_CopyPub(&keyBlob->pub, &createOut.outPublic);
-    wolfTPM2_CopyPriv(&keyBlob->priv, &createOut.outPrivate);
+            &createOut->outPublic.publicArea.parameters.asymDetail.symmetric);
+    wolfTPM2_CopyPub(&keyBlob->pub, &createOut->outPublic);
+    wolfTPM2_CopyPriv(&keyBlob->priv, &createOut->outPrivate);
 
+    WOLFTPM2_SCRATCH_END(dev);
     return rc;
 }
 
-int wolfTPM2_LoadKey(WOLFTPM2_DEV* dev, WOLFTPM2_KEYBLOB* keyBlob,
-    WOLFTPM2_HANDLE* parent)
+#ifdef WOLFTPM_KEY_CACHE
+/* Digest identifying a key blob loaded under a specific parent. The parent
+ * auth is included so a hit requires the same auth a TPM2_Load would */
+static int wolfTPM2_KeyCacheDigest(WOLFTPM2_KEYBLOB* keyBlob,
+    const WOLFTPM2_HANDLE* parent, byte* digest)
 {
     int rc;
-    Load_In loadIn;
-    Load_Out loadOut;
-
-    if (dev == NULL || keyBlob == NULL || parent == NULL)
-        return BAD_FUNC_ARG;
-
-    /* set session auth for parent key */
-    wolfTPM2_SetAuthHandle(dev, 0, parent);
+    wc_HashAlg hash;
+    byte buf[sizeof(TPM2B_PUBLIC)];
+    int bufSz = 0;
 
-    /* Load new key */
-    XMEMSET(&loadIn, 0, sizeof(loadIn));
-    loadIn.parentHandle = parent->hndl;
-    wolfTPM2_CopyPriv(&loadIn.inPrivate, &keyBlob->priv);
-    wolfTPM2_CopyPub(&loadIn.inPublic, &keyBlob->pub);
-    rc = TPM2_Load(&loadIn, &loadOut);
-    if (rc != TPM_RC_SUCCESS) {
-    #ifdef DEBUG_WOLFTPM
-        printf("TPM2_Load key failed %d: %s\n", rc, wolfTPM2_GetRCString(rc));
-    #endif
+    rc = TPM2_AppendPublic(buf, (word32)sizeof(buf), &bufSz, &keyBlob->pub);
+    if (rc != TPM_RC_SUCCESS)
         return rc;
-    }
-    keyBlob->handle.hndl = loadOut.objectHandle;
-    wolfTPM2_CopyName(&keyBlob->handle.name, &loadOut.name);
-
-#ifdef DEBUG_WOLFTPM
-    printf("TPM2_Load Key Handle 0x%x\n", (word32)keyBlob->handle.hndl);
-#endif
 
+    rc = wc_HashInit(&hash, WC_HASH_TYPE_SHA256);
+    if (rc == 0) {
+        TPM2_Packet_U32ToByteArray(parent->hndl, digest);
+        rc = wc_HashUpdate(&hash, WC_HASH_TYPE_SHA256, digest, sizeof(UINT32));
+        if (rc == 0) {
+            rc = wc_HashUpdate(&hash, WC_HASH_TYPE_SHA256, parent->name.name,
+                parent->name.size);
+        }
+        if (rc == 0) {
+            rc = wc_HashUpdate(&hash, WC_HASH_TYPE_SHA256, parent->auth.buffer,
+                parent->auth.size);
+        }
+        if (rc == 0) {
+            rc = wc_HashUpdate(&hash, WC_HASH_TYPE_SHA256, buf, (word32)bufSz);
+        }
+        if (rc == 0) {
+            rc = wc_HashUpdate(&hash, WC_HASH_TYPE_SHA256, keyBlob->priv.buffer,
+                keyBlob->priv.size);
+        }
+        if (rc == 0) {
+            rc = wc_HashFinal(&hash, WC_HASH_TYPE_SHA256, digest);
+        }
+        wc_HashFree(&hash, WC_HASH_TYPE_SHA256);
+    }
     return rc;
 }
 
-int wolfTPM2_CreateAndLoadKey(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* key,
-    WOLFTPM2_HANDLE* parent, TPMT_PUBLIC* publicTemplate,
-    const byte* auth, int authSz)
+static WOLFTPM2_KEY_CACHE_ENTRY* wolfTPM2_KeyCacheFind(WOLFTPM2_DEV* dev,
+    const byte* digest, TPM_HANDLE hndl)
 {
-    int rc;
-    WOLFTPM2_KEYBLOB keyBlob;
-
+    int i;
+    for (i = 0; i < WOLFTPM2_KEY_CACHE_NUM; i++) {
+        WOLFTPM2_KEY_CACHE_ENTRY* entry = &dev->keyCache[i];
+        if (entry->hndl == 0)
+            continue;
+        if ((digest != NULL && XMEMCMP(entry->digest, digest,
+                                       WOLFTPM2_KEY_CACHE_DIGEST_SZ) == 0) ||
+            (digest == NULL && entry->hndl == hndl)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/* Flush the least recently used idle key. Returns 0 if one was evicted */
+static int wolfTPM2_KeyCacheEvict(WOLFTPM2_DEV* dev)
+{
+    int rc;
+    int i;
+    WOLFTPM2_KEY_CACHE_ENTRY* lru = NULL;
+    FlushContext_In in;
+
+    for (i = 0; i < WOLFTPM2_KEY_CACHE_NUM; i++) {
+        WOLFTPM2_KEY_CACHE_ENTRY* entry = &dev->keyCache[i];
+        if (entry->hndl != 0 && entry->refCount == 0 &&
+                (lru == NULL || entry->lastUse < lru->lastUse)) {
+            lru = entry;
+        }
+    }
+    if (lru == NULL)
+        return TPM_RC_OBJECT_MEMORY;
+
+    XMEMSET(&in, 0, sizeof(in));
+    in.flushHandle = lru->hndl;
+    rc = TPM2_FlushContext(&in);
+#ifdef DEBUG_WOLFTPM
+    printf("Key cache: evict handle 0x%x (rc %d)\n", (word32)lru->hndl, rc);
+#endif
+    /* drop the entry even if flush failed, the handle is no longer trusted */
+    XMEMSET(lru, 0, sizeof(*lru));
+    return rc;
+}
+
+/* Free slot for a newly loaded key, evicting an idle key if the cache is full.
+ * Returns NULL when every slot is referenced */
+static WOLFTPM2_KEY_CACHE_ENTRY* wolfTPM2_KeyCacheSlot(WOLFTPM2_DEV* dev)
+{
+    int i, tries;
+    for (tries = 0; tries < 2; tries++) {
+        for (i = 0; i < WOLFTPM2_KEY_CACHE_NUM; i++) {
+            if (dev->keyCache[i].hndl == 0)
+                return &dev->keyCache[i];
+        }
+        if (wolfTPM2_KeyCacheEvict(dev) == TPM_RC_OBJECT_MEMORY)
+            break;
+    }
+    return NULL;
+}
+
+int wolfTPM2_KeyCacheFlush(WOLFTPM2_DEV* dev)
+{
+    int rc = TPM_RC_SUCCESS, evictRc;
+
+    if (dev == NULL)
+        return BAD_FUNC_ARG;
+
+    /* evict until no idle keys remain */
+    while ((evictRc = wolfTPM2_KeyCacheEvict(dev)) != TPM_RC_OBJECT_MEMORY) {
+        if (rc == TPM_RC_SUCCESS)
+            rc = evictRc;
+    }
+    return rc;
+}
+#endif /* WOLFTPM_KEY_CACHE */
+
+int wolfTPM2_LoadKey(WOLFTPM2_DEV* dev, WOLFTPM2_KEYBLOB* keyBlob,
+    WOLFTPM2_HANDLE* parent)
+{
+    int rc;
+    WOLFTPM2_SCRATCH_VAR(Load_In, loadIn);
+    Load_Out loadOut;
+#ifdef WOLFTPM_KEY_CACHE
+    byte digest[WOLFTPM2_KEY_CACHE_DIGEST_SZ];
+    WOLFTPM2_KEY_CACHE_ENTRY* entry = NULL;
+    int useCache = 1;
+#endif
+
+    if (dev == NULL || keyBlob == NULL || parent == NULL)
+        return BAD_FUNC_ARG;
+
+#ifdef WOLFTPM_KEY_CACHE
+    /* a policy on the parent can only be satisfied by the TPM */
+    if (parent->policyAuth ||
+            TPM2_IS_POLICY_SESSION(dev->session[0].sessionHandle)) {
+        useCache = 0;
+    }
+    if (useCache) {
+        rc = wolfTPM2_KeyCacheDigest(keyBlob, parent, digest);
+        if (rc != 0)
+            return rc;
+        entry = wolfTPM2_KeyCacheFind(dev, digest, 0);
+    }
+    if (entry != NULL) {
+        entry->refCount++;
+        entry->lastUse = ++dev->keyCacheTick;
+        keyBlob->handle.hndl = entry->hndl;
+        wolfTPM2_CopyName(&keyBlob->handle.name, &entry->name);
+    #ifdef DEBUG_WOLFTPM
+        printf("TPM2_Load Key Handle 0x%x (cached, refs %d)\n",
+            (word32)entry->hndl, entry->refCount);
+    #endif
+        return TPM_RC_SUCCESS;
+    }
+
+    if (useCache)
+        entry = wolfTPM2_KeyCacheSlot(dev);
+    /* if all slots are referenced the key is loaded without caching */
+#endif
+
+    /* set session auth for parent key */
+    wolfTPM2_SetAuthHandle(dev, 0, parent);
+
+    rc = WOLFTPM2_SCRATCH_BEGIN(dev);
+    if (rc != TPM_RC_SUCCESS)
+        return rc;
+    if (!WOLFTPM2_SCRATCH_GET(dev, Load_In, loadIn)) {
+        WOLFTPM2_SCRATCH_END(dev);
+        return MEMORY_E;
+    }
+
+    /* Load new key, the copies set every field marshaled */
+    loadIn->parentHandle = parent->hndl;
+    wolfTPM2_CopyPriv(&loadIn->inPrivate, &keyBlob->priv);
+    wolfTPM2_CopyPub(&loadIn->inPublic, &keyBlob->pub);
+    rc = TPM2_Load(loadIn, &loadOut);
+#ifdef WOLFTPM_KEY_CACHE
+    /* out of object slots: evict idle cached keys and retry */
+    while (rc == TPM_RC_OBJECT_MEMORY &&
+            wolfTPM2_KeyCacheEvict(dev) == TPM_RC_SUCCESS) {
+        wolfTPM2_SetAuthHandle(dev, 0, parent);
+        rc = TPM2_Load(loadIn, &loadOut);
+    }
+#endif
+    WOLFTPM2_SCRATCH_END(dev);
+    if (rc != TPM_RC_SUCCESS) {
+    #ifdef DEBUG_WOLFTPM
+        printf("TPM2_Load key failed %d: %s\n", rc, wolfTPM2_GetRCString(rc));
+    #endif
+        return rc;
+    }
+    keyBlob->handle.hndl = loadOut.objectHandle;
+    wolfTPM2_CopyName(&keyBlob->handle.name, &loadOut.name);
+
+#ifdef WOLFTPM_KEY_CACHE
+    if (entry != NULL) {
+        entry->hndl = loadOut.objectHandle;
+        wolfTPM2_CopyName(&entry->name, &loadOut.name);
+        entry->refCount = 1;
+        entry->lastUse = ++dev->keyCacheTick;
+        XMEMCPY(entry->digest, digest, sizeof(digest));
+    }
+#endif
+
+#ifdef DEBUG_WOLFTPM
+    printf("TPM2_Load Key Handle 0x%x\n", (word32)keyBlob->handle.hndl);
+#endif
+
+    return rc;
+}
+
+int wolfTPM2_CreateAndLoadKey(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* key,
+    WOLFTPM2_HANDLE* parent, TPMT_PUBLIC* publicTemplate,
+    const byte* auth, int authSz)
+{
+    int rc;
+    WOLFTPM2_KEYBLOB keyBlob;
+
     if (dev == NULL || key == NULL)
         return BAD_FUNC_ARG;
 
@@ -2035,6 +2676,7 @@ int wolfTPM2_SensitiveToPrivate(TPM2B_SENSITIVE* sens, TPM2B_PRIVATE* priv,
         symSeed, 0);
 }
 
+#ifndef WOLFTPM2_NO_IMPORT
 /* Import external private key */
 int wolfTPM2_ImportPrivateKey(WOLFTPM2_DEV* dev, const WOLFTPM2_KEY* parentKey,
     WOLFTPM2_KEYBLOB* keyBlob, const TPM2B_PUBLIC* pub, TPM2B_SENSITIVE* sens)
@@ -2150,6 +2792,7 @@ int wolfTPM2_LoadPrivateKey(WOLFTPM2_DEV* dev, const WOLFTPM2_KEY* parentKey,
 
     return rc;
 }
+#endif /* !WOLFTPM2_NO_IMPORT */
 
 int wolfTPM2_LoadRsaPublicKey_ex(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* key,
     const byte* rsaPub, word32 rsaPubSz, word32 exponent,
@@ -2201,6 +2844,7 @@ int wolfTPM2_LoadRsaPublicKey(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* key,
         TPM_ALG_NULL, TPM_ALG_NULL);
 }
 
+#ifndef WOLFTPM2_NO_IMPORT
 int wolfTPM2_ImportRsaPrivateKeySeed(WOLFTPM2_DEV* dev,
     const WOLFTPM2_KEY* parentKey, WOLFTPM2_KEYBLOB* keyBlob, const byte* rsaPub,
     word32 rsaPubSz, word32 exponent, const byte* rsaPriv, word32 rsaPrivSz,
@@ -2320,6 +2964,7 @@ int wolfTPM2_LoadRsaPrivateKey(WOLFTPM2_DEV* dev, const WOLFTPM2_KEY* parentKey,
     return wolfTPM2_LoadRsaPrivateKey_ex(dev, parentKey, key, rsaPub, rsaPubSz,
         exponent, rsaPriv, rsaPrivSz, TPM_ALG_NULL, TPM_ALG_NULL);
 }
+#endif /* !WOLFTPM2_NO_IMPORT */
 
 int wolfTPM2_LoadEccPublicKey(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* key, int curveId,
     const byte* eccPubX, word32 eccPubXSz, const byte* eccPubY, word32 eccPubYSz)
@@ -2352,6 +2997,7 @@ int wolfTPM2_LoadEccPublicKey(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* key, int curveId,
     return wolfTPM2_LoadPublicKey(dev, key, &pub);
 }
 
+#ifndef WOLFTPM2_NO_IMPORT
 int wolfTPM2_ImportEccPrivateKeySeed(WOLFTPM2_DEV* dev, const WOLFTPM2_KEY* parentKey,
     WOLFTPM2_KEYBLOB* keyBlob, int curveId,
     const byte* eccPubX, word32 eccPubXSz,
@@ -2465,6 +3111,7 @@ int wolfTPM2_LoadEccPrivateKey(WOLFTPM2_DEV* dev, const WOLFTPM2_KEY* parentKey,
 
     return rc;
 }
+#endif /* !WOLFTPM2_NO_IMPORT */
 
 int wolfTPM2_ReadPublicKey(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* key,
     const TPM_HANDLE handle)
@@ -2479,7 +3126,12 @@ int wolfTPM2_ReadPublicKey(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* key,
     /* Read public key */
     XMEMSET(&readPubIn, 0, sizeof(readPubIn));
     readPubIn.objectHandle = handle;
+#ifdef WOLFTPM_SINGLE_FLIGHT
+    rc = wolfTPM2_FlightRun(dev, WOLFTPM2_FLIGHT_READ_PUBLIC, handle, 0,
+        &readPubIn, &readPubOut, sizeof(readPubOut));
+#else
     rc = TPM2_ReadPublic(&readPubIn, &readPubOut);
+#endif
     if (rc != TPM_RC_SUCCESS) {
     #ifdef DEBUG_WOLFTPM
         printf("TPM2_ReadPublic failed %d: %s\n", rc, wolfTPM2_GetRCString(rc));
@@ -2764,6 +3416,7 @@ int wolfTPM2_ImportPublicKeyBuffer(WOLFTPM2_DEV* dev, int keyType,
     return rc;
 }
 
+#ifndef WOLFTPM2_NO_IMPORT
 int wolfTPM2_ImportPrivateKeyBuffer(WOLFTPM2_DEV* dev,
     const WOLFTPM2_KEY* parentKey, int keyType, WOLFTPM2_KEYBLOB* keyBlob,
     int encodingType, const char* input, word32 inSz, const char* pass,
@@ -2864,9 +3517,11 @@ int wolfTPM2_ImportPrivateKeyBuffer(WOLFTPM2_DEV* dev,
 
     return rc;
 }
+#endif /* !WOLFTPM2_NO_IMPORT */
 #endif /* !NO_ASN */
 
 #ifndef NO_RSA
+#ifndef WOLFTPM2_NO_IMPORT
 #ifndef NO_ASN
 int wolfTPM2_RsaPrivateKeyImportDer(WOLFTPM2_DEV* dev,
     const WOLFTPM2_KEY* parentKey, WOLFTPM2_KEYBLOB* keyBlob, const byte* input,
@@ -2929,6 +3584,7 @@ int wolfTPM2_RsaPrivateKeyImportPem(WOLFTPM2_DEV* dev,
 }
 
 #endif /* !WOLFTPM2_NO_HEAP && WOLFSSL_PEM_TO_DER */
+#endif /* !WOLFTPM2_NO_IMPORT */
 
 
 int wolfTPM2_RsaKey_TpmToWolf(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* tpmKey,
@@ -3262,6 +3918,30 @@ int wolfTPM2_EccKey_WolfToPubPoint(WOLFTPM2_DEV* dev, ecc_key* wolfKey,
 #endif /* !WOLFTPM2_NO_WOLFCRYPT */
 
 
+/* Drop the public cache entry of a persistent handle that was evicted or
+ * replaced, so the next read goes to the TPM */
+static void wolfTPM2_PubCacheDrop(WOLFTPM2_DEV* dev, TPM_HANDLE handle)
+{
+    WOLFTPM2_PUBCACHE* cache = dev->pubCache;
+    word32 i;
+
+    if (cache == NULL)
+        return;
+    for (i = 0; i < cache->count; i++) {
+        if (cache->entry[i].hndl == handle) {
+            cache->count--;
+            if (i != cache->count) {
+                XMEMCPY(&cache->entry[i], &cache->entry[cache->count],
+                    sizeof(WOLFTPM2_PUBCACHE_ENTRY));
+            }
+            XMEMSET(&cache->entry[cache->count], 0,
+                sizeof(WOLFTPM2_PUBCACHE_ENTRY));
+            cache->isDirty = 1;
+            break;
+        }
+    }
+}
+
 /* primaryHandle must be owner or platform hierarchy */
 /* Owner    Persistent Handle Range: 0x81000000 to 0x817FFFFF */
 /* Platform Persistent Handle Range: 0x81800000 to 0x81FFFFFF */
@@ -3327,6 +4007,7 @@ int wolfTPM2_NVStoreKey(WOLFTPM2_DEV* dev, TPM_HANDLE primaryHandle,
 
     /* replace handle with persistent one */
     key->handle.hndl = persistentHandle;
+    wolfTPM2_PubCacheDrop(dev, persistentHandle);
 
     return rc;
 }
@@ -3366,6 +4047,8 @@ int wolfTPM2_NVDeleteKey(WOLFTPM2_DEV* dev, TPM_HANDLE primaryHandle,
         (word32)in.auth, (word32)in.objectHandle, (word32)in.persistentHandle);
 #endif
 
+    wolfTPM2_PubCacheDrop(dev, in.persistentHandle);
+
     /* indicate no handle */
     key->handle.hndl = TPM_RH_NULL;
 
@@ -3374,9 +4057,11 @@ int wolfTPM2_NVDeleteKey(WOLFTPM2_DEV* dev, TPM_HANDLE primaryHandle,
 
 /* sigAlg: TPM_ALG_RSASSA, TPM_ALG_RSAPSS, TPM_ALG_ECDSA or TPM_ALG_ECDAA */
 /* hashAlg: TPM_ALG_SHA1, TPM_ALG_SHA256, TPM_ALG_SHA384 or TPM_ALG_SHA512 */
-int wolfTPM2_SignHashScheme(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* key,
+/* validation: optional hashcheck ticket (required for restricted keys) */
+int wolfTPM2_SignHashTicket(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* key,
     const byte* digest, int digestSz, byte* sig, int* sigSz,
-    TPMI_ALG_SIG_SCHEME sigAlg, TPMI_ALG_HASH hashAlg)
+    TPMI_ALG_SIG_SCHEME sigAlg, TPMI_ALG_HASH hashAlg,
+    const TPMT_TK_HASHCHECK* validation)
 {
     int rc;
     Sign_In  signIn;
@@ -3407,8 +4092,13 @@ int wolfTPM2_SignHashScheme(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* key,
     XMEMCPY(signIn.digest.buffer, digest, signIn.digest.size);
     signIn.inScheme.scheme = sigAlg;
     signIn.inScheme.details.any.hashAlg = hashAlg;
-    signIn.validation.tag = TPM_ST_HASHCHECK;
-    signIn.validation.hierarchy = TPM_RH_NULL;
+    if (validation != NULL) {
+        XMEMCPY(&signIn.validation, validation, sizeof(signIn.validation));
+    }
+    else {
+        signIn.validation.tag = TPM_ST_HASHCHECK;
+        signIn.validation.hierarchy = TPM_RH_NULL;
+    }
     rc = TPM2_Sign(&signIn, &signOut);
     if (rc != TPM_RC_SUCCESS) {
     #ifdef DEBUG_WOLFTPM
@@ -3457,6 +4147,16 @@ int wolfTPM2_SignHashScheme(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* key,
     return rc;
 }
 
+/* sigAlg: TPM_ALG_RSASSA, TPM_ALG_RSAPSS, TPM_ALG_ECDSA or TPM_ALG_ECDAA */
+/* hashAlg: TPM_ALG_SHA1, TPM_ALG_SHA256, TPM_ALG_SHA384 or TPM_ALG_SHA512 */
+int wolfTPM2_SignHashScheme(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* key,
+    const byte* digest, int digestSz, byte* sig, int* sigSz,
+    TPMI_ALG_SIG_SCHEME sigAlg, TPMI_ALG_HASH hashAlg)
+{
+    return wolfTPM2_SignHashTicket(dev, key, digest, digestSz, sig, sigSz,
+        sigAlg, hashAlg, NULL);
+}
+
 int wolfTPM2_SignHash(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* key,
     const byte* digest, int digestSz, byte* sig, int* sigSz)
 {
@@ -3482,6 +4182,115 @@ int wolfTPM2_SignHash(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* key,
 
 }
 
+int wolfTPM2_SignHashBatch(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* key,
+    const byte* digests, int digestSz, int count, byte* sigs, int sigSz,
+    TPMI_ALG_SIG_SCHEME sigAlg, TPMI_ALG_HASH hashAlg, int* signedCount)
+{
+    int rc = TPM_RC_SUCCESS;
+    int i, partSz, keySigSz;
+    Sign_In  signIn;
+    Sign_Out signOut;
+    TPM2_PREPARED prep;
+    TPMS_SIGNATURE_ECC* ecc;
+    byte* sig;
+
+    if (signedCount != NULL)
+        *signedCount = 0;
+    if (dev == NULL || key == NULL || digests == NULL || sigs == NULL ||
+            count < 0 || digestSz <= 0 ||
+            digestSz > (int)sizeof(signIn.digest.buffer)) {
+        return BAD_FUNC_ARG;
+    }
+
+    /* fixed signature size for the output stride */
+    if (key->pub.publicArea.type == TPM_ALG_ECC) {
+        if (sigAlg == TPM_ALG_NULL)
+            sigAlg = key->pub.publicArea.parameters.eccDetail.scheme.scheme;
+        partSz = wolfTPM2_GetCurveSize(
+            key->pub.publicArea.parameters.eccDetail.curveID);
+        if (partSz <= 0)
+            return BAD_FUNC_ARG;
+        keySigSz = partSz * 2;
+    }
+    else if (key->pub.publicArea.type == TPM_ALG_RSA) {
+        if (sigAlg == TPM_ALG_NULL)
+            sigAlg = key->pub.publicArea.parameters.rsaDetail.scheme.scheme;
+        partSz = key->pub.publicArea.parameters.rsaDetail.keyBits / 8;
+        keySigSz = partSz;
+    }
+    else {
+        return BAD_FUNC_ARG;
+    }
+    if (sigSz < keySigSz)
+        return BUFFER_E;
+    /* the TPM rejects a NULL scheme, use the default for the key type */
+    if (sigAlg == TPM_ALG_NULL) {
+        sigAlg = (key->pub.publicArea.type == TPM_ALG_ECC) ?
+            TPM_ALG_ECDSA : TPM_ALG_RSASSA;
+    }
+    if (hashAlg == TPM_ALG_NULL)
+        hashAlg = WOLFTPM2_WRAP_DIGEST;
+
+    /* set session auth for key once for the batch */
+    wolfTPM2_SetAuthHandle(dev, 0, &key->handle);
+
+    XMEMSET(&signIn, 0, sizeof(signIn));
+    signIn.keyHandle = key->handle.hndl;
+    signIn.digest.size = digestSz;
+    signIn.inScheme.scheme = sigAlg;
+    signIn.inScheme.details.any.hashAlg = hashAlg;
+    signIn.validation.tag = TPM_ST_HASHCHECK;
+    signIn.validation.hierarchy = TPM_RH_NULL;
+    /* marshal once, then only the digest is replaced */
+    rc = TPM2_Sign_Prepare(&prep, &signIn);
+
+    for (i = 0; rc == TPM_RC_SUCCESS && i < count; i++) {
+        rc = TPM2_Sign_Execute(&prep, digests + (i * digestSz),
+            (UINT16)digestSz, &signOut);
+        if (rc != TPM_RC_SUCCESS) {
+        #ifdef DEBUG_WOLFTPM
+            printf("TPM2_Sign batch %d failed %d: %s\n", i, rc,
+                wolfTPM2_GetRCString(rc));
+        #endif
+            break;
+        }
+
+        sig = sigs + (i * sigSz);
+        if (key->pub.publicArea.type == TPM_ALG_ECC) {
+            ecc = &signOut.signature.signature.ecdsa;
+            if (ecc->signatureR.size > partSz ||
+                                            ecc->signatureS.size > partSz) {
+                rc = BUFFER_E;
+                break;
+            }
+            /* R then S, each left padded to the curve size */
+            XMEMSET(sig, 0, keySigSz);
+            XMEMCPY(sig + partSz - ecc->signatureR.size,
+                ecc->signatureR.buffer, ecc->signatureR.size);
+            XMEMCPY(sig + keySigSz - ecc->signatureS.size,
+                ecc->signatureS.buffer, ecc->signatureS.size);
+        }
+        else {
+            if (signOut.signature.signature.rsassa.sig.size != keySigSz) {
+                rc = BUFFER_E;
+                break;
+            }
+            XMEMCPY(sig, signOut.signature.signature.rsassa.sig.buffer,
+                keySigSz);
+        }
+        if (signedCount != NULL)
+            *signedCount = i + 1;
+    }
+
+#ifdef DEBUG_WOLFTPM
+    if (rc == TPM_RC_SUCCESS) {
+        printf("TPM2_Sign batch: %s %d signatures of %d\n",
+            TPM2_GetAlgName(sigAlg), count, keySigSz);
+    }
+#endif
+    return rc;
+}
+
 /* sigAlg: TPM_ALG_RSASSA, TPM_ALG_RSAPSS, TPM_ALG_ECDSA or TPM_ALG_ECDAA */
 /* hashAlg: TPM_ALG_SHA1, TPM_ALG_SHA256, TPM_ALG_SHA384 or TPM_ALG_SHA512 */
 int wolfTPM2_VerifyHashTicket(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* key,
@@ -3939,7 +4748,12 @@ int wolfTPM2_ReadPCR(WOLFTPM2_DEV* dev, int pcrIndex, int hashAlg, byte* digest,
 
     XMEMSET(&pcrReadIn, 0, sizeof(pcrReadIn));
     wolfTPM2_SetupPCRSel(&pcrReadIn.pcrSelectionIn, hashAlg, pcrIndex);
+#ifdef WOLFTPM_SINGLE_FLIGHT
+    rc = wolfTPM2_FlightRun(dev, WOLFTPM2_FLIGHT_PCR_READ, (word32)pcrIndex,
+        (word32)hashAlg, &pcrReadIn, &pcrReadOut, sizeof(pcrReadOut));
+#else
     rc = TPM2_PCR_Read(&pcrReadIn, &pcrReadOut);
+#endif
     if (rc != TPM_RC_SUCCESS) {
     #ifdef DEBUG_WOLFTPM
         printf("TPM2_PCR_Read failed %d: %s\n", rc, wolfTPM2_GetRCString(rc));
@@ -4001,6 +4815,9 @@ int wolfTPM2_UnloadHandle(WOLFTPM2_DEV* dev, WOLFTPM2_HANDLE* handle)
 {
     int rc;
     FlushContext_In in;
+#ifdef WOLFTPM_KEY_CACHE
+    WOLFTPM2_KEY_CACHE_ENTRY* entry;
+#endif
 
     if (dev == NULL || handle == NULL)
         return BAD_FUNC_ARG;
@@ -4011,6 +4828,19 @@ int wolfTPM2_UnloadHandle(WOLFTPM2_DEV* dev, WOLFTPM2_HANDLE* handle)
         return TPM_RC_SUCCESS;
     }
 
+#ifdef WOLFTPM_KEY_CACHE
+    entry = wolfTPM2_KeyCacheFind(dev, NULL, handle->hndl);
+    if (entry != NULL) {
+        if (entry->refCount > 0) {
+            /* release reference, key stays loaded for reuse until evicted */
+            entry->refCount--;
+            handle->hndl = TPM_RH_NULL;
+            return TPM_RC_SUCCESS;
+        }
+        XMEMSET(entry, 0, sizeof(*entry));
+    }
+#endif
+
     XMEMSET(&in, 0, sizeof(in));
     in.flushHandle = handle->hndl;
     rc = TPM2_FlushContext(&in);
@@ -4031,6 +4861,7 @@ int wolfTPM2_UnloadHandle(WOLFTPM2_DEV* dev, WOLFTPM2_HANDLE* handle)
     return TPM_RC_SUCCESS;
 }
 
+#ifndef WOLFTPM2_NO_NV
 /* nv is the populated handle and auth */
 /* auth and authSz are optional NV authentication */
 int wolfTPM2_NVCreateAuth(WOLFTPM2_DEV* dev, WOLFTPM2_HANDLE* parent,
@@ -4116,7 +4947,7 @@ int wolfTPM2_NVWriteAuth(WOLFTPM2_DEV* dev, WOLFTPM2_NV* nv,
 {
     int rc = TPM_RC_SUCCESS;
     word32 pos = 0, towrite;
-    NV_Write_In in;
+    WOLFTPM2_SCRATCH_VAR(NV_Write_In, in);
 
     if (dev == NULL || nv == NULL) {
         return BAD_FUNC_ARG;
@@ -4140,26 +4971,36 @@ int wolfTPM2_NVWriteAuth(WOLFTPM2_DEV* dev, WOLFTPM2_NV* nv,
         return TPM_RC_FAILURE;
     }
 
+    rc = WOLFTPM2_SCRATCH_BEGIN(dev);
+    if (rc != TPM_RC_SUCCESS)
+        return rc;
+    if (!WOLFTPM2_SCRATCH_GET(dev, NV_Write_In, in)) {
+        WOLFTPM2_SCRATCH_END(dev);
+        return MEMORY_E;
+    }
+
     while (dataSz > 0) {
         towrite = dataSz;
         if (towrite > MAX_NV_BUFFER_SIZE)
             towrite = MAX_NV_BUFFER_SIZE;
 
-        XMEMSET(&in, 0, sizeof(in));
-        in.authHandle = nv->handle.hndl;
-        in.nvIndex = nvIndex;
-        in.offset = offset+pos;
-        in.data.size = towrite;
+        /* every field is set, only the bytes written are copied */
+        in->authHandle = nv->handle.hndl;
+        in->nvIndex = nvIndex;
+        in->offset = offset+pos;
+        in->data.size = towrite;
         if (dataBuf)
-            XMEMCPY(in.data.buffer, &dataBuf[pos], towrite);
+            XMEMCPY(in->data.buffer, &dataBuf[pos], towrite);
+        else
+            XMEMSET(in->data.buffer, 0, towrite);
 
-        rc = TPM2_NV_Write(&in);
+        rc = TPM2_NV_Write(in);
         if (rc != TPM_RC_SUCCESS) {
         #ifdef DEBUG_WOLFTPM
             printf("TPM2_NV_Write failed %d: %s\n", rc,
                 wolfTPM2_GetRCString(rc));
         #endif
-            return rc;
+            break;
         }
 
         /* if this is the first write to NV then the NV_WRITTEN bit will get set
@@ -4172,14 +5013,15 @@ int wolfTPM2_NVWriteAuth(WOLFTPM2_DEV* dev, WOLFTPM2_NV* nv,
 
     #ifdef DEBUG_WOLFTPM
         printf("TPM2_NV_Write: Auth 0x%x, Idx 0x%x, Offset %d, Size %d\n",
-            (word32)in.authHandle, (word32)in.nvIndex,
-            in.offset, in.data.size);
+            (word32)in->authHandle, (word32)in->nvIndex,
+            in->offset, in->data.size);
     #endif
 
         pos += towrite;
         dataSz -= towrite;
     }
 
+    WOLFTPM2_SCRATCH_END(dev);
     return rc;
 }
 
@@ -4200,7 +5042,7 @@ int wolfTPM2_NVReadAuth(WOLFTPM2_DEV* dev, WOLFTPM2_NV* nv,
     int rc = TPM_RC_SUCCESS;
     word32 pos = 0, toread, dataSz;
     NV_Read_In in;
-    NV_Read_Out out;
+    WOLFTPM2_SCRATCH_VAR(NV_Read_Out, out);
 
     if (dev == NULL || nv == NULL || pDataSz == NULL) {
         return BAD_FUNC_ARG;
@@ -4222,6 +5064,14 @@ int wolfTPM2_NVReadAuth(WOLFTPM2_DEV* dev, WOLFTPM2_NV* nv,
         return TPM_RC_FAILURE;
     }
 
+    rc = WOLFTPM2_SCRATCH_BEGIN(dev);
+    if (rc != TPM_RC_SUCCESS)
+        return rc;
+    if (!WOLFTPM2_SCRATCH_GET(dev, NV_Read_Out, out)) {
+        WOLFTPM2_SCRATCH_END(dev);
+        return MEMORY_E;
+    }
+
     dataSz = *pDataSz;
     while (dataSz > 0) {
         toread = dataSz;
@@ -4234,23 +5084,25 @@ int wolfTPM2_NVReadAuth(WOLFTPM2_DEV* dev, WOLFTPM2_NV* nv,
         in.offset = offset+pos;
         in.size = toread;
 
-        rc = TPM2_NV_Read(&in, &out);
+        rc = TPM2_NV_Read(&in, out);
         if (rc != TPM_RC_SUCCESS) {
         #ifdef DEBUG_WOLFTPM
             printf("TPM2_NV_Read failed %d: %s\n", rc,
                 wolfTPM2_GetRCString(rc));
         #endif
+            WOLFTPM2_SCRATCH_END(dev);
             return rc;
         }
 
-        toread = out.data.size;
+        toread = out->data.size;
         if (dataBuf) {
-            XMEMCPY(&dataBuf[pos], out.data.buffer, toread);
+            XMEMCPY(&dataBuf[pos], out->data.buffer, toread);
         }
 
     #ifdef DEBUG_WOLFTPM
         printf("TPM2_NV_Read: Auth 0x%x, Idx 0x%x, Offset %d, Size %d\n",
-            (word32)in.authHandle, (word32)in.nvIndex, in.offset, out.data.size);
+            (word32)in.authHandle, (word32)in.nvIndex, in.offset,
+            out->data.size);
     #endif
 
         /* if we are done reading, exit loop */
@@ -4262,6 +5114,7 @@ int wolfTPM2_NVReadAuth(WOLFTPM2_DEV* dev, WOLFTPM2_NV* nv,
     }
     *pDataSz = pos;
 
+    WOLFTPM2_SCRATCH_END(dev);
     return rc;
 }
 
@@ -4331,7 +5184,12 @@ int wolfTPM2_NVReadPublic(WOLFTPM2_DEV* dev, word32 nvIndex,
 
     XMEMSET(&in, 0, sizeof(in));
     in.nvIndex = nvIndex;
+#ifdef WOLFTPM_SINGLE_FLIGHT
+    rc = wolfTPM2_FlightRun(dev, WOLFTPM2_FLIGHT_NV_READ_PUBLIC, nvIndex, 0,
+        &in, &out, sizeof(out));
+#else
     rc = TPM2_NV_ReadPublic(&in, &out);
+#endif
     if (rc != TPM_RC_SUCCESS) {
     #ifdef DEBUG_WOLFTPM
         printf("TPM2_NV_ReadPublic failed %d: %s\n", rc,
@@ -4484,6 +5342,7 @@ int wolfTPM2_NVDelete(WOLFTPM2_DEV* dev, TPM_HANDLE authHandle,
     parent.hndl = authHandle;
     return wolfTPM2_NVDeleteAuth(dev, &parent, nvIndex);
 }
+#endif /* !WOLFTPM2_NO_NV */
 
 #ifndef WOLFTPM2_NO_WOLFCRYPT
 struct WC_RNG* wolfTPM2_GetRng(WOLFTPM2_DEV* dev)
@@ -4567,18 +5426,24 @@ int wolfTPM2_Clear(WOLFTPM2_DEV* dev)
 }
 
 /* Hashing */
+static int wolfTPM2_SequenceStart(WOLFTPM2_DEV* dev, WOLFTPM2_HASH* hash,
+    TPMI_ALG_HASH hashAlg, TPM_HANDLE keyHandle);
+
 /* usageAuth: Optional auth for handle */
+/* With WOLFTPM2_HASH_HYBRID the TPM sequence is deferred until the input
+ * exceeds one command buffer, so small inputs complete with a single
+ * TPM2_Hash or TPM2_HMAC command */
 int wolfTPM2_HashStart(WOLFTPM2_DEV* dev, WOLFTPM2_HASH* hash,
     TPMI_ALG_HASH hashAlg, const byte* usageAuth, word32 usageAuthSz)
 {
-    int rc;
-    HashSequenceStart_In in;
-    HashSequenceStart_Out out;
-
     if (dev == NULL || hash == NULL || hashAlg == TPM_ALG_NULL ||
         (usageAuthSz > 0 && usageAuth == NULL)) {
         return BAD_FUNC_ARG;
     }
+    /* no TPM command is sent until finish, so reject bad input here */
+    if (TPM2_GetHashDigestSize(hashAlg) <= 0) {
+        return BAD_FUNC_ARG;
+    }
 
     /* Capture usage auth */
     if (usageAuthSz > sizeof(hash->handle.auth.buffer))
@@ -4588,41 +5453,67 @@ int wolfTPM2_HashStart(WOLFTPM2_DEV* dev, WOLFTPM2_HASH* hash,
     if (usageAuth != NULL)
         XMEMCPY(hash->handle.auth.buffer, usageAuth, usageAuthSz);
 
-    XMEMSET(&in, 0, sizeof(in));
-    wolfTPM2_CopyAuth(&in.auth, &hash->handle.auth);
-    in.hashAlg = hashAlg;
-    rc = TPM2_HashSequenceStart(&in, &out);
-    if (rc != TPM_RC_SUCCESS) {
-    #ifdef DEBUG_WOLFTPM
-        printf("TPM2_HashSequenceStart failed 0x%x: %s\n", rc,
-            TPM2_GetRCString(rc));
-    #endif
-        return rc;
-    }
-
-    /* Capture hash sequence handle */
-    hash->handle.hndl = out.sequenceHandle;
+#ifdef WOLFTPM2_HASH_HYBRID
+    hash->hashAlg = hashAlg;
+    hash->isPending = 1;
 
 #ifdef DEBUG_WOLFTPM
-    printf("wolfTPM2_HashStart: Handle 0x%x\n",
-        (word32)out.sequenceHandle);
+    printf("wolfTPM2_HashStart: %s\n", TPM2_GetAlgName(hashAlg));
 #endif
 
-    return rc;
+    return TPM_RC_SUCCESS;
+#else
+    return wolfTPM2_SequenceStart(dev, hash, hashAlg, 0);
+#endif
 }
 
-int wolfTPM2_HashUpdate(WOLFTPM2_DEV* dev, WOLFTPM2_HASH* hash,
+/* signKey: Optional key the digest will be signed with. Only a restricted
+ * signing key needs the TPM hash sequence for its hashcheck ticket, all other
+ * hashing is done on the host */
+int wolfTPM2_HashStart_ex(WOLFTPM2_DEV* dev, WOLFTPM2_HASH* hash,
+    TPMI_ALG_HASH hashAlg, const byte* usageAuth, word32 usageAuthSz,
+    const WOLFTPM2_KEY* signKey)
+{
+#if defined(WOLFTPM2_HASH_HYBRID) && !defined(WOLFTPM2_NO_WOLFCRYPT)
+    int rc;
+    enum wc_HashType hashType;
+#endif
+
+    if (dev == NULL || hash == NULL || hashAlg == TPM_ALG_NULL ||
+        (usageAuthSz > 0 && usageAuth == NULL)) {
+        return BAD_FUNC_ARG;
+    }
+
+#if defined(WOLFTPM2_HASH_HYBRID) && !defined(WOLFTPM2_NO_WOLFCRYPT)
+    hashType = (enum wc_HashType)TPM2_GetHashType(hashAlg);
+    if ((signKey == NULL || (signKey->pub.publicArea.objectAttributes &
+            TPMA_OBJECT_restricted) == 0) && hashType != WC_HASH_TYPE_NONE) {
+        XMEMSET(hash, 0, sizeof(WOLFTPM2_HASH));
+        rc = wc_HashInit(&hash->hostHash, hashType);
+        if (rc == 0) {
+            hash->hashAlg = hashAlg;
+            hash->isHost = 1;
+        #ifdef DEBUG_WOLFTPM
+            printf("wolfTPM2_HashStart_ex: Host %s\n",
+                TPM2_GetAlgName(hashAlg));
+        #endif
+        }
+        return rc;
+    }
+#else
+    (void)signKey;
+#endif
+
+    return wolfTPM2_HashStart(dev, hash, hashAlg, usageAuth, usageAuthSz);
+}
+
+static int wolfTPM2_SequenceUpdate(WOLFTPM2_DEV* dev, WOLFTPM2_HASH* hash,
     const byte* data, word32 dataSz)
 {
     int rc = TPM_RC_SUCCESS;
     SequenceUpdate_In in;
     word32 pos = 0, hashSz;
 
-    if (dev == NULL || hash == NULL || (data == NULL && dataSz > 0) ||
-            hash->handle.hndl == 0) {
-        return BAD_FUNC_ARG;
-    }
-
     /* set session auth for hash handle */
     wolfTPM2_SetAuthHandle(dev, 0, &hash->handle);
 
@@ -4647,32 +5538,237 @@ int wolfTPM2_HashUpdate(WOLFTPM2_DEV* dev, WOLFTPM2_HASH* hash,
         pos += hashSz;
     }
 
-#ifdef DEBUG_WOLFTPM
-    printf("wolfTPM2_HashUpdate: Handle 0x%x, DataSz %d\n",
-        (word32)in.sequenceHandle, dataSz);
-#endif
-
     return rc;
 }
 
-int wolfTPM2_HashFinish(WOLFTPM2_DEV* dev, WOLFTPM2_HASH* hash,
-    byte* digest, word32* digestSz)
+/* Starts the TPM sequence and sends any buffered input.
+ * keyHandle: HMAC key or 0 for a hash sequence */
+static int wolfTPM2_SequenceStart(WOLFTPM2_DEV* dev, WOLFTPM2_HASH* hash,
+    TPMI_ALG_HASH hashAlg, TPM_HANDLE keyHandle)
 {
     int rc;
-    SequenceComplete_In in;
-    SequenceComplete_Out out;
+    TPM_HANDLE sequenceHandle;
 
-    if (dev == NULL || hash == NULL || digest == NULL || digestSz == NULL ||
-            hash->handle.hndl == 0) {
-        return BAD_FUNC_ARG;
+    if (keyHandle == 0) {
+        HashSequenceStart_In in;
+        HashSequenceStart_Out out;
+
+        XMEMSET(&in, 0, sizeof(in));
+        wolfTPM2_CopyAuth(&in.auth, &hash->handle.auth);
+        in.hashAlg = hashAlg;
+        rc = TPM2_HashSequenceStart(&in, &out);
+        if (rc != TPM_RC_SUCCESS) {
+        #ifdef DEBUG_WOLFTPM
+            printf("TPM2_HashSequenceStart failed 0x%x: %s\n", rc,
+                TPM2_GetRCString(rc));
+        #endif
+            return rc;
+        }
+        sequenceHandle = out.sequenceHandle;
     }
+    else {
+        HMAC_Start_In in;
+        HMAC_Start_Out out;
 
-    /* set session auth for hash handle */
-    wolfTPM2_SetAuthHandle(dev, 0, &hash->handle);
+        /* set session auth for hmac key */
+        wolfTPM2_SetAuthHandle(dev, 0, &hash->handle);
+
+        XMEMSET(&in, 0, sizeof(in));
+        in.handle = keyHandle;
+        wolfTPM2_CopyAuth(&in.auth, &hash->handle.auth);
+        in.hashAlg = hashAlg;
+        rc = TPM2_HMAC_Start(&in, &out);
+        if (rc != TPM_RC_SUCCESS) {
+        #ifdef DEBUG_WOLFTPM
+            printf("TPM2_HMAC_Start failed 0x%x: %s\n", rc,
+                TPM2_GetRCString(rc));
+        #endif
+            return rc;
+        }
+        sequenceHandle = out.sequenceHandle;
+    }
+
+    /* Capture hash sequence handle */
+    hash->handle.hndl = sequenceHandle;
+
+#ifdef DEBUG_WOLFTPM
+    printf("wolfTPM2_SequenceStart: Handle 0x%x\n", (word32)sequenceHandle);
+#endif
+
+#ifdef WOLFTPM2_HASH_HYBRID
+    hash->isPending = 0;
+    if (hash->buffer.size > 0) {
+        rc = wolfTPM2_SequenceUpdate(dev, hash, hash->buffer.buffer,
+            hash->buffer.size);
+        hash->buffer.size = 0;
+    }
+#endif
+
+    return rc;
+}
+
+/* Buffers input while it fits in one command, otherwise starts the sequence */
+static int wolfTPM2_HashUpdatePending(WOLFTPM2_DEV* dev, WOLFTPM2_HASH* hash,
+    TPM_HANDLE keyHandle, const byte* data, word32 dataSz)
+{
+    int rc;
+
+#ifdef WOLFTPM2_HASH_HYBRID
+    if (hash->isPending) {
+        if (dataSz <= sizeof(hash->buffer.buffer) - hash->buffer.size) {
+            if (dataSz > 0) {
+                XMEMCPY(&hash->buffer.buffer[hash->buffer.size], data, dataSz);
+                hash->buffer.size += dataSz;
+            }
+            return TPM_RC_SUCCESS;
+        }
+        rc = wolfTPM2_SequenceStart(dev, hash, hash->hashAlg, keyHandle);
+        if (rc != TPM_RC_SUCCESS) {
+            return rc;
+        }
+    }
+#else
+    (void)keyHandle;
+#endif
+    if (hash->handle.hndl == 0) {
+        return BAD_FUNC_ARG;
+    }
+    rc = wolfTPM2_SequenceUpdate(dev, hash, data, dataSz);
+
+#ifdef DEBUG_WOLFTPM
+    printf("wolfTPM2_HashUpdate: Handle 0x%x, DataSz %d\n",
+        (word32)hash->handle.hndl, dataSz);
+#endif
+
+    return rc;
+}
+
+int wolfTPM2_HashUpdate(WOLFTPM2_DEV* dev, WOLFTPM2_HASH* hash,
+    const byte* data, word32 dataSz)
+{
+    if (dev == NULL || hash == NULL || (data == NULL && dataSz > 0)) {
+        return BAD_FUNC_ARG;
+    }
+
+#if defined(WOLFTPM2_HASH_HYBRID) && !defined(WOLFTPM2_NO_WOLFCRYPT)
+    if (hash->isHost) {
+        return wc_HashUpdate(&hash->hostHash,
+            (enum wc_HashType)TPM2_GetHashType(hash->hashAlg), data, dataSz);
+    }
+#endif
+
+    return wolfTPM2_HashUpdatePending(dev, hash, 0, data, dataSz);
+}
+
+#ifdef WOLFTPM2_HASH_HYBRID
+#ifndef WOLFTPM2_NO_WOLFCRYPT
+static int wolfTPM2_HashFinishHost(WOLFTPM2_HASH* hash, byte* digest,
+    word32* digestSz)
+{
+    int rc;
+    enum wc_HashType hashType;
+    byte result[TPM_MAX_DIGEST_SIZE];
+    word32 resultSz;
+
+    hashType = (enum wc_HashType)TPM2_GetHashType(hash->hashAlg);
+    resultSz = (word32)TPM2_GetHashDigestSize(hash->hashAlg);
+    rc = wc_HashFinal(&hash->hostHash, hashType, result);
+    wc_HashFree(&hash->hostHash, hashType);
+    hash->isHost = 0;
+    if (rc == 0) {
+        if (resultSz > *digestSz)
+            resultSz = *digestSz;
+        *digestSz = resultSz;
+        XMEMCPY(digest, result, resultSz);
+    }
+    return rc;
+}
+#endif
+
+/* Single TPM2_Hash command for input that never exceeded one buffer */
+static int wolfTPM2_HashFinishOneShot(WOLFTPM2_HASH* hash, byte* digest,
+    word32* digestSz, TPMI_RH_HIERARCHY hierarchy,
+    TPMT_TK_HASHCHECK* validation)
+{
+    int rc;
+    Hash_In in;
+    Hash_Out out;
+
+    XMEMSET(&in, 0, sizeof(in));
+    in.data.size = hash->buffer.size;
+    XMEMCPY(in.data.buffer, hash->buffer.buffer, in.data.size);
+    in.hashAlg = hash->hashAlg;
+    in.hierarchy = (validation != NULL) ? hierarchy : TPM_RH_NULL;
+    rc = TPM2_Hash(&in, &out);
+
+    hash->isPending = 0;
+    hash->buffer.size = 0;
+
+    if (rc != TPM_RC_SUCCESS) {
+    #ifdef DEBUG_WOLFTPM
+        printf("TPM2_Hash failed 0x%x: %s\n", rc, TPM2_GetRCString(rc));
+    #endif
+        return rc;
+    }
+
+    if (out.outHash.size > *digestSz)
+        out.outHash.size = *digestSz;
+    *digestSz = out.outHash.size;
+    XMEMCPY(digest, out.outHash.buffer, *digestSz);
+    if (validation != NULL) {
+        XMEMCPY(validation, &out.validation, sizeof(*validation));
+    }
+
+#ifdef DEBUG_WOLFTPM
+    printf("wolfTPM2_HashFinish: One-shot DataSz %d, DigestSz %d\n",
+        in.data.size, *digestSz);
+#endif
+
+    return rc;
+}
+
+#endif /* WOLFTPM2_HASH_HYBRID */
+
+/* validation: Optional, when set the ticket is requested for hierarchy */
+static int wolfTPM2_HashFinishSeq(WOLFTPM2_DEV* dev, WOLFTPM2_HASH* hash,
+    byte* digest, word32* digestSz, TPMI_RH_HIERARCHY hierarchy,
+    TPMT_TK_HASHCHECK* validation)
+{
+    int rc;
+    SequenceComplete_In in;
+    SequenceComplete_Out out;
+
+    if (dev == NULL || hash == NULL || digest == NULL || digestSz == NULL) {
+        return BAD_FUNC_ARG;
+    }
+
+#ifdef WOLFTPM2_HASH_HYBRID
+#ifndef WOLFTPM2_NO_WOLFCRYPT
+    if (hash->isHost) {
+        rc = wolfTPM2_HashFinishHost(hash, digest, digestSz);
+        if (rc == 0 && validation != NULL) {
+            XMEMSET(validation, 0, sizeof(*validation));
+            validation->tag = TPM_ST_HASHCHECK;
+            validation->hierarchy = TPM_RH_NULL;
+        }
+        return rc;
+    }
+#endif
+    if (hash->isPending) {
+        return wolfTPM2_HashFinishOneShot(hash, digest, digestSz, hierarchy,
+            validation);
+    }
+#endif
+    if (hash->handle.hndl == 0) {
+        return BAD_FUNC_ARG;
+    }
+
+    /* set session auth for hash handle */
+    wolfTPM2_SetAuthHandle(dev, 0, &hash->handle);
 
     XMEMSET(&in, 0, sizeof(in));
     in.sequenceHandle = hash->handle.hndl;
-    in.hierarchy = TPM_RH_NULL;
+    in.hierarchy = (validation != NULL) ? hierarchy : TPM_RH_NULL;
     rc = TPM2_SequenceComplete(&in, &out);
 
     /* mark hash handle as done */
@@ -4690,6 +5786,9 @@ int wolfTPM2_HashFinish(WOLFTPM2_DEV* dev, WOLFTPM2_HASH* hash,
         out.result.size = *digestSz;
     *digestSz = out.result.size;
     XMEMCPY(digest, out.result.buffer, *digestSz);
+    if (validation != NULL) {
+        XMEMCPY(validation, &out.validation, sizeof(*validation));
+    }
 
 #ifdef DEBUG_WOLFTPM
     printf("wolfTPM2_HashFinish: Handle 0x%x, DigestSz %d\n",
@@ -4699,6 +5798,27 @@ int wolfTPM2_HashFinish(WOLFTPM2_DEV* dev, WOLFTPM2_HASH* hash,
     return rc;
 }
 
+int wolfTPM2_HashFinish(WOLFTPM2_DEV* dev, WOLFTPM2_HASH* hash,
+    byte* digest, word32* digestSz)
+{
+    return wolfTPM2_HashFinishSeq(dev, hash, digest, digestSz, TPM_RH_NULL,
+        NULL);
+}
+
+/* hierarchy: hierarchy of the key that will sign the digest */
+int wolfTPM2_HashFinishTicket(WOLFTPM2_DEV* dev, WOLFTPM2_HASH* hash,
+    byte* digest, word32* digestSz, TPMI_RH_HIERARCHY hierarchy,
+    TPMT_TK_HASHCHECK* validation)
+{
+    if (validation == NULL || (hierarchy != TPM_RH_OWNER &&
+            hierarchy != TPM_RH_ENDORSEMENT && hierarchy != TPM_RH_PLATFORM &&
+            hierarchy != TPM_RH_NULL)) {
+        return BAD_FUNC_ARG;
+    }
+    return wolfTPM2_HashFinishSeq(dev, hash, digest, digestSz, hierarchy,
+        validation);
+}
+
 
 static int wolfTPM2_ComputeSymmetricUnique(WOLFTPM2_DEV* dev, int hashAlg,
     const TPMT_SENSITIVE* sensitive, TPM2B_DIGEST* unique)
@@ -5074,10 +6194,13 @@ int wolfTPM2_HmacStart(WOLFTPM2_DEV* dev, WOLFTPM2_HMAC* hmac,
     word32 keySz, const byte* usageAuth, word32 usageAuthSz)
 {
     int rc;
-    HMAC_Start_In in;
-    HMAC_Start_Out out;
 
-    if (dev == NULL || hmac == NULL || hashAlg == TPM_ALG_NULL) {
+    if (dev == NULL || hmac == NULL || hashAlg == TPM_ALG_NULL ||
+        (usageAuthSz > 0 && usageAuth == NULL)) {
+        return BAD_FUNC_ARG;
+    }
+    /* no TPM command is sent until finish, so reject bad input here */
+    if (TPM2_GetHashDigestSize(hashAlg) <= 0) {
         return BAD_FUNC_ARG;
     }
 
@@ -5096,55 +6219,103 @@ int wolfTPM2_HmacStart(WOLFTPM2_DEV* dev, WOLFTPM2_HMAC* hmac,
         }
         hmac->hmacKeyLoaded = 1;
     }
+    else if ((hmac->key.handle.hndl & HR_RANGE_MASK) != HR_TRANSIENT &&
+             (hmac->key.handle.hndl & HR_RANGE_MASK) != HR_PERSISTENT) {
+        return BAD_FUNC_ARG;
+    }
+
+#ifdef WOLFTPM2_HASH_HYBRID
+    /* HMAC sequence is started once input exceeds one command buffer */
+    hmac->hash.handle.hndl = 0;
+    hmac->hash.hashAlg = hashAlg;
+    hmac->hash.buffer.size = 0;
+    hmac->hash.isHost = 0;
+    hmac->hash.isPending = 1;
+
+#ifdef DEBUG_WOLFTPM
+    printf("wolfTPM2_HmacStart: Key Handle 0x%x\n",
+        (word32)hmac->key.handle.hndl);
+#endif
+
+    return TPM_RC_SUCCESS;
+#else
+    return wolfTPM2_SequenceStart(dev, &hmac->hash, hashAlg,
+        hmac->key.handle.hndl);
+#endif
+}
+
+int wolfTPM2_HmacUpdate(WOLFTPM2_DEV* dev, WOLFTPM2_HMAC* hmac,
+    const byte* data, word32 dataSz)
+{
+    if (dev == NULL || hmac == NULL || (data == NULL && dataSz > 0)) {
+        return BAD_FUNC_ARG;
+    }
+
+    return wolfTPM2_HashUpdatePending(dev, &hmac->hash, hmac->key.handle.hndl,
+        data, dataSz);
+}
+
+#ifdef WOLFTPM2_HASH_HYBRID
+/* Single TPM2_HMAC command for input that never exceeded one buffer */
+static int wolfTPM2_HmacFinishOneShot(WOLFTPM2_DEV* dev, WOLFTPM2_HMAC* hmac,
+    byte* digest, word32* digestSz)
+{
+    int rc;
+    HMAC_In in;
+    HMAC_Out out;
 
-    /* set session auth for hmac key */
+    /* set session auth for hmac key, same as wolfTPM2_SequenceStart */
     wolfTPM2_SetAuthHandle(dev, 0, &hmac->hash.handle);
 
-    /* Setup HMAC start command */
     XMEMSET(&in, 0, sizeof(in));
     in.handle = hmac->key.handle.hndl;
-    wolfTPM2_CopyAuth(&in.auth, &hmac->hash.handle.auth);
-    in.hashAlg = hashAlg;
-    rc = TPM2_HMAC_Start(&in, &out);
+    in.buffer.size = hmac->hash.buffer.size;
+    XMEMCPY(in.buffer.buffer, hmac->hash.buffer.buffer, in.buffer.size);
+    in.hashAlg = hmac->hash.hashAlg;
+    rc = TPM2_HMAC(&in, &out);
+
+    hmac->hash.isPending = 0;
+    hmac->hash.buffer.size = 0;
+
     if (rc != TPM_RC_SUCCESS) {
     #ifdef DEBUG_WOLFTPM
-        printf("TPM2_HMAC_Start failed 0x%x: %s\n", rc,
-            TPM2_GetRCString(rc));
+        printf("TPM2_HMAC failed 0x%x: %s\n", rc, TPM2_GetRCString(rc));
     #endif
         return rc;
     }
 
-    /* Capture hash sequence handle */
-    hmac->hash.handle.hndl = out.sequenceHandle;
+    if (out.outHMAC.size > *digestSz)
+        out.outHMAC.size = *digestSz;
+    *digestSz = out.outHMAC.size;
+    XMEMCPY(digest, out.outHMAC.buffer, *digestSz);
 
 #ifdef DEBUG_WOLFTPM
-    printf("wolfTPM2_HmacStart: Handle 0x%x\n",
-        (word32)out.sequenceHandle);
+    printf("wolfTPM2_HmacFinish: One-shot DataSz %d, DigestSz %d\n",
+        in.buffer.size, *digestSz);
 #endif
 
     return rc;
 }
-
-int wolfTPM2_HmacUpdate(WOLFTPM2_DEV* dev, WOLFTPM2_HMAC* hmac,
-    const byte* data, word32 dataSz)
-{
-    if (dev == NULL || hmac == NULL) {
-        return BAD_FUNC_ARG;
-    }
-
-    return wolfTPM2_HashUpdate(dev, &hmac->hash, data, dataSz);
-}
+#endif /* WOLFTPM2_HASH_HYBRID */
 
 int wolfTPM2_HmacFinish(WOLFTPM2_DEV* dev, WOLFTPM2_HMAC* hmac,
     byte* digest, word32* digestSz)
 {
     int rc;
 
-    if (dev == NULL || hmac == NULL) {
+    if (dev == NULL || hmac == NULL || digest == NULL || digestSz == NULL) {
         return BAD_FUNC_ARG;
     }
 
-    rc = wolfTPM2_HashFinish(dev, &hmac->hash, digest, digestSz);
+#ifdef WOLFTPM2_HASH_HYBRID
+    if (hmac->hash.isPending) {
+        rc = wolfTPM2_HmacFinishOneShot(dev, hmac, digest, digestSz);
+    }
+    else
+#endif
+    {
+        rc = wolfTPM2_HashFinish(dev, &hmac->hash, digest, digestSz);
+    }
 
     if (!hmac->hmacKeyKeep) {
         /* unload HMAC key */
@@ -5197,19 +6368,85 @@ int wolfTPM2_Shutdown(WOLFTPM2_DEV* dev, int doStartup)
     return rc;
 }
 
-int wolfTPM2_UnloadHandles(WOLFTPM2_DEV* dev, word32 handleStart,
-    word32 handleCount)
+/* Flush only the handles the TPM reports as present in the range, using
+ * TPM_CAP_HANDLES. Returns TPM error if the handles cannot be enumerated. */
+static int wolfTPM2_FlushEnumerated(WOLFTPM2_DEV* dev, word32 handleStart,
+    word32 handleCount, WOLFTPM2_HANDLE* handle)
+{
+    int rc;
+    word32 i, hndl;
+    GetCapability_In in;
+    GetCapability_Out out;
+    TPML_HANDLE* handles = &out.capabilityData.data.handles;
+
+    XMEMSET(&in, 0, sizeof(in));
+    in.capability = TPM_CAP_HANDLES;
+    in.property = handleStart;
+    in.propertyCount = MAX_CAP_HANDLES;
+    do {
+        XMEMSET(&out, 0, sizeof(out));
+        rc = TPM2_GetCapability(&in, &out);
+        if (rc != TPM_RC_SUCCESS) {
+        #ifdef DEBUG_WOLFTPM
+            printf("TPM2_GetCapability handles 0x%x failed %d: %s\n",
+                (word32)in.property, rc, wolfTPM2_GetRCString(rc));
+        #endif
+            return rc;
+        }
+        if (handles->count > MAX_CAP_HANDLES)
+            handles->count = MAX_CAP_HANDLES;
+
+        for (i = 0; i < handles->count; i++) {
+            hndl = handles->handle[i];
+            if (hndl < handleStart || hndl - handleStart >= handleCount) {
+                out.moreData = 0;
+                break;
+            }
+            handle->hndl = hndl;
+            /* ignore return code failures */
+            (void)wolfTPM2_UnloadHandle(dev, handle);
+        }
+        if (handles->count == 0)
+            break;
+        in.property = handles->handle[handles->count-1] + 1;
+    } while (out.moreData);
+
+    return TPM_RC_SUCCESS;
+}
+
+/* sweepCount: handles to try from handleStart if the TPM cannot enumerate */
+static int wolfTPM2_UnloadHandles_ex(WOLFTPM2_DEV* dev, word32 handleStart,
+    word32 handleCount, word32 sweepCount)
 {
     int rc = TPM_RC_SUCCESS;
     word32 hndl;
     WOLFTPM2_HANDLE handle;
+#ifdef WOLFTPM_KEY_CACHE
+    int i;
+#endif
     if (dev == NULL) {
         return BAD_FUNC_ARG;
     }
     XMEMSET(&handle, 0, sizeof(handle));
     wolfTPM2_CopyAuth(&handle.auth, &dev->session[0].auth);
 
-    for (hndl=handleStart; hndl < handleStart+handleCount; hndl++) {
+#ifdef WOLFTPM_KEY_CACHE
+    /* cached keys in the range are flushed regardless of references */
+    for (i = 0; i < WOLFTPM2_KEY_CACHE_NUM; i++) {
+        if (dev->keyCache[i].hndl >= handleStart &&
+            dev->keyCache[i].hndl - handleStart < handleCount) {
+            XMEMSET(&dev->keyCache[i], 0, sizeof(dev->keyCache[i]));
+        }
+    }
+#endif
+
+    if (wolfTPM2_FlushEnumerated(dev, handleStart, handleCount,
+            &handle) == TPM_RC_SUCCESS) {
+        return rc;
+    }
+
+    /* handles could not be enumerated, try each one */
+    for (hndl=handleStart; hndl < handleStart+sweepCount; hndl++) {
         handle.hndl = hndl;
         /* ignore return code failures */
         (void)wolfTPM2_UnloadHandle(dev, &handle);
@@ -5217,9 +6454,47 @@ int wolfTPM2_UnloadHandles(WOLFTPM2_DEV* dev, word32 handleStart,
     return rc;
 }
 
+int wolfTPM2_UnloadHandles(WOLFTPM2_DEV* dev, word32 handleStart,
+    word32 handleCount)
+{
+    return wolfTPM2_UnloadHandles_ex(dev, handleStart, handleCount,
+        handleCount);
+}
+
 int wolfTPM2_UnloadHandles_AllTransient(WOLFTPM2_DEV* dev)
 {
-    return wolfTPM2_UnloadHandles(dev, TRANSIENT_FIRST, MAX_HANDLE_NUM);
+    return wolfTPM2_UnloadHandles_ex(dev, TRANSIENT_FIRST,
+        (word32)HR_HANDLE_MASK + 1, MAX_HANDLE_NUM);
+}
+
+int wolfTPM2_UnloadHandles_All(WOLFTPM2_DEV* dev)
+{
+    int rc, i;
+
+    rc = wolfTPM2_UnloadHandles_AllTransient(dev);
+    if (rc == TPM_RC_SUCCESS) {
+        /* loaded sessions are reported as HMAC or policy session handles */
+        rc = wolfTPM2_UnloadHandles_ex(dev, LOADED_SESSION_FIRST,
+            2 * ((word32)HR_HANDLE_MASK + 1), MAX_ACTIVE_SESSIONS);
+    }
+    if (rc == TPM_RC_SUCCESS) {
+        /* context saved sessions */
+        rc = wolfTPM2_UnloadHandles_ex(dev, ACTIVE_SESSION_FIRST,
+            (word32)HR_HANDLE_MASK + 1, MAX_ACTIVE_SESSIONS);
+    }
+    if (rc == TPM_RC_SUCCESS) {
+        /* sessions no longer exist, fall back to password auth */
+        for (i = 0; i < MAX_SESSION_NUM; i++) {
+            if (TPM2_IS_HMAC_SESSION(dev->session[i].sessionHandle) ||
+                TPM2_IS_POLICY_SESSION(dev->session[i].sessionHandle)) {
+                XMEMSET(&dev->session[i], 0, sizeof(dev->session[i]));
+                if (i == 0)
+                    dev->session[i].sessionHandle = TPM_RS_PW;
+            }
+        }
+        rc = TPM2_SetSessionAuth(dev->session);
+    }
+    return rc;
 }
 
 
@@ -5712,6 +6987,90 @@ int wolfTPM2_CreateSRK(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* srkKey, TPM_ALG_ID alg,
     return rc;
 }
 
+int wolfTPM2_GetPrimaryStorageKey(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* srkKey,
+    TPM_ALG_ID alg, TPM_HANDLE persistHandle, const byte* auth, int authSz,
+    TPMS_CONTEXT* savedCtx)
+{
+    int rc = TPM_RC_HANDLE;
+    ContextSave_In saveIn;
+    ContextSave_Out saveOut;
+    ContextLoad_In loadIn;
+    ContextLoad_Out loadOut;
+
+    if (dev == NULL || srkKey == NULL || (auth == NULL && authSz > 0) ||
+            authSz < 0 || authSz > (int)sizeof(srkKey->handle.auth.buffer)) {
+        return BAD_FUNC_ARG;
+    }
+
+    /* already persisted */
+    if (persistHandle != 0) {
+        rc = wolfTPM2_ReadPublicKey(dev, srkKey, persistHandle);
+        /* only a missing handle means there is no SRK, anything else
+         * (transport error, lock timeout, TPM warning) is returned */
+        if (rc != TPM_RC_SUCCESS && (rc & RC_MAX_FMT1) != TPM_RC_HANDLE)
+            return rc;
+    }
+
+    /* transient SRK kept as a saved context (until TPM Reset) */
+    if (rc != TPM_RC_SUCCESS && savedCtx != NULL && savedCtx->savedHandle != 0) {
+        XMEMSET(&loadIn, 0, sizeof(loadIn));
+        XMEMCPY(&loadIn.context, savedCtx, sizeof(TPMS_CONTEXT));
+        rc = TPM2_ContextLoad(&loadIn, &loadOut);
+        if (rc == TPM_RC_SUCCESS) {
+            rc = wolfTPM2_ReadPublicKey(dev, srkKey, loadOut.loadedHandle);
+            if (rc != TPM_RC_SUCCESS) {
+                srkKey->handle.hndl = loadOut.loadedHandle;
+                wolfTPM2_UnloadHandle(dev, &srkKey->handle);
+            }
+        }
+        /* a TPM error means the context is stale (TPM Reset), a transport
+         * error or TPM warning may be transient so keep the context */
+        if (rc < 0 || (!(rc & RC_FMT1) && (rc & RC_WARN) == RC_WARN)) {
+            return rc;
+        }
+        if (rc != TPM_RC_SUCCESS) {
+        #ifdef DEBUG_WOLFTPM
+            printf("SRK saved context is stale %d: %s\n", rc,
+                wolfTPM2_GetRCString(rc));
+        #endif
+            XMEMSET(savedCtx, 0, sizeof(TPMS_CONTEXT));
+        }
+    }
+
+    if (rc == TPM_RC_SUCCESS) {
+        /* found existing key, only the auth needs to be set */
+        srkKey->handle.auth.size = authSz;
+        if (authSz > 0)
+            XMEMCPY(srkKey->handle.auth.buffer, auth, authSz);
+        return rc;
+    }
+
+    rc = wolfTPM2_CreateSRK(dev, srkKey, alg, auth, authSz);
+    if (rc != TPM_RC_SUCCESS)
+        return rc;
+
+    if (persistHandle != 0) {
+        rc = wolfTPM2_NVStoreKey(dev, TPM_RH_OWNER, srkKey, persistHandle);
+        if (rc == TPM_RC_SUCCESS || savedCtx == NULL)
+            return rc;
+    #ifdef DEBUG_WOLFTPM
+        printf("SRK persist not allowed %d: %s, saving context\n", rc,
+            wolfTPM2_GetRCString(rc));
+    #endif
+    }
+
+    if (savedCtx != NULL) {
+        XMEMSET(&saveIn, 0, sizeof(saveIn));
+        saveIn.saveHandle = srkKey->handle.hndl;
+        rc = TPM2_ContextSave(&saveIn, &saveOut);
+        if (rc == TPM_RC_SUCCESS) {
+            XMEMCPY(savedCtx, &saveOut.context, sizeof(TPMS_CONTEXT));
+        }
+    }
+
+    return rc;
+}
+
 int wolfTPM2_CreateAndLoadAIK(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* aikKey,
     TPM_ALG_ID alg, WOLFTPM2_KEY* srkKey, const byte* auth, int authSz)
 {
@@ -5818,6 +7177,7 @@ int wolfTPM2_CreateKeySeal_ex(WOLFTPM2_DEV* dev, WOLFTPM2_KEYBLOB* keyBlob,
     return rc;
 }
 
+#ifndef WOLFTPM2_NO_ATTEST
 int wolfTPM2_GetTime(WOLFTPM2_KEY* aikKey, GetTime_Out* getTimeOut)
 {
     int rc;
@@ -5850,6 +7210,7 @@ int wolfTPM2_GetTime(WOLFTPM2_KEY* aikKey, GetTime_Out* getTimeOut)
 
     return rc;
 }
+#endif /* !WOLFTPM2_NO_ATTEST */
 
 static void wolfTPM2_CopySymmetric(TPMT_SYM_DEF* out, const TPMT_SYM_DEF* in)
 {
@@ -6035,6 +7396,7 @@ static void wolfTPM2_CopyEccParam(TPM2B_ECC_PARAMETER* out,
     }
 }
 
+#ifndef WOLFTPM2_NO_IMPORT
 static void wolfTPM2_CopyKeyFromBlob(WOLFTPM2_KEY* key, const WOLFTPM2_KEYBLOB* keyBlob)
 {
     if (key != NULL && keyBlob != NULL) {
@@ -6045,7 +7407,9 @@ static void wolfTPM2_CopyKeyFromBlob(WOLFTPM2_KEY* key, const WOLFTPM2_KEYBLOB*
         wolfTPM2_CopyPub(&key->pub, &keyBlob->pub);
     }
 }
+#endif
 
+#ifndef WOLFTPM2_NO_NV
 static void wolfTPM2_CopyNvPublic(TPMS_NV_PUBLIC* out, const TPMS_NV_PUBLIC* in)
 {
     if (out != NULL && in != NULL) {
@@ -6062,6 +7426,7 @@ static void wolfTPM2_CopyNvPublic(TPMS_NV_PUBLIC* out, const TPMS_NV_PUBLIC* in)
         out->nvIndex = in->nvIndex;
     }
 }
+#endif /* !WOLFTPM2_NO_NV */
 
 /******************************************************************************/
 /* --- END Utility Functions -- */
@@ -6450,6 +7815,7 @@ int wolfTPM2_CSR_Generate(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* key,
 /* --- BEGIN Policy Support -- */
 /******************************************************************************/
 
+#ifndef WOLFTPM2_NO_POLICY
 int wolfTPM2_PolicyRestart(WOLFTPM2_DEV* dev, TPM_HANDLE sessionHandle)
 {
     int rc;
@@ -6521,8 +7887,10 @@ int wolfTPM2_PolicyPCR(WOLFTPM2_DEV* dev, TPM_HANDLE sessionHandle,
 
     return rc;
 }
+#endif /* !WOLFTPM2_NO_POLICY */
 
 #ifndef WOLFTPM2_NO_WOLFCRYPT
+#ifndef WOLFTPM2_NO_POLICY
 /* Authorize a policy based on external key for a verified policy digiest signature */
 int wolfTPM2_PolicyAuthorize(WOLFTPM2_DEV* dev, TPM_HANDLE sessionHandle,
     const TPM2B_PUBLIC* pub, const TPMT_TK_VERIFIED* checkTicket,
@@ -6562,6 +7930,7 @@ int wolfTPM2_PolicyAuthorize(WOLFTPM2_DEV* dev, TPM_HANDLE sessionHandle,
 #endif
     return rc;
 }
+#endif /* !WOLFTPM2_NO_POLICY */
 
 /* Build Hash of PCR's */
 int wolfTPM2_PCRGetDigest(WOLFTPM2_DEV* dev, TPM_ALG_ID pcrAlg,
@@ -6616,6 +7985,7 @@ int wolfTPM2_PCRGetDigest(WOLFTPM2_DEV* dev, TPM_ALG_ID pcrAlg,
     return rc;
 }
 
+#ifndef WOLFTPM2_NO_POLICY
 /* Assemble a PCR policy */
 /* policyDigestnew = hash(policyDigestOld || TPM_CC_PolicyPCR  || PCRS ||
  *                        pcrDigest) */
@@ -6818,10 +8188,1307 @@ int wolfTPM2_PolicyAuthorizeMake(TPM_ALG_ID pcrAlg,
 #endif
     return rc;
 }
+#endif /* !WOLFTPM2_NO_POLICY */
 #endif /* !WOLFTPM2_NO_WOLFCRYPT */
 
 /******************************************************************************/
 /* --- END Policy Support -- */
 /******************************************************************************/
 
+/******************************************************************************/
+/* --- BEGIN Envelope Encryption -- */
+/******************************************************************************/
+
+#if !defined(WOLFTPM2_NO_WOLFCRYPT) && defined(HAVE_AESGCM) && \
+    !defined(NO_SHA256)
+
+static int wolfTPM2_EnvelopeSetKey(WOLFTPM2_ENVELOPE* env,
+    const byte* key, word32 keySz)
+{
+    int rc;
+
+    rc = wc_AesInit(&env->aes, NULL, INVALID_DEVID);
+    if (rc == 0) {
+        rc = wc_AesGcmSetKey(&env->aes, key, keySz);
+        if (rc == 0) {
+            env->aesInit = 1;
+            env->isFinal = 0;
+            env->chunkIdx = 0;
+        }
+        else {
+            wc_AesFree(&env->aes);
+        }
+    }
+    return rc;
+}
+
+/* Unique nonce per chunk: base nonce with chunk index in the last 4 bytes */
+static void wolfTPM2_EnvelopeNonce(WOLFTPM2_ENVELOPE* env, byte* nonce)
+{
+    XMEMCPY(nonce, env->iv, WOLFTPM2_ENVELOPE_IV_SZ);
+    nonce[WOLFTPM2_ENVELOPE_IV_SZ-4] ^= (byte)(env->chunkIdx >> 24);
+    nonce[WOLFTPM2_ENVELOPE_IV_SZ-3] ^= (byte)(env->chunkIdx >> 16);
+    nonce[WOLFTPM2_ENVELOPE_IV_SZ-2] ^= (byte)(env->chunkIdx >> 8);
+    nonce[WOLFTPM2_ENVELOPE_IV_SZ-1] ^= (byte)(env->chunkIdx);
+}
+
+/* Binds the encoded header to every chunk through the GCM AAD */
+static int wolfTPM2_EnvelopeBindHeader(WOLFTPM2_ENVELOPE* env,
+    const byte* hdr, word32 hdrSz)
+{
+    return wc_Sha256Hash(hdr, hdrSz, env->aad);
+}
+
+int wolfTPM2_EnvelopeCreate(WOLFTPM2_DEV* dev, WOLFTPM2_ENVELOPE* env,
+    WOLFTPM2_HANDLE* parent, const byte* auth, int authSz)
+{
+    int rc;
+    byte dataKey[WOLFTPM2_ENVELOPE_KEY_SZ];
+    byte hdr[WOLFTPM2_ENVELOPE_HDR_SZ + sizeof(TPM2B_PUBLIC) +
+             sizeof(TPM2B_PRIVATE)];
+    TPMT_PUBLIC publicTemplate;
+
+    if (dev == NULL || env == NULL || parent == NULL ||
+            (auth == NULL && authSz > 0)) {
+        return BAD_FUNC_ARG;
+    }
+
+    XMEMSET(env, 0, sizeof(WOLFTPM2_ENVELOPE));
+
+    rc = wolfTPM2_GetRandom(dev, dataKey, (word32)sizeof(dataKey));
+    if (rc == 0) {
+        rc = wolfTPM2_GetRandom(dev, env->iv, (word32)sizeof(env->iv));
+    }
+    if (rc == 0) {
+        rc = wolfTPM2_GetKeyTemplate_KeySeal(&publicTemplate, TPM_ALG_SHA256);
+    }
+    if (rc == 0) {
+        rc = wolfTPM2_CreateKeySeal(dev, &env->sealBlob, parent,
+            &publicTemplate, auth, authSz, dataKey, (int)sizeof(dataKey));
+    }
+    if (rc == 0) {
+        /* header digest is set while encoding */
+        rc = wolfTPM2_EnvelopeGetHeader(env, hdr, (word32)sizeof(hdr));
+        if (rc > 0)
+            rc = 0;
+    }
+    if (rc == 0) {
+        rc = wolfTPM2_EnvelopeSetKey(env, dataKey, (word32)sizeof(dataKey));
+    }
+    TPM2_ForceZero(dataKey, (word32)sizeof(dataKey));
+
+#ifdef DEBUG_WOLFTPM
+    if (rc != 0) {
+        printf("wolfTPM2_EnvelopeCreate failed %d: %s\n", rc,
+            wolfTPM2_GetRCString(rc));
+    }
+#endif
+
+    return rc;
+}
+
+int wolfTPM2_EnvelopeOpen(WOLFTPM2_DEV* dev, WOLFTPM2_ENVELOPE* env,
+    WOLFTPM2_HANDLE* parent, const byte* auth, int authSz)
+{
+    int rc;
+    Unseal_In  unsealIn;
+    Unseal_Out unsealOut;
+
+    if (dev == NULL || env == NULL || parent == NULL ||
+            (auth == NULL && authSz > 0) ||
+            authSz > (int)sizeof(env->sealBlob.handle.auth.buffer)) {
+        return BAD_FUNC_ARG;
+    }
+
+    rc = wolfTPM2_LoadKey(dev, &env->sealBlob, parent);
+    if (rc != TPM_RC_SUCCESS) {
+        return rc;
+    }
+
+    /* set session auth for the sealed data key */
+    env->sealBlob.handle.auth.size = authSz;
+    if (authSz > 0)
+        XMEMCPY(env->sealBlob.handle.auth.buffer, auth, authSz);
+    wolfTPM2_SetAuthHandle(dev, 0, &env->sealBlob.handle);
+
+    XMEMSET(&unsealIn, 0, sizeof(unsealIn));
+    unsealIn.itemHandle = env->sealBlob.handle.hndl;
+    rc = TPM2_Unseal(&unsealIn, &unsealOut);
+    wolfTPM2_UnloadHandle(dev, &env->sealBlob.handle);
+    if (rc != TPM_RC_SUCCESS) {
+    #ifdef DEBUG_WOLFTPM
+        printf("TPM2_Unseal failed %d: %s\n", rc, wolfTPM2_GetRCString(rc));
+    #endif
+        return rc;
+    }
+
+    if (unsealOut.outData.size != WOLFTPM2_ENVELOPE_KEY_SZ) {
+        rc = BUFFER_E;
+    }
+    else {
+        rc = wolfTPM2_EnvelopeSetKey(env, unsealOut.outData.buffer,
+            unsealOut.outData.size);
+    }
+    TPM2_ForceZero(&unsealOut, (word32)sizeof(unsealOut));
+
+    return rc;
+}
+
+int wolfTPM2_EnvelopeGetHeader(WOLFTPM2_ENVELOPE* env, byte* buffer,
+    word32 bufferSz)
+{
+    int rc;
+    word32 pos = 0;
+
+    if (env == NULL || buffer == NULL) {
+        return BAD_FUNC_ARG;
+    }
+    if (bufferSz <= WOLFTPM2_ENVELOPE_HDR_SZ) {
+        return BUFFER_E;
+    }
+
+    rc = wolfTPM2_GetKeyBlobAsBuffer(buffer + WOLFTPM2_ENVELOPE_HDR_SZ,
+        bufferSz - WOLFTPM2_ENVELOPE_HDR_SZ, &env->sealBlob);
+    if (rc < 0) {
+        return rc;
+    }
+
+    buffer[pos++] = (byte)(WOLFTPM2_ENVELOPE_MAGIC >> 24);
+    buffer[pos++] = (byte)(WOLFTPM2_ENVELOPE_MAGIC >> 16);
+    buffer[pos++] = (byte)(WOLFTPM2_ENVELOPE_MAGIC >> 8);
+    buffer[pos++] = (byte)(WOLFTPM2_ENVELOPE_MAGIC);
+    buffer[pos++] = WOLFTPM2_ENVELOPE_VERSION;
+    XMEMCPY(&buffer[pos], env->iv, WOLFTPM2_ENVELOPE_IV_SZ);
+    pos += WOLFTPM2_ENVELOPE_IV_SZ;
+    buffer[pos++] = (byte)(rc >> 8);
+    buffer[pos++] = (byte)(rc);
+    pos += (word32)rc;
+
+    rc = wolfTPM2_EnvelopeBindHeader(env, buffer, pos);
+    if (rc != 0) {
+        return rc;
+    }
+
+    return (int)pos;
+}
+
+int wolfTPM2_EnvelopeSetHeader(WOLFTPM2_ENVELOPE* env, const byte* buffer,
+    word32 bufferSz)
+{
+    int rc;
+    word32 pos = 0, magic, blobSz;
+
+    if (env == NULL || buffer == NULL) {
+        return BAD_FUNC_ARG;
+    }
+    if (bufferSz < WOLFTPM2_ENVELOPE_HDR_SZ) {
+        return BUFFER_E;
+    }
+
+    magic = ((word32)buffer[0] << 24) | ((word32)buffer[1] << 16) |
+            ((word32)buffer[2] << 8)  |  (word32)buffer[3];
+    pos += 4;
+    if (magic != WOLFTPM2_ENVELOPE_MAGIC ||
+            buffer[pos++] != WOLFTPM2_ENVELOPE_VERSION) {
+    #ifdef DEBUG_WOLFTPM
+        printf("wolfTPM2_EnvelopeSetHeader: Invalid header\n");
+    #endif
+        return BUFFER_E;
+    }
+
+    XMEMSET(env, 0, sizeof(WOLFTPM2_ENVELOPE));
+    XMEMCPY(env->iv, &buffer[pos], WOLFTPM2_ENVELOPE_IV_SZ);
+    pos += WOLFTPM2_ENVELOPE_IV_SZ;
+    blobSz = ((word32)buffer[pos] << 8) | buffer[pos+1];
+    pos += 2;
+    if (blobSz > bufferSz - pos) {
+        return BUFFER_E;
+    }
+
+    rc = wolfTPM2_SetKeyBlobFromBuffer(&env->sealBlob, (byte*)&buffer[pos],
+        blobSz);
+    if (rc != TPM_RC_SUCCESS) {
+        return rc;
+    }
+    pos += blobSz;
+
+    rc = wolfTPM2_EnvelopeBindHeader(env, buffer, pos);
+    if (rc != 0) {
+        return rc;
+    }
+
+    return (int)pos;
+}
+
+int wolfTPM2_EnvelopeEncrypt(WOLFTPM2_ENVELOPE* env, const byte* in,
+    word32 inSz, byte* out, byte* tag, int isFinal)
+{
+    int rc;
+    byte nonce[WOLFTPM2_ENVELOPE_IV_SZ];
+
+    if (env == NULL || (in == NULL && inSz > 0) || (out == NULL && inSz > 0) ||
+            tag == NULL || !env->aesInit || env->isFinal ||
+            env->chunkIdx == 0xFFFFFFFFUL) {
+        return BAD_FUNC_ARG;
+    }
+
+    wolfTPM2_EnvelopeNonce(env, nonce);
+    env->aad[WOLFTPM2_ENVELOPE_AAD_SZ-1] = (byte)(isFinal ? 1 : 0);
+    rc = wc_AesGcmEncrypt(&env->aes, out, in, inSz, nonce, sizeof(nonce),
+        tag, WOLFTPM2_ENVELOPE_TAG_SZ, env->aad, sizeof(env->aad));
+    if (rc == 0) {
+        env->chunkIdx++;
+        env->isFinal = (isFinal != 0);
+    }
+
+    return rc;
+}
+
+int wolfTPM2_EnvelopeDecrypt(WOLFTPM2_ENVELOPE* env, const byte* in,
+    word32 inSz, byte* out, const byte* tag, int isFinal)
+{
+    int rc;
+    byte nonce[WOLFTPM2_ENVELOPE_IV_SZ];
+
+    if (env == NULL || (in == NULL && inSz > 0) || (out == NULL && inSz > 0) ||
+            tag == NULL || !env->aesInit || env->isFinal ||
+            env->chunkIdx == 0xFFFFFFFFUL) {
+        return BAD_FUNC_ARG;
+    }
+
+    wolfTPM2_EnvelopeNonce(env, nonce);
+    env->aad[WOLFTPM2_ENVELOPE_AAD_SZ-1] = (byte)(isFinal ? 1 : 0);
+    rc = wc_AesGcmDecrypt(&env->aes, out, in, inSz, nonce, sizeof(nonce),
+        tag, WOLFTPM2_ENVELOPE_TAG_SZ, env->aad, sizeof(env->aad));
+    if (rc == 0) {
+        env->chunkIdx++;
+        env->isFinal = (isFinal != 0);
+    }
+#ifdef DEBUG_WOLFTPM
+    else {
+        printf("wolfTPM2_EnvelopeDecrypt: Chunk %d failed %d\n",
+            (int)env->chunkIdx, rc);
+    }
+#endif
+
+    return rc;
+}
+
+int wolfTPM2_EnvelopeFree(WOLFTPM2_ENVELOPE* env)
+{
+    if (env == NULL) {
+        return BAD_FUNC_ARG;
+    }
+    if (env->aesInit) {
+        wc_AesFree(&env->aes);
+    }
+    TPM2_ForceZero(env, (word32)sizeof(WOLFTPM2_ENVELOPE));
+    return TPM_RC_SUCCESS;
+}
+
+#endif /* !WOLFTPM2_NO_WOLFCRYPT && HAVE_AESGCM && !NO_SHA256 */
+
+/******************************************************************************/
+/* --- END Envelope Encryption -- */
+/******************************************************************************/
+
+
+/******************************************************************************/
+/* --- BEGIN Persistent Public Cache -- */
+/******************************************************************************/
+
+/* Export: magic (4) | resetCount (4) | count (2) | entries of:
+ *   handle (4) | name size (2) | name | marshalled TPM2B_PUBLIC */
+#define WOLFTPM2_PUBCACHE_HDR_SZ (4 + 4 + 2)
+
+static word32 wolfTPM2_PubCacheGetU32(const byte* buf)
+{
+    return ((word32)buf[0] << 24) | ((word32)buf[1] << 16) |
+           ((word32)buf[2] << 8)  |  (word32)buf[3];
+}
+
+int wolfTPM2_PubCacheImport(WOLFTPM2_PUBCACHE* cache, const byte* buf,
+    word32 bufSz)
+{
+    int rc = TPM_RC_SUCCESS;
+    word32 pos, count, i, sz;
+    byte pubBuf[sizeof(TPM2B_PUBLIC)];
+    int pubSz;
+    WOLFTPM2_PUBCACHE_ENTRY* entry;
+
+    if (cache == NULL || (buf == NULL && bufSz > 0))
+        return BAD_FUNC_ARG;
+
+    XMEMSET(cache, 0, sizeof(WOLFTPM2_PUBCACHE));
+    if (buf == NULL || bufSz == 0)
+        return TPM_RC_SUCCESS;
+
+    if (bufSz < WOLFTPM2_PUBCACHE_HDR_SZ ||
+            wolfTPM2_PubCacheGetU32(buf) != WOLFTPM2_PUBCACHE_MAGIC) {
+        return BUFFER_E;
+    }
+    cache->resetCount = wolfTPM2_PubCacheGetU32(&buf[4]);
+    count = ((word32)buf[8] << 8) | buf[9];
+    pos = WOLFTPM2_PUBCACHE_HDR_SZ;
+    if (count > WOLFTPM2_PUBCACHE_MAX)
+        rc = BUFFER_E;
+
+    for (i = 0; rc == TPM_RC_SUCCESS && i < count; i++) {
+        entry = &cache->entry[i];
+        if (pos + 4 + 2 > bufSz) {
+            rc = BUFFER_E;
+            break;
+        }
+        entry->hndl = wolfTPM2_PubCacheGetU32(&buf[pos]);
+        sz = ((word32)buf[pos+4] << 8) | buf[pos+5];
+        pos += 4 + 2;
+        if (sz > sizeof(entry->name.name) || pos + sz + 2 > bufSz) {
+            rc = BUFFER_E;
+            break;
+        }
+        entry->name.size = (UINT16)sz;
+        XMEMCPY(entry->name.name, &buf[pos], sz);
+        pos += sz;
+
+        /* public area is prefixed by its own size */
+        sz = 2 + (((word32)buf[pos] << 8) | buf[pos+1]);
+        if (sz > sizeof(pubBuf) || pos + sz > bufSz) {
+            rc = BUFFER_E;
+            break;
+        }
+        XMEMSET(pubBuf, 0, sizeof(pubBuf));
+        XMEMCPY(pubBuf, &buf[pos], sz);
+        rc = TPM2_ParsePublic(&entry->pub, pubBuf, (word32)sizeof(pubBuf),
+            &pubSz);
+        if (rc == TPM_RC_SUCCESS && (word32)pubSz != sz)
+            rc = BUFFER_E;
+        pos += sz;
+    }
+    if (rc == TPM_RC_SUCCESS && pos != bufSz)
+        rc = BUFFER_E;
+
+    if (rc != TPM_RC_SUCCESS) {
+    #ifdef DEBUG_WOLFTPM
+        printf("Public cache import failed %d, starting empty\n", rc);
+    #endif
+        XMEMSET(cache, 0, sizeof(WOLFTPM2_PUBCACHE));
+        return rc;
+    }
+    cache->count = count;
+    return rc;
+}
+
+int wolfTPM2_PubCacheExport(WOLFTPM2_PUBCACHE* cache, byte* buf,
+    word32 bufSz)
+{
+    int rc;
+    word32 pos, i;
+    byte pubBuf[sizeof(TPM2B_PUBLIC)];
+    int pubSz;
+    WOLFTPM2_PUBCACHE_ENTRY* entry;
+
+    if (cache == NULL || buf == NULL)
+        return BAD_FUNC_ARG;
+    if (bufSz < WOLFTPM2_PUBCACHE_HDR_SZ)
+        return BUFFER_E;
+
+    TPM2_Packet_U32ToByteArray(WOLFTPM2_PUBCACHE_MAGIC, buf);
+    TPM2_Packet_U32ToByteArray(cache->resetCount, &buf[4]);
+    TPM2_Packet_U16ToByteArray((UINT16)cache->count, &buf[8]);
+    pos = WOLFTPM2_PUBCACHE_HDR_SZ;
+
+    for (i = 0; i < cache->count; i++) {
+        entry = &cache->entry[i];
+        rc = TPM2_AppendPublic(pubBuf, (word32)sizeof(pubBuf), &pubSz,
+            &entry->pub);
+        if (rc != TPM_RC_SUCCESS)
+            return rc;
+        if (pos + 4 + 2 + entry->name.size + (word32)pubSz > bufSz)
+            return BUFFER_E;
+
+        TPM2_Packet_U32ToByteArray(entry->hndl, &buf[pos]);
+        TPM2_Packet_U16ToByteArray(entry->name.size, &buf[pos+4]);
+        pos += 4 + 2;
+        XMEMCPY(&buf[pos], entry->name.name, entry->name.size);
+        pos += entry->name.size;
+        XMEMCPY(&buf[pos], pubBuf, pubSz);
+        pos += pubSz;
+    }
+
+    cache->isDirty = 0;
+    return (int)pos;
+}
+
+int wolfTPM2_PubCacheValidate(WOLFTPM2_DEV* dev, WOLFTPM2_PUBCACHE* cache)
+{
+    int rc;
+    word32 i, j, count;
+    ReadClock_Out clockOut;
+    GetCapability_In capIn;
+    GetCapability_Out capOut;
+    TPML_HANDLE* handles;
+
+    if (dev == NULL || cache == NULL)
+        return BAD_FUNC_ARG;
+
+    XMEMSET(&clockOut, 0, sizeof(clockOut));
+    rc = TPM2_ReadClock(&clockOut);
+    if (rc != TPM_RC_SUCCESS) {
+    #ifdef DEBUG_WOLFTPM
+        printf("TPM2_ReadClock failed %d: %s\n", rc, wolfTPM2_GetRCString(rc));
+    #endif
+        return rc;
+    }
+    if (clockOut.currentTime.clockInfo.resetCount != cache->resetCount) {
+        /* TPM was reset or cleared since the cache was written */
+        if (cache->count > 0)
+            cache->isDirty = 1;
+        cache->count = 0;
+        cache->resetCount = clockOut.currentTime.clockInfo.resetCount;
+    }
+
+    if (cache->count > 0) {
+        XMEMSET(&capIn, 0, sizeof(capIn));
+        capIn.capability = TPM_CAP_HANDLES;
+        capIn.property = PERSISTENT_FIRST;
+        capIn.propertyCount = MAX_CAP_HANDLES;
+        rc = TPM2_GetCapability(&capIn, &capOut);
+        if (rc != TPM_RC_SUCCESS) {
+        #ifdef DEBUG_WOLFTPM
+            printf("TPM2_GetCapability handles failed %d: %s\n", rc,
+                wolfTPM2_GetRCString(rc));
+        #endif
+            return rc;
+        }
+        handles = &capOut.capabilityData.data.handles;
+
+        /* drop entries for evicted keys, if the list is partial (moreData)
+         * keep entries past the last handle returned */
+        for (i = 0, count = 0; i < cache->count; i++) {
+            int found = 0;
+            for (j = 0; j < handles->count; j++) {
+                if (handles->handle[j] == cache->entry[i].hndl) {
+                    found = 1;
+                    break;
+                }
+            }
+            if (!found && capOut.moreData && handles->count > 0 &&
+                    cache->entry[i].hndl > handles->handle[handles->count-1]) {
+                found = 1;
+            }
+            if (found) {
+                if (count != i) {
+                    XMEMCPY(&cache->entry[count], &cache->entry[i],
+                        sizeof(WOLFTPM2_PUBCACHE_ENTRY));
+                }
+                count++;
+            }
+        }
+        if (count != cache->count) {
+            cache->count = count;
+            cache->isDirty = 1;
+        }
+    }
+
+    cache->isValid = 1;
+    dev->pubCache = cache;
+    return TPM_RC_SUCCESS;
+}
+
+int wolfTPM2_PubCacheReadPublicKey(WOLFTPM2_DEV* dev, WOLFTPM2_PUBCACHE* cache,
+    WOLFTPM2_KEY* key, const TPM_HANDLE handle)
+{
+    int rc;
+    word32 i;
+    WOLFTPM2_PUBCACHE_ENTRY* entry;
+
+    if (dev == NULL || cache == NULL || key == NULL)
+        return BAD_FUNC_ARG;
+
+    /* only persistent keys are stable across processes */
+    if (handle < PERSISTENT_FIRST || handle > PERSISTENT_LAST)
+        return wolfTPM2_ReadPublicKey(dev, key, handle);
+
+    if (!cache->isValid) {
+        rc = wolfTPM2_PubCacheValidate(dev, cache);
+        if (rc != TPM_RC_SUCCESS)
+            return rc;
+    }
+
+    for (i = 0; i < cache->count; i++) {
+        entry = &cache->entry[i];
+        if (entry->hndl == handle) {
+            key->handle.hndl = handle;
+            wolfTPM2_CopySymmetric(&key->handle.symmetric,
+                &entry->pub.publicArea.parameters.asymDetail.symmetric);
+            wolfTPM2_CopyName(&key->handle.name, &entry->name);
+            wolfTPM2_CopyPub(&key->pub, &entry->pub);
+        #ifdef DEBUG_WOLFTPM
+            printf("Public cache hit for handle 0x%x\n", (word32)handle);
+        #endif
+            return TPM_RC_SUCCESS;
+        }
+    }
+
+    rc = wolfTPM2_ReadPublicKey(dev, key, handle);
+    if (rc == TPM_RC_SUCCESS && cache->count < WOLFTPM2_PUBCACHE_MAX) {
+        entry = &cache->entry[cache->count++];
+        entry->hndl = handle;
+        wolfTPM2_CopyName(&entry->name, &key->handle.name);
+        wolfTPM2_CopyPub(&entry->pub, &key->pub);
+        cache->isDirty = 1;
+    }
+    return rc;
+}
+
+/******************************************************************************/
+/* --- END Persistent Public Cache -- */
+/******************************************************************************/
+
+
+/******************************************************************************/
+/* --- BEGIN Context Save and Restore -- */
+/******************************************************************************/
+
+/* Export format (big endian):
+ *   magic (4) | version (1) | type (1) |
+ *   context: sequence (8) | savedHandle (4) | hierarchy (4) | blob (2B) |
+ *   handle:  sym alg (2) | sym bits (2) | sym mode (2) |
+ *            name (2B) | policyAuth (1) |
+ *   key:     public (2B marshalled TPMT_PUBLIC)
+ *   session: type (1) | authHash (2) | attributes (1) | nonceTPM (2B)
+ *   hash:    hashAlg (2) | isPending (1) | buffer (2B)
+ * No secrets are exported: the handle auth, session key and salt stay with
+ * the caller. nonceTPM is public (sent in the clear in each response) and
+ * a fresh nonceCaller is generated on load.
+ * 2B = 2 byte size followed by data */
+enum {
+    WOLFTPM2_CONTEXT_KEY     = 1,
+    WOLFTPM2_CONTEXT_SESSION = 2,
+    WOLFTPM2_CONTEXT_HASH    = 3,
+};
+
+static int wolfTPM2_CtxPut(byte* out, word32 outSz, word32* pos,
+    const byte* data, word32 sz)
+{
+    if (*pos + sz > outSz)
+        return BUFFER_E;
+    if (sz > 0)
+        XMEMCPY(&out[*pos], data, sz);
+    *pos += sz;
+    return 0;
+}
+static int wolfTPM2_CtxPutU16(byte* out, word32 outSz, word32* pos, UINT16 v)
+{
+    byte b[2];
+    TPM2_Packet_U16ToByteArray(v, b);
+    return wolfTPM2_CtxPut(out, outSz, pos, b, sizeof(b));
+}
+static int wolfTPM2_CtxPutU32(byte* out, word32 outSz, word32* pos, UINT32 v)
+{
+    byte b[4];
+    TPM2_Packet_U32ToByteArray(v, b);
+    return wolfTPM2_CtxPut(out, outSz, pos, b, sizeof(b));
+}
+static int wolfTPM2_CtxPut2B(byte* out, word32 outSz, word32* pos,
+    const byte* data, UINT16 sz)
+{
+    int rc = wolfTPM2_CtxPutU16(out, outSz, pos, sz);
+    if (rc == 0)
+        rc = wolfTPM2_CtxPut(out, outSz, pos, data, sz);
+    return rc;
+}
+
+static int wolfTPM2_CtxGet(const byte* in, word32 inSz, word32* pos,
+    byte* data, word32 sz)
+{
+    if (*pos + sz > inSz)
+        return BUFFER_E;
+    if (sz > 0)
+        XMEMCPY(data, &in[*pos], sz);
+    *pos += sz;
+    return 0;
+}
+static int wolfTPM2_CtxGetU16(const byte* in, word32 inSz, word32* pos,
+    UINT16* v)
+{
+    byte b[2];
+    int rc = wolfTPM2_CtxGet(in, inSz, pos, b, sizeof(b));
+    if (rc == 0)
+        *v = (UINT16)(((UINT16)b[0] << 8) | b[1]);
+    return rc;
+}
+static int wolfTPM2_CtxGetU32(const byte* in, word32 inSz, word32* pos,
+    UINT32* v)
+{
+    byte b[4];
+    int rc = wolfTPM2_CtxGet(in, inSz, pos, b, sizeof(b));
+    if (rc == 0)
+        *v = ((UINT32)b[0] << 24) | ((UINT32)b[1] << 16) |
+             ((UINT32)b[2] << 8)  |  (UINT32)b[3];
+    return rc;
+}
+static int wolfTPM2_CtxGet2B(const byte* in, word32 inSz, word32* pos,
+    byte* data, UINT16* sz, word32 maxSz)
+{
+    int rc = wolfTPM2_CtxGetU16(in, inSz, pos, sz);
+    if (rc == 0 && *sz > maxSz)
+        rc = BUFFER_E;
+    if (rc == 0)
+        rc = wolfTPM2_CtxGet(in, inSz, pos, data, *sz);
+    return rc;
+}
+
+int wolfTPM2_ContextSave(WOLFTPM2_DEV* dev, WOLFTPM2_HANDLE* handle,
+    TPMS_CONTEXT* context)
+{
+    int rc;
+    ContextSave_In in;
+    ContextSave_Out out;
+
+    if (dev == NULL || handle == NULL || context == NULL)
+        return BAD_FUNC_ARG;
+
+    XMEMSET(&in, 0, sizeof(in));
+    in.saveHandle = handle->hndl;
+    rc = TPM2_ContextSave(&in, &out);
+    if (rc != TPM_RC_SUCCESS) {
+    #ifdef DEBUG_WOLFTPM
+        printf("TPM2_ContextSave failed %d: %s\n", rc,
+            wolfTPM2_GetRCString(rc));
+    #endif
+        return rc;
+    }
+    XMEMCPY(context, &out.context, sizeof(TPMS_CONTEXT));
+
+#ifdef DEBUG_WOLFTPM
+    printf("TPM2_ContextSave: handle 0x%x, %d bytes\n", (word32)handle->hndl,
+        out.context.contextBlob.size);
+#endif
+    return rc;
+}
+
+int wolfTPM2_ContextLoad(WOLFTPM2_DEV* dev, TPMS_CONTEXT* context,
+    WOLFTPM2_HANDLE* handle)
+{
+    int rc;
+    ContextLoad_In in;
+    ContextLoad_Out out;
+
+    if (dev == NULL || handle == NULL || context == NULL)
+        return BAD_FUNC_ARG;
+
+    XMEMSET(&in, 0, sizeof(in));
+    XMEMCPY(&in.context, context, sizeof(TPMS_CONTEXT));
+    rc = TPM2_ContextLoad(&in, &out);
+    if (rc != TPM_RC_SUCCESS) {
+    #ifdef DEBUG_WOLFTPM
+        printf("TPM2_ContextLoad failed %d: %s\n", rc,
+            wolfTPM2_GetRCString(rc));
+    #endif
+        return rc;
+    }
+    handle->hndl = out.loadedHandle;
+
+#ifdef DEBUG_WOLFTPM
+    printf("TPM2_ContextLoad: handle 0x%x\n", (word32)handle->hndl);
+#endif
+    return rc;
+}
+
+/* Save the TPM context of handle (if any) and write the common header */
+static int wolfTPM2_ContextExport(WOLFTPM2_DEV* dev, byte type,
+    WOLFTPM2_HANDLE* handle, int saveContext, byte* buf, word32 bufSz,
+    word32* pos)
+{
+    int rc = 0;
+    TPMS_CONTEXT context;
+
+    XMEMSET(&context, 0, sizeof(context));
+    if (saveContext) {
+        rc = wolfTPM2_ContextSave(dev, handle, &context);
+    }
+
+    *pos = 0;
+    if (rc == 0)
+        rc = wolfTPM2_CtxPutU32(buf, bufSz, pos, WOLFTPM2_CONTEXT_MAGIC);
+    if (rc == 0) {
+        byte hdr[2];
+        hdr[0] = WOLFTPM2_CONTEXT_VERSION;
+        hdr[1] = type;
+        rc = wolfTPM2_CtxPut(buf, bufSz, pos, hdr, sizeof(hdr));
+    }
+    if (rc == 0) {
+        rc = wolfTPM2_CtxPutU32(buf, bufSz, pos, (UINT32)(context.sequence >> 32));
+        if (rc == 0)
+            rc = wolfTPM2_CtxPutU32(buf, bufSz, pos, (UINT32)context.sequence);
+    }
+    if (rc == 0)
+        rc = wolfTPM2_CtxPutU32(buf, bufSz, pos, context.savedHandle);
+    if (rc == 0)
+        rc = wolfTPM2_CtxPutU32(buf, bufSz, pos, context.hierarchy);
+    if (rc == 0)
+        rc = wolfTPM2_CtxPut2B(buf, bufSz, pos, context.contextBlob.buffer,
+            context.contextBlob.size);
+
+    if (rc == 0)
+        rc = wolfTPM2_CtxPutU16(buf, bufSz, pos, handle->symmetric.algorithm);
+    if (rc == 0)
+        rc = wolfTPM2_CtxPutU16(buf, bufSz, pos, handle->symmetric.keyBits.sym);
+    if (rc == 0)
+        rc = wolfTPM2_CtxPutU16(buf, bufSz, pos, handle->symmetric.mode.sym);
+    if (rc == 0)
+        rc = wolfTPM2_CtxPut2B(buf, bufSz, pos, handle->name.name,
+            handle->name.size);
+    if (rc == 0) {
+        byte policyAuth = (byte)(handle->policyAuth != 0);
+        rc = wolfTPM2_CtxPut(buf, bufSz, pos, &policyAuth, 1);
+    }
+
+    TPM2_ForceZero(&context, sizeof(context));
+    return rc;
+}
+
+/* Parse the common header and load the TPM context (if any) into handle */
+static int wolfTPM2_ContextImport(WOLFTPM2_DEV* dev, byte type,
+    WOLFTPM2_HANDLE* handle, const byte* buf, word32 bufSz, word32* pos)
+{
+    int rc;
+    UINT32 magic = 0, seqHi = 0, seqLo = 0;
+    byte hdr[2];
+    byte policyAuth = 0;
+    TPMS_CONTEXT context;
+
+    XMEMSET(&context, 0, sizeof(context));
+    *pos = 0;
+    rc = wolfTPM2_CtxGetU32(buf, bufSz, pos, &magic);
+    if (rc == 0)
+        rc = wolfTPM2_CtxGet(buf, bufSz, pos, hdr, sizeof(hdr));
+    if (rc == 0 && (magic != WOLFTPM2_CONTEXT_MAGIC ||
+            hdr[0] != WOLFTPM2_CONTEXT_VERSION || hdr[1] != type)) {
+        rc = BAD_FUNC_ARG;
+    }
+    if (rc == 0)
+        rc = wolfTPM2_CtxGetU32(buf, bufSz, pos, &seqHi);
+    if (rc == 0)
+        rc = wolfTPM2_CtxGetU32(buf, bufSz, pos, &seqLo);
+    context.sequence = ((UINT64)seqHi << 32) | seqLo;
+    if (rc == 0)
+        rc = wolfTPM2_CtxGetU32(buf, bufSz, pos, &context.savedHandle);
+    if (rc == 0)
+        rc = wolfTPM2_CtxGetU32(buf, bufSz, pos, &context.hierarchy);
+    if (rc == 0)
+        rc = wolfTPM2_CtxGet2B(buf, bufSz, pos, context.contextBlob.buffer,
+            &context.contextBlob.size, sizeof(context.contextBlob.buffer));
+
+    XMEMSET(handle, 0, sizeof(WOLFTPM2_HANDLE));
+    if (rc == 0)
+        rc = wolfTPM2_CtxGetU16(buf, bufSz, pos, &handle->symmetric.algorithm);
+    if (rc == 0)
+        rc = wolfTPM2_CtxGetU16(buf, bufSz, pos, &handle->symmetric.keyBits.sym);
+    if (rc == 0)
+        rc = wolfTPM2_CtxGetU16(buf, bufSz, pos, &handle->symmetric.mode.sym);
+    if (rc == 0)
+        rc = wolfTPM2_CtxGet2B(buf, bufSz, pos, handle->name.name,
+            &handle->name.size, sizeof(handle->name.name));
+    if (rc == 0)
+        rc = wolfTPM2_CtxGet(buf, bufSz, pos, &policyAuth, 1);
+    handle->policyAuth = policyAuth;
+
+    if (rc == 0 && context.savedHandle != 0) {
+        rc = wolfTPM2_ContextLoad(dev, &context, handle);
+    }
+
+    TPM2_ForceZero(&context, sizeof(context));
+    return rc;
+}
+
+int wolfTPM2_SaveKeyContext(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* key,
+    byte* buf, word32 bufSz)
+{
+    int rc;
+    word32 pos = 0;
+    byte pubBuf[sizeof(TPM2B_PUBLIC)];
+    int pubSz = 0;
+
+    if (dev == NULL || key == NULL || buf == NULL)
+        return BAD_FUNC_ARG;
+
+    rc = TPM2_AppendPublic(pubBuf, (word32)sizeof(pubBuf), &pubSz, &key->pub);
+    if (rc == 0) {
+        rc = wolfTPM2_ContextExport(dev, WOLFTPM2_CONTEXT_KEY, &key->handle, 1,
+            buf, bufSz, &pos);
+    }
+    if (rc == 0) {
+        /* marshalled public already has its size prefix */
+        rc = wolfTPM2_CtxPut(buf, bufSz, &pos, pubBuf, (word32)pubSz);
+    }
+    return (rc == 0) ? (int)pos : rc;
+}
+
+int wolfTPM2_LoadKeyContext(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* key,
+    const byte* buf, word32 bufSz)
+{
+    int rc;
+    word32 pos = 0;
+    UINT16 pubSz = 0;
+    byte pubBuf[sizeof(TPM2B_PUBLIC)];
+    int sizeUsed = 0;
+
+    if (dev == NULL || key == NULL || buf == NULL)
+        return BAD_FUNC_ARG;
+
+    XMEMSET(key, 0, sizeof(WOLFTPM2_KEY));
+    XMEMSET(pubBuf, 0, sizeof(pubBuf));
+    rc = wolfTPM2_ContextImport(dev, WOLFTPM2_CONTEXT_KEY, &key->handle,
+        buf, bufSz, &pos);
+    if (rc == 0) {
+        rc = wolfTPM2_CtxGet2B(buf, bufSz, &pos, &pubBuf[2], &pubSz,
+            sizeof(pubBuf) - 2);
+    }
+    if (rc == 0) {
+        TPM2_Packet_U16ToByteArray(pubSz, pubBuf);
+        rc = TPM2_ParsePublic(&key->pub, pubBuf, (word32)sizeof(pubBuf),
+            &sizeUsed);
+    }
+    if (rc == 0 && pos != bufSz)
+        rc = BUFFER_E;
+    if (rc != 0 && key->handle.hndl != 0) {
+        wolfTPM2_UnloadHandle(dev, &key->handle);
+    }
+    return rc;
+}
+
+int wolfTPM2_SaveSessionContext(WOLFTPM2_DEV* dev, WOLFTPM2_SESSION* session,
+    byte* buf, word32 bufSz)
+{
+    int rc;
+    word32 pos = 0;
+    byte b[2];
+
+    if (dev == NULL || session == NULL || buf == NULL)
+        return BAD_FUNC_ARG;
+    /* a salted or bound session key cannot be restored without exporting
+     * it, so only unsalted and unbound sessions are supported */
+    if (session->handle.auth.size > 0 || session->salt.size > 0)
+        return BAD_FUNC_ARG;
+
+    /* password "sessions" have no TPM state */
+    rc = wolfTPM2_ContextExport(dev, WOLFTPM2_CONTEXT_SESSION, &session->handle,
+        session->type != TPM_SES_PWD, buf, bufSz, &pos);
+    if (rc == 0) {
+        b[0] = (byte)session->type;
+        rc = wolfTPM2_CtxPut(buf, bufSz, &pos, b, 1);
+    }
+    if (rc == 0)
+        rc = wolfTPM2_CtxPutU16(buf, bufSz, &pos, session->authHash);
+    if (rc == 0) {
+        b[0] = (byte)session->sessionAttributes;
+        rc = wolfTPM2_CtxPut(buf, bufSz, &pos, b, 1);
+    }
+    if (rc == 0)
+        rc = wolfTPM2_CtxPut2B(buf, bufSz, &pos, session->nonceTPM.buffer,
+            session->nonceTPM.size);
+    return (rc == 0) ? (int)pos : rc;
+}
+
+int wolfTPM2_LoadSessionContext(WOLFTPM2_DEV* dev, WOLFTPM2_SESSION* session,
+    const byte* buf, word32 bufSz)
+{
+    int rc;
+    word32 pos = 0;
+    byte b[2] = {0, 0};
+
+    if (dev == NULL || session == NULL || buf == NULL)
+        return BAD_FUNC_ARG;
+
+    XMEMSET(session, 0, sizeof(WOLFTPM2_SESSION));
+    rc = wolfTPM2_ContextImport(dev, WOLFTPM2_CONTEXT_SESSION, &session->handle,
+        buf, bufSz, &pos);
+    if (rc == 0)
+        rc = wolfTPM2_CtxGet(buf, bufSz, &pos, b, 1);
+    session->type = b[0];
+    if (rc == 0)
+        rc = wolfTPM2_CtxGetU16(buf, bufSz, &pos, &session->authHash);
+    if (rc == 0)
+        rc = wolfTPM2_CtxGet(buf, bufSz, &pos, b, 1);
+    session->sessionAttributes = b[0];
+    if (rc == 0)
+        rc = wolfTPM2_CtxGet2B(buf, bufSz, &pos, session->nonceTPM.buffer,
+            &session->nonceTPM.size, sizeof(session->nonceTPM.buffer));
+    if (rc == 0 && pos != bufSz)
+        rc = BUFFER_E;
+    if (rc == 0 && session->type != TPM_SES_PWD) {
+        int digestSz = TPM2_GetHashDigestSize(session->authHash);
+        if (digestSz <= 0 ||
+                digestSz > (int)sizeof(session->nonceCaller.buffer)) {
+            rc = BUFFER_E;
+        }
+        else {
+            session->nonceCaller.size = (UINT16)digestSz;
+            rc = TPM2_GetNonce(session->nonceCaller.buffer,
+                session->nonceCaller.size);
+        }
+    }
+    if (rc != 0 && session->handle.hndl != 0) {
+        wolfTPM2_UnloadHandle(dev, &session->handle);
+    }
+    return rc;
+}
+
+int wolfTPM2_SaveHashContext(WOLFTPM2_DEV* dev, WOLFTPM2_HASH* hash,
+    byte* buf, word32 bufSz)
+{
+    int rc;
+    word32 pos = 0;
+    byte isPending = 0;
+    TPMI_ALG_HASH hashAlg = TPM_ALG_NULL;
+    const byte* pending = &isPending;
+    UINT16 pendingSz = 0;
+
+    if (dev == NULL || hash == NULL || buf == NULL)
+        return BAD_FUNC_ARG;
+#ifdef WOLFTPM2_HASH_HYBRID
+    /* host digest state is internal to wolfCrypt and not exported */
+    if (hash->isHost)
+        return BAD_FUNC_ARG;
+    hashAlg = hash->hashAlg;
+    if (hash->isPending) {
+        isPending = 1;
+        pending = hash->buffer.buffer;
+        pendingSz = hash->buffer.size;
+    }
+#endif
+
+    rc = wolfTPM2_ContextExport(dev, WOLFTPM2_CONTEXT_HASH, &hash->handle,
+        !isPending, buf, bufSz, &pos);
+    if (rc == 0)
+        rc = wolfTPM2_CtxPutU16(buf, bufSz, &pos, hashAlg);
+    if (rc == 0)
+        rc = wolfTPM2_CtxPut(buf, bufSz, &pos, &isPending, 1);
+    if (rc == 0)
+        rc = wolfTPM2_CtxPut2B(buf, bufSz, &pos, pending, pendingSz);
+    return (rc == 0) ? (int)pos : rc;
+}
+
+int wolfTPM2_LoadHashContext(WOLFTPM2_DEV* dev, WOLFTPM2_HASH* hash,
+    const byte* buf, word32 bufSz)
+{
+    int rc;
+    word32 pos = 0;
+    byte isPending = 0;
+    TPMI_ALG_HASH hashAlg = TPM_ALG_NULL;
+#ifndef WOLFTPM2_HASH_HYBRID
+    UINT16 pendingSz = 0;
+#endif
+
+    if (dev == NULL || hash == NULL || buf == NULL)
+        return BAD_FUNC_ARG;
+
+    XMEMSET(hash, 0, sizeof(WOLFTPM2_HASH));
+    rc = wolfTPM2_ContextImport(dev, WOLFTPM2_CONTEXT_HASH, &hash->handle,
+        buf, bufSz, &pos);
+    if (rc == 0)
+        rc = wolfTPM2_CtxGetU16(buf, bufSz, &pos, &hashAlg);
+    if (rc == 0)
+        rc = wolfTPM2_CtxGet(buf, bufSz, &pos, &isPending, 1);
+#ifdef WOLFTPM2_HASH_HYBRID
+    hash->hashAlg = hashAlg;
+    hash->isPending = isPending ? 1 : 0;
+    if (rc == 0)
+        rc = wolfTPM2_CtxGet2B(buf, bufSz, &pos, hash->buffer.buffer,
+            &hash->buffer.size, sizeof(hash->buffer.buffer));
+#else
+    /* pending input needs WOLFTPM2_HASH_HYBRID to be held */
+    if (rc == 0 && isPending)
+        rc = BAD_FUNC_ARG;
+    if (rc == 0)
+        rc = wolfTPM2_CtxGet2B(buf, bufSz, &pos, &isPending, &pendingSz, 0);
+#endif
+    if (rc == 0 && pos != bufSz)
+        rc = BUFFER_E;
+    if (rc != 0 && hash->handle.hndl != 0) {
+        wolfTPM2_UnloadHandle(dev, &hash->handle);
+    }
+    return rc;
+}
+
+/******************************************************************************/
+/* --- END Context Save and Restore -- */
+/******************************************************************************/
+
+
+/******************************************************************************/
+/* --- BEGIN Device Pool -- */
+/******************************************************************************/
+
+#if !defined(WOLFTPM2_NO_WOLFCRYPT) && !defined(SINGLE_THREADED)
+    #define POOL_LOCK(pool)   (wc_LockMutex(&(pool)->lock) == 0 ? 0 : \
+                                  TPM_RC_FAILURE)
+    #define POOL_UNLOCK(pool) wc_UnLockMutex(&(pool)->lock)
+#else
+    #define POOL_LOCK(pool)   0
+    #define POOL_UNLOCK(pool)
+#endif
+
+int wolfTPM2_PoolInit(WOLFTPM2_POOL* pool, int policy,
+    WOLFTPM2_POOL_TIME_CB timeCb, void* timeCtx)
+{
+    if (pool == NULL || (policy != WOLFTPM2_POOL_ROUND_ROBIN &&
+                         policy != WOLFTPM2_POOL_LEAST_LOADED)) {
+        return BAD_FUNC_ARG;
+    }
+
+    XMEMSET(pool, 0, sizeof(*pool));
+    pool->policy = policy;
+    pool->timeCb = timeCb;
+    pool->timeCtx = timeCtx;
+#if !defined(WOLFTPM2_NO_WOLFCRYPT) && !defined(SINGLE_THREADED)
+    if (wc_InitMutex(&pool->lock) != 0) {
+    #ifdef DEBUG_WOLFTPM
+        printf("wolfTPM2_PoolInit: mutex init failed\n");
+    #endif
+        return TPM_RC_FAILURE;
+    }
+#endif
+    return TPM_RC_SUCCESS;
+}
+
+int wolfTPM2_PoolAdd(WOLFTPM2_POOL* pool, TPM2HalIoCb ioCb, void* userCtx)
+{
+    int rc, idx;
+    WOLFTPM2_POOL_DEV* member;
+
+    if (pool == NULL)
+        return BAD_FUNC_ARG;
+
+    rc = POOL_LOCK(pool);
+    if (rc != 0)
+        return rc;
+    idx = pool->count;
+    if (idx >= WOLFTPM2_POOL_MAX) {
+        POOL_UNLOCK(pool);
+        return BUFFER_E;
+    }
+    member = &pool->member[idx];
+    XMEMSET(member, 0, sizeof(*member));
+    /* reserve the slot while the TPM is opened */
+    member->isEjected = 1;
+    pool->count++;
+    POOL_UNLOCK(pool);
+
+    rc = wolfTPM2_Init(&member->dev, ioCb, userCtx);
+    if (rc == TPM_RC_SUCCESS) {
+        rc = POOL_LOCK(pool);
+        if (rc != 0) {
+            wolfTPM2_Cleanup(&member->dev);
+            return rc;
+        }
+        member->isOpen = 1;
+        member->isEjected = 0;
+        POOL_UNLOCK(pool);
+        rc = idx;
+    }
+    else {
+    #ifdef DEBUG_WOLFTPM
+        printf("wolfTPM2_PoolAdd: member %d init failed 0x%x: %s\n",
+            idx, rc, TPM2_GetRCString(rc));
+    #endif
+        /* release the slot if no other member was added meanwhile */
+        if (POOL_LOCK(pool) == 0) {
+            if (pool->count == idx + 1)
+                pool->count--;
+            POOL_UNLOCK(pool);
+        }
+    }
+    return rc;
+}
+
+int wolfTPM2_PoolAcquire(WOLFTPM2_POOL* pool, int owner,
+    WOLFTPM2_DEV** dev, word32* ticket)
+{
+    int rc, i, idx = -1;
+    WOLFTPM2_POOL_DEV* member;
+
+    if (pool == NULL || dev == NULL || ticket == NULL ||
+            owner < -1 || owner >= WOLFTPM2_POOL_MAX) {
+        return BAD_FUNC_ARG;
+    }
+
+    rc = POOL_LOCK(pool);
+    if (rc != 0)
+        return rc;
+
+    if (owner >= 0) {
+        /* key-bound operations must run on the TPM holding the key */
+        if (owner < pool->count && !pool->member[owner].isEjected)
+            idx = owner;
+    }
+    else if (pool->policy == WOLFTPM2_POOL_LEAST_LOADED) {
+        for (i = 0; i < pool->count; i++) {
+            member = &pool->member[i];
+            if (member->isEjected)
+                continue;
+            if (idx < 0 || member->inUse < pool->member[idx].inUse ||
+                    (member->inUse == pool->member[idx].inUse &&
+                     member->latencyMs < pool->member[idx].latencyMs)) {
+                idx = i;
+            }
+        }
+    }
+    else {
+        for (i = 0; i < pool->count; i++) {
+            int n = (pool->next + i) % pool->count;
+            if (!pool->member[n].isEjected) {
+                idx = n;
+                pool->next = (n + 1) % pool->count;
+                break;
+            }
+        }
+    }
+
+    if (idx < 0) {
+        POOL_UNLOCK(pool);
+    #ifdef DEBUG_WOLFTPM
+        printf("wolfTPM2_PoolAcquire: no healthy TPM (owner %d)\n", owner);
+    #endif
+        return TPM_RC_FAILURE;
+    }
+    member = &pool->member[idx];
+    member->inUse++;
+    POOL_UNLOCK(pool);
+
+    *ticket = (pool->timeCb != NULL) ? pool->timeCb(pool->timeCtx) : 0;
+    *dev = &member->dev;
+    TPM2_SetActiveCtx(&member->dev.ctx);
+    return idx;
+}
+
+int wolfTPM2_PoolRelease(WOLFTPM2_POOL* pool, int idx, word32 ticket, int rc)
+{
+    int lrc;
+    word32 elapsed;
+    WOLFTPM2_POOL_DEV* member;
+
+    if (pool == NULL || idx < 0 || idx >= WOLFTPM2_POOL_MAX)
+        return BAD_FUNC_ARG;
+
+    /* count changes under the lock in wolfTPM2_PoolAdd */
+    lrc = POOL_LOCK(pool);
+    if (lrc != 0)
+        return lrc;
+    if (idx >= pool->count) {
+        POOL_UNLOCK(pool);
+        return BAD_FUNC_ARG;
+    }
+    member = &pool->member[idx];
+
+    if (member->inUse > 0)
+        member->inUse--;
+    member->ops++;
+
+    /* IO errors and failure mode count against the device, TPM response
+     * codes for bad parameters or authorization do not */
+    if (rc < 0 || rc == TPM_RC_FAILURE) {
+        member->failures++;
+        member->errors++;
+        if (member->errors >= WOLFTPM2_POOL_MAX_ERRORS)
+            member->isEjected = 1;
+    }
+    else {
+        member->errors = 0;
+    }
+
+    if (pool->timeCb != NULL) {
+        elapsed = pool->timeCb(pool->timeCtx) - ticket;
+        /* exponential moving average, 1/8 weight for new sample */
+        if (member->latencyMs == 0)
+            member->latencyMs = elapsed;
+        else
+            member->latencyMs = member->latencyMs - (member->latencyMs >> 3) +
+                (elapsed >> 3);
+        if (pool->maxLatencyMs > 0 && member->latencyMs > pool->maxLatencyMs)
+            member->isEjected = 1;
+    }
+
+#ifdef DEBUG_WOLFTPM
+    if (member->isEjected) {
+        printf("wolfTPM2_PoolRelease: member %d ejected (errors %d, "
+            "latency %d ms)\n", idx, member->errors, member->latencyMs);
+    }
+#endif
+    POOL_UNLOCK(pool);
+    return TPM_RC_SUCCESS;
+}
+
+int wolfTPM2_PoolReinstate(WOLFTPM2_POOL* pool, int idx)
+{
+    int rc;
+    WOLFTPM2_POOL_DEV* member;
+
+    if (pool == NULL || idx < 0 || idx >= WOLFTPM2_POOL_MAX)
+        return BAD_FUNC_ARG;
+
+    rc = POOL_LOCK(pool);
+    if (rc != 0)
+        return rc;
+    member = &pool->member[idx];
+    if (idx >= pool->count || !member->isOpen) {
+        POOL_UNLOCK(pool);
+        return BAD_FUNC_ARG;
+    }
+    member->errors = 0;
+    member->latencyMs = 0;
+    member->isEjected = 0;
+    POOL_UNLOCK(pool);
+    return TPM_RC_SUCCESS;
+}
+
+int wolfTPM2_PoolGetRandom(WOLFTPM2_POOL* pool, byte* buf, word32 len)
+{
+    int rc, idx, tries;
+    word32 ticket;
+    WOLFTPM2_DEV* dev;
+
+    if (pool == NULL || buf == NULL)
+        return BAD_FUNC_ARG;
+
+    /* on a device failure try the next member */
+    for (tries = 0; tries < WOLFTPM2_POOL_MAX; tries++) {
+        idx = wolfTPM2_PoolAcquire(pool, -1, &dev, &ticket);
+        if (idx < 0)
+            return idx;
+        rc = wolfTPM2_GetRandom(dev, buf, len);
+        wolfTPM2_PoolRelease(pool, idx, ticket, rc);
+        if (rc >= 0 && rc != TPM_RC_FAILURE)
+            return rc;
+    }
+    return TPM_RC_FAILURE;
+}
+
+int wolfTPM2_PoolCleanup(WOLFTPM2_POOL* pool)
+{
+    int i;
+
+    if (pool == NULL)
+        return BAD_FUNC_ARG;
+
+    for (i = 0; i < pool->count; i++) {
+        if (pool->member[i].isOpen) {
+            wolfTPM2_Cleanup(&pool->member[i].dev);
+            pool->member[i].isOpen = 0;
+        }
+        pool->member[i].isEjected = 1;
+    }
+    pool->count = 0;
+#if !defined(WOLFTPM2_NO_WOLFCRYPT) && !defined(SINGLE_THREADED)
+    wc_FreeMutex(&pool->lock);
+#endif
+    return TPM_RC_SUCCESS;
+}
+
+/******************************************************************************/
+/* --- END Device Pool -- */
+/******************************************************************************/
+
 #endif /* !WOLFTPM2_NO_WRAPPER */
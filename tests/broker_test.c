@@ -0,0 +1,298 @@
+/* broker_test.c
+ *
+ * Copyright (C) 2006-2022 wolfSSL Inc.
+ *
+ * This file is part of wolfTPM.
+ *
+ * wolfTPM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfTPM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+/* End to end test of the broker daemon (examples/broker). Speaks the raw
+ * command protocol to a running broker from two clients. Started by
+ * scripts/broker.test */
+
+#include <wolftpm/tpm2.h>
+#include <wolftpm/tpm2_broker.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if !defined(_WIN32)
+
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define BROKER_TEST_WAIT_MS 5000
+
+#define Fail(...) do {                                                         \
+    printf("\nERROR - %s line %d: ", __FILE__, __LINE__);                      \
+    printf(__VA_ARGS__); printf("\n");                                         \
+    exit(1);                                                                   \
+} while(0)
+
+typedef struct TestCmd {
+    byte buf[MAX_RESPONSE_SIZE];
+    int  pos;
+} TestCmd;
+
+static void PutU16(TestCmd* c, word32 v)
+{
+    c->buf[c->pos++] = (byte)(v >> 8);
+    c->buf[c->pos++] = (byte)v;
+}
+
+static void PutU32(TestCmd* c, word32 v)
+{
+    PutU16(c, v >> 16);
+    PutU16(c, v & 0xFFFF);
+}
+
+static word32 GetU32(const byte* p)
+{
+    return ((word32)p[0] << 24) | ((word32)p[1] << 16) |
+           ((word32)p[2] << 8)  |  (word32)p[3];
+}
+
+/* starts a command, the size is filled by CmdEnd */
+static void CmdStart(TestCmd* c, TPM_ST tag, TPM_CC cc)
+{
+    c->pos = 0;
+    PutU16(c, tag);
+    PutU32(c, 0);
+    PutU32(c, cc);
+}
+
+static void CmdEnd(TestCmd* c)
+{
+    int pos = c->pos;
+    c->pos = 2;
+    PutU32(c, (word32)pos);
+    c->pos = pos;
+}
+
+static int Connect(const char* path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    XMEMSET(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    XMEMCPY(addr.sun_path, path, XSTRLEN(path));
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+        Fail("connect %s errno %d", path, errno);
+    return fd;
+}
+
+static void Send(int fd, const byte* buf, int sz)
+{
+    ssize_t r;
+    while (sz > 0) {
+        r = write(fd, buf, sz);
+        if (r <= 0)
+            Fail("write errno %d", errno);
+        buf += r;
+        sz -= (int)r;
+    }
+}
+
+static void Recv(int fd, byte* buf, int sz)
+{
+    struct pollfd pfd;
+    ssize_t r;
+    while (sz > 0) {
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, BROKER_TEST_WAIT_MS) != 1)
+            Fail("no response from broker");
+        r = read(fd, buf, sz);
+        if (r <= 0)
+            Fail("read errno %d", errno);
+        buf += r;
+        sz -= (int)r;
+    }
+}
+
+/* sends the command and returns the response code, response left in c */
+static TPM_RC Run(int fd, TestCmd* c)
+{
+    word32 rspSz;
+
+    Send(fd, c->buf, c->pos);
+    Recv(fd, c->buf, TPM2_HEADER_SIZE);
+    rspSz = GetU32(&c->buf[2]);
+    if (rspSz < TPM2_HEADER_SIZE || rspSz > sizeof(c->buf))
+        Fail("bad response size %u", rspSz);
+    Recv(fd, &c->buf[TPM2_HEADER_SIZE], (int)rspSz - TPM2_HEADER_SIZE);
+    c->pos = (int)rspSz;
+    return GetU32(&c->buf[6]);
+}
+
+static void GetRandomCmd(TestCmd* c, word32 sz)
+{
+    CmdStart(c, TPM_ST_NO_SESSIONS, TPM_CC_GetRandom);
+    PutU16(c, sz);
+    CmdEnd(c);
+}
+
+/* A client that sent part of a command does not hold up another client */
+static void test_PartialCommand(int a, int b)
+{
+    TestCmd cmdA, cmdB;
+    TPM_RC rc;
+
+    GetRandomCmd(&cmdA, 8);
+    Send(a, cmdA.buf, 5);
+
+    GetRandomCmd(&cmdB, 8);
+    rc = Run(b, &cmdB);
+    if (rc != TPM_RC_SUCCESS || cmdB.pos != TPM2_HEADER_SIZE + 2 + 8)
+        Fail("GetRandom behind a stalled client: rc 0x%x", rc);
+
+    Send(a, &cmdA.buf[5], cmdA.pos - 5);
+    Recv(a, cmdA.buf, TPM2_HEADER_SIZE + 2 + 8);
+    if (GetU32(&cmdA.buf[6]) != TPM_RC_SUCCESS)
+        Fail("completed partial command failed");
+    printf("Test Broker:\t\tPartial command:\tPassed\n");
+}
+
+/* Startup, Shutdown and Clear would affect every client */
+static void test_DeniedCommands(int a)
+{
+    TestCmd cmd;
+    TPM_RC rc;
+
+    CmdStart(&cmd, TPM_ST_NO_SESSIONS, TPM_CC_Startup);
+    PutU16(&cmd, TPM_SU_CLEAR);
+    CmdEnd(&cmd);
+    if ((rc = Run(a, &cmd)) != TPM_RC_COMMAND_CODE)
+        Fail("Startup not refused: 0x%x", rc);
+
+    CmdStart(&cmd, TPM_ST_NO_SESSIONS, TPM_CC_Shutdown);
+    PutU16(&cmd, TPM_SU_CLEAR);
+    CmdEnd(&cmd);
+    if ((rc = Run(a, &cmd)) != TPM_RC_COMMAND_CODE)
+        Fail("Shutdown not refused: 0x%x", rc);
+
+    CmdStart(&cmd, TPM_ST_SESSIONS, TPM_CC_Clear);
+    PutU32(&cmd, TPM_RH_LOCKOUT);
+    PutU32(&cmd, 9);            /* auth area size */
+    PutU32(&cmd, TPM_RS_PW);
+    PutU16(&cmd, 0);            /* nonce */
+    cmd.buf[cmd.pos++] = 0;     /* attributes */
+    PutU16(&cmd, 0);            /* hmac */
+    CmdEnd(&cmd);
+    if ((rc = Run(a, &cmd)) != TPM_RC_COMMAND_CODE)
+        Fail("Clear not refused: 0x%x", rc);
+    printf("Test Broker:\t\tDenied commands:\tPassed\n");
+}
+
+/* A client may save and load its own session; nobody else may load it */
+static void test_SessionContext(int a, int b)
+{
+    TestCmd cmd, ctx;
+    TPM_RC rc;
+    TPM_HANDLE sess;
+    int i;
+
+    CmdStart(&cmd, TPM_ST_NO_SESSIONS, TPM_CC_StartAuthSession);
+    PutU32(&cmd, TPM_RH_NULL);  /* tpmKey */
+    PutU32(&cmd, TPM_RH_NULL);  /* bind */
+    PutU16(&cmd, 16);           /* nonceCaller */
+    for (i = 0; i < 16; i++)
+        cmd.buf[cmd.pos++] = (byte)i;
+    PutU16(&cmd, 0);            /* encryptedSalt */
+    cmd.buf[cmd.pos++] = TPM_SE_HMAC;
+    PutU16(&cmd, TPM_ALG_NULL); /* symmetric */
+    PutU16(&cmd, TPM_ALG_SHA256);
+    CmdEnd(&cmd);
+    if ((rc = Run(a, &cmd)) != TPM_RC_SUCCESS)
+        Fail("StartAuthSession: 0x%x", rc);
+    sess = GetU32(&cmd.buf[TPM2_HEADER_SIZE]);
+
+    CmdStart(&ctx, TPM_ST_NO_SESSIONS, TPM_CC_ContextSave);
+    PutU32(&ctx, sess);
+    CmdEnd(&ctx);
+    if ((rc = Run(a, &ctx)) != TPM_RC_SUCCESS)
+        Fail("ContextSave of own session: 0x%x", rc);
+    /* turn the response (header + TPMS_CONTEXT) into a ContextLoad */
+    ctx.buf[0] = (byte)(TPM_ST_NO_SESSIONS >> 8);
+    ctx.buf[1] = (byte)TPM_ST_NO_SESSIONS;
+    ctx.buf[6] = 0; ctx.buf[7] = 0;
+    ctx.buf[8] = (byte)(TPM_CC_ContextLoad >> 8);
+    ctx.buf[9] = (byte)TPM_CC_ContextLoad;
+    XMEMCPY(cmd.buf, ctx.buf, ctx.pos);
+    cmd.pos = ctx.pos;
+
+    /* another client cannot load or flush it */
+    if ((rc = Run(b, &cmd)) != (TPM_RC_HANDLE + TPM_RC_P + TPM_RC_1))
+        Fail("ContextLoad of another client's session: 0x%x", rc);
+    CmdStart(&cmd, TPM_ST_NO_SESSIONS, TPM_CC_FlushContext);
+    PutU32(&cmd, sess);
+    CmdEnd(&cmd);
+    if ((rc = Run(b, &cmd)) == TPM_RC_SUCCESS)
+        Fail("FlushContext of another client's session");
+
+    /* the owner loads it back under the same handle */
+    if ((rc = Run(a, &ctx)) != TPM_RC_SUCCESS)
+        Fail("ContextLoad of own session: 0x%x", rc);
+    if (GetU32(&ctx.buf[TPM2_HEADER_SIZE]) != sess)
+        Fail("session loaded under another handle");
+
+    /* still tracked: the broker swaps it out and in around this command */
+    GetRandomCmd(&cmd, 8);
+    if ((rc = Run(a, &cmd)) != TPM_RC_SUCCESS)
+        Fail("GetRandom: 0x%x", rc);
+    CmdStart(&cmd, TPM_ST_NO_SESSIONS, TPM_CC_FlushContext);
+    PutU32(&cmd, sess);
+    CmdEnd(&cmd);
+    if ((rc = Run(a, &cmd)) != TPM_RC_SUCCESS)
+        Fail("FlushContext of own session: 0x%x", rc);
+    printf("Test Broker:\t\tSession context:\tPassed\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char* path = getenv(TPM2_BROKER_PATH_ENV);
+    int a, b;
+
+    if (argc >= 2)
+        path = argv[1];
+    if (path == NULL || path[0] == '\0')
+        path = TPM2_BROKER_PATH;
+    if (XSTRLEN(path) >= sizeof(((struct sockaddr_un*)0)->sun_path))
+        Fail("socket path too long");
+
+    a = Connect(path);
+    b = Connect(path);
+
+    test_PartialCommand(a, b);
+    test_DeniedCommands(a);
+    test_SessionContext(a, b);
+
+    close(a);
+    close(b);
+    return 0;
+}
+#else
+int main(void)
+{
+    printf("Broker test requires Unix-domain sockets\n");
+    return 0;
+}
+#endif /* !_WIN32 */
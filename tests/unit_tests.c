@@ -25,6 +25,9 @@
 #include <wolftpm/tpm2.h>
 #include <wolftpm/tpm2_wrap.h>
 #include <wolftpm/tpm2_param_enc.h>
+#ifdef WOLFTPM_SWTPM
+#include <wolftpm/tpm2_swtpm.h>
+#endif
 
 #include <hal/tpm_io.h>
 #include <examples/tpm_test.h>
@@ -97,7 +100,8 @@ static void test_wolfTPM2_Init(void)
     AssertIntNE(rc, 0);
     /* Test second argument, TPM2 IO Callbacks */
     rc = wolfTPM2_Init(&dev, NULL, NULL);
-#if defined(WOLFTPM_LINUX_DEV) || defined(WOLFTPM_SWTPM) || defined(WOLFTPM_WINAPI)
+#if defined(WOLFTPM_LINUX_DEV) || defined(WOLFTPM_SWTPM) || \
+    defined(WOLFTPM_BROKER) || defined(WOLFTPM_WINAPI)
     /* Custom IO Callbacks are not needed for Linux TIS driver */
     AssertIntEQ(rc, 0);
 #else
@@ -150,6 +154,41 @@ static void test_wolfTPM2_OpenExisting(void)
         rc == 0 ? "Passed" : "Failed");
 }
 
+/* test for restart of a service on an already started TPM */
+static void test_wolfTPM2_InitWarmStart(void)
+{
+    int rc;
+    WOLFTPM2_DEV dev;
+    WOLFTPM2_CAPS caps;
+    TPML_ALG toTest;
+
+    /* Test first argument, wolfTPM2 context */
+    rc = wolfTPM2_InitWarmStart(NULL, TPM2_IoCb, NULL, NULL);
+    AssertIntNE(rc, 0);
+
+    /* Cold start with TPM left running */
+    rc = wolfTPM2_Init(&dev, TPM2_IoCb, NULL);
+    AssertIntEQ(rc, 0);
+    rc = wolfTPM2_Cleanup_ex(&dev, 0);
+    AssertIntEQ(rc, 0);
+
+    /* Warm start, self-test only the algorithms in use */
+    XMEMSET(&toTest, 0, sizeof(toTest));
+    toTest.count = 1;
+    toTest.algorithms[0] = TPM_ALG_SHA256;
+    rc = wolfTPM2_InitWarmStart(&dev, TPM2_IoCb, NULL, &toTest);
+    AssertIntEQ(rc, 0);
+
+    /* Test access to TPM by getting capabilities */
+    rc = wolfTPM2_GetCapabilities(&dev, &caps);
+    AssertIntEQ(rc, 0);
+
+    wolfTPM2_Cleanup(&dev);
+
+    printf("Test TPM Wrapper:\tInit Warm Start:\t%s\n",
+        rc == 0 ? "Passed" : "Failed");
+}
+
 /* test for wolfTPM2_GetCapabilities */
 static void test_wolfTPM2_GetCapabilities(void)
 {
@@ -176,12 +215,112 @@ static void test_wolfTPM2_GetCapabilities(void)
         caps.fwVerMinor, caps.fwVerVendor, caps.fips140_2, caps.cc_eal4);
 #endif
 
+    /* Second call is served from the copy in the device */
+    AssertIntEQ(dev.capsValid, 1);
+    dev.caps.fwVerVendor ^= 1;
+    rc = wolfTPM2_GetCapabilities(&dev, &caps);
+    AssertIntEQ(rc, 0);
+    AssertIntEQ(caps.fwVerVendor, dev.caps.fwVerVendor);
+
+    /* Startup or field upgrade drops the copy */
+    dev.ctx.stateGen++;
+    rc = wolfTPM2_GetCapabilities(&dev, &caps);
+    AssertIntEQ(rc, 0);
+    AssertIntEQ(dev.capsGen, dev.ctx.stateGen);
+
     wolfTPM2_Cleanup(&dev);
 
     printf("Test TPM Wrapper:\tGet Capabilities:\t%s\n",
         rc == 0 ? "Passed" : "Failed");
 }
 
+#if defined(WOLFTPM_SINGLE_FLIGHT) && defined(HAVE_PTHREAD)
+#include <pthread.h>
+#include <unistd.h>
+
+#define FLIGHT_TEST_THREADS 4
+
+typedef struct FlightTestArg {
+    WOLFTPM2_DEV* dev;
+    int rc;
+    int digestSz;
+    byte digest[TPM_MAX_DIGEST_SIZE];
+} FlightTestArg;
+
+static void* test_wolfTPM2_SingleFlight_thread(void* args)
+{
+    FlightTestArg* arg = (FlightTestArg*)args;
+
+    TPM2_SetActiveCtx(&arg->dev->ctx);
+    arg->rc = wolfTPM2_ReadPCR(arg->dev, 0, TPM_ALG_SHA256, arg->digest,
+        &arg->digestSz);
+    return NULL;
+}
+
+/* Identical PCR reads from several threads while the TPM is busy are served
+ * by the first request */
+static void test_wolfTPM2_SingleFlight(void)
+{
+    int rc, i;
+    WOLFTPM2_DEV dev;
+    pthread_t threads[FLIGHT_TEST_THREADS];
+    FlightTestArg args[FLIGHT_TEST_THREADS];
+    word32 issued0 = 0, coalesced0 = 0, issued = 0, coalesced = 0;
+
+    rc = wolfTPM2_Init(&dev, TPM2_IoCb, NULL);
+    AssertIntEQ(rc, 0);
+    AssertIntEQ(dev.ctx.hwLockInit, 1);
+    rc = wolfTPM2_GetFlightStats(&dev, &issued0, &coalesced0);
+    AssertIntEQ(rc, 0);
+
+    /* hold the TPM so the first reader stays in flight */
+    AssertIntEQ(wc_LockMutex(&dev.ctx.hwLock), 0);
+    XMEMSET(args, 0, sizeof(args));
+    for (i = 0; i < FLIGHT_TEST_THREADS; i++) {
+        args[i].dev = &dev;
+        args[i].rc = -1;
+        AssertIntEQ(pthread_create(&threads[i], NULL,
+            test_wolfTPM2_SingleFlight_thread, &args[i]), 0);
+    }
+    /* wait for the others to join the first request */
+    for (i = 0; i < 5000; i++) {
+        rc = wolfTPM2_GetFlightStats(&dev, NULL, &coalesced);
+        AssertIntEQ(rc, 0);
+        if (coalesced - coalesced0 == FLIGHT_TEST_THREADS - 1)
+            break;
+        usleep(1000);
+    }
+    wc_UnLockMutex(&dev.ctx.hwLock);
+    for (i = 0; i < FLIGHT_TEST_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    rc = wolfTPM2_GetFlightStats(&dev, &issued, &coalesced);
+    AssertIntEQ(rc, 0);
+    AssertIntEQ(issued - issued0, 1);
+    AssertIntEQ(coalesced - coalesced0, FLIGHT_TEST_THREADS - 1);
+    for (i = 0; i < FLIGHT_TEST_THREADS; i++) {
+        AssertIntEQ(args[i].rc, 0);
+        AssertIntEQ(args[i].digestSz, TPM_SHA256_DIGEST_SIZE);
+        AssertIntEQ(XMEMCMP(args[i].digest, args[0].digest,
+            args[0].digestSz), 0);
+    }
+
+    /* the slot is free again, so a later read is issued */
+    rc = wolfTPM2_ReadPCR(&dev, 0, TPM_ALG_SHA256, args[0].digest,
+        &args[0].digestSz);
+    AssertIntEQ(rc, 0);
+    rc = wolfTPM2_GetFlightStats(&dev, &issued, NULL);
+    AssertIntEQ(rc, 0);
+    AssertIntEQ(issued - issued0, 2);
+
+    wolfTPM2_Cleanup(&dev);
+
+    printf("Test TPM Wrapper:\tSingle Flight:\t\t%s\n",
+        rc == 0 ? "Passed" : "Failed");
+}
+#endif /* WOLFTPM_SINGLE_FLIGHT && HAVE_PTHREAD */
+
 /* test for wolfTPM2_ReadPublicKey */
 static void test_wolfTPM2_ReadPublicKey(void)
 {
@@ -238,6 +377,1055 @@ static void test_wolfTPM2_GetRandom(void)
         rc == 0 ? "Passed" : "Failed");
 }
 
+#ifdef WOLFTPM_PRIORITY
+static void test_TPM2_Priority(void)
+{
+    int rc, prev;
+    WOLFTPM2_DEV dev;
+    WOLFTPM2_BUFFER rngData;
+    TPM2_PRIORITY_STATS stats;
+
+    rc = wolfTPM2_Init(&dev, TPM2_IoCb, NULL);
+    AssertIntEQ(rc, 0);
+
+    /* Test arguments */
+    rc = TPM2_SetPriority(NULL, TPM2_PRIORITY_BULK, NULL, NULL);
+    AssertIntNE(rc, 0);
+    rc = TPM2_SetPriority(&dev.ctx, TPM2_PRIORITY_COUNT, NULL, NULL);
+    AssertIntNE(rc, 0);
+    rc = TPM2_GetPriorityStats(&dev.ctx, TPM2_PRIORITY_DEFAULT, &stats);
+    AssertIntNE(rc, 0);
+
+    /* context default class */
+    rc = TPM2_SetPriority(&dev.ctx, TPM2_PRIORITY_BULK, NULL, NULL);
+    AssertIntEQ(rc, 0);
+    rc = wolfTPM2_GetRandom(&dev, rngData.buffer, sizeof(rngData.buffer));
+    AssertIntEQ(rc, 0);
+    rc = TPM2_GetPriorityStats(&dev.ctx, TPM2_PRIORITY_BULK, &stats);
+    AssertIntEQ(rc, 0);
+    AssertIntGT(stats.acquired, 0);
+    rc = TPM2_GetPriorityStats(&dev.ctx, TPM2_PRIORITY_HIGH, &stats);
+    AssertIntEQ(rc, 0);
+    AssertIntEQ(stats.acquired, 0);
+
+    /* per call override */
+    prev = TPM2_SetCallPriority(TPM2_PRIORITY_HIGH, 0);
+    AssertIntEQ(prev, TPM2_PRIORITY_DEFAULT);
+    rc = wolfTPM2_GetRandom(&dev, rngData.buffer, sizeof(rngData.buffer));
+    AssertIntEQ(rc, 0);
+    prev = TPM2_SetCallPriority(prev, 0);
+    AssertIntEQ(prev, TPM2_PRIORITY_HIGH);
+    rc = TPM2_GetPriorityStats(&dev.ctx, TPM2_PRIORITY_HIGH, &stats);
+    AssertIntEQ(rc, 0);
+    AssertIntGT(stats.acquired, 0);
+    AssertIntEQ(stats.expired, 0);
+
+    wolfTPM2_Cleanup(&dev);
+
+    printf("Test TPM2:\t\tPriority:\t%s\n",
+        rc == 0 ? "Passed" : "Failed");
+}
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#include <unistd.h>
+
+typedef struct PriorityTestArg {
+    WOLFTPM2_DEV* dev;
+    int priority;
+    word32 deadlineMs;
+    int rc;
+    int order;
+} PriorityTestArg;
+
+static pthread_mutex_t gPrioOrderLock = PTHREAD_MUTEX_INITIALIZER;
+static int gPrioOrder;
+
+static void* test_TPM2_Priority_thread(void* args)
+{
+    PriorityTestArg* arg = (PriorityTestArg*)args;
+    byte rng[16];
+
+    TPM2_SetActiveCtx(&arg->dev->ctx);
+    (void)TPM2_SetCallPriority(arg->priority, arg->deadlineMs);
+    arg->rc = wolfTPM2_GetRandom(arg->dev, rng, sizeof(rng));
+    pthread_mutex_lock(&gPrioOrderLock);
+    arg->order = ++gPrioOrder;
+    pthread_mutex_unlock(&gPrioOrderLock);
+    return NULL;
+}
+
+/* waits until a thread of the class is queued on the TPM lock */
+static void test_TPM2_Priority_waitQueued(TPM2_CTX* ctx, int priority)
+{
+    int i;
+    word32 waiting = 0;
+    for (i = 0; i < 5000 && waiting == 0; i++) {
+        usleep(1000);
+        AssertIntEQ(wc_LockMutex(&ctx->prioLock), 0);
+        waiting = ctx->prioWaiting[priority];
+        wc_UnLockMutex(&ctx->prioLock);
+    }
+    AssertIntGT(waiting, 0);
+}
+
+static void test_TPM2_Priority_setBusy(TPM2_CTX* ctx, int busy)
+{
+    AssertIntEQ(wc_LockMutex(&ctx->prioLock), 0);
+    ctx->prioBusy = busy;
+    wc_UnLockMutex(&ctx->prioLock);
+}
+
+/* A high class thread queued after a bulk one gets the TPM first, and a
+ * deadline expires while the TPM stays busy */
+static void test_TPM2_PriorityThreads(void)
+{
+    int rc;
+    WOLFTPM2_DEV dev;
+    pthread_t bulkThread, highThread;
+    PriorityTestArg bulk, high;
+    TPM2_PRIORITY_STATS stats;
+
+    rc = wolfTPM2_Init(&dev, TPM2_IoCb, NULL);
+    AssertIntEQ(rc, 0);
+    AssertIntEQ(dev.ctx.hwLockInit, 1);
+
+    /* act as the current owner of the TPM */
+    test_TPM2_Priority_setBusy(&dev.ctx, 1);
+
+    XMEMSET(&bulk, 0, sizeof(bulk));
+    bulk.dev = &dev;
+    bulk.priority = TPM2_PRIORITY_BULK;
+    XMEMSET(&high, 0, sizeof(high));
+    high.dev = &dev;
+    high.priority = TPM2_PRIORITY_HIGH;
+    gPrioOrder = 0;
+
+    AssertIntEQ(pthread_create(&bulkThread, NULL, test_TPM2_Priority_thread,
+        &bulk), 0);
+    test_TPM2_Priority_waitQueued(&dev.ctx, TPM2_PRIORITY_BULK);
+    AssertIntEQ(pthread_create(&highThread, NULL, test_TPM2_Priority_thread,
+        &high), 0);
+    test_TPM2_Priority_waitQueued(&dev.ctx, TPM2_PRIORITY_HIGH);
+
+    test_TPM2_Priority_setBusy(&dev.ctx, 0);
+    pthread_join(highThread, NULL);
+    pthread_join(bulkThread, NULL);
+    AssertIntEQ(high.rc, 0);
+    AssertIntEQ(bulk.rc, 0);
+    AssertIntEQ(high.order, 1);
+    AssertIntEQ(bulk.order, 2);
+
+    /* deadline while the TPM stays busy, timed by the monotonic clock */
+    test_TPM2_Priority_setBusy(&dev.ctx, 1);
+    high.deadlineMs = 20;
+    AssertIntEQ(pthread_create(&highThread, NULL, test_TPM2_Priority_thread,
+        &high), 0);
+    pthread_join(highThread, NULL);
+    test_TPM2_Priority_setBusy(&dev.ctx, 0);
+    AssertIntEQ(high.rc, TPM_RC_DEADLINE);
+    rc = TPM2_GetPriorityStats(&dev.ctx, TPM2_PRIORITY_HIGH, &stats);
+    AssertIntEQ(rc, 0);
+    AssertIntEQ(stats.expired, 1);
+
+    wolfTPM2_Cleanup(&dev);
+
+    printf("Test TPM2:\t\tPriority Threads:\t%s\n",
+        rc == 0 ? "Passed" : "Failed");
+}
+#endif /* HAVE_PTHREAD */
+#endif
+
+static word32 test_LockTick(void* timeCtx)
+{
+    return ++(*(word32*)timeCtx);
+}
+
+static void test_TPM2_LockStats(void)
+{
+    int rc;
+    word32 tick = 0, acquired;
+    WOLFTPM2_DEV dev;
+    WOLFTPM2_BUFFER rngData;
+    TPM2_LOCK_STATS stats;
+    TPM2B_PUBLIC pub;
+    TPM2B_NAME name;
+#ifdef WOLFTPM_TIS_LOCK
+    TPM2_TIS_LOCK_STATS tisStats;
+#endif
+
+    rc = wolfTPM2_Init(&dev, TPM2_IoCb, NULL);
+    AssertIntEQ(rc, 0);
+
+#ifdef WOLFTPM_TIS_LOCK
+    /* the TIS lock is taken once per command, not per register access */
+    rc = TPM2_TIS_GetLockStats(&dev.ctx, &tisStats);
+    AssertIntEQ(rc, 0);
+    acquired = tisStats.acquired;
+    rc = wolfTPM2_GetRandom(&dev, rngData.buffer, 16); /* one command */
+    AssertIntEQ(rc, 0);
+    rc = TPM2_TIS_GetLockStats(&dev.ctx, &tisStats);
+    AssertIntEQ(rc, 0);
+    AssertIntEQ(tisStats.acquired, acquired + 1);
+#endif
+
+    /* Test arguments */
+    rc = TPM2_GetLockStats(NULL, &stats);
+    AssertIntNE(rc, 0);
+    rc = TPM2_GetLockStats(&dev.ctx, NULL);
+    AssertIntNE(rc, 0);
+
+    rc = TPM2_GetLockStats(&dev.ctx, &stats);
+    if (rc == NOT_COMPILED_IN) {
+        wolfTPM2_Cleanup(&dev);
+        printf("Test TPM2:\t\tLock Stats:\tSkipped\n");
+        return;
+    }
+    AssertIntEQ(rc, 0);
+    AssertIntEQ(stats.recursive, 0);
+
+    rc = TPM2_SetTimeCb(&dev.ctx, test_LockTick, &tick);
+    AssertIntEQ(rc, 0);
+    rc = wolfTPM2_GetRandom(&dev, rngData.buffer, sizeof(rngData.buffer));
+    AssertIntEQ(rc, 0);
+    rc = TPM2_GetLockStats(&dev.ctx, &stats);
+    AssertIntEQ(rc, 0);
+    AssertIntGT(stats.acquired, 0);
+    AssertIntEQ(stats.contended, 0);
+    AssertIntGT(stats.holdTotalMs, 0);
+    acquired = stats.acquired;
+
+    /* host only helpers do not take the lock */
+    XMEMSET(&pub, 0, sizeof(pub));
+    rc = wolfTPM2_GetKeyTemplate_ECC(&pub.publicArea,
+        TPMA_OBJECT_sign | TPMA_OBJECT_userWithAuth, TPM_ECC_NIST_P256,
+        TPM_ALG_ECDSA);
+    AssertIntEQ(rc, 0);
+    rc = wolfTPM2_ComputeName(&pub, &name);
+    AssertIntEQ(rc, 0);
+    rc = TPM2_GetLockStats(&dev.ctx, &stats);
+    AssertIntEQ(rc, 0);
+    AssertIntEQ(stats.acquired, acquired);
+
+    wolfTPM2_Cleanup(&dev);
+
+    printf("Test TPM2:\t\tLock Stats:\t%s\n",
+        rc == 0 ? "Passed" : "Failed");
+}
+
+#if defined(HAVE_PTHREAD) && !defined(WOLFTPM2_NO_WOLFCRYPT) && \
+    !defined(SINGLE_THREADED)
+#include <pthread.h>
+#include <unistd.h>
+
+typedef struct LockHoldTest {
+    WOLFTPM2_DEV* dev;
+    pthread_t holder;       /* paused while it owns the TPM lock */
+    volatile int holderSet;
+    volatile int held;
+    volatile int release;
+} LockHoldTest;
+
+typedef struct LockThreadArg {
+    LockHoldTest* hold;
+    int isHolder;
+    int rc;
+    volatile int done;
+} LockThreadArg;
+
+/* tick callback, runs inside the lock: pauses the holder thread once it
+ * owns the lock until the test releases it */
+static word32 test_LockHoldTick(void* timeCtx)
+{
+    LockHoldTest* hold = (LockHoldTest*)timeCtx;
+    if (hold->holderSet && pthread_equal(pthread_self(), hold->holder) &&
+            hold->dev->ctx.lockOwner != NULL) {
+        hold->held = 1;
+        while (!hold->release)
+            usleep(1000);
+    }
+    return 0;
+}
+
+static void* test_TPM2_LockThreads_thread(void* args)
+{
+    LockThreadArg* arg = (LockThreadArg*)args;
+    byte rng[16];
+
+    TPM2_SetActiveCtx(&arg->hold->dev->ctx);
+    if (arg->isHolder) {
+        arg->hold->holder = pthread_self();
+        arg->hold->holderSet = 1;
+    }
+    arg->rc = wolfTPM2_GetRandom(arg->hold->dev, rng, sizeof(rng));
+    arg->done = 1;
+    return NULL;
+}
+
+/* While one thread owns the lock another thread waits on the mutex, even
+ * though the lock count is non-zero */
+static void test_TPM2_LockThreads(void)
+{
+    int rc, i;
+    WOLFTPM2_DEV dev;
+    LockHoldTest hold;
+    LockThreadArg holder, waiter;
+    pthread_t holderThread, waiterThread;
+    TPM2_LOCK_STATS before, after;
+
+    rc = wolfTPM2_Init(&dev, TPM2_IoCb, NULL);
+    AssertIntEQ(rc, 0);
+
+    XMEMSET(&hold, 0, sizeof(hold));
+    hold.dev = &dev;
+    XMEMSET(&holder, 0, sizeof(holder));
+    holder.hold = &hold;
+    holder.isHolder = 1;
+    XMEMSET(&waiter, 0, sizeof(waiter));
+    waiter.hold = &hold;
+
+    rc = TPM2_GetLockStats(&dev.ctx, &before);
+    AssertIntEQ(rc, 0);
+    rc = TPM2_SetTimeCb(&dev.ctx, test_LockHoldTick, &hold);
+    AssertIntEQ(rc, 0);
+
+    AssertIntEQ(pthread_create(&holderThread, NULL,
+        test_TPM2_LockThreads_thread, &holder), 0);
+    for (i = 0; i < 5000 && !hold.held; i++)
+        usleep(1000);
+    AssertIntEQ(hold.held, 1);
+
+    AssertIntEQ(pthread_create(&waiterThread, NULL,
+        test_TPM2_LockThreads_thread, &waiter), 0);
+    usleep(50000);
+    AssertIntEQ(waiter.done, 0);
+
+    hold.release = 1;
+    pthread_join(holderThread, NULL);
+    pthread_join(waiterThread, NULL);
+    AssertIntEQ(holder.rc, 0);
+    AssertIntEQ(waiter.rc, 0);
+
+    (void)TPM2_SetTimeCb(&dev.ctx, NULL, NULL);
+    rc = TPM2_GetLockStats(&dev.ctx, &after);
+    AssertIntEQ(rc, 0);
+    AssertIntEQ(after.acquired, before.acquired + 2);
+    AssertIntEQ(after.contended, before.contended + 1);
+    AssertIntEQ(after.recursive, before.recursive);
+
+    wolfTPM2_Cleanup(&dev);
+
+    printf("Test TPM2:\t\tLock Threads:\t%s\n",
+        rc == 0 ? "Passed" : "Failed");
+}
+#endif /* HAVE_PTHREAD && !WOLFTPM2_NO_WOLFCRYPT && !SINGLE_THREADED */
+
+static void test_TPM2_CommandTimeout(void)
+{
+    int rc;
+    word32 prev;
+    WOLFTPM2_DEV dev;
+    WOLFTPM2_BUFFER rngData;
+
+    rc = wolfTPM2_Init(&dev, TPM2_IoCb, NULL);
+    AssertIntEQ(rc, 0);
+
+    rc = TPM2_SetCommandTimeout(NULL, 1000);
+    AssertIntNE(rc, 0);
+    rc = TPM2_SetCommandTimeout(&dev.ctx, 10000);
+    AssertIntEQ(rc, 0);
+    rc = wolfTPM2_GetRandom(&dev, rngData.buffer, 16);
+    AssertIntEQ(rc, 0);
+
+    /* per call override */
+    prev = TPM2_SetCallTimeout(5000);
+    AssertIntEQ(prev, 0);
+    rc = wolfTPM2_GetRandom(&dev, rngData.buffer, 16);
+    AssertIntEQ(rc, 0);
+    prev = TPM2_SetCallTimeout(prev);
+    AssertIntEQ(prev, 5000);
+
+    wolfTPM2_Cleanup(&dev);
+
+    printf("Test TPM2:\t\tCmd Timeout:\t%s\n",
+        rc == 0 ? "Passed" : "Failed");
+}
+
+#ifndef WOLFTPM_NO_RETRY
+static void test_TPM2_RetryPolicy(void)
+{
+    int rc;
+    WOLFTPM2_DEV dev;
+    TPM2_RETRY_POLICY policy;
+    TPM2_RETRY_STATS stats;
+
+    rc = wolfTPM2_Init(&dev, TPM2_IoCb, NULL);
+    AssertIntEQ(rc, 0);
+
+    /* defaults are set on init */
+    AssertIntEQ(dev.ctx.retryPolicy.maxRetries, WOLFTPM_RETRY_MAX);
+    AssertIntEQ(dev.ctx.retryPolicy.rcMask, TPM2_RETRY_MASK_ALL);
+
+    XMEMSET(&policy, 0, sizeof(policy));
+    policy.maxRetries = 2;
+    policy.initialMs = 20;
+    policy.maxMs = 10;
+    AssertIntNE(TPM2_SetRetryPolicy(NULL, &policy), 0);
+    AssertIntNE(TPM2_SetRetryPolicy(&dev.ctx, &policy), 0);
+    policy.maxMs = 100;
+    policy.rcMask = TPM2_RETRY_MASK(TPM2_RETRY_RC_RETRY);
+    rc = TPM2_SetRetryPolicy(&dev.ctx, &policy);
+    AssertIntEQ(rc, 0);
+    AssertIntEQ(dev.ctx.retryPolicy.maxMs, 100);
+
+    AssertIntNE(TPM2_GetRetryStats(&dev.ctx, NULL), 0);
+    rc = TPM2_GetRetryStats(&dev.ctx, &stats);
+    AssertIntEQ(rc, 0);
+
+    rc = TPM2_SetRetryPolicy(&dev.ctx, NULL);
+    AssertIntEQ(rc, 0);
+    AssertIntEQ(dev.ctx.retryPolicy.maxRetries, WOLFTPM_RETRY_MAX);
+
+    wolfTPM2_Cleanup(&dev);
+
+    printf("Test TPM2:\t\tRetry Policy:\t%s\n",
+        rc == 0 ? "Passed" : "Failed");
+}
+
+#if defined(WOLFTPM_SWTPM) && defined(HAVE_PTHREAD) && !defined(_WIN32)
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define RETRY_STUB_SCRIPT_SZ 4
+#define RETRY_STUB_RNG_SZ    8
+
+/* Stub of the simulator socket protocol. Each command is answered with the
+ * next scripted response code: a header only warning, or a GetRandom reply
+ * for TPM_RC_SUCCESS. Commands after the first are compared with it. */
+typedef struct RetryStub {
+    int listenFd;
+    pthread_mutex_t lock;
+    TPM_RC script[RETRY_STUB_SCRIPT_SZ];
+    int scriptSz;
+    int cmdCount;
+    int mismatch;
+    byte firstCmd[MAX_COMMAND_SIZE];
+    word32 firstCmdSz;
+} RetryStub;
+
+static word32 RetryStub_GetU32(const byte* p)
+{
+    return ((word32)p[0] << 24) | ((word32)p[1] << 16) |
+           ((word32)p[2] << 8)  |  (word32)p[3];
+}
+
+static void RetryStub_SetU32(byte* p, word32 v)
+{
+    p[0] = (byte)(v >> 24);
+    p[1] = (byte)(v >> 16);
+    p[2] = (byte)(v >> 8);
+    p[3] = (byte)v;
+}
+
+static int RetryStub_Xfer(int fd, byte* buf, word32 sz, int isRead)
+{
+    ssize_t n;
+    while (sz > 0) {
+        n = isRead ? read(fd, buf, sz) : write(fd, buf, sz);
+        if (n <= 0)
+            return -1;
+        buf += n;
+        sz -= (word32)n;
+    }
+    return 0;
+}
+
+static void RetryStub_Reply(RetryStub* stub, int fd)
+{
+    byte cmd[MAX_COMMAND_SIZE];
+    byte hdr[9]; /* TPM_SEND_COMMAND, locality, size */
+    byte rsp[4 + TPM2_HEADER_SIZE + 2 + RETRY_STUB_RNG_SZ + 4];
+    word32 cmdSz, rspSz = TPM2_HEADER_SIZE;
+    TPM_RC rspCode;
+
+    if (RetryStub_Xfer(fd, hdr, sizeof(hdr), 1) != 0 ||
+            RetryStub_GetU32(hdr) != TPM_SEND_COMMAND)
+        return;
+    cmdSz = RetryStub_GetU32(&hdr[5]);
+    if (cmdSz > sizeof(cmd) || RetryStub_Xfer(fd, cmd, cmdSz, 1) != 0)
+        return;
+
+    pthread_mutex_lock(&stub->lock);
+    if (stub->cmdCount == 0) {
+        XMEMCPY(stub->firstCmd, cmd, cmdSz);
+        stub->firstCmdSz = cmdSz;
+    }
+    else if (cmdSz != stub->firstCmdSz ||
+            XMEMCMP(cmd, stub->firstCmd, cmdSz) != 0) {
+        stub->mismatch = 1;
+    }
+    rspCode = (stub->cmdCount < stub->scriptSz) ?
+        stub->script[stub->cmdCount] : TPM_RC_SUCCESS;
+    stub->cmdCount++;
+    pthread_mutex_unlock(&stub->lock);
+
+    XMEMSET(rsp, 0, sizeof(rsp));
+    if (rspCode == TPM_RC_SUCCESS) {
+        rspSz += 2 + RETRY_STUB_RNG_SZ;
+        rsp[4 + TPM2_HEADER_SIZE + 1] = RETRY_STUB_RNG_SZ;
+    }
+    RetryStub_SetU32(rsp, rspSz);
+    rsp[4] = (byte)(TPM_ST_NO_SESSIONS >> 8);
+    rsp[5] = (byte)TPM_ST_NO_SESSIONS;
+    RetryStub_SetU32(&rsp[6], rspSz);
+    RetryStub_SetU32(&rsp[10], rspCode);
+    /* size, response and a zero ack, then the session end */
+    if (RetryStub_Xfer(fd, rsp, 4 + rspSz + 4, 0) == 0)
+        (void)RetryStub_Xfer(fd, hdr, 4, 1);
+}
+
+static void* RetryStub_thread(void* args)
+{
+    RetryStub* stub = (RetryStub*)args;
+    int fd;
+
+    /* ends when the listening socket is shut down */
+    while ((fd = accept(stub->listenFd, NULL, NULL)) >= 0) {
+        RetryStub_Reply(stub, fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+static void RetryStub_Script(RetryStub* stub, TPM_RC rc1, TPM_RC rc2,
+    TPM_RC rc3, TPM_RC rc4)
+{
+    pthread_mutex_lock(&stub->lock);
+    stub->script[0] = rc1;
+    stub->script[1] = rc2;
+    stub->script[2] = rc3;
+    stub->script[3] = rc4;
+    stub->scriptSz = RETRY_STUB_SCRIPT_SZ;
+    stub->cmdCount = 0;
+    stub->mismatch = 0;
+    pthread_mutex_unlock(&stub->lock);
+}
+
+static word32 RetryStub_NowMs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (word32)ts.tv_sec * 1000 + (word32)(ts.tv_nsec / 1000000);
+}
+
+/* Warning responses from a stub simulator are resent with backoff until
+ * they clear, the retry budget is spent or the deadline is near */
+static void test_TPM2_RetryScripted(void)
+{
+    int rc;
+    TPM2_CTX ctx;
+    RetryStub stub;
+    pthread_t thread;
+    struct sockaddr_un addr;
+    TPM2_RETRY_POLICY policy;
+    TPM2_RETRY_STATS stats;
+    GetRandom_In in;
+    GetRandom_Out out;
+    word32 start;
+
+    XMEMSET(&stub, 0, sizeof(stub));
+    XMEMSET(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path),
+        "/tmp/wolftpm_retry_%d.sock", (int)getpid());
+    (void)unlink(addr.sun_path);
+    stub.listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    AssertIntGE(stub.listenFd, 0);
+    AssertIntEQ(bind(stub.listenFd, (struct sockaddr*)&addr, sizeof(addr)),
+        0);
+    AssertIntEQ(listen(stub.listenFd, 4), 0);
+    AssertIntEQ(pthread_mutex_init(&stub.lock, NULL), 0);
+    AssertIntEQ(pthread_create(&thread, NULL, RetryStub_thread, &stub), 0);
+
+    rc = TPM2_Init_minimal(&ctx);
+    AssertIntEQ(rc, 0);
+    rc = TPM2_SWTPM_SetAddress(&ctx, addr.sun_path, NULL);
+    AssertIntEQ(rc, 0);
+
+    XMEMSET(&policy, 0, sizeof(policy));
+    policy.maxRetries = 3;
+    policy.initialMs = 10;
+    policy.maxMs = 20;
+    policy.rcMask = TPM2_RETRY_MASK(TPM2_RETRY_RC_RETRY) |
+                    TPM2_RETRY_MASK(TPM2_RETRY_RC_TESTING);
+    rc = TPM2_SetRetryPolicy(&ctx, &policy);
+    AssertIntEQ(rc, 0);
+    XMEMSET(&in, 0, sizeof(in));
+    in.bytesRequested = RETRY_STUB_RNG_SZ;
+
+    /* two warnings, then the unchanged command succeeds */
+    RetryStub_Script(&stub, TPM_RC_RETRY, TPM_RC_TESTING, TPM_RC_SUCCESS,
+        TPM_RC_SUCCESS);
+    start = RetryStub_NowMs();
+    rc = TPM2_GetRandom(&in, &out);
+    AssertIntEQ(rc, 0);
+    AssertIntGE(RetryStub_NowMs() - start, 10 + 20);
+    AssertIntEQ(out.randomBytes.size, RETRY_STUB_RNG_SZ);
+    AssertIntEQ(stub.cmdCount, 3);
+    AssertIntEQ(stub.mismatch, 0);
+    rc = TPM2_GetRetryStats(&ctx, &stats);
+    AssertIntEQ(rc, 0);
+    AssertIntEQ(stats.retries[TPM2_RETRY_RC_RETRY], 1);
+    AssertIntEQ(stats.retries[TPM2_RETRY_RC_TESTING], 1);
+    AssertIntEQ(stats.recovered, 1);
+    AssertIntEQ(stats.exhausted, 0);
+
+    /* the backoff doubles up to maxMs and the last warning is returned */
+    RetryStub_Script(&stub, TPM_RC_RETRY, TPM_RC_RETRY, TPM_RC_RETRY,
+        TPM_RC_RETRY);
+    start = RetryStub_NowMs();
+    rc = TPM2_GetRandom(&in, &out);
+    AssertIntEQ(rc, TPM_RC_RETRY);
+    AssertIntGE(RetryStub_NowMs() - start, 10 + 20 + 20);
+    AssertIntEQ(stub.cmdCount, 4);
+    AssertIntEQ(stub.mismatch, 0);
+    rc = TPM2_GetRetryStats(&ctx, &stats);
+    AssertIntEQ(rc, 0);
+    AssertIntEQ(stats.retries[TPM2_RETRY_RC_RETRY], 1 + 3);
+    AssertIntEQ(stats.exhausted, 1);
+
+    /* a warning outside the mask is not retried */
+    RetryStub_Script(&stub, TPM_RC_YIELDED, TPM_RC_SUCCESS, TPM_RC_SUCCESS,
+        TPM_RC_SUCCESS);
+    rc = TPM2_GetRandom(&in, &out);
+    AssertIntEQ(rc, TPM_RC_YIELDED);
+    AssertIntEQ(stub.cmdCount, 1);
+
+    /* no backoff that would end past the command deadline */
+    policy.initialMs = 200;
+    policy.maxMs = 200;
+    rc = TPM2_SetRetryPolicy(&ctx, &policy);
+    AssertIntEQ(rc, 0);
+    rc = TPM2_SetCommandTimeout(&ctx, 100);
+    AssertIntEQ(rc, 0);
+    RetryStub_Script(&stub, TPM_RC_RETRY, TPM_RC_SUCCESS, TPM_RC_SUCCESS,
+        TPM_RC_SUCCESS);
+    rc = TPM2_GetRandom(&in, &out);
+    AssertIntEQ(rc, TPM_RC_RETRY);
+    AssertIntEQ(stub.cmdCount, 1);
+    rc = TPM2_GetRetryStats(&ctx, &stats);
+    AssertIntEQ(rc, 0);
+    AssertIntEQ(stats.retries[TPM2_RETRY_RC_YIELDED], 0);
+    AssertIntEQ(stats.exhausted, 2);
+    AssertIntEQ(stats.recovered, 1);
+
+    TPM2_Cleanup(&ctx);
+    shutdown(stub.listenFd, SHUT_RDWR);
+    pthread_join(thread, NULL);
+    close(stub.listenFd);
+    (void)unlink(addr.sun_path);
+    pthread_mutex_destroy(&stub.lock);
+
+    printf("Test TPM2:\t\tRetry Script:\t%s\n",
+        rc == 0 ? "Passed" : "Failed");
+}
+#endif /* WOLFTPM_SWTPM && HAVE_PTHREAD && !_WIN32 */
+#endif /* !WOLFTPM_NO_RETRY */
+
+#ifdef WOLFTPM_CRB_SIM
+#include <wolftpm/tpm2_crb.h>
+
+/* IO callback in front of the CRB simulator. It stands in for a mapped data
+ * buffer and can hold START set, like a TPM that does not complete. */
+typedef struct CrbTestIo {
+    byte map[TPM_CRB_DATA_BUFFER_SZ];
+    int mapped;
+    int stall;
+    int cancels;
+    int cancelDeadlineSet; /* deadline still set when CANCEL is cleared */
+} CrbTestIo;
+
+static int test_CrbIoCb(TPM2_CTX* ctx, int isRead, word32 addr, byte* buf,
+    word16 size, void* userCtx)
+{
+    CrbTestIo* io = (CrbTestIo*)userCtx;
+    int rc;
+    int start = (addr == TPM_CRB_CTRL_START(ctx->locality));
+
+    if (isRead && start && io->stall) {
+        XMEMSET(buf, 0, size);
+        buf[0] = 1;
+        return TPM_RC_SUCCESS;
+    }
+    if (!isRead && addr == TPM_CRB_CTRL_CANCEL(ctx->locality) &&
+            (buf[0] & 1)) {
+        io->cancels++;
+        io->stall = 0;
+    }
+    else if (!isRead && addr == TPM_CRB_CTRL_CANCEL(ctx->locality)) {
+        io->cancelDeadlineSet = ctx->cmdDeadlineSet;
+    }
+    if (!isRead && start && io->mapped && (buf[0] & 1)) {
+        rc = TPM2_IoCb(ctx, 0, TPM_CRB_DATA_BUFFER(ctx->locality), io->map,
+            sizeof(io->map), NULL);
+        if (rc != TPM_RC_SUCCESS)
+            return rc;
+    }
+    rc = TPM2_IoCb(ctx, isRead, addr, buf, size, NULL);
+    if (rc == TPM_RC_SUCCESS && isRead && start && io->mapped &&
+            (buf[0] & 1) == 0) {
+        rc = TPM2_IoCb(ctx, 1, TPM_CRB_DATA_BUFFER(ctx->locality), io->map,
+            sizeof(io->map), NULL);
+    }
+    return rc;
+}
+
+static word32 test_CrbRead32(TPM2_CTX* ctx, word32 addr)
+{
+    byte reg[4];
+    AssertIntEQ(TPM2_IoCb(ctx, 1, addr, reg, sizeof(reg), NULL), 0);
+    return (word32)reg[0] | ((word32)reg[1] << 8) | ((word32)reg[2] << 16) |
+           ((word32)reg[3] << 24);
+}
+
+static void test_CrbWrite32(TPM2_CTX* ctx, word32 addr, word32 v)
+{
+    byte reg[4];
+    reg[0] = (byte)v;
+    reg[1] = (byte)(v >> 8);
+    reg[2] = (byte)(v >> 16);
+    reg[3] = (byte)(v >> 24);
+    AssertIntEQ(TPM2_IoCb(ctx, 0, addr, reg, sizeof(reg), NULL), 0);
+}
+
+static void test_TPM2_CRB(void)
+{
+    int rc, loc;
+    WOLFTPM2_DEV dev;
+    WOLFTPM2_BUFFER rngData;
+    CrbTestIo io;
+    byte rsp[TPM2_HEADER_SIZE];
+#ifndef WOLFTPM2_USE_WOLF_RNG
+    byte stage[32], nonce[16];
+    int i;
+#endif
+
+    XMEMSET(&io, 0, sizeof(io));
+    rc = wolfTPM2_Init(&dev, test_CrbIoCb, &io);
+    AssertIntEQ(rc, 0);
+    AssertIntEQ(dev.ctx.did_vid & 0xFFFF, 0x1414);
+    loc = dev.ctx.locality;
+
+    /* registers and data buffer through the HAL */
+    rc = wolfTPM2_GetRandom(&dev, rngData.buffer, 32);
+    AssertIntEQ(rc, 0);
+#ifndef WOLFTPM_CRB_IDLE
+    /* stays ready between commands */
+    AssertIntEQ(test_CrbRead32(&dev.ctx, TPM_CRB_CTRL_STS(loc)) &
+        TPM_CRB_CTRL_STS_IDLE, 0);
+#endif
+
+    /* START is ignored while idle, the next command leaves idle */
+    test_CrbWrite32(&dev.ctx, TPM_CRB_CTRL_REQ(loc), TPM_CRB_CTRL_REQ_GO_IDLE);
+    AssertIntEQ(test_CrbRead32(&dev.ctx, TPM_CRB_CTRL_STS(loc)) &
+        TPM_CRB_CTRL_STS_IDLE, TPM_CRB_CTRL_STS_IDLE);
+    test_CrbWrite32(&dev.ctx, TPM_CRB_CTRL_START(loc), 1);
+    AssertIntEQ(test_CrbRead32(&dev.ctx, TPM_CRB_CTRL_START(loc)), 0);
+    rc = wolfTPM2_GetRandom(&dev, rngData.buffer, 32);
+    AssertIntEQ(rc, 0);
+
+    /* a command still running at the deadline is canceled */
+    io.stall = 1;
+    rc = TPM2_SetCommandTimeout(&dev.ctx, 20);
+    AssertIntEQ(rc, 0);
+    rc = wolfTPM2_GetRandom(&dev, rngData.buffer, 32);
+    AssertIntEQ(rc, TPM_RC_DEADLINE);
+    AssertIntEQ(io.cancels, 1);
+    AssertIntEQ(io.cancelDeadlineSet, 1);
+    AssertIntEQ(test_CrbRead32(&dev.ctx, TPM_CRB_CTRL_START(loc)), 0);
+    AssertIntEQ(test_CrbRead32(&dev.ctx, TPM_CRB_CTRL_CANCEL(loc)), 0);
+    rc = TPM2_IoCb(&dev.ctx, 1, TPM_CRB_DATA_BUFFER(loc), rsp, sizeof(rsp),
+        NULL);
+    AssertIntEQ(rc, 0);
+    AssertIntEQ(((word32)rsp[6] << 24) | ((word32)rsp[7] << 16) |
+        ((word32)rsp[8] << 8) | rsp[9], TPM_RC_CANCELED);
+    rc = TPM2_SetCommandTimeout(&dev.ctx, 0);
+    AssertIntEQ(rc, 0);
+    rc = wolfTPM2_GetRandom(&dev, rngData.buffer, 32);
+    AssertIntEQ(rc, 0);
+
+    /* zero copy with the mapped buffer */
+    AssertIntNE(TPM2_CRB_SetBuffer(&dev.ctx, io.map, TPM2_HEADER_SIZE), 0);
+    rc = TPM2_CRB_SetBuffer(&dev.ctx, io.map, sizeof(io.map));
+    AssertIntEQ(rc, 0);
+    io.mapped = 1;
+    rc = wolfTPM2_GetRandom(&dev, rngData.buffer, 32);
+    AssertIntEQ(rc, 0);
+#ifndef WOLFTPM2_USE_WOLF_RNG
+    /* the nonce for an auth session runs while its command is staged in
+     * the mapped buffer, which gets the staged command back */
+    for (i = 0; i < (int)sizeof(stage); i++)
+        stage[i] = (byte)i;
+    stage[2] = 0; stage[3] = 0; stage[4] = 0; stage[5] = sizeof(stage);
+    XMEMCPY(io.map, stage, sizeof(stage));
+    rc = TPM2_GetNonce(nonce, sizeof(nonce));
+    AssertIntEQ(rc, 0);
+    AssertIntEQ(XMEMCMP(io.map, stage, sizeof(stage)), 0);
+#endif
+    rc = TPM2_CRB_SetBuffer(&dev.ctx, NULL, 0);
+    AssertIntEQ(rc, 0);
+    io.mapped = 0;
+
+    /* cleanup leaves the TPM idle and gives up the locality */
+    wolfTPM2_Cleanup(&dev);
+    AssertIntEQ(test_CrbRead32(&dev.ctx, TPM_CRB_CTRL_STS(loc)) &
+        TPM_CRB_CTRL_STS_IDLE, TPM_CRB_CTRL_STS_IDLE);
+    AssertIntEQ(test_CrbRead32(&dev.ctx, TPM_CRB_LOC_STATE(loc)) &
+        TPM_CRB_LOC_STATE_ASSIGNED, 0);
+
+    printf("Test TPM2:\t\tCRB:\t\t%s\n",
+        rc == 0 ? "Passed" : "Failed");
+}
+#endif
+
+#ifdef WOLFTPM_SWTPM
+static void test_TPM2_SWTPM_Address(void)
+{
+    int rc;
+    TPM2_CTX ctx;
+    char path[TPM2_SWTPM_ADDR_SZ + 1];
+
+    XMEMSET(&ctx, 0, sizeof(ctx));
+    XMEMSET(path, '/', sizeof(path) - 1);
+    path[sizeof(path) - 1] = '\0';
+
+    rc = TPM2_SWTPM_SetAddress(NULL, "localhost", "2321");
+    AssertIntNE(rc, 0);
+    rc = TPM2_SWTPM_SetAddress(&ctx, path, NULL);
+    AssertIntNE(rc, 0);
+    rc = TPM2_SWTPM_SetAddress(&ctx, "/tmp/swtpm.sock", NULL);
+    AssertIntEQ(rc, 0);
+    AssertIntEQ(XSTRCMP(ctx.tcpCtx.host, "/tmp/swtpm.sock"), 0);
+    AssertIntEQ(ctx.tcpCtx.port[0], '\0');
+
+    /* a Unix socket has no default control channel */
+    if (getenv(TPM2_SWTPM_CTRL_HOST_ENV) == NULL) {
+        AssertIntEQ(TPM2_SWTPM_PowerCycle(&ctx, 0), BAD_FUNC_ARG);
+    }
+    rc = TPM2_SWTPM_SetCtrlAddress(&ctx, "/tmp/swtpm.ctrl", NULL);
+    AssertIntEQ(rc, 0);
+
+    printf("Test TPM2:\t\tSWTPM Address:\t%s\n",
+        rc == 0 ? "Passed" : "Failed");
+}
+#endif
+
+static void test_wolfTPM2_Pool(void)
+{
+    int rc, idx, i;
+    WOLFTPM2_POOL pool;
+    WOLFTPM2_DEV* dev = NULL;
+    word32 ticket = 0;
+    WOLFTPM2_BUFFER rngData;
+
+    /* Test arguments */
+    rc = wolfTPM2_PoolInit(NULL, WOLFTPM2_POOL_ROUND_ROBIN, NULL, NULL);
+    AssertIntNE(rc, 0);
+    rc = wolfTPM2_PoolInit(&pool, -1, NULL, NULL);
+    AssertIntNE(rc, 0);
+
+    rc = wolfTPM2_PoolInit(&pool, WOLFTPM2_POOL_LEAST_LOADED, NULL, NULL);
+    AssertIntEQ(rc, 0);
+
+    /* empty pool has no healthy TPM */
+    idx = wolfTPM2_PoolAcquire(&pool, -1, &dev, &ticket);
+    AssertIntEQ(idx, TPM_RC_FAILURE);
+
+    idx = wolfTPM2_PoolAdd(&pool, TPM2_IoCb, NULL);
+    AssertIntEQ(idx, 0);
+
+    /* Test success */
+    rc = wolfTPM2_PoolGetRandom(&pool, rngData.buffer, sizeof(rngData.buffer));
+    AssertIntEQ(rc, 0);
+
+    /* device failures eject the member until reinstated */
+    for (i = 0; i < WOLFTPM2_POOL_MAX_ERRORS; i++) {
+        idx = wolfTPM2_PoolAcquire(&pool, 0, &dev, &ticket);
+        AssertIntEQ(idx, 0);
+        rc = wolfTPM2_PoolRelease(&pool, idx, ticket, TPM_RC_FAILURE);
+        AssertIntEQ(rc, 0);
+    }
+    idx = wolfTPM2_PoolAcquire(&pool, 0, &dev, &ticket);
+    AssertIntEQ(idx, TPM_RC_FAILURE);
+    rc = wolfTPM2_PoolReinstate(&pool, 0);
+    AssertIntEQ(rc, 0);
+    idx = wolfTPM2_PoolAcquire(&pool, 0, &dev, &ticket);
+    AssertIntEQ(idx, 0);
+    rc = wolfTPM2_GetRandom(dev, rngData.buffer, sizeof(rngData.buffer));
+    AssertIntEQ(rc, 0);
+    rc = wolfTPM2_PoolRelease(&pool, idx, ticket, rc);
+    AssertIntEQ(rc, 0);
+
+    rc = wolfTPM2_PoolCleanup(&pool);
+    AssertIntEQ(rc, 0);
+
+    printf("Test TPM Wrapper:\tDevice Pool:\t%s\n",
+        rc == 0 ? "Passed" : "Failed");
+}
+
+static void test_wolfTPM2_UnloadHandles(void)
+{
+    int rc;
+    WOLFTPM2_DEV dev;
+
+    /* Test arguments */
+    rc = wolfTPM2_UnloadHandles_All(NULL);
+    AssertIntNE(rc, 0);
+
+    rc = wolfTPM2_Init(&dev, TPM2_IoCb, NULL);
+    AssertIntEQ(rc, 0);
+
+    /* Test success */
+    rc = wolfTPM2_UnloadHandles_AllTransient(&dev);
+    AssertIntEQ(rc, 0);
+    rc = wolfTPM2_UnloadHandles_All(&dev);
+    AssertIntEQ(rc, 0);
+
+    wolfTPM2_Cleanup(&dev);
+
+    printf("Test TPM Wrapper:\tUnload Handles:\t%s\n",
+        rc == 0 ? "Passed" : "Failed");
+}
+
+static void test_TPM2_GetCommandHandleCount(void)
+{
+    int rc, inCnt = -1, outCnt = -1;
+
+    rc = TPM2_GetCommandHandleCount(TPM_CC_StartAuthSession, &inCnt, &outCnt);
+    AssertIntEQ(rc, 0);
+    AssertIntEQ(inCnt, 2);
+    AssertIntEQ(outCnt, 1);
+    /* CreateLoaded returns the object handle ahead of the parameters */
+    rc = TPM2_GetCommandHandleCount(TPM_CC_CreateLoaded, &inCnt, &outCnt);
+    AssertIntEQ(rc, 0);
+    AssertIntEQ(inCnt, 1);
+    AssertIntEQ(outCnt, 1);
+    rc = TPM2_GetCommandHandleCount(TPM_CC_FlushContext, &inCnt, NULL);
+    AssertIntEQ(rc, 0);
+    AssertIntEQ(inCnt, 0);
+
+    /* unknown command */
+    rc = TPM2_GetCommandHandleCount(0x12345, &inCnt, &outCnt);
+    AssertIntEQ(rc, TPM_RC_COMMAND_CODE);
+
+    printf("Test TPM2:\t\tGetCommandHandleCount:\t%s\n",
+        rc == TPM_RC_COMMAND_CODE ? "Passed" : "Failed");
+}
+
+static void test_TPM2_GetRCString(void)
+{
+    const char* str;
+
+    str = TPM2_GetRCString(TPM_RC_SUCCESS);
+    AssertNotNull(str);
+    AssertIntEQ(XMEMCMP(str, "Success", 8), 0);
+    str = TPM2_GetRCString(TPM_RC_NV_LOCKED);
+    AssertNotNull(str);
+#ifdef WOLFTPM2_NO_RC_STRINGS
+    AssertIntEQ(XMEMCMP(str, "Error", 6), 0);
+#else
+    AssertIntGE((int)XSTRLEN(str), 17);
+    AssertIntEQ(XMEMCMP(str, "TPM_RC_NV_LOCKED", 16), 0);
+#endif
+
+    printf("Test TPM2:\t\tGetRCString:\t%s\n", "Passed");
+}
+
+static void test_TPM2_ParseAttest(void)
+{
+    int rc;
+    TPM2B_ATTEST attest;
+    TPMS_ATTEST out;
+    byte* p = attest.attestationData;
+
+    XMEMSET(&attest, 0, sizeof(attest));
+    /* magic, type, qualifiedSigner larger than the name buffer */
+    p[0] = 0xFF; p[1] = 'T'; p[2] = 'C'; p[3] = 'G';
+    p[4] = (byte)(TPM_ST_ATTEST_QUOTE >> 8); p[5] = (byte)TPM_ST_ATTEST_QUOTE;
+    p[6] = 0xFF; p[7] = 0xFF;
+    attest.size = 8 + 16;
+
+    rc = TPM2_ParseAttest(&attest, &out);
+    AssertIntEQ(rc, BUFFER_E);
+    AssertIntEQ(out.qualifiedSigner.size, 0);
+    AssertIntEQ(out.extraData.size, 0);
+
+    /* a name that fits the buffer but runs past the attestation */
+    p[6] = 0x00; p[7] = 0x20;
+    rc = TPM2_ParseAttest(&attest, &out);
+    AssertIntEQ(rc, BUFFER_E);
+
+    printf("Test TPM2:\t\tParseAttest:\t%s\n",
+        rc == BUFFER_E ? "Passed" : "Failed");
+}
+
+static void test_TPM2_PCR_Extend_Prepared(void)
+{
+    int rc, digestSz;
+    WOLFTPM2_DEV dev;
+    TPM2_PREPARED cmd;
+    PCR_Extend_In in;
+    byte digest[TPM_SHA256_DIGEST_SIZE];
+    byte pcrPrep[TPM_SHA256_DIGEST_SIZE];
+    byte pcrExt[TPM_SHA256_DIGEST_SIZE];
+
+    rc = wolfTPM2_Init(&dev, TPM2_IoCb, NULL);
+    AssertIntEQ(rc, 0);
+
+    XMEMSET(&in, 0, sizeof(in));
+    in.pcrHandle = TPM2_TEST_PCR;
+    in.digests.count = 1;
+    in.digests.digests[0].hashAlg = TPM_ALG_SHA256;
+
+    /* Test arguments */
+    rc = TPM2_PCR_Extend_Prepare(NULL, &in);
+    AssertIntNE(rc, 0);
+    rc = TPM2_PCR_Extend_Prepare(&cmd, &in);
+    AssertIntEQ(rc, 0);
+    rc = TPM2_PCR_Extend_Execute(&cmd, digest, sizeof(digest) - 1);
+    AssertIntNE(rc, 0);
+
+    /* Test success: matches a regular extend */
+    XMEMSET(digest, 0x11, sizeof(digest));
+    rc = wolfTPM2_ResetPCR(&dev, TPM2_TEST_PCR);
+    AssertIntEQ(rc, 0);
+    rc = TPM2_PCR_Extend_Execute(&cmd, digest, sizeof(digest));
+    AssertIntEQ(rc, 0);
+    digestSz = (int)sizeof(pcrPrep);
+    rc = wolfTPM2_ReadPCR(&dev, TPM2_TEST_PCR, TPM_ALG_SHA256, pcrPrep,
+        &digestSz);
+    AssertIntEQ(rc, 0);
+
+    rc = wolfTPM2_ResetPCR(&dev, TPM2_TEST_PCR);
+    AssertIntEQ(rc, 0);
+    rc = wolfTPM2_ExtendPCR(&dev, TPM2_TEST_PCR, TPM_ALG_SHA256, digest,
+        (int)sizeof(digest));
+    AssertIntEQ(rc, 0);
+    digestSz = (int)sizeof(pcrExt);
+    rc = wolfTPM2_ReadPCR(&dev, TPM2_TEST_PCR, TPM_ALG_SHA256, pcrExt,
+        &digestSz);
+    AssertIntEQ(rc, 0);
+    AssertIntEQ(XMEMCMP(pcrPrep, pcrExt, sizeof(pcrExt)), 0);
+
+    wolfTPM2_Cleanup(&dev);
+
+    printf("Test TPM Wrapper:\tPCR Extend Prepared:\t%s\n",
+        rc == 0 ? "Passed" : "Failed");
+}
+
 static void test_wolfTPM2_Cleanup(void)
 {
     int rc;
@@ -369,6 +1557,7 @@ static void test_wolfTPM_ImportPublicKey(void)
     wolfTPM2_Cleanup(&dev);
 }
 
+#ifndef WOLFTPM2_NO_POLICY
 /* Test vector from ibmtss policy authorize test for SHA2-256 */
 static void test_wolfTPM2_PCRPolicy(void)
 {
@@ -433,6 +1622,7 @@ static void test_wolfTPM2_PCRPolicy(void)
 
     wolfTPM2_Cleanup(&dev);
 }
+#endif /* !WOLFTPM2_NO_POLICY */
 #endif /* !WOLFTPM2_NO_WOLFCRYPT */
 
 #if defined(HAVE_THREAD_LS) && defined(HAVE_PTHREAD)
@@ -500,15 +1690,51 @@ int unit_tests(int argc, char *argv[])
 #ifndef WOLFTPM2_NO_WRAPPER
     test_wolfTPM2_Init();
     test_wolfTPM2_OpenExisting();
+    test_wolfTPM2_InitWarmStart();
     test_wolfTPM2_GetCapabilities();
     test_wolfTPM2_GetRandom();
+#if defined(WOLFTPM_SINGLE_FLIGHT) && defined(HAVE_PTHREAD)
+    test_wolfTPM2_SingleFlight();
+#endif
+#ifdef WOLFTPM_PRIORITY
+    test_TPM2_Priority();
+    #ifdef HAVE_PTHREAD
+    test_TPM2_PriorityThreads();
+    #endif
+#endif
+    test_TPM2_LockStats();
+#if defined(HAVE_PTHREAD) && !defined(WOLFTPM2_NO_WOLFCRYPT) && \
+    !defined(SINGLE_THREADED)
+    test_TPM2_LockThreads();
+#endif
+    test_TPM2_CommandTimeout();
+#ifndef WOLFTPM_NO_RETRY
+    test_TPM2_RetryPolicy();
+    #if defined(WOLFTPM_SWTPM) && defined(HAVE_PTHREAD) && !defined(_WIN32)
+    test_TPM2_RetryScripted();
+    #endif
+#endif
+#ifdef WOLFTPM_CRB_SIM
+    test_TPM2_CRB();
+#endif
+#ifdef WOLFTPM_SWTPM
+    test_TPM2_SWTPM_Address();
+#endif
+    test_wolfTPM2_Pool();
+    test_wolfTPM2_UnloadHandles();
+    test_TPM2_PCR_Extend_Prepared();
+    test_TPM2_GetCommandHandleCount();
+    test_TPM2_GetRCString();
+    test_TPM2_ParseAttest();
     test_TPM2_KDFa();
     test_wolfTPM2_ReadPublicKey();
     test_wolfTPM2_CSR();
     #ifndef WOLFTPM2_NO_WOLFCRYPT
     test_wolfTPM_ImportPublicKey();
+    #ifndef WOLFTPM2_NO_POLICY
     test_wolfTPM2_PCRPolicy();
     #endif
+    #endif
     test_wolfTPM2_Cleanup();
     test_wolfTPM2_thread_local_storage();
 #endif /* !WOLFTPM2_NO_WRAPPER */
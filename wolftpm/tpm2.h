@@ -399,6 +399,7 @@ typedef enum {
 
     /* use negative codes for internal errors */
     TPM_RC_TIMEOUT = -100,
+    TPM_RC_DEADLINE = -101, /* a caller deadline expired, not sent by a TPM */
 } TPM_RC_T;
 typedef INT32 TPM_RC; /* type is unsigned 16-bits, but internally use signed 32-bit */
 
@@ -1652,11 +1653,20 @@ static const BYTE TPM_20_EK_AUTH_POLICY[] = {
 /* HAL IO Callbacks */
 struct TPM2_CTX;
 
-#ifdef WOLFTPM_SWTPM
+#if defined(WOLFTPM_SWTPM) || defined(WOLFTPM_BROKER)
+#ifndef TPM2_SWTPM_ADDR_SZ
+#define TPM2_SWTPM_ADDR_SZ 108 /* host name or Unix socket path */
+#endif
 struct wolfTPM_tcpContext {
     int fd;
+#ifdef WOLFTPM_SWTPM
+    char host[TPM2_SWTPM_ADDR_SZ];
+    char port[8];
+    char ctrlHost[TPM2_SWTPM_ADDR_SZ];
+    char ctrlPort[8];
+#endif
 };
-#endif /* WOLFTPM_SWTPM */
+#endif /* WOLFTPM_SWTPM || WOLFTPM_BROKER */
 
 #ifdef WOLFTPM_WINAPI
 #include <tbs.h>
@@ -1675,8 +1685,8 @@ struct wolfTPM_winContext {
 #define WOLFTPM_IS_COMMAND_UNAVAILABLE(code) (code == (int)TPM_RC_COMMAND_CODE)
 #endif /* WOLFTPM_WINAPI */
 
-/* make sure advanced IO is enabled for I2C */
-#ifdef WOLFTPM_I2C
+/* make sure advanced IO is enabled for I2C and CRB */
+#if defined(WOLFTPM_I2C) || defined(WOLFTPM_CRB)
     #undef  WOLFTPM_ADV_IO
     #define WOLFTPM_ADV_IO
 #endif
@@ -1700,10 +1710,89 @@ typedef int (*TPM2HalIoCb)(struct TPM2_CTX*, const BYTE* txBuf, BYTE* rxBuf,
 #define XFER_MAX_SIZE MAX_COMMAND_SIZE
 #endif
 
+/* Returns a free running millisecond tick */
+typedef word32 (*TPM2TimeCb)(void* timeCtx);
+
+/* Hardware lock statistics. Times need a tick set with TPM2_SetTimeCb */
+typedef struct TPM2_LOCK_STATS {
+    word32 acquired;     /* lock acquisitions */
+    word32 recursive;    /* nested acquisitions by the owning thread */
+    word32 contended;    /* acquisitions that found the lock held */
+    word32 waitTotalMs;  /* total time waiting for the lock */
+    word32 waitMaxMs;    /* longest wait for the lock */
+    word32 holdTotalMs;  /* total time the lock was held */
+    word32 holdMaxMs;    /* longest time the lock was held */
+} TPM2_LOCK_STATS;
+
+#ifdef WOLFTPM_TIS_LOCK
+/* Cross process TIS lock statistics */
+typedef struct TPM2_TIS_LOCK_STATS {
+    word32 acquired;     /* commands (or startup accesses) locked */
+    word32 contended;    /* acquisitions that found the lock held */
+    word32 waitTotalMs;  /* total time waiting for the lock */
+    word32 waitMaxMs;    /* longest wait for the lock */
+} TPM2_TIS_LOCK_STATS;
+#endif
+
+#ifndef WOLFTPM_NO_RETRY
+/* Warning response codes resent automatically, see TPM2_SetRetryPolicy */
+enum {
+    TPM2_RETRY_RC_RETRY = 0,    /* TPM_RC_RETRY */
+    TPM2_RETRY_RC_YIELDED,      /* TPM_RC_YIELDED */
+    TPM2_RETRY_RC_TESTING,      /* TPM_RC_TESTING */
+    TPM2_RETRY_RC_NV_RATE,      /* TPM_RC_NV_RATE */
+    TPM2_RETRY_RC_COUNT
+};
+#define TPM2_RETRY_MASK(idx) (1U << (idx))
+#define TPM2_RETRY_MASK_ALL  (TPM2_RETRY_MASK(TPM2_RETRY_RC_COUNT) - 1)
+
+typedef struct TPM2_RETRY_POLICY {
+    word32 maxRetries;   /* resends per command, 0 disables retry */
+    word32 initialMs;    /* first backoff, doubled on each resend */
+    word32 maxMs;        /* backoff limit */
+    word32 rcMask;       /* TPM2_RETRY_MASK() of the codes to retry */
+} TPM2_RETRY_POLICY;
+
+typedef struct TPM2_RETRY_STATS {
+    word32 retries[TPM2_RETRY_RC_COUNT]; /* resends per response code */
+    word32 recovered;    /* commands that completed after a resend */
+    word32 exhausted;    /* commands that ran out of retries */
+} TPM2_RETRY_STATS;
+
+#ifndef WOLFTPM_RETRY_MAX
+    #define WOLFTPM_RETRY_MAX 8
+#endif
+#ifndef WOLFTPM_RETRY_INITIAL_MS
+    #define WOLFTPM_RETRY_INITIAL_MS 1
+#endif
+#ifndef WOLFTPM_RETRY_MAX_MS
+    #define WOLFTPM_RETRY_MAX_MS 500
+#endif
+#endif /* !WOLFTPM_NO_RETRY */
+
+#ifdef WOLFTPM_PRIORITY
+/* Priority classes for commands queued on the TPM lock. Lower is served
+ * first: waiters of a class yield while any higher class is waiting. */
+enum {
+    TPM2_PRIORITY_DEFAULT = -1, /* use the context priority */
+    TPM2_PRIORITY_HIGH = 0,     /* latency critical (TLS signing) */
+    TPM2_PRIORITY_NORMAL,
+    TPM2_PRIORITY_BULK,         /* key generation, NV logs, sequences */
+    TPM2_PRIORITY_COUNT
+};
+
+typedef struct TPM2_PRIORITY_STATS {
+    word32 acquired;     /* lock acquisitions */
+    word32 waitTotalMs;  /* total queue wait time */
+    word32 waitMaxMs;    /* longest queue wait time */
+    word32 expired;      /* calls canceled due to deadline */
+} TPM2_PRIORITY_STATS;
+#endif
+
 typedef struct TPM2_CTX {
     TPM2HalIoCb ioCb;
     void* userCtx;
-#ifdef WOLFTPM_SWTPM
+#if defined(WOLFTPM_SWTPM) || defined(WOLFTPM_BROKER)
     struct wolfTPM_tcpContext tcpCtx;
 #endif
 #ifdef WOLFTPM_WINAPI
@@ -1712,17 +1801,50 @@ typedef struct TPM2_CTX {
 #ifndef WOLFTPM2_NO_WOLFCRYPT
 #ifndef SINGLE_THREADED
     wolfSSL_Mutex hwLock;
-    int lockCount;
+    int lockCount;           /* recursion depth of the owning thread */
+    void* volatile lockOwner; /* thread holding hwLock, NULL when free */
+    word32 lockStart;        /* tick when hwLock was taken */
+    TPM2_LOCK_STATS lockStats;
+#endif
+#ifdef WOLFTPM_PRIORITY
+    wolfSSL_Mutex prioLock;  /* protects waiting counts and stats */
+    int priority;            /* default class for this context */
+    int prioBusy;            /* a thread holds or is taking hwLock */
+    word32 prioWaiting[TPM2_PRIORITY_COUNT];
+    TPM2_PRIORITY_STATS prioStats[TPM2_PRIORITY_COUNT];
 #endif
     #ifdef WOLFTPM2_USE_WOLF_RNG
     WC_RNG rng;
     #endif
 #endif /* !WOLFTPM2_NO_WOLFCRYPT */
 
+#ifdef WOLFTPM_TIS_LOCK
+    int tisLockFd;           /* lock file, open for the context lifetime */
+    int tisLockDepth;
+    TPM2_TIS_LOCK_STATS tisLockStats;
+#endif
+
+    TPM2TimeCb timeCb;       /* millisecond tick for deadlines and stats */
+    void* timeCtx;
+    word32 cmdTimeoutMs;     /* deadline for each command, 0 for none */
+    word32 cmdDeadline;      /* tick at which the current command expires */
+    int cmdDeadlineSet;
+#ifndef WOLFTPM_NO_RETRY
+    TPM2_RETRY_POLICY retryPolicy;
+    TPM2_RETRY_STATS retryStats;
+#endif
+
     /* TPM TIS Info */
     int locality;
     word32 caps;
     word32 did_vid;
+    word32 stateGen;         /* bumped on Startup and field upgrade, which
+                              * can change the reported capabilities */
+#ifdef WOLFTPM_CRB
+    word32 crbCmdSz;         /* CRB data buffer size in the register window */
+    byte* crbBuf;            /* mapped CRB buffer, see TPM2_CRB_SetBuffer */
+    word32 crbBufSz;
+#endif
 
     /* Pointer to current TPM auth sessions */
     TPM2_AUTH_SESSION* session;
@@ -3212,6 +3334,387 @@ WOLFTPM_API void      TPM2_SetActiveCtx(TPM2_CTX* ctx);
 */
 WOLFTPM_API TPM2_CTX* TPM2_GetActiveCtx(void);
 
+/*!
+    \ingroup TPM2_Proprietary
+    \brief Sets the millisecond tick for a TPM2 context. It times command
+    deadlines and the hardware lock wait and hold times reported by
+    TPM2_GetLockStats. Without a tick, deadlines use the monotonic clock on
+    POSIX systems and are disabled elsewhere.
+
+    \return TPM_RC_SUCCESS: successful
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param ctx pointer to a TPM2_CTX struct
+    \param timeCb millisecond tick, NULL to use the default clock
+    \param timeCtx user context for timeCb
+
+    \sa TPM2_SetCommandTimeout
+    \sa TPM2_GetLockStats
+*/
+WOLFTPM_API int TPM2_SetTimeCb(TPM2_CTX* ctx, TPM2TimeCb timeCb,
+    void* timeCtx);
+
+/*!
+    \ingroup TPM2_Proprietary
+    \brief Sets a deadline for each command sent on a TPM2 context. A command
+    still running at the deadline is aborted and fails with TPM_RC_DEADLINE.
+    This wolfTPM error is negative, so callers can tell it apart from
+    TPM_RC_CANCELED, the warning a TPM returns for a command it canceled.
+    The TIS interface aborts it with commandReady. The socket and /dev/tpm
+    interfaces stop waiting for the response and drop the connection. The
+    Windows TBS interface only checks the deadline before submitting.
+
+    \return TPM_RC_SUCCESS: successful
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param ctx pointer to a TPM2_CTX struct
+    \param timeoutMs deadline per command in milliseconds, 0 for none
+
+    \sa TPM2_SetCallTimeout
+    \sa TPM2_SetTimeCb
+*/
+WOLFTPM_API int TPM2_SetCommandTimeout(TPM2_CTX* ctx, word32 timeoutMs);
+
+/*!
+    \ingroup TPM2_Proprietary
+    \brief Sets the command deadline for the calling thread. It overrides
+    the context deadline until reset with 0.
+
+    \return the previous call timeout
+
+    \param timeoutMs deadline per command in milliseconds, 0 for the context
+    deadline
+
+    _Example_
+    \code
+    word32 prev = TPM2_SetCallTimeout(200);
+    rc = wolfTPM2_SignHash(&dev, &key, digest, digestSz, sig, &sigSz);
+    TPM2_SetCallTimeout(prev);
+    if (rc == TPM_RC_DEADLINE) {
+        // shed load
+    }
+    \endcode
+
+    \sa TPM2_SetCommandTimeout
+*/
+WOLFTPM_API word32 TPM2_SetCallTimeout(word32 timeoutMs);
+
+#ifndef WOLFTPM_NO_RETRY
+/*!
+    \ingroup TPM2_Proprietary
+    \brief Sets the automatic retry policy for a TPM2 context. A command that
+    gets one of the selected warning codes (TPM_RC_RETRY, TPM_RC_YIELDED,
+    TPM_RC_TESTING or TPM_RC_NV_RATE) is resent after an exponential backoff.
+    The TPM did not process the command, so the packet is resent as built,
+    including its authorization area. Retries stop at the command deadline
+    and the last warning code is returned. The backoff sleeps while the
+    command holds the TPM lock, so other threads and higher priority callers
+    wait for up to the sum of the delays (about 255 ms with the defaults).
+    Latency sensitive applications should lower maxRetries or maxMs, or leave
+    TPM_RC_TESTING and TPM_RC_NV_RATE out of rcMask.
+
+    \return TPM_RC_SUCCESS: successful
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param ctx pointer to a TPM2_CTX struct
+    \param policy pointer to the TPM2_RETRY_POLICY, NULL for the defaults
+    (WOLFTPM_RETRY_MAX, WOLFTPM_RETRY_INITIAL_MS, WOLFTPM_RETRY_MAX_MS, all
+    codes)
+
+    _Example_
+    \code
+    TPM2_RETRY_POLICY policy;
+    policy.maxRetries = 4;
+    policy.initialMs = 10;
+    policy.maxMs = 200;
+    policy.rcMask = TPM2_RETRY_MASK(TPM2_RETRY_RC_RETRY) |
+                    TPM2_RETRY_MASK(TPM2_RETRY_RC_YIELDED);
+    TPM2_SetRetryPolicy(ctx, &policy);
+    \endcode
+
+    \sa TPM2_GetRetryStats
+    \sa TPM2_SetCommandTimeout
+*/
+WOLFTPM_API int TPM2_SetRetryPolicy(TPM2_CTX* ctx,
+    const TPM2_RETRY_POLICY* policy);
+
+/*!
+    \ingroup TPM2_Proprietary
+    \brief Gets the automatic retry counters for a TPM2 context
+
+    \return TPM_RC_SUCCESS: successful
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param ctx pointer to a TPM2_CTX struct
+    \param stats pointer to TPM2_RETRY_STATS to populate
+
+    \sa TPM2_SetRetryPolicy
+*/
+WOLFTPM_API int TPM2_GetRetryStats(TPM2_CTX* ctx, TPM2_RETRY_STATS* stats);
+#endif
+
+/* Milliseconds left before the deadline of the command being sent: -1 when
+ * there is no deadline, 0 once it passed. Used by the transports. */
+WOLFTPM_LOCAL int TPM2_DeadlineRemaining(TPM2_CTX* ctx);
+
+/*!
+    \ingroup TPM2_Proprietary
+    \brief Gets the hardware lock statistics for a TPM2 context. The lock is
+    recursive for the thread that owns it, so nested calls from a callback
+    count as recursive rather than as new acquisitions. Host only helpers
+    (name computation, policy digests, key blob buffers) never take the lock.
+
+    \return TPM_RC_SUCCESS: successful
+    \return BAD_FUNC_ARG: check the provided arguments
+    \return NOT_COMPILED_IN: built without the hardware lock
+
+    \param ctx pointer to a TPM2_CTX struct
+    \param stats pointer to TPM2_LOCK_STATS to populate
+
+    \sa TPM2_SetTimeCb
+*/
+WOLFTPM_API int TPM2_GetLockStats(TPM2_CTX* ctx, TPM2_LOCK_STATS* stats);
+
+#ifdef WOLFTPM_CRB
+/*!
+    \ingroup TPM2_Proprietary
+    \brief Registers the memory mapped CRB command and response buffer (the
+    buffer reported in CRB_CTRL_CMD_LADDR) for zero copy operation. Commands
+    are then marshaled directly into the buffer, the TPM writes the response
+    in place and only the control registers use the HAL IO callback. Without
+    a buffer the command is written to the data buffer in the locality
+    register window through the HAL IO callback.
+
+    \return TPM_RC_SUCCESS: successful
+    \return BAD_FUNC_ARG: check the provided arguments, the buffer must hold
+    at least TPM_CRB_DATA_BUFFER_SZ bytes
+
+    \param ctx pointer to a TPM2_CTX struct
+    \param buf mapped command and response buffer, NULL to stop using it
+    \param bufSz size of the buffer in bytes
+*/
+WOLFTPM_API int TPM2_CRB_SetBuffer(TPM2_CTX* ctx, byte* buf, word32 bufSz);
+#endif
+
+#ifdef WOLFTPM_TIS_LOCK
+/*!
+    \ingroup TPM2_Proprietary
+    \brief Gets the statistics of the cross process TIS lock file
+    (WOLFTPM_TIS_LOCK_FILE), which is taken once per command
+
+    \return TPM_RC_SUCCESS: successful
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param ctx pointer to a TPM2_CTX struct
+    \param stats pointer to TPM2_TIS_LOCK_STATS to populate
+
+    \sa TPM2_GetLockStats
+*/
+WOLFTPM_API int TPM2_TIS_GetLockStats(TPM2_CTX* ctx,
+    TPM2_TIS_LOCK_STATS* stats);
+#endif
+
+#ifdef WOLFTPM_PRIORITY
+/*!
+    \ingroup TPM2_Proprietary
+    \brief Sets the default priority class for commands on a TPM2 context
+    and the optional millisecond tick used for deadlines and wait statistics
+
+    \return TPM_RC_SUCCESS: successful
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param ctx pointer to a TPM2_CTX struct
+    \param priority TPM2_PRIORITY_HIGH, TPM2_PRIORITY_NORMAL or
+    TPM2_PRIORITY_BULK
+    \param timeCb optional millisecond tick (NULL disables deadlines)
+    \param timeCtx user context for timeCb
+
+    \sa TPM2_SetCallPriority
+    \sa TPM2_GetPriorityStats
+*/
+WOLFTPM_API int TPM2_SetPriority(TPM2_CTX* ctx, int priority,
+    TPM2TimeCb timeCb, void* timeCtx);
+
+/*!
+    \ingroup TPM2_Proprietary
+    \brief Sets the priority class and deadline for commands issued by the
+    calling thread, overriding the context default until reset with
+    TPM2_PRIORITY_DEFAULT. The deadline bounds how long each command may
+    wait in the queue behind higher classes; once passed the command fails
+    with TPM_RC_DEADLINE without being sent. Deadlines use the time
+    callback set with TPM2_SetPriority, or the monotonic clock where one is
+    known. Without either, a command with a deadline fails with
+    BAD_FUNC_ARG.
+
+    \return the previous call priority
+
+    \param priority class or TPM2_PRIORITY_DEFAULT
+    \param deadlineMs maximum queue wait per command, 0 for none
+
+    _Example_
+    \code
+    int prev = TPM2_SetCallPriority(TPM2_PRIORITY_HIGH, 50);
+    rc = wolfTPM2_SignHash(&dev, &key, digest, digestSz, sig, &sigSz);
+    TPM2_SetCallPriority(prev, 0);
+    \endcode
+
+    \sa TPM2_SetPriority
+*/
+WOLFTPM_API int TPM2_SetCallPriority(int priority, word32 deadlineMs);
+
+/*!
+    \ingroup TPM2_Proprietary
+    \brief Gets queue wait statistics for a priority class
+
+    \return TPM_RC_SUCCESS: successful
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param ctx pointer to a TPM2_CTX struct
+    \param priority class to report
+    \param stats pointer to TPM2_PRIORITY_STATS to populate
+
+    \sa TPM2_SetPriority
+*/
+WOLFTPM_API int TPM2_GetPriorityStats(TPM2_CTX* ctx, int priority,
+    TPM2_PRIORITY_STATS* stats);
+#endif /* WOLFTPM_PRIORITY */
+
+/* Prepared command: parameters are marshalled once and only the variable
+ * fields are patched for each execution. The auth area is built from the
+ * current sessions when executed. */
+#ifndef TPM2_PREPARED_MAX_FIELDS
+#define TPM2_PREPARED_MAX_FIELDS HASH_COUNT
+#endif
+#ifndef TPM2_PREPARED_MAX_SZ
+#define TPM2_PREPARED_MAX_SZ \
+    (16 + (HASH_COUNT + 2) * (sizeof(UINT16) + TPM_MAX_DIGEST_SIZE))
+#endif
+
+typedef struct TPM2_PREPARED_FIELD {
+    UINT16 pos; /* offset in parameters */
+    UINT16 size;
+} TPM2_PREPARED_FIELD;
+
+typedef struct TPM2_PREPARED {
+    TPM_CC cmdCode;
+    UINT16 paramSz;
+    BYTE fieldCnt;
+    TPM2_PREPARED_FIELD field[TPM2_PREPARED_MAX_FIELDS];
+    TPM_HANDLE handle; /* input handle, if the command has one */
+    BYTE param[TPM2_PREPARED_MAX_SZ];
+} TPM2_PREPARED;
+
+/*!
+    \ingroup TPM2_Proprietary
+    \brief Prepares a TPM2_Sign command where only the digest changes
+    \note The key handle, scheme and validation ticket are fixed. The digest
+    size is fixed to in->digest.size.
+
+    \return TPM_RC_SUCCESS: successful
+    \return BUFFER_E: parameters do not fit TPM2_PREPARED_MAX_SZ
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param cmd pointer to a TPM2_PREPARED to fill
+    \param in pointer to the TPM2_Sign input (digest contents are not used)
+
+    \sa TPM2_Sign_Execute
+    \sa TPM2_Sign
+*/
+WOLFTPM_API TPM_RC TPM2_Sign_Prepare(TPM2_PREPARED* cmd, const Sign_In* in);
+
+/*!
+    \ingroup TPM2_Proprietary
+    \brief Runs a prepared TPM2_Sign command on a new digest
+
+    \return TPM_RC_SUCCESS: successful
+    \return TPM_RC_FAILURE: general error (possibly IO)
+    \return BAD_FUNC_ARG: check the provided arguments (digestSz must match)
+
+    \param cmd pointer to a TPM2_PREPARED from TPM2_Sign_Prepare
+    \param digest pointer to the digest to sign
+    \param digestSz size of the digest, in bytes
+    \param out pointer to the TPM2_Sign output
+
+    \sa TPM2_Sign_Prepare
+*/
+WOLFTPM_API TPM_RC TPM2_Sign_Execute(TPM2_PREPARED* cmd, const BYTE* digest,
+    UINT16 digestSz, Sign_Out* out);
+
+/*!
+    \ingroup TPM2_Proprietary
+    \brief Prepares a TPM2_PCR_Extend command where only the digests change
+    \note The PCR handle and list of hash algorithms are fixed.
+
+    \return TPM_RC_SUCCESS: successful
+    \return BUFFER_E: parameters do not fit TPM2_PREPARED_MAX_SZ
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param cmd pointer to a TPM2_PREPARED to fill
+    \param in pointer to the TPM2_PCR_Extend input (digest contents are not
+    used)
+
+    \sa TPM2_PCR_Extend_Execute
+    \sa TPM2_PCR_Extend
+*/
+WOLFTPM_API TPM_RC TPM2_PCR_Extend_Prepare(TPM2_PREPARED* cmd,
+    const PCR_Extend_In* in);
+
+/*!
+    \ingroup TPM2_Proprietary
+    \brief Runs a prepared TPM2_PCR_Extend command with new digests
+
+    \return TPM_RC_SUCCESS: successful
+    \return TPM_RC_FAILURE: general error (possibly IO)
+    \return BAD_FUNC_ARG: check the provided arguments (digestsSz must match)
+
+    \param cmd pointer to a TPM2_PREPARED from TPM2_PCR_Extend_Prepare
+    \param digests digest for each hash algorithm, concatenated in order
+    \param digestsSz total size of digests, in bytes
+
+    \sa TPM2_PCR_Extend_Prepare
+*/
+WOLFTPM_API TPM_RC TPM2_PCR_Extend_Execute(TPM2_PREPARED* cmd,
+    const BYTE* digests, UINT32 digestsSz);
+
+/*!
+    \ingroup TPM2_Proprietary
+    \brief Gets the number of handles in the handle area of a command and of
+    its response
+
+    \return TPM_RC_SUCCESS: successful
+    \return TPM_RC_COMMAND_CODE: unknown command code
+
+    \param cc TPM command code
+    \param inHandleCnt optional, number of command handles
+    \param outHandleCnt optional, number of response handles
+
+    \sa TPM2_SendRawCommand
+*/
+WOLFTPM_API int TPM2_GetCommandHandleCount(TPM_CC cc, int* inHandleCnt,
+    int* outHandleCnt);
+
+/*!
+    \ingroup TPM2_Proprietary
+    \brief Sends an already marshalled command to the TPM and receives the
+    response in the same buffer. No authorization or parameter encryption is
+    applied, which lets a proxy forward commands built by another TSS.
+
+    \return TPM_RC_SUCCESS: command delivered, the TPM response code is in
+    the response header
+    \return TPM_RC_SIZE: invalid response size
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param ctx pointer to a TPM2_CTX struct
+    \param buf command on input, response on output
+    \param cmdSz size of the command in buf
+    \param bufSz size of buf (should be MAX_RESPONSE_SIZE or more)
+    \param rspSz size of the response
+
+    \sa TPM2_GetCommandHandleCount
+*/
+WOLFTPM_API TPM_RC TPM2_SendRawCommand(TPM2_CTX* ctx, BYTE* buf, int cmdSz,
+    int bufSz, int* rspSz);
+
 /*!
     \ingroup TPM2_Proprietary
     \brief Determine the size in bytes of a TPM 2.0 hash digest
@@ -3340,6 +3843,9 @@ WOLFTPM_API void TPM2_SetupPCRSelArray(TPML_PCR_SELECTION* pcr, TPM_ALG_ID alg,
 
     \param rc integer value representing a TPM return code
 
+    \note With WOLFTPM2_NO_RC_STRINGS the string tables are compiled out and
+    only "Success" or "Error" is returned
+
     _Example_
     \code
     int rc;
@@ -0,0 +1,55 @@
+/* tpm2_broker.h
+ *
+ * Copyright (C) 2006-2022 wolfSSL Inc.
+ *
+ * This file is part of wolfTPM.
+ *
+ * wolfTPM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfTPM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#ifndef _TPM2_BROKER_H_
+#define _TPM2_BROKER_H_
+
+#include <wolftpm/tpm2.h>
+#include <wolftpm/tpm2_packet.h>
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+/* Unix-domain socket of the local TPM broker daemon (examples/broker).
+ * The WOLFTPM_BROKER_PATH environment variable overrides it at runtime.
+ * The directory must not be writable by other users (the broker refuses to
+ * listen otherwise); /run/wolftpm is created for a dedicated group. */
+#ifndef TPM2_BROKER_PATH
+#define TPM2_BROKER_PATH            "/run/wolftpm/broker.sock"
+#endif
+#define TPM2_BROKER_PATH_ENV        "WOLFTPM_BROKER_PATH"
+
+/* Commands and responses are exchanged as raw TPM 2.0 byte streams; the
+ * size in the header frames each message. The connection stays open for the
+ * life of the context, since the broker scopes objects and sessions to it. */
+
+#ifdef WOLFTPM_BROKER
+/* TPM2 IO for using TPM through the local broker daemon */
+WOLFTPM_LOCAL int  TPM2_BROKER_SendCommand(TPM2_CTX* ctx, TPM2_Packet* packet);
+WOLFTPM_LOCAL void TPM2_BROKER_Cleanup(TPM2_CTX* ctx);
+#endif
+
+#ifdef __cplusplus
+    }  /* extern "C" */
+#endif
+
+#endif /* _TPM2_BROKER_H_ */
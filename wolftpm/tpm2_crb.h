@@ -0,0 +1,95 @@
+/* tpm2_crb.h
+ *
+ * Copyright (C) 2006-2023 wolfSSL Inc.
+ *
+ * This file is part of wolfTPM.
+ *
+ * wolfTPM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfTPM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#ifndef __TPM2_CRB_H__
+#define __TPM2_CRB_H__
+
+#include <wolftpm/tpm2.h>
+#include <wolftpm/tpm2_packet.h>
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+/* TCG PC Client Platform TPM Profile (PTP) CRB registers. Each locality has
+ * a 4KB register window, addressed through the ADV_IO HAL callback the same
+ * way as the TIS registers. */
+#ifndef TPM_CRB_BASE_ADDRESS
+#define TPM_CRB_BASE_ADDRESS    (0xD40000u)
+#endif
+
+#define TPM_CRB_LOC_STATE(l)    (TPM_CRB_BASE_ADDRESS | 0x0000u | ((l) << 12u))
+#define TPM_CRB_LOC_CTRL(l)     (TPM_CRB_BASE_ADDRESS | 0x0008u | ((l) << 12u))
+#define TPM_CRB_LOC_STS(l)      (TPM_CRB_BASE_ADDRESS | 0x000Cu | ((l) << 12u))
+#define TPM_CRB_INTF_ID(l)      (TPM_CRB_BASE_ADDRESS | 0x0030u | ((l) << 12u))
+#define TPM_CRB_CTRL_REQ(l)     (TPM_CRB_BASE_ADDRESS | 0x0040u | ((l) << 12u))
+#define TPM_CRB_CTRL_STS(l)     (TPM_CRB_BASE_ADDRESS | 0x0044u | ((l) << 12u))
+#define TPM_CRB_CTRL_CANCEL(l)  (TPM_CRB_BASE_ADDRESS | 0x0048u | ((l) << 12u))
+#define TPM_CRB_CTRL_START(l)   (TPM_CRB_BASE_ADDRESS | 0x004Cu | ((l) << 12u))
+#define TPM_CRB_CTRL_CMD_SIZE(l) (TPM_CRB_BASE_ADDRESS | 0x0058u | ((l) << 12u))
+#define TPM_CRB_CTRL_RSP_SIZE(l) (TPM_CRB_BASE_ADDRESS | 0x0064u | ((l) << 12u))
+#define TPM_CRB_DATA_BUFFER(l)  (TPM_CRB_BASE_ADDRESS | 0x0080u | ((l) << 12u))
+
+/* data buffer inside the locality window */
+#define TPM_CRB_DATA_BUFFER_SZ  0xF80u
+
+enum tpm_crb_loc_state {
+    TPM_CRB_LOC_STATE_ESTABLISHED = 0x01,
+    TPM_CRB_LOC_STATE_ASSIGNED    = 0x02,
+    TPM_CRB_LOC_STATE_ACTIVE_MASK = 0x1C, /* active locality, bits 4:2 */
+    TPM_CRB_LOC_STATE_REG_VALID   = 0x80,
+};
+
+enum tpm_crb_loc_ctrl {
+    TPM_CRB_LOC_CTRL_REQUEST      = 0x01,
+    TPM_CRB_LOC_CTRL_RELINQUISH   = 0x02,
+};
+
+enum tpm_crb_ctrl_req {
+    TPM_CRB_CTRL_REQ_CMD_READY    = 0x01,
+    TPM_CRB_CTRL_REQ_GO_IDLE      = 0x02,
+};
+
+enum tpm_crb_ctrl_sts {
+    TPM_CRB_CTRL_STS_ERROR        = 0x01, /* fatal error, needs reset */
+    TPM_CRB_CTRL_STS_IDLE         = 0x02,
+};
+
+#define TPM_CRB_INTF_TYPE_MASK    0x0F
+#define TPM_CRB_INTF_TYPE_CRB     0x01
+
+WOLFTPM_LOCAL int TPM2_CRB_Read(TPM2_CTX* ctx, word32 addr, byte* result,
+    word32 len);
+WOLFTPM_LOCAL int TPM2_CRB_Write(TPM2_CTX* ctx, word32 addr,
+    const byte* value, word32 len);
+WOLFTPM_LOCAL int TPM2_CRB_StartupWait(TPM2_CTX* ctx, int timeout);
+WOLFTPM_LOCAL int TPM2_CRB_RequestLocality(TPM2_CTX* ctx, int timeout);
+WOLFTPM_LOCAL int TPM2_CRB_GetInfo(TPM2_CTX* ctx);
+WOLFTPM_LOCAL int TPM2_CRB_Ready(TPM2_CTX* ctx);
+WOLFTPM_LOCAL int TPM2_CRB_GoIdle(TPM2_CTX* ctx);
+WOLFTPM_LOCAL int TPM2_CRB_SendCommand(TPM2_CTX* ctx, TPM2_Packet* packet);
+WOLFTPM_LOCAL void TPM2_CRB_Cleanup(TPM2_CTX* ctx);
+
+#ifdef __cplusplus
+    }  /* extern "C" */
+#endif
+
+#endif /* __TPM2_CRB_H__ */
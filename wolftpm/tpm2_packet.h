@@ -45,6 +45,8 @@ typedef struct TPM2_Packet {
     byte* buf;
     int pos;
     int size;
+    int parseErr; /* first response field that did not fit, see
+                   * TPM2_Packet_ParseStatus */
 } TPM2_Packet;
 
 
@@ -71,6 +73,8 @@ typedef struct {
 } CmdInfo_t;
 
 
+WOLFTPM_LOCAL int TPM2_GetCmdInfo(TPM_CC cc, CmdInfo_t* info);
+
 WOLFTPM_LOCAL void TPM2_Packet_U16ToByteArray(UINT16 val, BYTE* b);
 WOLFTPM_LOCAL void TPM2_Packet_U32ToByteArray(UINT32 val, BYTE* b);
 
@@ -91,6 +95,11 @@ WOLFTPM_LOCAL void TPM2_Packet_ParseU64(TPM2_Packet* packet, UINT64* data);
 WOLFTPM_LOCAL void TPM2_Packet_AppendS32(TPM2_Packet* packet, INT32 data);
 WOLFTPM_LOCAL void TPM2_Packet_AppendBytes(TPM2_Packet* packet, byte* buf, int size);
 WOLFTPM_LOCAL void TPM2_Packet_ParseBytes(TPM2_Packet* packet, byte* buf, int size);
+WOLFTPM_LOCAL int  TPM2_Packet_ParseU16Buf(TPM2_Packet* packet, UINT16* size,
+    byte* buf, UINT16 maxSz);
+WOLFTPM_LOCAL int  TPM2_Packet_ParseCount(TPM2_Packet* packet, UINT32* count,
+    UINT32 maxCount);
+WOLFTPM_LOCAL int  TPM2_Packet_ParseStatus(TPM2_Packet* packet);
 WOLFTPM_LOCAL void TPM2_Packet_MarkU16(TPM2_Packet* packet, int* markSz);
 WOLFTPM_LOCAL int  TPM2_Packet_PlaceU16(TPM2_Packet* packet, int markSz);
 WOLFTPM_LOCAL void TPM2_Packet_MarkU32(TPM2_Packet* packet, int* markSz);
@@ -42,9 +42,51 @@
 #define TPM_STOP                    21
 #endif
 
+/* Default simulator address. A host starting with '/' is a Unix domain
+ * socket path (swtpm --server type=unixio,path=...). The environment
+ * variables override the defaults at runtime and TPM2_SWTPM_SetAddress
+ * overrides both for one context. */
+#ifndef TPM2_SWTPM_HOST
+#define TPM2_SWTPM_HOST             "localhost"
+#endif
+#ifndef TPM2_SWTPM_PORT
+#define TPM2_SWTPM_PORT             "2321"
+#endif
+#ifndef TPM2_SWTPM_CTRL_PORT
+#define TPM2_SWTPM_CTRL_PORT        "2322"
+#endif
+#define TPM2_SWTPM_HOST_ENV         "WOLFTPM_SWTPM_HOST"
+#define TPM2_SWTPM_PORT_ENV         "WOLFTPM_SWTPM_PORT"
+#define TPM2_SWTPM_CTRL_HOST_ENV    "WOLFTPM_SWTPM_CTRL_HOST"
+#define TPM2_SWTPM_CTRL_PORT_ENV    "WOLFTPM_SWTPM_CTRL_PORT"
+
+/* swtpm control channel commands (swtpm --ctrl, see swtpm-ioctls) */
+#define SWTPM_CTRL_CMD_INIT         0x02 /* power cycle, payload: flags */
+#define SWTPM_CTRL_CMD_SHUTDOWN     0x03 /* power off */
+#define SWTPM_CTRL_CMD_STOP         0x0E /* stop, keep the process */
+
+#define SWTPM_CTRL_INIT_DELETE_VOLATILE 0x01 /* discard saved volatile state */
+
 /* TPM2 IO for using TPM through a Socket connection */
 WOLFTPM_LOCAL int TPM2_SWTPM_SendCommand(TPM2_CTX* ctx, TPM2_Packet* packet);
 
+/* Sets the command channel address for a context (copied). NULL or empty
+ * values use the environment or build default. */
+WOLFTPM_API int TPM2_SWTPM_SetAddress(TPM2_CTX* ctx, const char* host,
+    const char* port);
+/* Sets the control channel address for a context. A TCP control channel
+ * defaults to the command host and TPM2_SWTPM_CTRL_PORT. A Unix socket
+ * control channel must be set explicitly. */
+WOLFTPM_API int TPM2_SWTPM_SetCtrlAddress(TPM2_CTX* ctx, const char* host,
+    const char* port);
+/* Sends a control channel command with an optional big endian payload and
+ * returns the swtpm result code (0 on success) */
+WOLFTPM_API int TPM2_SWTPM_CtrlCommand(TPM2_CTX* ctx, word32 cmd,
+    const byte* in, word32 inSz, word32* result);
+/* Resets the simulator with SWTPM_CTRL_CMD_INIT. TPM2_Startup must be sent
+ * again afterwards. */
+WOLFTPM_API int TPM2_SWTPM_PowerCycle(TPM2_CTX* ctx, int deleteVolatile);
+
 #ifdef __cplusplus
     }  /* extern "C" */
 #endif
@@ -57,6 +57,9 @@ WOLFTPM_LOCAL int TPM2_TIS_CheckLocality(TPM2_CTX* ctx, int locality, byte* acce
 WOLFTPM_LOCAL int TPM2_TIS_StartupWait(TPM2_CTX* ctx, int timeout);
 WOLFTPM_LOCAL int TPM2_TIS_Write(TPM2_CTX* ctx, word32 addr, const byte* value, word32 len);
 WOLFTPM_LOCAL int TPM2_TIS_Read(TPM2_CTX* ctx, word32 addr, byte* result, word32 len);
+#ifdef WOLFTPM_TIS_LOCK
+WOLFTPM_LOCAL void TPM2_TIS_Cleanup(TPM2_CTX* ctx);
+#endif
 
 #ifdef __cplusplus
     }  /* extern "C" */
@@ -354,6 +354,46 @@ typedef int64_t  INT64;
     #define WOLFTPM_PERFORM_SELFTEST
 #endif
 
+/* Loaded key cache uses a wolfCrypt SHA2-256 digest of the key blob */
+#if defined(WOLFTPM_KEY_CACHE) && \
+    (defined(WOLFTPM2_NO_WOLFCRYPT) || defined(NO_SHA256))
+    #undef WOLFTPM_KEY_CACHE
+#endif
+
+/* Single-flight request coalescing waits on wolfCrypt mutexes */
+#if defined(WOLFTPM_SINGLE_FLIGHT) && \
+    (defined(WOLFTPM2_NO_WOLFCRYPT) || defined(SINGLE_THREADED))
+    #undef WOLFTPM_SINGLE_FLIGHT
+#endif
+
+/* Small stack builds take the large wrapper command structures from a per
+ * device scratch arena instead of the stack */
+#if defined(WOLFTPM_SMALL_STACK) && !defined(WOLFTPM_NO_SCRATCH) && \
+    !defined(WOLFTPM_SCRATCH)
+    #define WOLFTPM_SCRATCH
+#endif
+
+/* Priority scheduling is layered on the hardware lock mutex */
+#if defined(WOLFTPM_PRIORITY) && \
+    (defined(WOLFTPM2_NO_WOLFCRYPT) || defined(SINGLE_THREADED))
+    #undef WOLFTPM_PRIORITY
+#endif
+#if defined(WOLFTPM_PRIORITY) && !defined(XTPM_PRIORITY_YIELD)
+    /* sleep while the TPM is busy or a higher priority class is waiting */
+    #ifndef XTPM_PRIORITY_YIELD_US
+        #define XTPM_PRIORITY_YIELD_US 100
+    #endif
+    #if defined(__linux__) || defined(__unix__) || defined(__APPLE__)
+        #include <unistd.h>
+        #define XTPM_PRIORITY_YIELD() usleep(XTPM_PRIORITY_YIELD_US)
+    #elif defined(_WIN32)
+        #include <windows.h>
+        #define XTPM_PRIORITY_YIELD() Sleep(1)
+    #else
+        #error WOLFTPM_PRIORITY needs XTPM_PRIORITY_YIELD to sleep or yield
+    #endif
+#endif
+
 
 
 /* ---------------------------------------------------------------------------*/
@@ -392,7 +432,8 @@ typedef int64_t  INT64;
 #endif
 
 #ifndef TPM_TIMEOUT_TRIES
-    #if defined(WOLFTPM_LINUX_DEV) || defined(WOLFTPM_SWTPM) || defined(WOLFTPM_WINAPI)
+    #if defined(WOLFTPM_LINUX_DEV) || defined(WOLFTPM_SWTPM) || \
+        defined(WOLFTPM_BROKER) || defined(WOLFTPM_WINAPI)
     #define TPM_TIMEOUT_TRIES 0
     #else
     #define TPM_TIMEOUT_TRIES 1000000
@@ -457,6 +498,19 @@ typedef int64_t  INT64;
     #define XTPM_WAIT() /* just poll without delay by default */
 #endif
 
+/* Backoff before resending a command that got TPM_RC_RETRY and friends */
+#if !defined(WOLFTPM_NO_RETRY) && !defined(XTPM_DELAY_MS)
+    #if defined(__linux__) || defined(__unix__) || defined(__APPLE__)
+        #include <unistd.h>
+        #define XTPM_DELAY_MS(ms) usleep((ms) * 1000)
+    #elif defined(_WIN32)
+        #include <windows.h>
+        #define XTPM_DELAY_MS(ms) Sleep(ms)
+    #else
+        #define XTPM_DELAY_MS(ms) /* resend without delay by default */
+    #endif
+#endif
+
 #ifndef BUFFER_ALIGNMENT
 #define BUFFER_ALIGNMENT 4
 #endif
@@ -650,7 +704,7 @@ typedef int64_t  INT64;
 #endif
 
 #if !defined(WOLFTPM2_NO_WOLFCRYPT) && defined(WOLFSSL_CERT_GEN) && \
-    (!defined(NO_RSA) || defined(HAVE_ECC))
+    (!defined(NO_RSA) || defined(HAVE_ECC)) && !defined(WOLFTPM2_NO_CSR)
     /* Enable the certificate generation support */
     #define WOLFTPM2_CERT_GEN
 #endif
@@ -50,9 +50,114 @@ typedef struct WOLFTPM2_SESSION {
     TPMA_SESSION    sessionAttributes;
 } WOLFTPM2_SESSION;
 
+typedef enum WOLFTPM2_MFG {
+    TPM_MFG_UNKNOWN = 0,
+    TPM_MFG_INFINEON,
+    TPM_MFG_STM,
+    TPM_MFG_MCHP,
+    TPM_MFG_NUVOTON,
+    TPM_MFG_NATIONTECH,
+} WOLFTPM2_MFG;
+
+typedef struct WOLFTPM2_CAPS {
+    WOLFTPM2_MFG mfg;
+    char mfgStr[4 + 1];
+    char vendorStr[(4 * 4) + 1];
+    word32 tpmType;
+    word16 fwVerMajor;
+    word16 fwVerMinor;
+    word32 fwVerVendor;
+
+    /* bits */
+    word16 fips140_2 : 1; /* using FIPS mode */
+    word16 cc_eal4   : 1; /* Common Criteria EAL4+ */
+    word16 req_wait_state : 1; /* requires SPI wait state */
+} WOLFTPM2_CAPS;
+
+#ifdef WOLFTPM_SINGLE_FLIGHT
+#ifndef WOLFTPM2_FLIGHT_NUM
+    #define WOLFTPM2_FLIGHT_NUM 4 /* concurrent distinct read-only requests */
+#endif
+
+/* Result of a read-only request shared with identical concurrent requests */
+typedef union WOLFTPM2_FLIGHT_OUT {
+    ReadPublic_Out    readPub;
+    NV_ReadPublic_Out nvReadPub;
+    PCR_Read_Out      pcrRead;
+    WOLFTPM2_CAPS     caps;
+} WOLFTPM2_FLIGHT_OUT;
+
+typedef struct WOLFTPM2_FLIGHT {
+    wolfSSL_Mutex done;   /* held by the leader while the command runs */
+    word32 op;            /* request type and arguments, 0 when free */
+    word32 arg1;
+    word32 arg2;
+    int    rc;
+    word32 waiters;       /* followers waiting for the result */
+    byte   isDone;
+    WOLFTPM2_FLIGHT_OUT out;
+} WOLFTPM2_FLIGHT;
+#endif
+
+#ifdef WOLFTPM_KEY_CACHE
+#ifndef WOLFTPM2_KEY_CACHE_NUM
+    #define WOLFTPM2_KEY_CACHE_NUM MAX_HANDLE_NUM
+#endif
+#define WOLFTPM2_KEY_CACHE_DIGEST_SZ 32 /* SHA2-256 */
+
+/* Loaded key, matched by digest of parent, public and private blob */
+typedef struct WOLFTPM2_KEY_CACHE_ENTRY {
+    TPM_HANDLE  hndl;      /* loaded object handle, 0 when slot is free */
+    TPM2B_NAME  name;
+    word32      refCount;  /* users of the handle, idle when zero */
+    word32      lastUse;   /* for least recently used eviction */
+    byte        digest[WOLFTPM2_KEY_CACHE_DIGEST_SZ];
+} WOLFTPM2_KEY_CACHE_ENTRY;
+#endif
+
+#ifdef WOLFTPM_SCRATCH
+/* Scratch arena for the command structures of a single wrapper call. The
+ * default fits the largest user, wolfTPM2_CreateKey (Create_In and
+ * Create_Out). Calls needing more return MEMORY_E. */
+#define WOLFTPM2_SCRATCH_ALIGN 8
+#ifndef WOLFTPM2_SCRATCH_SZ
+#define WOLFTPM2_SCRATCH_SZ (sizeof(Create_In) + sizeof(Create_Out) + \
+    2 * WOLFTPM2_SCRATCH_ALIGN)
+#endif
+#endif
+#if defined(WOLFTPM_SCRATCH) && !defined(WOLFTPM2_NO_WOLFCRYPT) && \
+    !defined(SINGLE_THREADED)
+    #define WOLFTPM2_SCRATCH_LOCK /* threads sharing a device take turns */
+#endif
+
 typedef struct WOLFTPM2_DEV {
     TPM2_CTX ctx;
     TPM2_AUTH_SESSION session[MAX_SESSION_NUM];
+#ifdef WOLFTPM_KEY_CACHE
+    WOLFTPM2_KEY_CACHE_ENTRY keyCache[WOLFTPM2_KEY_CACHE_NUM];
+    word32 keyCacheTick;
+#endif
+#ifdef WOLFTPM_SINGLE_FLIGHT
+    wolfSSL_Mutex flightLock;
+    WOLFTPM2_FLIGHT* flight; /* WOLFTPM2_FLIGHT_NUM slots, allocated on use */
+    word32 flightIssued;    /* read-only requests sent to the TPM */
+    word32 flightCoalesced; /* requests answered by one already in flight */
+#endif
+    /* public cache validated against this device, entries are dropped when
+     * the wrapper persists or evicts a key */
+    struct WOLFTPM2_PUBCACHE* pubCache;
+    /* capabilities read at ctx.stateGen capsGen, see wolfTPM2_GetCapabilities */
+    WOLFTPM2_CAPS caps;
+    word32 capsGen;
+    byte capsValid;
+#ifdef WOLFTPM_SCRATCH
+#ifdef WOLFTPM2_SCRATCH_LOCK
+    wolfSSL_Mutex scratchLock; /* held by one wrapper call at a time */
+#endif
+    UINT64 scratch[(WOLFTPM2_SCRATCH_SZ + 7) / 8]; /* 8 byte aligned */
+    word32 scratchPos;
+    word32 scratchHigh;     /* high-water mark in bytes */
+#endif
 } WOLFTPM2_DEV;
 
 typedef struct WOLFTPM2_KEY {
@@ -67,8 +172,22 @@ typedef struct WOLFTPM2_KEYBLOB {
     TPM2B_PRIVATE     priv;
 } WOLFTPM2_KEYBLOB;
 
+/* WOLFTPM2_HASH_HYBRID: host digests (wolfTPM2_HashStart_ex) and deferred
+ * one-shot TPM2_Hash / TPM2_HMAC for small inputs. Adds the pending input
+ * and host hash state to WOLFTPM2_HASH, so it changes the structure size. */
 typedef struct WOLFTPM2_HASH {
     WOLFTPM2_HANDLE handle;
+#ifdef WOLFTPM2_HASH_HYBRID
+    TPMI_ALG_HASH   hashAlg;
+    TPM2B_MAX_BUFFER buffer; /* input held until a TPM sequence is needed */
+#ifndef WOLFTPM2_NO_WOLFCRYPT
+    wc_HashAlg      hostHash; /* host digest state when isHost is set */
+#endif
+
+    /* option bits */
+    word16 isHost:1;    /* digest is computed on host with wolfCrypt */
+    word16 isPending:1; /* TPM sequence not started, input is in buffer */
+#endif
 } WOLFTPM2_HASH;
 
 typedef struct WOLFTPM2_NV {
@@ -90,6 +209,101 @@ typedef struct WOLFTPM2_CSR {
 } WOLFTPM2_CSR;
 #endif
 
+#if !defined(WOLFTPM2_NO_WOLFCRYPT) && defined(HAVE_AESGCM) && \
+    !defined(NO_SHA256)
+#ifndef WOLFTPM2_ENVELOPE_KEY_SZ
+    #define WOLFTPM2_ENVELOPE_KEY_SZ 32 /* AES-256 data key */
+#endif
+#define WOLFTPM2_ENVELOPE_IV_SZ      12
+#define WOLFTPM2_ENVELOPE_TAG_SZ     16
+#define WOLFTPM2_ENVELOPE_MAGIC      0x77545045UL /* "wTPE" */
+#define WOLFTPM2_ENVELOPE_VERSION    2
+/* Header: magic (4) | version (1) | base nonce (12) | blob size (2) | blob */
+#define WOLFTPM2_ENVELOPE_HDR_SZ     (4 + 1 + WOLFTPM2_ENVELOPE_IV_SZ + 2)
+/* Chunk AAD: SHA-256 of the encoded header | final flag (1) */
+#define WOLFTPM2_ENVELOPE_AAD_SZ     (WC_SHA256_DIGEST_SIZE + 1)
+
+typedef struct WOLFTPM2_ENVELOPE {
+    WOLFTPM2_KEYBLOB sealBlob; /* data key sealed under a TPM storage key */
+    Aes     aes;               /* host AES-GCM using the unsealed data key */
+    byte    iv[WOLFTPM2_ENVELOPE_IV_SZ]; /* base nonce, chunk index mixed in */
+    byte    aad[WOLFTPM2_ENVELOPE_AAD_SZ]; /* header digest and final flag */
+    word32  chunkIdx;
+
+    /* option bits */
+    word16 aesInit:1;
+    word16 isFinal:1;
+} WOLFTPM2_ENVELOPE;
+#endif
+
+#ifndef WOLFTPM2_PUBCACHE_MAX
+    #define WOLFTPM2_PUBCACHE_MAX 8 /* persistent keys in public cache */
+#endif
+#define WOLFTPM2_PUBCACHE_MAGIC      0x77545043UL /* "wTPC" */
+#define WOLFTPM2_CONTEXT_MAGIC       0x77545053UL /* "wTPS" */
+#define WOLFTPM2_CONTEXT_VERSION     2
+
+#ifndef WOLFTPM2_POOL_MAX
+    #define WOLFTPM2_POOL_MAX 4 /* TPM devices in a pool */
+#endif
+#ifndef WOLFTPM2_POOL_MAX_ERRORS
+    #define WOLFTPM2_POOL_MAX_ERRORS 3 /* consecutive failures before eject */
+#endif
+
+/* Pool dispatch policy for operations not bound to a device */
+enum {
+    WOLFTPM2_POOL_ROUND_ROBIN  = 0,
+    WOLFTPM2_POOL_LEAST_LOADED = 1,
+};
+
+/* Returns a millisecond tick, used for member latency tracking */
+typedef word32 (*WOLFTPM2_POOL_TIME_CB)(void* timeCtx);
+
+typedef struct WOLFTPM2_POOL_DEV {
+    WOLFTPM2_DEV dev;
+    word32 inUse;     /* operations in progress */
+    word32 ops;       /* completed operations */
+    word32 failures;  /* total device failures */
+    word32 errors;    /* consecutive device failures */
+    word32 latencyMs; /* smoothed operation latency */
+
+    /* option bits */
+    word16 isOpen:1;
+    word16 isEjected:1; /* failed or slow, skipped until reinstated */
+} WOLFTPM2_POOL_DEV;
+
+typedef struct WOLFTPM2_POOL {
+    WOLFTPM2_POOL_DEV member[WOLFTPM2_POOL_MAX];
+    int count;
+    int next;                   /* round robin position */
+    int policy;                 /* WOLFTPM2_POOL_ROUND_ROBIN or LEAST_LOADED */
+    word32 maxLatencyMs;        /* eject members slower than this, 0=off */
+    WOLFTPM2_POOL_TIME_CB timeCb;
+    void* timeCtx;
+#if !defined(WOLFTPM2_NO_WOLFCRYPT) && !defined(SINGLE_THREADED)
+    wolfSSL_Mutex lock;
+#endif
+} WOLFTPM2_POOL;
+
+typedef struct WOLFTPM2_PUBCACHE_ENTRY {
+    TPM_HANDLE   hndl;
+    TPM2B_PUBLIC pub;
+    TPM2B_NAME   name;
+} WOLFTPM2_PUBCACHE_ENTRY;
+
+/* Public area and name of persistent keys, to avoid TPM2_ReadPublic at
+ * start-up. Tied to the TPM resetCount and validated against the list of
+ * persistent handles. */
+typedef struct WOLFTPM2_PUBCACHE {
+    UINT32 resetCount;
+    word32 count;
+    WOLFTPM2_PUBCACHE_ENTRY entry[WOLFTPM2_PUBCACHE_MAX];
+
+    /* option bits */
+    word16 isValid:1; /* checked against the TPM since import */
+    word16 isDirty:1; /* changed since import, export to persist */
+} WOLFTPM2_PUBCACHE;
+
 #ifndef WOLFTPM2_MAX_BUFFER
     #define WOLFTPM2_MAX_BUFFER 2048
 #endif
@@ -99,30 +313,6 @@ typedef struct WOLFTPM2_BUFFER {
     byte buffer[WOLFTPM2_MAX_BUFFER];
 } WOLFTPM2_BUFFER;
 
-typedef enum WOLFTPM2_MFG {
-    TPM_MFG_UNKNOWN = 0,
-    TPM_MFG_INFINEON,
-    TPM_MFG_STM,
-    TPM_MFG_MCHP,
-    TPM_MFG_NUVOTON,
-    TPM_MFG_NATIONTECH,
-} WOLFTPM2_MFG;
-
-typedef struct WOLFTPM2_CAPS {
-    WOLFTPM2_MFG mfg;
-    char mfgStr[4 + 1];
-    char vendorStr[(4 * 4) + 1];
-    word32 tpmType;
-    word16 fwVerMajor;
-    word16 fwVerMinor;
-    word32 fwVerVendor;
-
-    /* bits */
-    word16 fips140_2 : 1; /* using FIPS mode */
-    word16 cc_eal4   : 1; /* Common Criteria EAL4+ */
-    word16 req_wait_state : 1; /* requires SPI wait state */
-} WOLFTPM2_CAPS;
-
 /* NV Handles */
 #define TPM2_NV_RSA_EK_CERT 0x01C00002
 #define TPM2_NV_ECC_EK_CERT 0x01C0000A
@@ -191,6 +381,39 @@ WOLFTPM_API int wolfTPM2_Test(TPM2HalIoCb ioCb, void* userCtx, WOLFTPM2_CAPS* ca
 */
 WOLFTPM_API int wolfTPM2_Init(WOLFTPM2_DEV* dev, TPM2HalIoCb ioCb, void* userCtx);
 
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Initialization for a TPM that is likely already started, such as
+    when a service restarts. If the TPM reports it is started then TPM2_Startup
+    and the full self-test are skipped. Only the listed algorithms are tested
+    with TPM2_IncrementalSelfTest.
+    \note On a cold TPM this behaves like wolfTPM2_Init, except the full
+    self-test (WOLFTPM_PERFORM_SELFTEST) replaces the incremental one
+
+    \return TPM_RC_SUCCESS: successful
+    \return TPM_RC_FAILURE: generic failure (check TPM IO communication)
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param dev pointer to an empty structure of WOLFTPM2_DEV type
+    \param ioCb function pointer to a IO callback (see hal/tpm_io.h)
+    \param userCtx pointer to a user context (can be NULL)
+    \param toTest algorithms used by the application (can be NULL for none)
+
+    _Example_
+    \code
+    TPML_ALG toTest;
+    toTest.count = 2;
+    toTest.algorithms[0] = TPM_ALG_ECDSA;
+    toTest.algorithms[1] = TPM_ALG_SHA256;
+    rc = wolfTPM2_InitWarmStart(&dev, TPM2_IoCb, userCtx, &toTest);
+    \endcode
+
+    \sa wolfTPM2_Init
+    \sa wolfTPM2_OpenExisting
+*/
+WOLFTPM_API int wolfTPM2_InitWarmStart(WOLFTPM2_DEV* dev, TPM2HalIoCb ioCb,
+    void* userCtx, const TPML_ALG* toTest);
+
 /*!
     \ingroup wolfTPM2_Wrappers
     \brief Use an already initialized TPM, in its current TPM locality
@@ -322,6 +545,11 @@ WOLFTPM_API int wolfTPM2_SelfTest(WOLFTPM2_DEV* dev);
 /*!
     \ingroup wolfTPM2_Wrappers
     \brief Reported the available TPM capabilities
+    \note The capabilities are read from the TPM once and then served from
+    a copy in the device. The copy is refreshed after a successful
+    TPM2_Startup, TPM2_FieldUpgradeStart or TPM2_FieldUpgradeData sent
+    through this context. A firmware update done by another process is not
+    seen until the next wolfTPM2_Init.
 
     \return TPM_RC_SUCCESS: successful
     \return TPM_RC_FAILURE: generic failure (check TPM IO communication and TPM return code)
@@ -349,6 +577,51 @@ WOLFTPM_API int wolfTPM2_SelfTest(WOLFTPM2_DEV* dev);
 */
 WOLFTPM_API int wolfTPM2_GetCapabilities(WOLFTPM2_DEV* dev, WOLFTPM2_CAPS* caps);
 
+#ifdef WOLFTPM_SINGLE_FLIGHT
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Reports single-flight statistics. Identical concurrent read-only
+    requests (ReadPublic, NV_ReadPublic, PCR_Read, capabilities) are issued to
+    the TPM once and the result is shared with every waiting caller.
+
+    \return TPM_RC_SUCCESS: successful
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param dev pointer to a TPM2_DEV struct
+    \param issued optional, number of requests sent to the TPM
+    \param coalesced optional, number of requests served by one in flight
+
+    \sa wolfTPM2_GetCapabilities
+    \sa wolfTPM2_ReadPublicKey
+*/
+WOLFTPM_API int wolfTPM2_GetFlightStats(WOLFTPM2_DEV* dev, word32* issued,
+    word32* coalesced);
+#endif
+
+#ifdef WOLFTPM_SCRATCH
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Reports usage of the device scratch arena. With WOLFTPM_SCRATCH
+    (default for WOLFTPM_SMALL_STACK) the large command structures of the key
+    create/load and NV read/write wrappers come from an arena inside
+    WOLFTPM2_DEV instead of the stack. Size it with WOLFTPM2_SCRATCH_SZ.
+    One call holds the arena at a time; other threads using the same device
+    wait for it. The arena is zeroed when each call releases it.
+
+    \return TPM_RC_SUCCESS: successful
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param dev pointer to a TPM2_DEV struct
+    \param size optional, arena size in bytes
+    \param highWater optional, most bytes in use by any single call
+
+    \sa wolfTPM2_CreateKey
+    \sa wolfTPM2_NVWriteAuth
+*/
+WOLFTPM_API int wolfTPM2_GetScratchStats(WOLFTPM2_DEV* dev, word32* size,
+    word32* highWater);
+#endif
+
 /*!
     \ingroup wolfTPM2_Wrappers
     \brief Clears one of the TPM Authorization slots, pointed by its index number
@@ -613,6 +886,12 @@ WOLFTPM_API int wolfTPM2_CreateKey(WOLFTPM2_DEV* dev,
     \param keyBlob pointer to a struct of WOLFTPM2_KEYBLOB type
     \param parent pointer to a struct of WOLFTPM2_HANDLE type, specifying a TPM 2.0 Primary Key to be used as the parent(Storage Key)
 
+    \note With WOLFTPM_KEY_CACHE a blob already loaded under the same parent
+    with the same parent auth returns the cached handle without a TPM2_Load.
+    A parent authorized by a policy session always uses TPM2_Load, since the
+    policy cannot be checked on the host. wolfTPM2_UnloadHandle releases the
+    reference and the object stays loaded until evicted.
+
     \sa wolfTPM2_CreateKey
     \sa wolfTPM2_CreatePrimaryKey
     \sa wolfTPM2_GetKeyTemplate_RSA
@@ -621,6 +900,24 @@ WOLFTPM_API int wolfTPM2_CreateKey(WOLFTPM2_DEV* dev,
 WOLFTPM_API int wolfTPM2_LoadKey(WOLFTPM2_DEV* dev,
     WOLFTPM2_KEYBLOB* keyBlob, WOLFTPM2_HANDLE* parent);
 
+#ifdef WOLFTPM_KEY_CACHE
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Flushes idle keys held by the loaded key cache from the TPM
+    \note Keys still referenced (loaded and not yet unloaded) are kept
+
+    \return TPM_RC_SUCCESS: successful
+    \return TPM_RC_FAILURE: generic failure (check TPM IO and TPM return code)
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param dev pointer to a TPM2_DEV struct
+
+    \sa wolfTPM2_LoadKey
+    \sa wolfTPM2_UnloadHandle
+*/
+WOLFTPM_API int wolfTPM2_KeyCacheFlush(WOLFTPM2_DEV* dev);
+#endif
+
 /*!
     \ingroup wolfTPM2_Wrappers
     \brief Single function to create and load a TPM 2.0 Key in one step
@@ -1493,6 +1790,65 @@ WOLFTPM_API int wolfTPM2_SignHashScheme(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* key,
     const byte* digest, int digestSz, byte* sig, int* sigSz,
     TPMI_ALG_SIG_SCHEME sigAlg, TPMI_ALG_HASH hashAlg);
 
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Signs a batch of digests with one loaded TPM key. The key auth is
+    set once and the TPM2_Sign command is only updated with the next digest.
+    \note Signatures are written at a fixed stride of sigSz bytes. ECC
+    signatures are R then S, each left padded with zeros to the curve size.
+    RSA signatures are the key modulus size.
+
+    \return TPM_RC_SUCCESS: successful
+    \return TPM_RC_FAILURE: generic failure (check TPM IO and TPM return code)
+    \return BUFFER_E: sigSz is smaller than the key signature size
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param dev pointer to a TPM2_DEV struct
+    \param key pointer to a loaded WOLFTPM2_KEY signing key
+    \param digests pointer to count digests of digestSz bytes each
+    \param digestSz size of each digest, in bytes
+    \param count number of digests to sign
+    \param sigs pointer to the output array of count * sigSz bytes
+    \param sigSz size of each signature entry, in bytes
+    \param sigAlg signature scheme, or TPM_ALG_NULL to use the key scheme
+    (TPM_ALG_ECDSA or TPM_ALG_RSASSA if the key has none)
+    \param hashAlg hash algorithm of the digests (TPM_ALG_NULL for
+    WOLFTPM2_WRAP_DIGEST)
+    \param signedCount optional, receives the number of signatures produced
+    (can be NULL)
+
+    \sa wolfTPM2_SignHashScheme
+*/
+WOLFTPM_API int wolfTPM2_SignHashBatch(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* key,
+    const byte* digests, int digestSz, int count, byte* sigs, int sigSz,
+    TPMI_ALG_SIG_SCHEME sigAlg, TPMI_ALG_HASH hashAlg, int* signedCount);
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Sign a digest using a TPM key and a hashcheck ticket, as required for restricted signing keys
+
+    \return TPM_RC_SUCCESS: successful
+    \return TPM_RC_FAILURE: generic failure (check TPM IO and TPM return code)
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param dev pointer to a TPM2_DEV struct
+    \param key pointer to a struct of WOLFTPM2_KEY type, holding a TPM key material
+    \param digest pointer to a byte buffer, containing the digest
+    \param digestSz integer value, specifying the size of the digest buffer, in bytes
+    \param sig pointer to a byte buffer, containing the generated signature
+    \param sigSz integer value, specifying the size of the signature buffer, in bytes
+    \param sigAlg integer value of TPMI_ALG_SIG_SCHEME type, specifying a supported TPM 2.0 signature scheme
+    \param hashAlg integer value of TPMI_ALG_HASH type, specifying a supported TPM 2.0 hash algorithm
+    \param validation pointer to the ticket from wolfTPM2_HashFinishTicket (NULL for a NULL ticket)
+
+    \sa wolfTPM2_SignHashScheme
+    \sa wolfTPM2_HashFinishTicket
+*/
+WOLFTPM_API int wolfTPM2_SignHashTicket(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* key,
+    const byte* digest, int digestSz, byte* sig, int* sigSz,
+    TPMI_ALG_SIG_SCHEME sigAlg, TPMI_ALG_HASH hashAlg,
+    const TPMT_TK_HASHCHECK* validation);
+
 /*!
     \ingroup wolfTPM2_Wrappers
     \brief Helper function to verify a TPM generated signature
@@ -2096,6 +2452,9 @@ WOLFTPM_API int wolfTPM2_Clear(WOLFTPM2_DEV* dev);
 /*!
     \ingroup wolfTPM2_Wrappers
     \brief Helper function to start a TPM generated hash
+    \note With WOLFTPM2_HASH_HYBRID the TPM hash sequence is only started once
+    the input exceeds MAX_DIGEST_BUFFER. Smaller inputs are completed with a
+    single TPM2_Hash.
 
     \return TPM_RC_SUCCESS: successful
     \return TPM_RC_FAILURE: generic failure (check TPM IO and TPM return code)
@@ -2153,6 +2512,65 @@ WOLFTPM_API int wolfTPM2_HashUpdate(WOLFTPM2_DEV* dev, WOLFTPM2_HASH* hash,
 WOLFTPM_API int wolfTPM2_HashFinish(WOLFTPM2_DEV* dev, WOLFTPM2_HASH* hash,
     byte* digest, word32* digestSz);
 
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Start a hash using the host (wolfCrypt) when possible, using the
+    TPM hash sequence only when a hashcheck ticket is required
+    \note A restricted signing key only signs a digest with a valid
+    TPMT_TK_HASHCHECK ticket, which the TPM only produces for data that does
+    not start with TPM_GENERATED_VALUE. When signKey is restricted the TPM
+    sequence is used, otherwise the digest is computed on the host and no data
+    is sent to the TPM. Host hashing requires WOLFTPM2_HASH_HYBRID and
+    wolfCrypt, without them the TPM sequence is always used. Use
+    wolfTPM2_HashUpdate and wolfTPM2_HashFinish or wolfTPM2_HashFinishTicket
+    to complete the hash.
+
+    \return TPM_RC_SUCCESS: successful
+    \return TPM_RC_FAILURE: generic failure (check TPM IO and TPM return code)
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param dev pointer to a TPM2_DEV struct
+    \param hash pointer to a WOLFTPM2_HASH structure
+    \param hashAlg integer value, specifying a valid TPM 2.0 hash algorithm
+    \param usageAuth pointer to a string constant, specifying the authorization for the TPM sequence (optional)
+    \param usageAuthSz integer value, specifying the size of the authorization, in bytes
+    \param signKey pointer to the key the digest will be signed with (optional, NULL for host hashing)
+
+    \sa wolfTPM2_HashStart
+    \sa wolfTPM2_HashFinishTicket
+    \sa wolfTPM2_SignHashTicket
+*/
+WOLFTPM_API int wolfTPM2_HashStart_ex(WOLFTPM2_DEV* dev, WOLFTPM2_HASH* hash,
+    TPMI_ALG_HASH hashAlg, const byte* usageAuth, word32 usageAuthSz,
+    const WOLFTPM2_KEY* signKey);
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Finalize a hash and get the digest along with a hashcheck ticket
+    \note For a TPM hash sequence the ticket is produced for the given
+    hierarchy, which must be the hierarchy of the signing key for TPM2_Sign to
+    accept the ticket. The TPM returns a NULL ticket if the data started with
+    TPM_GENERATED_VALUE. For a host hash a NULL ticket is always returned.
+
+    \return TPM_RC_SUCCESS: successful
+    \return TPM_RC_FAILURE: generic failure (check TPM IO and TPM return code)
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param dev pointer to a TPM2_DEV struct
+    \param hash pointer to a WOLFTPM2_HASH structure
+    \param digest pointer to a byte buffer, used to store the resulting digest
+    \param[in,out] digestSz pointer to size of digest buffer, on return set to bytes stored in digest buffer
+    \param hierarchy hierarchy of the signing key: TPM_RH_OWNER,
+    TPM_RH_ENDORSEMENT, TPM_RH_PLATFORM or TPM_RH_NULL
+    \param validation pointer to a TPMT_TK_HASHCHECK, used to store the ticket
+
+    \sa wolfTPM2_HashStart_ex
+    \sa wolfTPM2_SignHashTicket
+*/
+WOLFTPM_API int wolfTPM2_HashFinishTicket(WOLFTPM2_DEV* dev,
+    WOLFTPM2_HASH* hash, byte* digest, word32* digestSz,
+    TPMI_RH_HIERARCHY hierarchy, TPMT_TK_HASHCHECK* validation);
+
 /*!
     \ingroup wolfTPM2_Wrappers
     \brief Creates and loads a new TPM key of KeyedHash type, typically used for HMAC operations
@@ -2182,6 +2600,9 @@ WOLFTPM_API int wolfTPM2_LoadKeyedHashKey(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* key,
 /*!
     \ingroup wolfTPM2_Wrappers
     \brief Helper function to start a TPM generated hmac
+    \note With WOLFTPM2_HASH_HYBRID the TPM HMAC sequence is only started once
+    the input exceeds MAX_DIGEST_BUFFER. Smaller inputs are completed with a
+    single TPM2_HMAC.
 
     \return TPM_RC_SUCCESS: successful
     \return TPM_RC_FAILURE: generic failure (check TPM IO and TPM return code)
@@ -2310,6 +2731,8 @@ WOLFTPM_API int wolfTPM2_Shutdown(WOLFTPM2_DEV* dev, int doStartup);
 /*!
     \ingroup wolfTPM2_Wrappers
     \brief One-shot API to unload subsequent TPM handles
+    \note Only handles reported by TPM2_GetCapability(TPM_CAP_HANDLES) are
+    flushed. If the TPM cannot enumerate handles each one in the range is tried.
 
     \return TPM_RC_SUCCESS: successful
     \return TPM_RC_FAILURE: generic failure (check TPM IO and TPM return code)
@@ -2340,6 +2763,24 @@ WOLFTPM_API int wolfTPM2_UnloadHandles(WOLFTPM2_DEV* dev, word32 handleStart,
 */
 WOLFTPM_API int wolfTPM2_UnloadHandles_AllTransient(WOLFTPM2_DEV* dev);
 
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief One-shot API to return the TPM to a clean state by unloading all
+    transient objects, loaded sessions and saved sessions
+    \note Handles are enumerated with TPM2_GetCapability(TPM_CAP_HANDLES) and
+    only the ones present are flushed. Auth sessions set on the device are
+    cleared and index 0 falls back to password auth.
+
+    \return TPM_RC_SUCCESS: successful
+    \return TPM_RC_FAILURE: generic failure (check TPM IO and TPM return code)
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param dev pointer to a TPM2_DEV struct
+
+    \sa wolfTPM2_UnloadHandles_AllTransient
+*/
+WOLFTPM_API int wolfTPM2_UnloadHandles_All(WOLFTPM2_DEV* dev);
+
 /* Utility functions */
 
 /*!
@@ -2599,6 +3040,38 @@ WOLFTPM_API int wolfTPM2_CreateEK(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* ekKey, TPM_AL
 */
 WOLFTPM_API int wolfTPM2_CreateSRK(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* srkKey, TPM_ALG_ID alg,
     const byte* auth, int authSz);
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Gets the Storage Root Key while avoiding a new TPM2_CreatePrimary
+    where possible. In order: uses the key at persistHandle, loads the saved
+    context savedCtx, or creates the SRK. A new SRK is persisted at
+    persistHandle. If that is not allowed it is saved into savedCtx instead.
+    \note A saved context is only valid until the next TPM Reset. Callers should
+    store savedCtx (e.g. on disk) when savedCtx->savedHandle changes from zero
+    to non-zero, and reset it to zero when it fails to load.
+    \note A new SRK is only created when the persistent handle does not exist
+    (TPM_RC_HANDLE). Transport errors and TPM warnings, such as a lock timeout
+    or TPM_RC_RETRY, are returned and savedCtx is left unchanged.
+
+    \return TPM_RC_SUCCESS: successful
+    \return TPM_RC_FAILURE: generic failure (check TPM IO and TPM return code)
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param dev pointer to a TPM2_DEV struct
+    \param srkKey pointer to an empty WOLFTPM2_KEY structure
+    \param alg can be only TPM_ALG_RSA or TPM_ALG_ECC
+    \param persistHandle persistent handle for the SRK (0 to not persist)
+    \param auth pointer to a string constant, specifying the password authorization for the TPM 2.0 Key
+    \param authSz integer value, specifying the size of the password authorization, in bytes
+    \param savedCtx in/out saved context of the SRK (can be NULL)
+
+    \sa wolfTPM2_CreateSRK
+    \sa wolfTPM2_NVStoreKey
+*/
+WOLFTPM_API int wolfTPM2_GetPrimaryStorageKey(WOLFTPM2_DEV* dev,
+    WOLFTPM2_KEY* srkKey, TPM_ALG_ID alg, TPM_HANDLE persistHandle,
+    const byte* auth, int authSz, TPMS_CONTEXT* savedCtx);
 /*!
     \ingroup wolfTPM2_Wrappers
     \brief Generates a new TPM Attestation Key under the provided Storage Key
@@ -3387,6 +3860,536 @@ WOLFTPM_API int wolfTPM2_PolicyAuthorizeMake(TPM_ALG_ID pcrAlg,
     const TPM2B_PUBLIC* pub, byte* digest, word32* digestSz,
     const byte* policyRef, word32 policyRefSz);
 
+
+#if !defined(WOLFTPM2_NO_WOLFCRYPT) && defined(HAVE_AESGCM) && \
+    !defined(NO_SHA256)
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Creates a new random data key for envelope encryption and seals it under a TPM storage key
+    \note Bulk data is encrypted on the host with AES-GCM. The TPM is only used
+    to generate and seal the data key. Use wolfTPM2_EnvelopeGetHeader to store
+    the sealed data key with the encrypted data.
+
+    \return TPM_RC_SUCCESS: successful
+    \return TPM_RC_FAILURE: generic failure (check TPM IO and TPM return code)
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param dev pointer to a TPM2_DEV struct
+    \param env pointer to an empty WOLFTPM2_ENVELOPE structure
+    \param parent pointer to the handle of a loaded storage key
+    \param auth pointer to the authorization for the sealed data key (optional)
+    \param authSz integer value, specifying the size of the authorization, in bytes
+
+    \sa wolfTPM2_EnvelopeOpen
+    \sa wolfTPM2_EnvelopeEncrypt
+    \sa wolfTPM2_EnvelopeFree
+*/
+WOLFTPM_API int wolfTPM2_EnvelopeCreate(WOLFTPM2_DEV* dev,
+    WOLFTPM2_ENVELOPE* env, WOLFTPM2_HANDLE* parent, const byte* auth,
+    int authSz);
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Unseals the data key of an envelope once, so the data can be decrypted on the host
+    \note The envelope must be populated using wolfTPM2_EnvelopeSetHeader
+
+    \return TPM_RC_SUCCESS: successful
+    \return TPM_RC_FAILURE: generic failure (check TPM IO and TPM return code)
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param dev pointer to a TPM2_DEV struct
+    \param env pointer to a WOLFTPM2_ENVELOPE structure with the sealed data key
+    \param parent pointer to the handle of the loaded storage key used at creation
+    \param auth pointer to the authorization for the sealed data key (optional)
+    \param authSz integer value, specifying the size of the authorization, in bytes
+
+    \sa wolfTPM2_EnvelopeSetHeader
+    \sa wolfTPM2_EnvelopeDecrypt
+*/
+WOLFTPM_API int wolfTPM2_EnvelopeOpen(WOLFTPM2_DEV* dev,
+    WOLFTPM2_ENVELOPE* env, WOLFTPM2_HANDLE* parent, const byte* auth,
+    int authSz);
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Encodes the envelope header: magic, version, base nonce and the sealed data key blob
+
+    \return size of the header in bytes on success
+    \return BUFFER_E: buffer is too small
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param env pointer to a WOLFTPM2_ENVELOPE structure
+    \param buffer pointer to a buffer for the encoded header
+    \param bufferSz size of the buffer, in bytes
+
+    \sa wolfTPM2_EnvelopeSetHeader
+*/
+WOLFTPM_API int wolfTPM2_EnvelopeGetHeader(WOLFTPM2_ENVELOPE* env,
+    byte* buffer, word32 bufferSz);
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Decodes an envelope header created by wolfTPM2_EnvelopeGetHeader
+
+    \return number of bytes consumed from the buffer on success
+    \return BUFFER_E: buffer is truncated or not an envelope header
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param env pointer to an empty WOLFTPM2_ENVELOPE structure
+    \param buffer pointer to the encoded header
+    \param bufferSz size of the buffer, in bytes
+
+    \sa wolfTPM2_EnvelopeGetHeader
+    \sa wolfTPM2_EnvelopeOpen
+*/
+WOLFTPM_API int wolfTPM2_EnvelopeSetHeader(WOLFTPM2_ENVELOPE* env,
+    const byte* buffer, word32 bufferSz);
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Encrypts the next chunk of a stream on the host using AES-GCM
+    \note Each chunk has its own nonce (base nonce and chunk index) and tag.
+    The final chunk must be flagged so truncation is detected on decrypt. The
+    SHA-256 of the envelope header is authenticated with every chunk, so a
+    changed or swapped header fails decryption.
+
+    \return TPM_RC_SUCCESS: successful
+    \return BAD_FUNC_ARG: check the provided arguments or envelope already finalized
+
+    \param env pointer to a WOLFTPM2_ENVELOPE structure with the data key set
+    \param in pointer to the plain text chunk
+    \param inSz size of the chunk, in bytes
+    \param out pointer to the cipher text output (same size as input)
+    \param tag pointer to a buffer of WOLFTPM2_ENVELOPE_TAG_SZ bytes for the tag
+    \param isFinal non-zero if this is the last chunk of the stream
+
+    \sa wolfTPM2_EnvelopeDecrypt
+*/
+WOLFTPM_API int wolfTPM2_EnvelopeEncrypt(WOLFTPM2_ENVELOPE* env,
+    const byte* in, word32 inSz, byte* out, byte* tag, int isFinal);
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Decrypts and authenticates the next chunk of a stream on the host using AES-GCM
+
+    \return TPM_RC_SUCCESS: successful
+    \return AES_GCM_AUTH_E: chunk failed authentication
+    \return BAD_FUNC_ARG: check the provided arguments or envelope already finalized
+
+    \param env pointer to a WOLFTPM2_ENVELOPE structure with the data key set
+    \param in pointer to the cipher text chunk
+    \param inSz size of the chunk, in bytes
+    \param out pointer to the plain text output (same size as input)
+    \param tag pointer to the WOLFTPM2_ENVELOPE_TAG_SZ byte tag for the chunk
+    \param isFinal non-zero if this is the last chunk of the stream
+
+    \sa wolfTPM2_EnvelopeEncrypt
+*/
+WOLFTPM_API int wolfTPM2_EnvelopeDecrypt(WOLFTPM2_ENVELOPE* env,
+    const byte* in, word32 inSz, byte* out, const byte* tag, int isFinal);
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Releases the host AES context and clears the data key from memory
+
+    \return TPM_RC_SUCCESS: successful
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param env pointer to a WOLFTPM2_ENVELOPE structure
+*/
+WOLFTPM_API int wolfTPM2_EnvelopeFree(WOLFTPM2_ENVELOPE* env);
+#endif /* !WOLFTPM2_NO_WOLFCRYPT && HAVE_AESGCM && !NO_SHA256 */
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Restores a persistent key public cache from a buffer, such as a file
+    saved with wolfTPM2_PubCacheExport
+    \note A missing or malformed buffer leaves an empty cache, which is filled
+    on demand by wolfTPM2_PubCacheReadPublicKey
+
+    \return TPM_RC_SUCCESS: successful
+    \return BUFFER_E: buffer is malformed (cache is cleared)
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param cache pointer to a WOLFTPM2_PUBCACHE struct
+    \param buf pointer to the exported cache, may be NULL for an empty cache
+    \param bufSz size of the buffer, in bytes
+
+    \sa wolfTPM2_PubCacheExport
+    \sa wolfTPM2_PubCacheReadPublicKey
+*/
+WOLFTPM_API int wolfTPM2_PubCacheImport(WOLFTPM2_PUBCACHE* cache,
+    const byte* buf, word32 bufSz);
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Serializes a persistent key public cache to a buffer
+
+    \return positive integer: size of the exported cache, in bytes
+    \return BUFFER_E: buffer too small
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param cache pointer to a WOLFTPM2_PUBCACHE struct
+    \param buf pointer to the output buffer
+    \param bufSz size of the output buffer, in bytes
+
+    \sa wolfTPM2_PubCacheImport
+*/
+WOLFTPM_API int wolfTPM2_PubCacheExport(WOLFTPM2_PUBCACHE* cache,
+    byte* buf, word32 bufSz);
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Checks a public cache against the TPM, using one TPM2_ReadClock and
+    one TPM2_GetCapability(TPM_CAP_HANDLES)
+    \note All entries are dropped if the TPM resetCount changed (TPM Reset or
+    TPM2_Clear). Entries for persistent handles no longer present are dropped.
+    The cache is then bound to dev, and wolfTPM2_NVStoreKey or
+    wolfTPM2_NVDeleteKey on dev drop the entry for that persistent handle, so
+    a re-provisioned handle is read from the TPM again. The cache must stay
+    valid until wolfTPM2_Cleanup or until another cache is validated. A key
+    re-provisioned by another process is only seen after that process
+    exports its cache and this one imports it again.
+
+    \return TPM_RC_SUCCESS: successful
+    \return TPM_RC_FAILURE: generic failure (check TPM IO and TPM return code)
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param dev pointer to a TPM2_DEV struct
+    \param cache pointer to a WOLFTPM2_PUBCACHE struct
+
+    \sa wolfTPM2_PubCacheReadPublicKey
+*/
+WOLFTPM_API int wolfTPM2_PubCacheValidate(WOLFTPM2_DEV* dev,
+    WOLFTPM2_PUBCACHE* cache);
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Same as wolfTPM2_ReadPublicKey, but persistent handles are served
+    from the cache. Misses are read from the TPM and added to the cache.
+    \note The cache is validated on first use after import
+
+    \return TPM_RC_SUCCESS: successful
+    \return TPM_RC_FAILURE: generic failure (check TPM IO and TPM return code)
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param dev pointer to a TPM2_DEV struct
+    \param cache pointer to a WOLFTPM2_PUBCACHE struct
+    \param key pointer to an empty struct of WOLFTPM2_KEY type
+    \param handle value of TPM_HANDLE type, specifying the handle of the key
+
+    \sa wolfTPM2_ReadPublicKey
+    \sa wolfTPM2_PubCacheValidate
+*/
+WOLFTPM_API int wolfTPM2_PubCacheReadPublicKey(WOLFTPM2_DEV* dev,
+    WOLFTPM2_PUBCACHE* cache, WOLFTPM2_KEY* key, const TPM_HANDLE handle);
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Saves the context of a loaded object or session using TPM2_ContextSave
+    \note A saved session is no longer loaded, an object stays loaded
+
+    \return TPM_RC_SUCCESS: successful
+    \return TPM_RC_FAILURE: generic failure (check TPM IO and TPM return code)
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param dev pointer to a TPM2_DEV struct
+    \param handle pointer to the handle of a loaded object or session
+    \param context pointer to a TPMS_CONTEXT to receive the saved context
+
+    \sa wolfTPM2_ContextLoad
+    \sa wolfTPM2_SaveKeyContext
+*/
+WOLFTPM_API int wolfTPM2_ContextSave(WOLFTPM2_DEV* dev,
+    WOLFTPM2_HANDLE* handle, TPMS_CONTEXT* context);
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Loads a context saved with wolfTPM2_ContextSave using TPM2_ContextLoad
+    \note Object contexts are valid until TPM Reset, and TPM Restart for
+    objects in the NULL hierarchy. A session context can only be loaded once.
+
+    \return TPM_RC_SUCCESS: successful
+    \return TPM_RC_FAILURE: generic failure (check TPM IO and TPM return code)
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param dev pointer to a TPM2_DEV struct
+    \param context pointer to a saved TPMS_CONTEXT
+    \param handle pointer to a WOLFTPM2_HANDLE to receive the loaded handle
+
+    \sa wolfTPM2_ContextSave
+*/
+WOLFTPM_API int wolfTPM2_ContextLoad(WOLFTPM2_DEV* dev,
+    TPMS_CONTEXT* context, WOLFTPM2_HANDLE* handle);
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Saves a loaded key to a buffer (for a file) so another process can
+    resume using it with wolfTPM2_LoadKeyContext
+    \note The key auth value is not saved. Set it again after loading, for
+    example with wolfTPM2_SetKeyAuthPassword.
+
+    \return positive integer: size of the saved key context, in bytes
+    \return TPM_RC_FAILURE: generic failure (check TPM IO and TPM return code)
+    \return BUFFER_E: buffer too small
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param dev pointer to a TPM2_DEV struct
+    \param key pointer to a loaded key
+    \param buf pointer to the output buffer
+    \param bufSz size of the output buffer, in bytes
+
+    \sa wolfTPM2_LoadKeyContext
+*/
+WOLFTPM_API int wolfTPM2_SaveKeyContext(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* key,
+    byte* buf, word32 bufSz);
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Loads a key saved with wolfTPM2_SaveKeyContext
+
+    \return TPM_RC_SUCCESS: successful
+    \return TPM_RC_FAILURE: generic failure (check TPM IO and TPM return code)
+    \return BUFFER_E: buffer is malformed
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param dev pointer to a TPM2_DEV struct
+    \param key pointer to an empty WOLFTPM2_KEY to receive the loaded key
+    \param buf pointer to the saved key context
+    \param bufSz size of the saved key context, in bytes
+
+    \sa wolfTPM2_SaveKeyContext
+*/
+WOLFTPM_API int wolfTPM2_LoadKeyContext(WOLFTPM2_DEV* dev, WOLFTPM2_KEY* key,
+    const byte* buf, word32 bufSz);
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Saves an auth or policy session to a buffer. The session is no
+    longer loaded in the TPM until restored with wolfTPM2_LoadSessionContext.
+    \note Only unsalted and unbound sessions can be saved, as the session key
+    is never written to the buffer. The TPM nonce is saved (it is public) and
+    a new caller nonce is generated on load.
+    \note Clear any wolfTPM2_SetAuthSession slot using this session and set it
+    again after loading
+
+    \return positive integer: size of the saved session context, in bytes
+    \return TPM_RC_FAILURE: generic failure (check TPM IO and TPM return code)
+    \return BUFFER_E: buffer too small
+    \return BAD_FUNC_ARG: check the provided arguments, or the session is
+    salted or bound
+
+    \param dev pointer to a TPM2_DEV struct
+    \param session pointer to a started WOLFTPM2_SESSION
+    \param buf pointer to the output buffer
+    \param bufSz size of the output buffer, in bytes
+
+    \sa wolfTPM2_LoadSessionContext
+    \sa wolfTPM2_StartSession
+*/
+WOLFTPM_API int wolfTPM2_SaveSessionContext(WOLFTPM2_DEV* dev,
+    WOLFTPM2_SESSION* session, byte* buf, word32 bufSz);
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Restores a session saved with wolfTPM2_SaveSessionContext
+
+    \return TPM_RC_SUCCESS: successful
+    \return TPM_RC_FAILURE: generic failure (check TPM IO and TPM return code)
+    \return BUFFER_E: buffer is malformed
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param dev pointer to a TPM2_DEV struct
+    \param session pointer to an empty WOLFTPM2_SESSION
+    \param buf pointer to the saved session context
+    \param bufSz size of the saved session context, in bytes
+
+    \sa wolfTPM2_SaveSessionContext
+    \sa wolfTPM2_SetAuthSession
+*/
+WOLFTPM_API int wolfTPM2_LoadSessionContext(WOLFTPM2_DEV* dev,
+    WOLFTPM2_SESSION* session, const byte* buf, word32 bufSz);
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Saves an in progress TPM hash or HMAC sequence to a buffer
+    \note Digests computed on the host (wolfTPM2_HashStart_ex) are not supported.
+    For HMAC the key is not included, save it with wolfTPM2_SaveKeyContext.
+    The sequence auth is not saved, set hash->handle.auth again after loading.
+
+    \return positive integer: size of the saved hash context, in bytes
+    \return TPM_RC_FAILURE: generic failure (check TPM IO and TPM return code)
+    \return BUFFER_E: buffer too small
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param dev pointer to a TPM2_DEV struct
+    \param hash pointer to a started WOLFTPM2_HASH (or the hash member of a
+    WOLFTPM2_HMAC)
+    \param buf pointer to the output buffer
+    \param bufSz size of the output buffer, in bytes
+
+    \sa wolfTPM2_LoadHashContext
+*/
+WOLFTPM_API int wolfTPM2_SaveHashContext(WOLFTPM2_DEV* dev,
+    WOLFTPM2_HASH* hash, byte* buf, word32 bufSz);
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Restores a hash sequence saved with wolfTPM2_SaveHashContext, to
+    continue with wolfTPM2_HashUpdate and wolfTPM2_HashFinish
+
+    \return TPM_RC_SUCCESS: successful
+    \return TPM_RC_FAILURE: generic failure (check TPM IO and TPM return code)
+    \return BUFFER_E: buffer is malformed
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param dev pointer to a TPM2_DEV struct
+    \param hash pointer to an empty WOLFTPM2_HASH
+    \param buf pointer to the saved hash context
+    \param bufSz size of the saved hash context, in bytes
+
+    \sa wolfTPM2_SaveHashContext
+*/
+WOLFTPM_API int wolfTPM2_LoadHashContext(WOLFTPM2_DEV* dev,
+    WOLFTPM2_HASH* hash, const byte* buf, word32 bufSz);
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Initializes an empty pool of TPM devices
+
+    \return TPM_RC_SUCCESS: successful
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param pool pointer to a WOLFTPM2_POOL struct
+    \param policy WOLFTPM2_POOL_ROUND_ROBIN or WOLFTPM2_POOL_LEAST_LOADED
+    \param timeCb optional millisecond tick for latency tracking (can be NULL)
+    \param timeCtx user context for timeCb
+
+    \sa wolfTPM2_PoolAdd
+    \sa wolfTPM2_PoolCleanup
+*/
+WOLFTPM_API int wolfTPM2_PoolInit(WOLFTPM2_POOL* pool, int policy,
+    WOLFTPM2_POOL_TIME_CB timeCb, void* timeCtx);
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Opens a TPM with wolfTPM2_Init and adds it to the pool
+    \note Each member has its own IO callback and context, such as a different
+    SPI chip select. The TPM interface (TIS, /dev/tpm, SWTPM) is the same for
+    all members as it is chosen at build time.
+
+    \return positive or zero: index of the new member
+    \return TPM_RC_FAILURE: generic failure (check TPM IO communication)
+    \return BUFFER_E: pool is full (WOLFTPM2_POOL_MAX)
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param pool pointer to an initialized WOLFTPM2_POOL
+    \param ioCb function pointer to a IO callback (see hal/tpm_io.h)
+    \param userCtx pointer to a user context (can be NULL)
+
+    \sa wolfTPM2_PoolInit
+*/
+WOLFTPM_API int wolfTPM2_PoolAdd(WOLFTPM2_POOL* pool, TPM2HalIoCb ioCb,
+    void* userCtx);
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Selects a pool member for an operation and makes it the active TPM
+    for the calling thread. Pass owner -1 for operations that can run on any
+    TPM (GetRandom, hashing, operations on external keys), or the index of
+    the member holding the key for key-bound operations.
+
+    \return positive or zero: index of the selected member
+    \return TPM_RC_FAILURE: no healthy member, or owner was ejected
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param pool pointer to a WOLFTPM2_POOL
+    \param owner member index owning the key, or -1 for any member
+    \param dev receives the WOLFTPM2_DEV to use for the operation
+    \param ticket receives an opaque value to pass to wolfTPM2_PoolRelease
+
+    _Example_
+    \code
+    WOLFTPM2_DEV* dev;
+    word32 ticket;
+    int idx = wolfTPM2_PoolAcquire(&pool, -1, &dev, &ticket);
+    if (idx >= 0) {
+        rc = wolfTPM2_GetRandom(dev, buf, sizeof(buf));
+        wolfTPM2_PoolRelease(&pool, idx, ticket, rc);
+    }
+    \endcode
+
+    \sa wolfTPM2_PoolRelease
+*/
+WOLFTPM_API int wolfTPM2_PoolAcquire(WOLFTPM2_POOL* pool, int owner,
+    WOLFTPM2_DEV** dev, word32* ticket);
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Completes an operation started with wolfTPM2_PoolAcquire and
+    updates member health. Members with WOLFTPM2_POOL_MAX_ERRORS consecutive
+    device failures (IO errors or TPM failure mode), or with a smoothed latency
+    above maxLatencyMs, are ejected.
+
+    \return TPM_RC_SUCCESS: successful
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param pool pointer to a WOLFTPM2_POOL
+    \param idx member index returned by wolfTPM2_PoolAcquire
+    \param ticket value returned by wolfTPM2_PoolAcquire
+    \param rc result of the operation
+
+    \sa wolfTPM2_PoolAcquire
+    \sa wolfTPM2_PoolReinstate
+*/
+WOLFTPM_API int wolfTPM2_PoolRelease(WOLFTPM2_POOL* pool, int idx,
+    word32 ticket, int rc);
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Returns an ejected member to service after its health counters are
+    reset, for example after a successful self-test by the application
+
+    \return TPM_RC_SUCCESS: successful
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param pool pointer to a WOLFTPM2_POOL
+    \param idx member index
+
+    \sa wolfTPM2_PoolRelease
+*/
+WOLFTPM_API int wolfTPM2_PoolReinstate(WOLFTPM2_POOL* pool, int idx);
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Fills a buffer with random data from any healthy pool member
+
+    \return TPM_RC_SUCCESS: successful
+    \return TPM_RC_FAILURE: generic failure (check TPM IO and TPM return code)
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param pool pointer to a WOLFTPM2_POOL
+    \param buf pointer to a byte buffer
+    \param len size of the buffer, in bytes
+
+    \sa wolfTPM2_GetRandom
+*/
+WOLFTPM_API int wolfTPM2_PoolGetRandom(WOLFTPM2_POOL* pool, byte* buf,
+    word32 len);
+
+/*!
+    \ingroup wolfTPM2_Wrappers
+    \brief Cleans up all pool members with wolfTPM2_Cleanup
+
+    \return TPM_RC_SUCCESS: successful
+    \return BAD_FUNC_ARG: check the provided arguments
+
+    \param pool pointer to a WOLFTPM2_POOL
+
+    \sa wolfTPM2_PoolInit
+*/
+WOLFTPM_API int wolfTPM2_PoolCleanup(WOLFTPM2_POOL* pool);
+
 #ifdef __cplusplus
     }  /* extern "C" */
 #endif
@@ -0,0 +1,496 @@
+/* tpm2_wrap.hpp
+ *
+ * Copyright (C) 2006-2022 wolfSSL Inc.
+ *
+ * This file is part of wolfTPM.
+ *
+ * wolfTPM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfTPM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+/* Header only C++17 binding for the wolfTPM2 wrappers (wolftpm/tpm2_wrap.h).
+ *
+ * - Device, Key, KeyBlob and Session are move-only. The C structure is kept
+ *   in a single heap allocation, so moves are pointer swaps and the C
+ *   structure address never changes. Destruction flushes the TPM handle
+ *   (wolfTPM2_UnloadHandle) and the Device runs wolfTPM2_Cleanup.
+ * - Buffers are passed as Span<T> (pointer and length, like std::span) and
+ *   are handed to the C API directly without intermediate copies.
+ * - Errors are returned as Result<T>, which holds either a value or the
+ *   TPM_RC / wolfCrypt error code (like std::expected).
+ *
+ * Objects created by a Device must not outlive it. For wrappers not covered
+ * here, get() returns the underlying C structure. */
+
+#ifndef __TPM2_WRAP_HPP__
+#define __TPM2_WRAP_HPP__
+
+#if __cplusplus < 201703L && (!defined(_MSVC_LANG) || _MSVC_LANG < 201703L)
+    #error wolftpm/tpm2_wrap.hpp requires C++17
+#endif
+
+#include <wolftpm/tpm2_wrap.h>
+
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#ifdef __cpp_exceptions
+    #include <exception>
+#endif
+
+#ifndef WOLFTPM2_NO_WRAPPER
+
+namespace wolftpm {
+
+/******************************************************************************/
+/* --- BEGIN Span -- */
+/******************************************************************************/
+
+/* Non-owning view of contiguous memory */
+template <typename T>
+class Span {
+public:
+    using element_type = T;
+
+    constexpr Span() noexcept : ptr_(nullptr), sz_(0) {}
+    constexpr Span(T* ptr, std::size_t sz) noexcept : ptr_(ptr), sz_(sz) {}
+    template <std::size_t N>
+    constexpr Span(T (&arr)[N]) noexcept : ptr_(arr), sz_(N) {}
+    /* any contiguous container with data() and size() (std::vector,
+     * std::array, std::span) holding the same element type. Only lvalues
+     * bind, so a span cannot outlive a temporary container. */
+    template <typename C, typename = std::enable_if_t<
+        !std::is_base_of<Span, std::remove_const_t<C>>::value &&
+        std::is_convertible<decltype(std::declval<C&>().data()), T*>::value &&
+        sizeof(*std::declval<C&>().data()) == sizeof(T)>>
+    constexpr Span(C& c) noexcept : ptr_(c.data()), sz_(c.size()) {}
+    /* Span<T> converts to Span<const T> */
+    template <typename U, typename = std::enable_if_t<
+        std::is_convertible<U(*)[], T(*)[]>::value>>
+    constexpr Span(const Span<U>& o) noexcept : ptr_(o.data()), sz_(o.size()) {}
+
+    constexpr T* data() const noexcept { return ptr_; }
+    constexpr std::size_t size() const noexcept { return sz_; }
+    constexpr bool empty() const noexcept { return sz_ == 0; }
+    constexpr T* begin() const noexcept { return ptr_; }
+    constexpr T* end() const noexcept { return ptr_ + sz_; }
+    constexpr T& operator[](std::size_t i) const noexcept { return ptr_[i]; }
+    constexpr Span first(std::size_t n) const noexcept {
+        return Span(ptr_, n < sz_ ? n : sz_);
+    }
+
+private:
+    T* ptr_;
+    std::size_t sz_;
+};
+
+/******************************************************************************/
+/* --- END Span -- */
+/******************************************************************************/
+
+
+/******************************************************************************/
+/* --- BEGIN Result -- */
+/******************************************************************************/
+
+/* Error code wrapper used to construct a failed Result */
+struct Unexpected {
+    int rc;
+    constexpr explicit Unexpected(int code) noexcept : rc(code) {}
+};
+
+#ifdef __cpp_exceptions
+/* Thrown by Result::value() on a failed result */
+class BadResultAccess : public std::exception {
+public:
+    explicit BadResultAccess(int rc) noexcept : rc_(rc) {}
+    int error() const noexcept { return rc_; }
+    const char* what() const noexcept override { return TPM2_GetRCString(rc_); }
+private:
+    int rc_;
+};
+#endif
+
+namespace detail {
+[[noreturn]] inline void BadAccess(int rc)
+{
+#ifdef __cpp_exceptions
+    throw BadResultAccess(rc);
+#else
+    (void)rc;
+    std::abort();
+#endif
+}
+} /* namespace detail */
+
+/* Value or error code. A success with a value has error() == 0 */
+template <typename T>
+class Result {
+public:
+    Result(T&& val) : rc_(TPM_RC_SUCCESS), val_(std::move(val)) {}
+    Result(Unexpected err) noexcept : rc_(err.rc) {
+        if (rc_ == TPM_RC_SUCCESS)
+            rc_ = TPM_RC_FAILURE; /* an error must not read as success */
+    }
+
+    bool has_value() const noexcept { return val_.has_value(); }
+    explicit operator bool() const noexcept { return has_value(); }
+    int error() const noexcept { return rc_; }
+    const char* message() const noexcept { return TPM2_GetRCString(rc_); }
+
+    T& value() & { check(); return *val_; }
+    const T& value() const & { check(); return *val_; }
+    T&& value() && { check(); return std::move(*val_); }
+    T& operator*() & noexcept { return *val_; }
+    T&& operator*() && noexcept { return std::move(*val_); }
+    T* operator->() noexcept { return &*val_; }
+    const T* operator->() const noexcept { return &*val_; }
+    template <typename U>
+    T value_or(U&& def) && {
+        return has_value() ? std::move(*val_) : T(std::forward<U>(def));
+    }
+
+private:
+    void check() const { if (!has_value()) detail::BadAccess(rc_); }
+
+    int rc_;
+    std::optional<T> val_;
+};
+
+template <>
+class Result<void> {
+public:
+    Result() noexcept : rc_(TPM_RC_SUCCESS) {}
+    Result(Unexpected err) noexcept : rc_(err.rc) {
+        if (rc_ == TPM_RC_SUCCESS)
+            rc_ = TPM_RC_FAILURE;
+    }
+
+    bool has_value() const noexcept { return rc_ == TPM_RC_SUCCESS; }
+    explicit operator bool() const noexcept { return has_value(); }
+    int error() const noexcept { return rc_; }
+    const char* message() const noexcept { return TPM2_GetRCString(rc_); }
+    void value() const { if (!has_value()) detail::BadAccess(rc_); }
+
+private:
+    int rc_;
+};
+
+namespace detail {
+inline Result<void> Check(int rc) noexcept
+{
+    if (rc != TPM_RC_SUCCESS)
+        return Unexpected(rc);
+    return Result<void>();
+}
+} /* namespace detail */
+
+/******************************************************************************/
+/* --- END Result -- */
+/******************************************************************************/
+
+
+/******************************************************************************/
+/* --- BEGIN Handle Types -- */
+/******************************************************************************/
+
+class Device;
+
+namespace detail {
+/* Owns one wolfTPM2 structure with a TPM handle, flushed on destruction */
+template <typename CType>
+class Owned {
+public:
+    Owned() noexcept : dev_(nullptr) {}
+    Owned(Owned&& o) noexcept : dev_(o.dev_), obj_(std::move(o.obj_)) {
+        o.dev_ = nullptr;
+    }
+    Owned& operator=(Owned&& o) noexcept {
+        if (this != &o) {
+            reset();
+            dev_ = o.dev_;
+            obj_ = std::move(o.obj_);
+            o.dev_ = nullptr;
+        }
+        return *this;
+    }
+    Owned(const Owned&) = delete;
+    Owned& operator=(const Owned&) = delete;
+    ~Owned() { reset(); }
+
+    explicit operator bool() const noexcept { return obj_ != nullptr; }
+    CType* get() noexcept { return obj_.get(); }
+    const CType* get() const noexcept { return obj_.get(); }
+    CType* operator->() noexcept { return obj_.get(); }
+    const CType* operator->() const noexcept { return obj_.get(); }
+    TPM_HANDLE handle() const noexcept {
+        return obj_ ? obj_->handle.hndl : (TPM_HANDLE)0;
+    }
+
+    /* Flush the handle now and report the result */
+    Result<void> reset() noexcept {
+        int rc = TPM_RC_SUCCESS;
+        if (obj_ && dev_ != nullptr)
+            rc = wolfTPM2_UnloadHandle(dev_, &obj_->handle);
+        obj_.reset();
+        dev_ = nullptr;
+        return Check(rc);
+    }
+
+    /* Give up ownership, the caller must unload the returned handle. An
+     * empty owner returns a zeroed structure. */
+    CType release() {
+        CType out = CType();
+        if (obj_)
+            out = *obj_;
+        obj_.reset();
+        dev_ = nullptr;
+        return out;
+    }
+
+protected:
+    friend class wolftpm::Device;
+
+    explicit Owned(WOLFTPM2_DEV* dev) noexcept
+        : dev_(dev), obj_(new (std::nothrow) CType()) {}
+
+    WOLFTPM2_DEV* dev_;
+    std::unique_ptr<CType> obj_;
+};
+} /* namespace detail */
+
+/* Loaded key, flushed on destruction unless persistent */
+class Key : public detail::Owned<WOLFTPM2_KEY> {
+public:
+    Key() noexcept = default;
+private:
+    friend class Device;
+    using Owned::Owned;
+};
+
+/* Created key (public and private parts), flushed on destruction if loaded */
+class KeyBlob : public detail::Owned<WOLFTPM2_KEYBLOB> {
+public:
+    KeyBlob() noexcept = default;
+private:
+    friend class Device;
+    using Owned::Owned;
+};
+
+/* Authorization session, flushed on destruction */
+class Session : public detail::Owned<WOLFTPM2_SESSION> {
+public:
+    Session() noexcept = default;
+private:
+    friend class Device;
+    using Owned::Owned;
+};
+
+/******************************************************************************/
+/* --- END Handle Types -- */
+/******************************************************************************/
+
+
+/******************************************************************************/
+/* --- BEGIN Device -- */
+/******************************************************************************/
+
+class Device {
+public:
+    /* Initialize the TPM, ioCb and userCtx as for wolfTPM2_Init */
+    static Result<Device> Open(TPM2HalIoCb ioCb = nullptr,
+        void* userCtx = nullptr)
+    {
+        std::unique_ptr<WOLFTPM2_DEV, Deleter> dev(
+            new (std::nothrow) WOLFTPM2_DEV);
+        if (!dev)
+            return Unexpected(MEMORY_E);
+        int rc = wolfTPM2_Init(dev.get(), ioCb, userCtx);
+        if (rc != TPM_RC_SUCCESS) {
+            delete dev.release(); /* nothing to clean up */
+            return Unexpected(rc);
+        }
+        return Device(std::move(dev));
+    }
+
+    Device(Device&&) noexcept = default;
+    Device& operator=(Device&&) noexcept = default;
+    Device(const Device&) = delete;
+    Device& operator=(const Device&) = delete;
+
+    WOLFTPM2_DEV* get() noexcept { return dev_.get(); }
+    const WOLFTPM2_DEV* get() const noexcept { return dev_.get(); }
+
+    Result<void> GetRandom(Span<byte> out) {
+        return detail::Check(wolfTPM2_GetRandom(get(), out.data(),
+            (word32)out.size()));
+    }
+
+    /* The template is read only, the C API takes it non-const */
+    Result<Key> CreatePrimaryKey(TPM_HANDLE hierarchy,
+        const TPMT_PUBLIC& publicTemplate, Span<const byte> auth = {})
+    {
+        Key key(get());
+        if (!key)
+            return Unexpected(MEMORY_E);
+        int rc = wolfTPM2_CreatePrimaryKey(get(), key.get(), hierarchy,
+            const_cast<TPMT_PUBLIC*>(&publicTemplate), auth.data(),
+            (int)auth.size());
+        if (rc != TPM_RC_SUCCESS)
+            return Unexpected(rc);
+        return key;
+    }
+
+    Result<KeyBlob> CreateKey(Key& parent, const TPMT_PUBLIC& publicTemplate,
+        Span<const byte> auth = {})
+    {
+        KeyBlob blob(get());
+        if (!blob)
+            return Unexpected(MEMORY_E);
+        int rc = wolfTPM2_CreateKey(get(), blob.get(), &parent->handle,
+            const_cast<TPMT_PUBLIC*>(&publicTemplate), auth.data(),
+            (int)auth.size());
+        if (rc != TPM_RC_SUCCESS)
+            return Unexpected(rc);
+        return blob;
+    }
+
+    /* Load in place, the blob then owns the loaded handle */
+    Result<void> LoadKey(KeyBlob& blob, Key& parent) {
+        if (!blob)
+            return Unexpected(BAD_FUNC_ARG);
+        return detail::Check(wolfTPM2_LoadKey(get(), blob.get(),
+            &parent->handle));
+    }
+
+    Result<Key> CreateAndLoadKey(Key& parent,
+        const TPMT_PUBLIC& publicTemplate, Span<const byte> auth = {})
+    {
+        Key key(get());
+        if (!key)
+            return Unexpected(MEMORY_E);
+        int rc = wolfTPM2_CreateAndLoadKey(get(), key.get(), &parent->handle,
+            const_cast<TPMT_PUBLIC*>(&publicTemplate), auth.data(),
+            (int)auth.size());
+        if (rc != TPM_RC_SUCCESS)
+            return Unexpected(rc);
+        return key;
+    }
+
+    /* Public part of a loaded or persistent key */
+    Result<Key> ReadPublicKey(TPM_HANDLE handle) {
+        Key key(get());
+        if (!key)
+            return Unexpected(MEMORY_E);
+        int rc = wolfTPM2_ReadPublicKey(get(), key.get(), handle);
+        if (rc != TPM_RC_SUCCESS)
+            return Unexpected(rc);
+        return key;
+    }
+
+    /* Returns the signature size written to sig */
+    Result<std::size_t> SignHash(Key& key, Span<const byte> digest,
+        Span<byte> sig)
+    {
+        int sigSz = (int)sig.size();
+        int rc = wolfTPM2_SignHash(get(), key.get(), digest.data(),
+            (int)digest.size(), sig.data(), &sigSz);
+        if (rc != TPM_RC_SUCCESS)
+            return Unexpected(rc);
+        return (std::size_t)sigSz;
+    }
+
+    Result<void> VerifyHash(Key& key, Span<const byte> sig,
+        Span<const byte> digest)
+    {
+        return detail::Check(wolfTPM2_VerifyHash(get(), key.get(), sig.data(),
+            (int)sig.size(), digest.data(), (int)digest.size()));
+    }
+
+    /* Returns the digest size written */
+    Result<std::size_t> ReadPCR(int pcrIndex, TPM_ALG_ID hashAlg,
+        Span<byte> digest)
+    {
+        int digestSz = (int)digest.size();
+        if (digestSz < TPM2_GetHashDigestSize(hashAlg))
+            return Unexpected(BUFFER_E);
+        int rc = wolfTPM2_ReadPCR(get(), pcrIndex, hashAlg, digest.data(),
+            &digestSz);
+        if (rc != TPM_RC_SUCCESS)
+            return Unexpected(rc);
+        return (std::size_t)digestSz;
+    }
+
+    Result<void> ExtendPCR(int pcrIndex, TPM_ALG_ID hashAlg,
+        Span<const byte> digest)
+    {
+        return detail::Check(wolfTPM2_ExtendPCR(get(), pcrIndex, hashAlg,
+            digest.data(), (int)digest.size()));
+    }
+
+    /* saltKey is optional, encDecAlg is TPM_ALG_CFB, TPM_ALG_XOR or
+     * TPM_ALG_NULL */
+    Result<Session> StartSession(TPM_SE sesType, int encDecAlg,
+        Key* saltKey = nullptr)
+    {
+        Session session(get());
+        if (!session)
+            return Unexpected(MEMORY_E);
+        int rc = wolfTPM2_StartSession(get(), session.get(),
+            saltKey != nullptr ? saltKey->get() : nullptr, nullptr, sesType,
+            encDecAlg);
+        if (rc != TPM_RC_SUCCESS)
+            return Unexpected(rc);
+        return session;
+    }
+
+    /* The session must stay alive while it is set on the device */
+    Result<void> SetAuthSession(int index, Session& session,
+        TPMA_SESSION sessionAttributes)
+    {
+        return detail::Check(wolfTPM2_SetAuthSession(get(), index,
+            session.get(), sessionAttributes));
+    }
+
+    Result<void> UnsetAuth(int index) {
+        return detail::Check(wolfTPM2_UnsetAuth(get(), index));
+    }
+
+private:
+    struct Deleter {
+        void operator()(WOLFTPM2_DEV* dev) const noexcept {
+            wolfTPM2_Cleanup(dev);
+            delete dev;
+        }
+    };
+
+    explicit Device(std::unique_ptr<WOLFTPM2_DEV, Deleter> dev) noexcept
+        : dev_(std::move(dev)) {}
+
+    std::unique_ptr<WOLFTPM2_DEV, Deleter> dev_;
+};
+
+/******************************************************************************/
+/* --- END Device -- */
+/******************************************************************************/
+
+} /* namespace wolftpm */
+
+#endif /* !WOLFTPM2_NO_WRAPPER */
+
+#endif /* __TPM2_WRAP_HPP__ */
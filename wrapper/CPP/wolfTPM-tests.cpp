@@ -0,0 +1,180 @@
+/* wolfTPM-tests.cpp
+ *
+ * Copyright (C) 2006-2022 wolfSSL Inc.
+ *
+ * This file is part of wolfTPM.
+ *
+ * wolfTPM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfTPM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+/* Tests for the header only C++ binding (wolftpm/tpm2_wrap.hpp). The device
+ * tests run when a TPM (or the simulator) is available */
+
+#include <wolftpm/tpm2_wrap.hpp>
+#include <hal/tpm_io.h>
+
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#define AssertTrue(x) do {                                                     \
+    if (!(x)) {                                                                \
+        printf("\nERROR - %s line %d failed: %s\n", __FILE__, __LINE__, #x);   \
+        exit(EXIT_FAILURE);                                                    \
+    }                                                                          \
+} while(0)
+
+using namespace wolftpm;
+
+/* stray copies must not compile and moves must not throw */
+static_assert(!std::is_copy_constructible<Device>::value, "Device copy");
+static_assert(!std::is_copy_constructible<Key>::value, "Key copy");
+static_assert(!std::is_copy_assignable<KeyBlob>::value, "KeyBlob copy");
+static_assert(!std::is_copy_constructible<Session>::value, "Session copy");
+static_assert(std::is_nothrow_move_constructible<Key>::value, "Key move");
+static_assert(std::is_nothrow_move_assignable<Device>::value, "Device move");
+static_assert(sizeof(Key) <= 2 * sizeof(void*), "Key is a handle");
+
+static void test_Span(void)
+{
+    std::vector<byte> vec(16, 0xAA);
+    std::array<byte, 4> arr = {{1, 2, 3, 4}};
+    byte raw[8] = {0};
+
+    Span<byte> s1(vec);
+    AssertTrue(s1.data() == vec.data() && s1.size() == vec.size());
+    Span<const byte> s2(arr);
+    AssertTrue(s2.data() == arr.data() && s2.size() == 4);
+    Span<const byte> s3 = s1; /* mutable to const */
+    AssertTrue(s3.data() == vec.data());
+    Span<byte> s4(raw);
+    AssertTrue(s4.size() == sizeof(raw));
+    AssertTrue(s1.first(4).size() == 4 && s1.first(64).size() == 16);
+    AssertTrue(Span<const byte>().empty());
+    /* element types of a different size are rejected */
+    static_assert(!std::is_constructible<Span<byte>,
+        std::vector<word32>&>::value, "Span element size");
+    /* a temporary container would leave the span dangling */
+    static_assert(!std::is_constructible<Span<const byte>,
+        std::vector<byte>&&>::value, "Span of a temporary");
+    static_assert(std::is_constructible<Span<const byte>,
+        const std::vector<byte>&>::value, "Span of a const container");
+
+    printf("Test C++ Wrapper:\tSpan:\t\t\tPassed\n");
+}
+
+static Result<int> ResultHelper(int rc)
+{
+    if (rc != 0)
+        return Unexpected(rc);
+    return 42;
+}
+
+static void test_Result(void)
+{
+    Result<int> ok = ResultHelper(0);
+    AssertTrue(ok && ok.error() == 0 && *ok == 42);
+    Result<int> bad = ResultHelper(TPM_RC_FAILURE);
+    AssertTrue(!bad && bad.error() == TPM_RC_FAILURE);
+    AssertTrue(std::move(bad).value_or(7) == 7);
+    /* an error code of zero must still read as a failure */
+    Result<void> zero = Unexpected(0);
+    AssertTrue(!zero && zero.error() != 0);
+#ifdef __cpp_exceptions
+    {
+        bool caught = false;
+        try {
+            (void)ResultHelper(BAD_FUNC_ARG).value();
+        }
+        catch (const BadResultAccess& e) {
+            caught = (e.error() == BAD_FUNC_ARG);
+        }
+        AssertTrue(caught);
+    }
+#endif
+
+    printf("Test C++ Wrapper:\tResult:\t\t\tPassed\n");
+}
+
+static void test_Owned(void)
+{
+    /* an empty owner gives up a zeroed structure */
+    Key empty;
+    AssertTrue(!empty && empty.handle() == 0);
+    WOLFTPM2_KEY released = empty.release();
+    AssertTrue(released.handle.hndl == 0);
+    AssertTrue(empty.reset());
+
+    printf("Test C++ Wrapper:\tOwned:\t\t\tPassed\n");
+}
+
+static void test_Device(void)
+{
+    Result<Device> devRes = Device::Open(TPM2_IoCb, NULL);
+    if (!devRes) {
+        printf("Test C++ Wrapper:\tDevice:\t\t\tSkipped (%s)\n",
+            devRes.message());
+        return;
+    }
+    Device dev = std::move(devRes).value();
+    TPM_HANDLE flushed;
+
+    std::array<byte, 32> rnd = {};
+    AssertTrue(dev.GetRandom(rnd));
+
+    TPMT_PUBLIC tmpl;
+    AssertTrue(wolfTPM2_GetKeyTemplate_RSA_SRK(&tmpl) == 0);
+    Result<Key> srk = dev.CreatePrimaryKey(TPM_RH_OWNER, tmpl);
+    AssertTrue(srk);
+
+    AssertTrue(wolfTPM2_GetKeyTemplate_ECC(&tmpl,
+        TPMA_OBJECT_sensitiveDataOrigin | TPMA_OBJECT_userWithAuth |
+        TPMA_OBJECT_sign | TPMA_OBJECT_noDA,
+        TPM_ECC_NIST_P256, TPM_ALG_ECDSA) == 0);
+    {
+        const byte auth[] = {'k', 'e', 'y'};
+        Result<Key> key = dev.CreateAndLoadKey(*srk, tmpl, auth);
+        AssertTrue(key && key->handle() != 0);
+
+        std::array<byte, 32> digest = rnd;
+        std::array<byte, 128> sig = {};
+        Result<std::size_t> sigSz = dev.SignHash(*key, digest, sig);
+        AssertTrue(sigSz && *sigSz > 0 && *sigSz <= sig.size());
+        AssertTrue(dev.VerifyHash(*key,
+            Span<const byte>(sig.data(), *sigSz), digest));
+
+        /* moving hands the TPM slot over without a copy */
+        Key moved = std::move(*key);
+        AssertTrue(!*key && moved.handle() != 0);
+        flushed = moved.handle();
+    }
+    /* the key left scope and was flushed */
+    AssertTrue(!dev.ReadPublicKey(flushed));
+
+    AssertTrue(srk->reset());
+    AssertTrue(srk->handle() == 0);
+
+    printf("Test C++ Wrapper:\tDevice:\t\t\tPassed\n");
+}
+
+int main(void)
+{
+    test_Span();
+    test_Result();
+    test_Owned();
+    test_Device();
+    return 0;
+}